@@ -0,0 +1,155 @@
+/*
+ * Copyright (c) 2016 Dell Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * THIS CODE IS PROVIDED ON AN *AS IS* BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT
+ * LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS
+ * FOR A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+ *
+ * See the Apache Version 2.0 License for specific language governing
+ * permissions and limitations under the License.
+ */
+
+/*
+ * filename: std_event_ring.h
+ */
+
+/*
+ * Rings of events in memory shared between the event service and a client
+ */
+
+#ifndef STD_EVENT_RING_H_
+#define STD_EVENT_RING_H_
+
+#include "std_error_codes.h"
+#include "private/std_event_utils.h"
+
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+/* smallest and largest rings the service maps */
+#define STD_EVENT_RING_MIN_SIZE (4096)
+#define STD_EVENT_RING_MAX_SIZE (64*1024*1024)
+
+/*
+ * The shared part of a ring, in its own cache lines. head is only written
+ * by the producer and tail by the consumer; each side keeps its own copy
+ * of the position it writes and checks what it reads of the other, since
+ * the other side may be a misbehaving process.
+ */
+struct std_event_ring_hdr_t {
+    uint64_t head __attribute__((aligned(64)));
+    uint32_t consumer_idle;     /* the consumer waits for a wakeup on the socket */
+    uint64_t tail __attribute__((aligned(64)));
+    uint32_t producer_waiting;  /* the producer waits for a wakeup once there is room */
+    uint64_t size __attribute__((aligned(64)));
+};
+
+#define STD_EVENT_RING_HDR_LEN (256)
+
+/* one side's view of a ring */
+struct std_event_ring_t {
+    std_event_ring_hdr_t *hdr;
+    uint8_t *data;
+    uint64_t size;              /* a power of 2 */
+    uint64_t pos;               /* head for the producer, tail for the consumer */
+};
+
+/*
+ * The mapping of a client: the ring of the events it publishes followed by
+ * the ring of the events it is sent.
+ */
+struct std_event_shm_t {
+    void *base;
+    size_t len;
+    std_event_ring_t pub;
+    std_event_ring_t sub;
+};
+
+/**
+ * Create the shared memory of a client, rings initially empty. The memory
+ * is sealed so that its size can not change.
+ * @param ring_size the size of each ring, rounded up to a power of 2
+ * @param shm the mapping
+ * @param fd the shared memory to pass to the service, for the caller to close
+ * @return STD_ERR_OK or a failure
+ */
+t_std_error std_event_shm_create(size_t ring_size, std_event_shm_t *shm, int *fd);
+
+/**
+ * Map the shared memory passed by a client
+ * @param fd the shared memory
+ * @param ring_size the size of each ring, as the client said
+ * @param shm the mapping
+ * @return STD_ERR_OK or STD_ERR(COM,PARAM,0) if the size or the memory do not fit,
+ *        or the memory is not sealed against shrinking
+ */
+t_std_error std_event_shm_map(int fd, size_t ring_size, std_event_shm_t *shm);
+
+void std_event_shm_unmap(std_event_shm_t *shm);
+
+/**
+ * Add a message to a ring, in chunks if it is larger than the room there is.
+ * Waits up to timeout ms for the consumer to make room. The single producer
+ * of a ring must be serialized by the caller.
+ * @param ring the ring
+ * @param data the parts of the message
+ * @param len the number of parts
+ * @param wake_fd socket to send a wakeup on if the consumer is waiting for one
+ * @param timeout the time in ms to wait for room
+ * @return STD_ERR_OK or STD_ERR(COM,FAIL,0)
+ */
+t_std_error std_event_ring_write(std_event_ring_t *ring, std_event_msg_descr_t *data, size_t len,
+        int wake_fd, size_t timeout);
+
+/**
+ * Check if a message can be added to a ring without waiting for the consumer
+ * @param ring the ring
+ * @param len the length of the message
+ * @return true if there is room for it
+ */
+bool std_event_ring_fits(std_event_ring_t *ring, size_t len);
+
+/**
+ * Add what there is room for of a message to a ring, without waiting. If the
+ * ring fills up the consumer is asked to send a wakeup when it goes idle, to
+ * write the rest then. The single producer of a ring must be serialized by
+ * the caller, and the message finished before another is started.
+ * @param ring the ring
+ * @param data the message
+ * @param done the bytes of the message already in the ring, updated
+ * @param wake_fd socket to send a wakeup on if the consumer is waiting for one
+ * @param timeout the time in ms to wait for the socket to take a wakeup
+ * @return 1 once the message is all in the ring, 0 if the ring is full or -1
+ *        if the ring is corrupted
+ */
+int std_event_ring_write_some(std_event_ring_t *ring, std_event_msg_descr_t *data,
+        size_t &done, int wake_fd, size_t timeout);
+
+/**
+ * Take the chunks of the next message from a ring, appending them to buff
+ * after the first len bytes
+ * @param ring the ring
+ * @param buff where the message is copied, grown as needed
+ * @param len the bytes in buff, updated
+ * @return 1 when the last chunk of the message was taken, 0 if the ring is empty
+ *        or -1 if the ring is corrupted
+ */
+int std_event_ring_read(std_event_ring_t *ring, std::vector<uint8_t> &buff, size_t &len);
+
+/**
+ * Tell the producer that the consumer is going to wait for a wakeup, and wake
+ * the producer if it is waiting for room
+ * @param ring the ring
+ * @param wake_fd socket to send a wakeup on if the producer is waiting for one
+ * @param timeout the time in ms to wait for the socket to take a wakeup
+ * @return false if something was added meanwhile, and the consumer should not wait
+ */
+bool std_event_ring_idle(std_event_ring_t *ring, int wake_fd, size_t timeout);
+
+#endif /* STD_EVENT_RING_H_ */
@@ -40,8 +40,14 @@ enum event_serv_msg_types_t {
     event_serv_msg_t_DEL_REG,
     event_serv_msg_t_PUBLISH,
     event_serv_msg_t_BUFFER,
+    event_serv_msg_t_SHM,       //! set up shared memory rings, and the reply of the service
+    event_serv_msg_t_WAKEUP,    //! there is something in a ring
+    event_serv_msg_t_PUBLISH_BATCH, //! a uint32_t count of events, then the events each padded to 4 bytes
 };
 
+//the length of an event in a batch, with its padding
+#define STD_EVENT_BATCH_ALIGN(x) (((x) + 3) & ~(size_t)3)
+
 struct event_serv_msg_t {
     event_serv_msg_types_t op;
 };
@@ -56,10 +62,31 @@ struct std_event_msg_descr_t {
 };
 
 t_std_error std_event_util_event_send(std_event_client_handle handle,
-        event_serv_msg_t *msg, std_event_msg_descr_t *data, size_t len, size_t timeout);
+        event_serv_msg_t *msg, std_event_msg_descr_t *data, size_t len, size_t timeout,
+        int pass_fd=-1);
 
+/*
+ * The bytes std_event_util_event_send would write, for a caller that
+ * writes them itself (possibly in several goes)
+ */
+t_std_error std_event_util_event_frame(event_serv_msg_t *msg, std_event_msg_descr_t *data,
+        size_t len, std::vector<uint8_t> &frame);
+
+/*
+ * Find the message (the event_serv_msg_t and what follows) of the frame at
+ * the start of len bytes of data.  Returns 1 if the frame is whole, 0 if it
+ * takes at least frame_len bytes and -1 if the header is not valid.
+ */
+int std_event_util_frame_parse(const void *data, size_t len, size_t *msg_off,
+        size_t *frame_len);
+
+/*
+ * Read a frame's message into buff, which is only grown and so can be longer
+ * than the message.  The message's length is returned in msg_len if given.
+ */
 t_std_error std_event_util_event_recv(std_event_client_handle handle,
-        std::vector<uint8_t> &buff, bool allow_resize=true);
+        std::vector<uint8_t> &buff, bool allow_resize=true, int *passed_fd=NULL,
+        size_t *msg_len=NULL);
 
 t_std_error std_event_util_event_recv_msg(std_event_client_handle handle,
         std_event_msg_t *msg, void * data, size_t len) ;
@@ -0,0 +1,129 @@
+/*
+ * Copyright (c) 2016 Dell Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * THIS CODE IS PROVIDED ON AN *AS IS* BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT
+ * LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS
+ * FOR A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+ *
+ * See the Apache Version 2.0 License for specific language governing
+ * permissions and limitations under the License.
+ */
+
+/*
+ * filename: std_atomic_bitmap.h
+ */
+
+/*!
+ * \file   std_atomic_bitmap.h
+ * \brief  Bitmap that threads can update concurrently without a lock
+ */
+
+#ifndef __STD_ATOMIC_BITMAP_H
+#define __STD_ATOMIC_BITMAP_H
+
+#include "std_error_codes.h"
+#include "std_type_defs.h"
+#include "std_bit_masks.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * A bitmap of 64 bit words updated with atomic operations, for flag sets
+ * shared between threads like dirty ports. Bit n is bit n % 64 of word
+ * n / 64. Any number of threads may set, clear and read bits at once.
+ * Treat all fields as private
+ */
+typedef struct _std_atomic_bitmap_t {
+    uint64_t *ab_words; //! the bits
+    size_t ab_len; //! number of bits
+    size_t ab_num_words; //! number of words in ab_words
+} std_atomic_bitmap_t;
+
+/**
+ * @brief initialize a bitmap with all the bits clear
+ * @param bm the bitmap
+ * @param len the number of bits
+ * @return STD_ERR_OK or STD_ERR(COM,NOMEM,0)
+ */
+t_std_error std_atomic_bitmap_init(std_atomic_bitmap_t *bm, size_t len);
+
+/**
+ * @brief free the bits of a bitmap. No other thread may use it anymore
+ * @param bm the bitmap
+ */
+void std_atomic_bitmap_destroy(std_atomic_bitmap_t *bm);
+
+/**
+ * @brief set a bit. A bit that is already set is not written, so setting
+ *      a hot bit again and again does not bounce its cache line around
+ * @param bm the bitmap
+ * @param bit the bit, less than the length
+ * @return the value of the bit before
+ */
+bool std_atomic_bitmap_test_and_set(std_atomic_bitmap_t *bm, size_t bit);
+
+/**
+ * @brief clear a bit
+ * @param bm the bitmap
+ * @param bit the bit, less than the length
+ * @return the value of the bit before
+ */
+bool std_atomic_bitmap_test_and_clear(std_atomic_bitmap_t *bm, size_t bit);
+
+/**
+ * @brief read a bit
+ * @param bm the bitmap
+ * @param bit the bit, less than the length
+ * @return the value of the bit
+ */
+bool std_atomic_bitmap_test(std_atomic_bitmap_t *bm, size_t bit);
+
+/**
+ * @brief clear a word of 64 bits at once and get what it held. Each bit set
+ *      before is returned to exactly one caller, whatever the other threads do
+ * @param bm the bitmap
+ * @param word the word, bits word * 64 to word * 64 + 63
+ * @return the bits of the word before
+ */
+uint64_t std_atomic_bitmap_fetch_and_clear_word(std_atomic_bitmap_t *bm, size_t word);
+
+/**
+ * @brief find the first bit set at or after 'from'. The words are read one
+ *      after the other while the bits may change: the bit returned was set
+ *      when its word was read, and a bit set all along the search is not
+ *      missed, but one set or cleared meanwhile may or may not be seen
+ * @param bm the bitmap
+ * @param from the bit to start at
+ * @return the bit, or -1 if none was found
+ */
+int std_atomic_bitmap_find_first(std_atomic_bitmap_t *bm, size_t from);
+
+/**
+ * @brief clear all the bits word by word with std_atomic_bitmap_fetch_and_clear_word,
+ *      calling a function for each bit that was set. A bit set again while its
+ *      word is visited is kept for the next drain
+ * @param bm the bitmap
+ * @param visit the function to call, see std_bit_visit_fn; returning false
+ *      stops the drain and the bits not visited yet are set back
+ * @param context passed to the function
+ * @return the number of bits visited
+ */
+size_t std_atomic_bitmap_drain(std_atomic_bitmap_t *bm, std_bit_visit_fn visit, void *context);
+
+/**
+ * @brief get the number of words of a bitmap
+ */
+size_t std_atomic_bitmap_num_words(std_atomic_bitmap_t *bm);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __STD_ATOMIC_BITMAP_H */
@@ -153,6 +153,137 @@ int std_find_first_bit(void *array, size_t len, size_t from) ;
  */
 int std_find_last_bit(void *varray, size_t len, size_t from);
 
+/**
+ * Find the first bit set to 0 in the array of bits.
+ * @param array the array of bits
+ * @param len the length of array in bits
+ * @param from starting from a specific bit position in the range 0 to len-1
+ * @return -1 if all the bits from 'from' are set, otherwise the bit position
+ */
+int std_find_next_zero_bit(void *array, size_t len, size_t from);
+
+/**
+ * Count the bits set to 1 in a range of an array of bits.
+ * @param array the array of bits
+ * @param from the first bit of the range
+ * @param to one past the last bit of the range
+ * @return the number of bits set
+ */
+size_t std_count_bits(void *array, size_t from, size_t to);
+
+/**
+ * A function called for each bit set by std_for_each_bit
+ * @param context the context passed to std_for_each_bit
+ * @param bit the position of the bit
+ * @return true to go on, false to stop
+ */
+typedef bool (*std_bit_visit_fn)(void *context, size_t bit);
+
+/**
+ * Call a function for each bit set to 1 in the array of bits, in order.
+ * @param array the array of bits
+ * @param len the length of array in bits
+ * @param visit the function to call
+ * @param context passed to the function
+ * @return the number of bits visited
+ */
+size_t std_for_each_bit(void *array, size_t len, std_bit_visit_fn visit, void *context);
+
+/**
+ * A loop over the bits set to 1 in a bit array.  bit is an int variable.
+@verbatim
+    int port;
+    STD_BIT_ARRAY_FOR_EACH(ports, 256, port) {
+        ...
+    }
+@endverbatim
+ */
+#define STD_BIT_ARRAY_FOR_EACH(name, len, bit) \
+    for ((bit) = std_find_first_bit((name), (len), 0); (bit) >= 0; \
+         (bit) = std_find_first_bit((name), (len), (bit) + 1))
+
+
+/**
+ * The bulk operations on bit arrays
+ */
+typedef enum {
+    STD_BIT_OP_AND,     /* a & b */
+    STD_BIT_OP_OR,      /* a | b */
+    STD_BIT_OP_XOR,     /* a ^ b */
+    STD_BIT_OP_ANDNOT,  /* a & ~b */
+} std_bit_op_t;
+
+/**
+ * Combine two bit arrays into a third, dst = a op b, with SSE2 or AVX2 when
+ * the CPU has them. dst may be a or b to do it in place. The bits of dst
+ * past len are left alone.
+ * @param dst the result
+ * @param a the first bit array
+ * @param b the second bit array
+ * @param len the length of the arrays in bits
+ * @param op the operation
+ */
+void std_bit_array_op(void *dst, const void *a, const void *b, size_t len, std_bit_op_t op);
+
+/**
+ * dst = a & b, see std_bit_array_op
+ */
+void std_bit_array_and(void *dst, const void *a, const void *b, size_t len);
+
+/**
+ * dst = a | b, see std_bit_array_op
+ */
+void std_bit_array_or(void *dst, const void *a, const void *b, size_t len);
+
+/**
+ * dst = a ^ b, see std_bit_array_op
+ */
+void std_bit_array_xor(void *dst, const void *a, const void *b, size_t len);
+
+/**
+ * dst = a & ~b, see std_bit_array_op
+ */
+void std_bit_array_andnot(void *dst, const void *a, const void *b, size_t len);
+
+/**
+ * Combine any number of bit arrays, dst = srcs[0] op srcs[1] op ... srcs[num-1].
+ * The arrays are gone through a block at a time for all of the sources.
+ * @param dst the result, may be srcs[0] but none of the others
+ * @param op the operation
+ * @param srcs the bit arrays to combine
+ * @param num the number of bit arrays in srcs
+ * @param len the length of the arrays in bits
+ */
+void std_bit_array_op_multi(void *dst, std_bit_op_t op, const void * const *srcs,
+                            size_t num, size_t len);
+
+/**
+ * Check if two bit arrays have the same first len bits
+ * @return true if they do
+ */
+bool std_bit_array_equal(const void *a, const void *b, size_t len);
+
+/**
+ * Check if all the bits set in a are set in b, among the first len bits
+ * @return true if they are
+ */
+bool std_bit_array_subset(const void *a, const void *b, size_t len);
+
+/**
+ * Check if none of the first len bits of a bit array are set
+ * @return true if none are
+ */
+bool std_bit_array_is_empty(const void *array, size_t len);
+
+/**
+ * Set the bits from 'from' to 'to' - 1 of a bit array
+ */
+void std_bit_array_set_range(void *array, size_t from, size_t to);
+
+/**
+ * Clear the bits from 'from' to 'to' - 1 of a bit array
+ */
+void std_bit_array_clear_range(void *array, size_t from, size_t to);
 
 #ifdef __cplusplus
 }
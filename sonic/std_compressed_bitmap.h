@@ -0,0 +1,198 @@
+/*
+ * Copyright (c) 2016 Dell Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * THIS CODE IS PROVIDED ON AN *AS IS* BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT
+ * LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS
+ * FOR A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+ *
+ * See the Apache Version 2.0 License for specific language governing
+ * permissions and limitations under the License.
+ */
+
+/*
+ * filename: std_compressed_bitmap.h
+ */
+
+/*!
+ * \file   std_compressed_bitmap.h
+ * \brief  Compressed bitmap for large, sparse sets of 32 bit values
+ */
+
+#ifndef __STD_COMPRESSED_BITMAP_H
+#define __STD_COMPRESSED_BITMAP_H
+
+#include "std_error_codes.h"
+#include "std_type_defs.h"
+#include "std_bit_masks.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * A set of 32 bit values, like label or flow IDs, in the layout of roaring
+ * bitmaps. The values are split by their upper 16 bits into chunks of 64K,
+ * and only the chunks with values have a container, in one of three forms:
+ * - an array of the sorted lower 16 bits, up to 4096 values
+ * - a bitmap of 64K bits (8KB), above 4096 values
+ * - a list of runs of consecutive values, only when smaller than the other
+ *   two: made by std_cbitmap_optimize and std_cbitmap_set_range, and kept
+ *   as long as the number of runs stays small
+ *
+ * Not thread safe. Treat all fields as private
+ */
+typedef struct _std_cbitmap_t {
+    struct _std_cbitmap_container *cb_containers; //! the containers in order of their chunk
+    uint32_t cb_num; //! containers in use
+    uint32_t cb_cap; //! containers allocated
+} std_cbitmap_t;
+
+/**
+ * @brief initialize an empty bitmap
+ * @param bm the bitmap
+ */
+void std_cbitmap_init(std_cbitmap_t *bm);
+
+/**
+ * @brief free the memory of a bitmap, which is left empty
+ * @param bm the bitmap
+ */
+void std_cbitmap_destroy(std_cbitmap_t *bm);
+
+/**
+ * @brief add a value
+ * @param bm the bitmap
+ * @param value the value
+ * @return STD_ERR_OK or STD_ERR(COM,NOMEM,0)
+ */
+t_std_error std_cbitmap_set(std_cbitmap_t *bm, uint32_t value);
+
+/**
+ * @brief add all the values from first to last, both included
+ * @param bm the bitmap
+ * @param first the first value
+ * @param last the last value
+ * @return STD_ERR_OK, STD_ERR(COM,PARAM,0) if last is below first or
+ *      STD_ERR(COM,NOMEM,0)
+ */
+t_std_error std_cbitmap_set_range(std_cbitmap_t *bm, uint32_t first, uint32_t last);
+
+/**
+ * @brief remove a value
+ * @param bm the bitmap
+ * @param value the value
+ * @return STD_ERR_OK or STD_ERR(COM,NOMEM,0) if a container could not be
+ *      changed to a smaller form, in which case the value is still there
+ */
+t_std_error std_cbitmap_clear(std_cbitmap_t *bm, uint32_t value);
+
+/**
+ * @brief check for a value
+ * @param bm the bitmap
+ * @param value the value
+ * @return true if the value is in the bitmap
+ */
+bool std_cbitmap_test(const std_cbitmap_t *bm, uint32_t value);
+
+/**
+ * @brief get the number of values
+ * @param bm the bitmap
+ * @return the number of values
+ */
+uint64_t std_cbitmap_cardinality(const std_cbitmap_t *bm);
+
+/**
+ * @brief get the rank of a value
+ * @param bm the bitmap
+ * @param value the value
+ * @return the number of values in the bitmap that are less or equal to value
+ */
+uint64_t std_cbitmap_rank(const std_cbitmap_t *bm, uint32_t value);
+
+/**
+ * @brief find the lowest value at or above 'from', to iterate over the values
+@verbatim
+    uint32_t v;
+    bool found;
+    for (found = std_cbitmap_find_next(&bm, 0, &v); found;
+         found = (v != UINT32_MAX) && std_cbitmap_find_next(&bm, v + 1, &v)) {
+        ...
+    }
+@endverbatim
+ * @param bm the bitmap
+ * @param from the value to start at
+ * @param value returns the value found
+ * @return true if a value was found
+ */
+bool std_cbitmap_find_next(const std_cbitmap_t *bm, uint32_t from, uint32_t *value);
+
+/**
+ * @brief call a function for each value, in increasing order
+ * @param bm the bitmap
+ * @param visit the function, see std_bit_visit_fn; returning false stops
+ * @param context passed to the function
+ * @return the number of values visited
+ */
+size_t std_cbitmap_for_each(const std_cbitmap_t *bm, std_bit_visit_fn visit, void *context);
+
+/**
+ * @brief union of two bitmaps, dst = a | b
+ * @param dst the result, may be a or b
+ * @param a a bitmap
+ * @param b a bitmap
+ * @return STD_ERR_OK or STD_ERR(COM,NOMEM,0) in which case dst is unchanged
+ */
+t_std_error std_cbitmap_or(std_cbitmap_t *dst, const std_cbitmap_t *a, const std_cbitmap_t *b);
+
+/**
+ * @brief intersection of two bitmaps, dst = a & b
+ * @param dst the result, may be a or b
+ * @param a a bitmap
+ * @param b a bitmap
+ * @return STD_ERR_OK or STD_ERR(COM,NOMEM,0) in which case dst is unchanged
+ */
+t_std_error std_cbitmap_and(std_cbitmap_t *dst, const std_cbitmap_t *a, const std_cbitmap_t *b);
+
+/**
+ * @brief change each container to the smallest form, which turns ranges of
+ *      consecutive values into runs
+ * @param bm the bitmap
+ * @return STD_ERR_OK or STD_ERR(COM,NOMEM,0)
+ */
+t_std_error std_cbitmap_optimize(std_cbitmap_t *bm);
+
+/**
+ * @brief get the memory used by the values of a bitmap
+ * @param bm the bitmap
+ * @return the number of bytes
+ */
+size_t std_cbitmap_size_in_bytes(const std_cbitmap_t *bm);
+
+/**
+ * @brief add the bits set in a bit array, like one of std_bitmap_create_array
+ * @param bm the bitmap
+ * @param array the bit array
+ * @param len the length of array in bits
+ * @return STD_ERR_OK or STD_ERR(COM,NOMEM,0)
+ */
+t_std_error std_cbitmap_from_array(std_cbitmap_t *bm, const void *array, size_t len);
+
+/**
+ * @brief write the values of a bitmap to a bit array. The first len bits of
+ *      the array are set for the values below len and cleared otherwise
+ * @param bm the bitmap
+ * @param array the bit array
+ * @param len the length of array in bits
+ */
+void std_cbitmap_to_array(const std_cbitmap_t *bm, void *array, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __STD_COMPRESSED_BITMAP_H */
@@ -41,14 +41,77 @@
  */
 #ifndef __STD_CRC32
 #define __STD_CRC32
+#include "std_error_codes.h"
+#include "std_thread_pool.h"
 #include <stdint.h>
 #include <stddef.h>
 /*****************************************************************************
- * \brief Calculate CRC for the given buffer from the initial value
+ * \brief Calculate CRC for the given buffer from the initial value.
+ *        The CRC of a buffer can be computed in pieces by passing the result
+ *        for one piece as the initial value of the next. Folds 16 bytes at a
+ *        time with carry-less multiplies when the CPU has PCLMULQDQ, or with
+ *        slicing-by-16 tables otherwise; the result is the same either way
  * \param int init : Initial CRC value
  * \param const void *buf : Buffer for which CRC to be calculated
  * \param uint size
  * \return uint32_t : The CRC result
  *****************************************************************************/
  uint32_t std_crc32(uint32_t crc, const void *buf, size_t size);
+
+/*****************************************************************************
+ * \brief Calculate the CRC of two buffers one after the other from the CRC of
+ *        each, as if std_crc32 had been run over both
+ * \param uint32_t crc_a : CRC of the first buffer
+ * \param uint32_t crc_b : CRC of the second buffer, from an initial value of 0
+ * \param uint64_t len_b : length of the second buffer
+ * \return uint32_t : The CRC of the two buffers
+ *****************************************************************************/
+ uint32_t std_crc32_combine(uint32_t crc_a, uint32_t crc_b, uint64_t len_b);
+
+/*****************************************************************************
+ * \brief Calculate CRC for the given buffer like std_crc32, with the buffer
+ *        split in pieces of at least 1MB that are checksummed by the threads
+ *        of a pool and by the caller, then combined. Smaller buffers, or a
+ *        NULL pool, are done by the caller alone
+ * \param std_thread_pool_handle_t pool : Pool whose threads may help
+ * \param int crc : Initial CRC value
+ * \param const void *buf : Buffer for which CRC to be calculated
+ * \param size_t size
+ * \return uint32_t : The CRC result
+ *****************************************************************************/
+ uint32_t std_crc32_parallel(std_thread_pool_handle_t pool, uint32_t crc,
+                             const void *buf, size_t size);
+
+/*****************************************************************************
+ * \brief Calculate CRC of the content of a file from its current offset
+ *        to its end, and leave the offset at the end. A regular file is
+ *        mapped and checksummed with std_crc32_parallel, anything else is
+ *        read
+ * \param std_thread_pool_handle_t pool : Pool whose threads may help, or NULL
+ * \param int fd : The open file
+ * \param uint32_t *crc : The CRC result, from an initial value of 0
+ * \return STD_ERR_OK or the error of the read
+ *****************************************************************************/
+ t_std_error std_crc32_fd(std_thread_pool_handle_t pool, int fd, uint32_t *crc);
+
+/*****************************************************************************
+ * \brief Calculate CRC32C (Castagnoli polynomial 0x1edc6f41, as in iSCSI and
+ *        ext4) for the given buffer from the initial value. Streams like
+ *        std_crc32. Uses the SSE4.2 crc32 instruction on three blocks at
+ *        once when the CPU has it, slicing-by-16 tables otherwise
+ * \param int crc : Initial CRC value
+ * \param const void *buf : Buffer for which CRC to be calculated
+ * \param size_t size
+ * \return uint32_t : The CRC result
+ *****************************************************************************/
+ uint32_t std_crc32c(uint32_t crc, const void *buf, size_t size);
+
+/*****************************************************************************
+ * \brief std_crc32_combine for CRC32C
+ * \param uint32_t crc_a : CRC32C of the first buffer
+ * \param uint32_t crc_b : CRC32C of the second buffer, from an initial value of 0
+ * \param uint64_t len_b : length of the second buffer
+ * \return uint32_t : The CRC32C of the two buffers
+ *****************************************************************************/
+ uint32_t std_crc32c_combine(uint32_t crc_a, uint32_t crc_b, uint64_t len_b);
 #endif
@@ -34,6 +34,16 @@
 
 #define STD_EVENT_MAX_EVENT_MSG_SIZE (5000)
 
+/**
+ * The default size of each of the two rings of std_server_client_connect_shm
+ */
+#define STD_EVENT_SHM_RING_SIZE (4*1024*1024)
+
+/**
+ * The default most bytes of events queued for a client of an event service
+ */
+#define STD_EVENT_QUEUE_SIZE (8*1024*1024)
+
 #define STD_EVENT_PRIO_RANGE (5000)
 #define STD_EVENT_MIDDLE_PRIO (10000)
 #define STD_EVENT_HIGH_PRIO (STD_EVENT_MIDDLE_PRIO - STD_EVENT_PRIO_RANGE)
@@ -52,10 +62,34 @@
 
 typedef void * std_event_server_handle_t;
 
+/**
+ * What the event service does with an event for a client whose queue is full
+ */
+typedef enum {
+    STD_EVENT_QUEUE_DISCONNECT,     //!< close the client (the default)
+    STD_EVENT_QUEUE_DROP_OLDEST,    //!< drop the oldest events the client has not been sent
+    STD_EVENT_QUEUE_BLOCK,          //!< the publishing thread waits for room after the publish, then closes the client
+} std_event_queue_policy_t;
+
+/**
+ * Counters of the queues of the clients of an event service
+ */
+typedef struct {
+    uint64_t events_queued;     //!< events that could not be sent right away
+    uint64_t events_dropped;    //!< events dropped for STD_EVENT_QUEUE_DROP_OLDEST
+    uint64_t publisher_waits;   //!< waits for room for STD_EVENT_QUEUE_BLOCK
+    uint64_t clients_closed;    //!< clients closed because they did not keep up
+    uint64_t queue_depth;       //!< events queued now, all clients together
+    uint64_t queue_bytes;       //!< bytes queued now, all clients together
+    uint64_t queue_max_depth;   //!< most events queued for one client so far
+} std_event_server_stats_t;
+
 typedef int std_event_client_handle;
 
 typedef void * std_event_msg_buff_t;
 
+typedef void * std_event_batch_buff_t;
+
 
 #define STD_EVENT_KEY_MAX 16
 
@@ -96,6 +130,32 @@ extern "C" {
 t_std_error std_event_server_init(std_event_server_handle_t *handle, const char * event_channel_name,
         size_t threads);
 
+/**
+ * @brief set how events are queued for the clients of the event service.  An event is
+ * written to a client's socket right away when nothing is queued for it, otherwise it is
+ * queued and written when the socket can take it, so that a slow client does not hold
+ * up the others.  Events that do not fit in the ring of a client using shared memory
+ * are queued the same way, and written to the ring as the client makes room.  For
+ * STD_EVENT_QUEUE_BLOCK the publishing thread waits for the clients over the limit once
+ * the event has been handed to all the others.
+ *
+ * @param handle the handle to the event service
+ * @param policy what to do with an event for a client with a full queue
+ * @param max_bytes the most bytes of events queued for a client, 0 for STD_EVENT_QUEUE_SIZE
+ * @return a standard error code or STD_ERR_OK if successful
+ */
+t_std_error std_event_server_set_queue_policy(std_event_server_handle_t handle,
+        std_event_queue_policy_t policy, size_t max_bytes);
+
+/**
+ * @brief get the counters of the queues of the clients of the event service
+ * @param handle the handle to the event service
+ * @param stats the counters
+ * @return a standard error code or STD_ERR_OK if successful
+ */
+t_std_error std_event_server_get_stats(std_event_server_handle_t handle,
+        std_event_server_stats_t *stats);
+
 /**
  * @brief connect to the event service from another process (or thread)
  * @param handle the handle to hold the client's connection details
@@ -104,6 +164,22 @@ t_std_error std_event_server_init(std_event_server_handle_t *handle, const char
  */
 t_std_error std_server_client_connect(std_event_client_handle * handle, const char *event_channel_name);
 
+/**
+ * @brief connect to the event service with the events published and received going through
+ * two rings in memory shared with the service instead of through the socket, which then only
+ * carries registrations and wakeups.  A wakeup is only sent to a side that found its ring
+ * empty, so under load events are passed without system calls.  Otherwise the handle is
+ * used as one from std_server_client_connect.
+ *
+ * @param handle the handle to hold the client's connection details
+ * @param event_channel_name the event channel name
+ * @param ring_size the size of each ring, rounded up to a power of 2, or 0 for
+ *        STD_EVENT_SHM_RING_SIZE.  Events larger than a ring are passed in pieces.
+ * @return standard return code, a failure if the service does not support shared memory
+ */
+t_std_error std_server_client_connect_shm(std_event_client_handle * handle,
+        const char *event_channel_name, size_t ring_size);
+
 /**
  * Close a channel with the common event service
  * @param handle a valid event service handle
@@ -133,6 +209,19 @@ t_std_error std_client_publish_msg(std_event_client_handle handle, std_event_msg
 t_std_error std_client_publish_msg_data(std_event_client_handle handle,
         std_event_key_t *key,void * data, size_t len) ;
 
+/**
+ * @brief send a number of messages to the event service at once.  The messages are packed
+ * into frames of up to 256k that are each sent with one system call, and unpacked by the
+ * service which publishes them as if they had been sent one by one, in order.
+ *
+ * @param handle handle created with from the register client API
+ * @param msgs the messages to send, each followed by its data
+ * @param count the number of messages
+ * @return standard return code, on failure some of the messages may have been sent
+ */
+t_std_error std_client_publish_msg_batch(std_event_client_handle handle,
+        std_event_msg_t **msgs, size_t count);
+
 /**
  * @brief register the specified event classes with the event service - so when these types of
  * events are sent, the client is sent a copy
@@ -211,6 +300,39 @@ void std_client_free_msg_buff(std_event_msg_buff_t *msg);
  */
 std_event_msg_t * std_event_msg_from_buff(std_event_msg_buff_t buff);
 
+/**
+ * @brief allocate a buffer to receive events in batches with std_client_wait_for_events
+ * @param buffer_space the most bytes read from the event service at once.  An event larger
+ *        than that is received alone in a buffer grown for it.
+ * @return NULL on error otherwise the buffer
+ */
+std_event_batch_buff_t std_client_allocate_batch_buff(size_t buffer_space);
+
+/**
+ * @brief free a batch buffer
+ * @param buff to free
+ */
+void std_client_free_batch_buff(std_event_batch_buff_t *buff);
+
+/**
+ * @brief wait for events from the event service, and take all the whole events that have
+ * arrived, up to the space of the buffer, with a single read.  The bytes of an event that
+ * has not all arrived are kept in the buffer for the next call, so a batch buffer must
+ * only be used with one handle, and the handle only received from with the batch buffer.
+ *
+ * @param handle opened from a previous client registration
+ * @param buff the batch buffer; the events received before are no longer valid
+ * @return standard return code, STD_ERR_OK once there is at least one event in the buffer
+ */
+t_std_error std_client_wait_for_events(std_event_client_handle handle, std_event_batch_buff_t buff);
+
+/**
+ * @brief go through the events received by std_client_wait_for_events
+ * @param buff the batch buffer
+ * @return the next event, in the order they were published, or NULL after the last one
+ */
+std_event_msg_t * std_event_batch_next(std_event_batch_buff_t buff);
+
 /**
  * @brief print out the contents of a message
  * @param msg to print
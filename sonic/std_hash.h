@@ -0,0 +1,172 @@
+/*
+ * Copyright (c) 2016 Dell Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * THIS CODE IS PROVIDED ON AN *AS IS* BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT
+ * LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS
+ * FOR A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+ *
+ * See the Apache Version 2.0 License for specific language governing
+ * permissions and limitations under the License.
+ */
+
+/*
+ * filename: std_hash.h
+ */
+
+/*!
+ * \file   std_hash.h
+ * \brief  Open addressing hash table for exact match lookups.
+ */
+
+#ifndef _STD_HASH_H_
+#define _STD_HASH_H_
+
+/*---------------------------------------------------------------*\
+ *                    Includes.
+\*---------------------------------------------------------------*/
+
+#include <sys/types.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include "std_error_codes.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*---------------------------------------------------------------*\
+ *                    Data structures.
+\*---------------------------------------------------------------*/
+
+/**
+ *  The hash table keeps, like the RBT tree, only a pointer to each user
+ *  node; the key lives in the user node at the offset given at creation.
+ *  Slots are organized in groups of 16 with one metadata byte per slot
+ *  holding 7 bits of the hash. A lookup loads the metadata of a group
+ *  and compares all 16 bytes at once (SSE2 when available) so the user
+ *  node is only touched for slots whose hash bits already match.
+ *
+ *  When the table grows the entries are not moved all at once: the old
+ *  slots are migrated a few groups at a time on each insert and remove,
+ *  and lookups check both tables while the migration is in progress.
+ *
+ *  The table is not thread safe; callers must serialize access.
+ */
+typedef struct _std_hash_table * std_hash_handle;
+
+
+/*---------------------------------------------------------------*\
+ *                    Prototypes with documentation.
+\*---------------------------------------------------------------*/
+
+/**
+ *  Instantiate a hash table.
+ *  @param name Pointer to character string for name of this table.
+ *  @param keyoffset Offset in number of bytes from the start of the
+ *                   user node at which key is located.
+ *  @param keylength Length of the key in bytes.
+ *  @param hash_malloc User provided malloc routine for the slot arrays.
+ *                     If NULL malloc from libc is used.
+ *  @param hash_free User provided free routine. If NULL free from libc
+ *                   is used.
+ *  @param compare Compare callback that returns 0 when the keys of the
+ *                 two user nodes are equal. If NULL the keylength bytes
+ *                 at keyoffset are compared with memcmp.
+ *  @param hash Callback returning the hash of the key of a user node.
+ *              If NULL the keylength bytes at keyoffset are hashed.
+ *              Must be provided along with compare when the key is not
+ *              contiguous.
+ *  @return Handle to the table or NULL on failure.
+ */
+std_hash_handle std_hash_create(char *name, int keyoffset, int keylength,
+                                void *hash_malloc(size_t), void hash_free(void *),
+                                int compare(std_hash_handle h, void *, void *),
+                                uint64_t hash(std_hash_handle h, void *));
+
+/**
+ * @brief create a hash table using memcmp and the default hash over the key bytes
+ * @param name the string name of the table
+ * @param keyoffset - the offset of the key in the user node
+ * @param keylength - the length of the key in the user node
+ * @return the handle or NULL on failure
+ */
+std_hash_handle std_hash_create_simple(char *name, int keyoffset, int keylength);
+
+/**
+ *  Destruct a hash table. The user nodes still on the table are not
+ *  touched.
+ *  @param h Handle to the table.
+ */
+void std_hash_destroy(std_hash_handle h);
+
+/**
+ *  Insert a user node. The user node must contain the key at the
+ *  correct offset. Unlike the RBT tree a key may only be present once.
+ *  @param h Handle to the table.
+ *  @param data User node to insert.
+ *  @return STD_ERR_OK, or an error if the key is already present or the
+ *          table could not grow.
+ */
+t_std_error std_hash_insert(std_hash_handle h, void *data);
+
+/**
+ *  Remove a user node from the table. The user node is not freed.
+ *  @param h Handle to the table.
+ *  @param data Pointer to a user node (may be on the stack) with the key.
+ *  @return Pointer to the user node removed or NULL if not found.
+ */
+void * std_hash_remove(std_hash_handle h, void *data);
+
+/**
+ *  Find the user node with the exact key.
+ *  @param h Handle to the table.
+ *  @param data Pointer to a user node (may be on the stack) with the key.
+ *  @return Pointer to the user node on the table or NULL if not found.
+ */
+void * std_hash_getexact(std_hash_handle h, void *data);
+
+/**
+ *  Walk all the user nodes on the table, in no particular order.
+ *  User is assumed not to manipulate the table during the callbacks.
+ *  @param h Handle to the table.
+ *  @param walkcb User function to call for each user node. The variable
+ *                parameters are passed as a va_list as in std_rbtree_walk.
+ *                If the callback returns non-zero the walk stops.
+ *  @return The user node on which the walk was stopped or NULL if all
+ *          the nodes were visited.
+ */
+void * std_hash_walk(std_hash_handle h, int (* walkcb)(std_hash_handle h, void *, va_list ap), ...);
+
+/**
+ *  Get the number of user nodes on the table.
+ *  @param h Handle to the table.
+ *  @return Number of user nodes.
+ */
+u_long std_hash_count(std_hash_handle h);
+
+/**
+ * @brief the default hash function: hash the key bytes of a user node
+ * @param h the table
+ * @param data the user node holding the key
+ * @return 64 bit hash value
+ */
+uint64_t std_hash_gen_hash(std_hash_handle h, void *data);
+
+/**
+ * @brief hash an arbitrary buffer with the same function as std_hash_gen_hash
+ * @param buf the buffer
+ * @param len length of the buffer in bytes
+ * @return 64 bit hash value
+ */
+uint64_t std_hash_bytes(const void *buf, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _STD_HASH_H_ */
@@ -0,0 +1,142 @@
+/*
+ * Copyright (c) 2016 Dell Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * THIS CODE IS PROVIDED ON AN *AS IS* BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT
+ * LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS
+ * FOR A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+ *
+ * See the Apache Version 2.0 License for specific language governing
+ * permissions and limitations under the License.
+ */
+
+/*
+ * filename: std_id_allocator.h
+ */
+
+/*!
+ * \file   std_id_allocator.h
+ * \brief  Allocator of integer IDs from a range, like VLAN, LAG or nexthop IDs
+ */
+
+#ifndef __STD_ID_ALLOCATOR_H
+#define __STD_ID_ALLOCATOR_H
+
+#include "std_error_codes.h"
+#include "std_type_defs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * The free IDs are kept in a bit array, one bit set per free ID, with
+ * summary bit arrays above it: a bit of a summary is set if any of the 64
+ * bits under it is. Finding the lowest free ID walks down from the top,
+ * one 64 bit word per level, so it takes O(log64 n) whatever the fill.
+ * Treat as opaque
+ */
+typedef struct std_id_allocator_s std_id_allocator_t;
+
+/**
+ * @brief create an ID allocator with all the IDs free
+ * @param alloc returns the allocator
+ * @param first_id the lowest ID
+ * @param num_ids the number of IDs, from first_id on, at most INT_MAX
+ * @param thread_safe true to serialize the calls with a mutex
+ * @return STD_ERR_OK, STD_ERR(COM,PARAM,0) or STD_ERR(COM,NOMEM,0)
+ */
+t_std_error std_id_allocator_create(std_id_allocator_t **alloc, uint32_t first_id,
+                                    uint32_t num_ids, bool thread_safe);
+
+/**
+ * @brief free an allocator
+ * @param alloc the allocator
+ */
+void std_id_allocator_destroy(std_id_allocator_t *alloc);
+
+/**
+ * @brief allocate the lowest free ID
+ * @param alloc the allocator
+ * @param id returns the ID
+ * @return STD_ERR_OK or STD_ERR(COM,NORESOURCE,0) if all IDs are in use
+ */
+t_std_error std_id_allocator_alloc(std_id_allocator_t *alloc, uint32_t *id);
+
+/**
+ * @brief allocate a given ID
+ * @param alloc the allocator
+ * @param id the ID
+ * @return STD_ERR_OK, STD_ERR(COM,PARAM,0) if out of range or
+ *      STD_ERR(COM,NORESOURCE,0) if in use
+ */
+t_std_error std_id_allocator_alloc_specific(std_id_allocator_t *alloc, uint32_t id);
+
+/**
+ * @brief allocate the lowest range of count consecutive free IDs. Each hole
+ *      of free IDs that is too short costs a search, so it is slower than
+ *      single IDs in a fragmented allocator
+ * @param alloc the allocator
+ * @param count number of IDs
+ * @param first_id returns the first ID of the range
+ * @return STD_ERR_OK, STD_ERR(COM,PARAM,0) if count is 0 or
+ *      STD_ERR(COM,NORESOURCE,0) if there is no such range
+ */
+t_std_error std_id_allocator_alloc_range(std_id_allocator_t *alloc, uint32_t count,
+                                         uint32_t *first_id);
+
+/**
+ * @brief allocate a given range of IDs, for example the ones set aside by
+ *      the platform. Nothing is allocated if one of them is in use
+ * @param alloc the allocator
+ * @param first_id the first ID of the range
+ * @param count number of IDs
+ * @return STD_ERR_OK, STD_ERR(COM,PARAM,0) if out of range or
+ *      STD_ERR(COM,NORESOURCE,0) if one of them is in use
+ */
+t_std_error std_id_allocator_reserve(std_id_allocator_t *alloc, uint32_t first_id,
+                                     uint32_t count);
+
+/**
+ * @brief free an ID
+ * @param alloc the allocator
+ * @param id the ID
+ * @return STD_ERR_OK, STD_ERR(COM,PARAM,0) if out of range or
+ *      STD_ERR(COM,NEXIST,0) if it was not allocated
+ */
+t_std_error std_id_allocator_free(std_id_allocator_t *alloc, uint32_t id);
+
+/**
+ * @brief free a range of IDs, allocated or not
+ * @param alloc the allocator
+ * @param first_id the first ID of the range
+ * @param count number of IDs
+ * @return STD_ERR_OK or STD_ERR(COM,PARAM,0) if out of range
+ */
+t_std_error std_id_allocator_free_range(std_id_allocator_t *alloc, uint32_t first_id,
+                                        uint32_t count);
+
+/**
+ * @brief check if an ID is allocated
+ * @param alloc the allocator
+ * @param id the ID
+ * @return true if allocated, false if free or out of range
+ */
+bool std_id_allocator_is_allocated(std_id_allocator_t *alloc, uint32_t id);
+
+/**
+ * @brief get the number of free IDs
+ * @param alloc the allocator
+ * @return the number of free IDs
+ */
+uint32_t std_id_allocator_num_free(std_id_allocator_t *alloc);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __STD_ID_ALLOCATOR_H */
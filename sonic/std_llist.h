@@ -75,6 +75,39 @@ typedef struct _std_dll_head {
 } std_dll_head;
 
 
+/// Number of index levels kept above the list by a skip list head
+#define STD_DLL_SKIP_LEVELS 8
+
+/**
+ * Node of a skip list: a sorted list with an index on top for
+ * O(log n) insert and search. Has to be the first in the user structure,
+ * in place of the std_dll, and is walked with the same std_dll calls
+@verbatim
+
+struct my_timer_s {
+    std_dll_skip list_pointers;
+    uint32_t expiry;
+};
+
+@endverbatim
+ */
+typedef struct _std_dll_skip {
+    std_dll dll; //! the list links, must be first
+    struct _std_dll_skip *skip_next[STD_DLL_SKIP_LEVELS]; //! next node on each index level
+    unsigned char skip_height; //! number of index levels this node is on
+} std_dll_skip;
+
+/**
+ * Head of a skip list. Pass &head->dll to the std_dll calls.
+ * An internally handled structure, treat all fields as private
+ */
+typedef struct _std_dll_skip_head {
+    std_dll_head dll; //! the list head, must be first
+    std_dll_skip *skip_next[STD_DLL_SKIP_LEVELS]; //! first node on each index level
+    unsigned char skip_height; //! number of index levels in use
+    unsigned int skip_seed; //! state of the level generator
+} std_dll_skip_head;
+
 #define std_dll_islinked(item) ((item)->dll_next && (item)->dll_back)
 
 /**
@@ -92,6 +125,36 @@ void std_dll_init(std_dll_head *head);
  */
 void std_dll_init_sort(std_dll_head *head,std_compare_function compare, unsigned int offset, unsigned int len);
 
+/**
+ * @brief initialize a skip list head. Like a sorted list std_dll_insert inserts
+ *      elements sorted (after any element with an equal key) but it finds the place
+ *      in O(log n), as does std_dll_find. Elements must be std_dll_skip structures,
+ *      may only be added with std_dll_insert and removed with std_dll_remove.
+ *      std_dll_getfirst/getnext/getprev work as on any other list
+ * @param head skip list structure to init
+ * @param compare function to compare keys
+ * @param offset of field to compare - use offsetof(struct,field) from stddef.h
+ * @param len length of data type to compare
+ */
+void std_dll_init_skip(std_dll_skip_head *head,std_compare_function compare, unsigned int offset, unsigned int len);
+
+/**
+ * @brief find the first element of a sorted or skip list with a key
+ * @param head pointer to dll structure
+ * @param key pointer to the key value to look for
+ * @return pointer to element or NULL if no element has the key
+ */
+std_dll * std_dll_find(std_dll_head *head, const void *key);
+
+/**
+ * @brief find the first element of a sorted or skip list with a key equal to or
+ *      greater than the one given
+ * @param head pointer to dll structure
+ * @param key pointer to the key value to look for
+ * @return pointer to element or NULL if all keys are smaller
+ */
+std_dll * std_dll_find_ge(std_dll_head *head, const void *key);
+
 /**
  * @brief compare integers in linked list structure
  * @param current the left hand side for the compare
@@ -186,5 +249,17 @@ void std_dll_insertbefore(std_dll_head *head, std_dll *before, std_dll *newnode)
  */
 void std_dll_remove(std_dll_head *head, std_dll *item);
 
+/**
+ * @brief sort the elements of a list in place with a stable bottom up merge sort
+ *      on the list links, in O(n log n) and without allocating memory.
+ *      Skip lists are always sorted and are left alone
+ * @param head list to sort
+ * @param compare function to compare keys, or NULL to use the one the list was
+ *      initialized with, along with its offset and len
+ * @param offset of field to compare - use offsetof(struct,field) from stddef.h
+ * @param len length of data type to compare
+ */
+void std_dll_sort(std_dll_head *head, std_compare_function compare, unsigned int offset, unsigned int len);
+
 
 #endif /* _LLIST_H_ */
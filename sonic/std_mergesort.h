@@ -28,6 +28,7 @@
 #define __STD_MERGE_SORT_H__
 
 #include <stdio.h>
+#include "std_thread_pool.h"
 
 /**
  * @brief std_merge_sort_cmp function User defined comparison function
@@ -67,4 +68,139 @@ typedef void (* std_merge_sort_copyfn) (void *context,
 void std_merge_sort (void *context, void *array, int numElements,
              void *tmpArray, std_merge_sort_cmp cmp_func,
              std_merge_sort_copyfn copy_func);
+
+/**
+ * @brief std_merge_sort_parallel sorts like std_merge_sort using the threads of a
+ *        thread pool. The array is cut in runs that are sorted concurrently, then
+ *        the runs are merged pairwise with each merge split between the threads.
+ *        The order is stable and the callbacks are the same as for std_merge_sort,
+ *        but they are called from several threads at once; they may only touch
+ *        the elements they are given. The calling thread takes part in the sort
+ *        and does not rely on the pool being idle, so it may be called from a
+ *        job of the same pool. Small arrays are sorted by the calling thread.
+ *
+ * @param pool  Thread pool to run the sort on, or NULL to sort on the calling thread.
+ * @param context Context provided by the application.
+ * @param array  The input array that needs to be sorted.
+ * @param numElements Number of elements in the array.
+ * @param tmpArray A temporary array of the same size as 'array'.
+ * @param std_merge_sort_cmp  User defined comparison function.
+ * @param std_merge_sort_copyfn  User defined copy function.
+ * @return void
+ */
+void std_merge_sort_parallel (std_thread_pool_handle_t pool, void *context,
+             void *array, int numElements, void *tmpArray,
+             std_merge_sort_cmp cmp_func, std_merge_sort_copyfn copy_func);
+
+/**
+ * @brief std_merge_run_read function User defined function that refills the
+ *        buffer of a run with its next elements
+ *
+ * @param context Context provided by the application.
+ * @param run_arg  The run_arg of the run
+ * @param buffer  The buffer of the run
+ * @param max  Number of elements that fit in the buffer
+ * @return number of elements read, 0 at the end of the run or < 0 on error
+ */
+typedef int (* std_merge_run_read) (void *context, void *run_arg,
+                                 void *buffer, int max);
+
+/**
+ * An input of std_kway_merge, sorted in the order of the comparison function
+ */
+typedef struct {
+    void *buffer;               /* elements of the run */
+    int num_elements;           /* elements in buffer, or its capacity if read is set */
+    std_merge_run_read read;    /* NULL if the whole run is in buffer */
+    void *run_arg;              /* passed to read */
+} std_merge_run_t;
+
+typedef struct std_kway_merge_s std_kway_merge_t;
+
+/**
+ * @brief std_kway_merge_create starts a streaming merge of sorted runs. The
+ *        elements are handed out one at a time in sorted order by
+ *        std_kway_merge_next, using a tournament (loser) tree, so each element
+ *        costs log2(num_runs) compares. Equal elements come out in the order of
+ *        their runs, which keeps the merge stable. The runs with a read
+ *        function are filled once here and again whenever their buffer has been
+ *        handed out, so a run can be larger than memory, e.g. in a file.
+ *
+ * @param merge  Returns the merge.
+ * @param context Context provided by the application.
+ * @param runs  The runs to merge; the array is copied and may be freed.
+ * @param num_runs  Number of runs.
+ * @param std_merge_sort_cmp  User defined comparison function.
+ * @return STD_ERR_OK, STD_ERR(COM,NOMEM,0) or STD_ERR(COM,FAIL,0) if a read failed
+ */
+t_std_error std_kway_merge_create (std_kway_merge_t **merge, void *context,
+             std_merge_run_t *runs, int num_runs, std_merge_sort_cmp cmp_func);
+
+/**
+ * @brief std_kway_merge_next gives the next element of the merge. It is left in
+ *        the buffer of its run and stays there until the following call.
+ *
+ * @param merge  The merge.
+ * @param array  Returns the buffer that holds the element.
+ * @param index  Returns the index of the element in the buffer.
+ * @return STD_ERR_OK, STD_ERR(COM,NEXIST,0) after the last element or
+ *         STD_ERR(COM,FAIL,0) if a read failed
+ */
+t_std_error std_kway_merge_next (std_kway_merge_t *merge, void **array, int *index);
+
+/**
+ * @brief std_kway_merge_destroy frees a merge. The runs are left alone.
+ *
+ * @param merge  The merge.
+ */
+void std_kway_merge_destroy (std_kway_merge_t *merge);
+
+/**
+ * @brief std_external_sort_input function User defined function that gives the
+ *        next elements to sort
+ *
+ * @param context Context provided by the application.
+ * @param array  Array to fill.
+ * @param max  Number of elements that fit in the array.
+ * @return number of elements read, 0 at the end of the input or < 0 on error
+ */
+typedef int (* std_external_sort_input) (void *context, void *array, int max);
+
+/**
+ * @brief std_external_sort_output function User defined function that is
+ *        given the sorted elements one at a time
+ *
+ * @param context Context provided by the application.
+ * @param array  Array that holds the element.
+ * @param index  Index of the element in the array.
+ * @return STD_ERR_OK to go on, an error stops the sort and is returned by it
+ */
+typedef t_std_error (* std_external_sort_output) (void *context, void *array, int index);
+
+/**
+ * @brief std_external_sort sorts an input of any size with a bounded amount of
+ *        memory. The input is read in chunks of mem_elements / 2 elements that
+ *        are sorted with std_merge_sort. If it all fits in one chunk it is output
+ *        from memory, otherwise each chunk is written to an unlinked file in
+ *        tmp_dir and the runs are merged with std_kway_merge, in several passes
+ *        if there are too many of them for the memory. The sort is stable.
+ *        The elements are elem_size bytes laid out one after the other, and are
+ *        written to the files as they are, so they must not hold pointers.
+ *
+ * @param context Context provided by the application.
+ * @param elem_size  Size of an element in bytes.
+ * @param mem_elements  Number of elements that may be held in memory, at least 3.
+ * @param tmp_dir  Directory for the run files, NULL for /tmp.
+ * @param input  Gives the elements to sort.
+ * @param output  Takes the sorted elements.
+ * @param std_merge_sort_cmp  User defined comparison function.
+ * @param std_merge_sort_copyfn  User defined copy function.
+ * @return STD_ERR_OK, the error of output, or an error if the memory, the
+ *         input or the run files fail
+ */
+t_std_error std_external_sort (void *context, size_t elem_size, int mem_elements,
+             const char *tmp_dir, std_external_sort_input input,
+             std_external_sort_output output, std_merge_sort_cmp cmp_func,
+             std_merge_sort_copyfn copy_func);
+
 #endif /* !__STD_MERGE_SORT_H__ */
@@ -0,0 +1,133 @@
+/*
+ * Copyright (c) 2016 Dell Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * THIS CODE IS PROVIDED ON AN *AS IS* BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT
+ * LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS
+ * FOR A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+ *
+ * See the Apache Version 2.0 License for specific language governing
+ * permissions and limitations under the License.
+ */
+
+/*
+ * filename: std_mpsc_queue.h
+ */
+
+/*!
+ * \file   std_mpsc_queue.h
+ * \brief  Lock-free multi producer, single consumer intrusive queue
+ */
+
+#ifndef __STD_MPSC_QUEUE_H
+#define __STD_MPSC_QUEUE_H
+
+#include "std_error_codes.h"
+#include "std_type_defs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * The links of a queue element. Like std_dll it is embedded in the user
+ * structure, preferably first
+@verbatim
+
+struct my_work_s {
+    std_mpsc_node_t link;
+    int job;
+};
+
+@endverbatim
+ */
+typedef struct _std_mpsc_node_t {
+    struct _std_mpsc_node_t *mpsc_next; //! next element, in queue order
+} std_mpsc_node_t;
+
+/**
+ * The queue. Any number of threads may push, but only one thread at a
+ * time may pop. Producers only touch mpsc_head and the consumer mostly
+ * the rest, so the two are kept on separate cache lines.
+ * Treat all fields as private
+ */
+typedef struct _std_mpsc_queue_t {
+    std_mpsc_node_t *mpsc_head __attribute__((aligned(64))); //! last element pushed
+    std_mpsc_node_t mpsc_stub __attribute__((aligned(64))); //! stub.mpsc_next is the oldest element
+    std_mpsc_node_t *mpsc_cache; //! elements taken off the queue by the consumer not yet popped
+    int mpsc_fd; //! eventfd for the wakeup or -1
+} std_mpsc_queue_t;
+
+/**
+ * @brief initialize a queue
+ * @param q the queue to initialize
+ * @param wakeup true to have pushes on an empty queue signal an eventfd that
+ *      the consumer can wait on (see std_mpsc_queue_get_fd)
+ * @return STD_ERR_OK or an error if the eventfd can not be created
+ */
+t_std_error std_mpsc_queue_init(std_mpsc_queue_t *q, bool wakeup);
+
+/**
+ * @brief release the resources of a queue. Elements still on it are not touched
+ * @param q the queue
+ */
+void std_mpsc_queue_destroy(std_mpsc_queue_t *q);
+
+/**
+ * @brief add an element at the end of the queue. Wait-free: a single atomic
+ *      exchange. May be called from any thread
+ * @param q the queue
+ * @param node the element to add
+ */
+void std_mpsc_queue_push(std_mpsc_queue_t *q, std_mpsc_node_t *node);
+
+/**
+ * @brief take the oldest element off the queue. Consumer thread only
+ * @param q the queue
+ * @return the element or NULL if the queue is empty
+ */
+std_mpsc_node_t * std_mpsc_queue_pop(std_mpsc_queue_t *q);
+
+/**
+ * @brief take every element off the queue at once. Consumer thread only
+ * @param q the queue
+ * @return the oldest element, the others follow in order through mpsc_next and
+ *      the last one has a NULL mpsc_next. NULL if the queue is empty
+ */
+std_mpsc_node_t * std_mpsc_queue_pop_all(std_mpsc_queue_t *q);
+
+/**
+ * @brief get the eventfd of a queue initialized with wakeup. It becomes readable
+ *      when an element is pushed on a queue the consumer had emptied; it may be
+ *      added to select along with sockets. Once readable, call
+ *      std_mpsc_queue_wakeup_clear and then pop until the queue is empty
+ * @param q the queue
+ * @return the fd or -1 if the queue has no wakeup
+ */
+int std_mpsc_queue_get_fd(std_mpsc_queue_t *q);
+
+/**
+ * @brief reset the eventfd of the queue, done before popping after a wakeup
+ * @param q the queue
+ */
+void std_mpsc_queue_wakeup_clear(std_mpsc_queue_t *q);
+
+/**
+ * @brief block the consumer until the queue may have elements. Returns
+ *      immediately if it was signalled since the last wait. Pop until the queue
+ *      is empty after each wait
+ * @param q the queue, initialized with wakeup
+ * @param timeout_ms time to wait in milli seconds, negative to wait forever
+ * @return STD_ERR_OK when signalled or an error on timeout or failure
+ */
+t_std_error std_mpsc_queue_wait(std_mpsc_queue_t *q, int timeout_ms);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __STD_MPSC_QUEUE_H */
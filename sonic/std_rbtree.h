@@ -32,6 +32,7 @@
 
 #include <sys/types.h>
 #include <stdarg.h>
+#include <stdint.h>
 #include "std_error_codes.h"
 
 /*---------------------------------------------------------------*\
@@ -49,6 +50,9 @@ enum { RBT_BLACK, RBT_RED };
 /// Flag value for selecting an preorder tree walk.
 #define RBT_PREORDERWALK    (1 << 0)
 
+/// Node flag: node was carved from a std_rbtree_build_sorted block.
+#define RBT_NODE_F_BULK    (1 << 0)
+
 /// Compare function for unsigned long keys.
 #define RBT_ULONG_KEY    _std_rbtree_compare_ul
 /// Compare function for integer keys.
@@ -80,6 +84,9 @@ struct _std_rbtree_node
     /// Height of the node: used only for printing tree
     u_char rbt_height;
 
+    /// Node flags (RBT_NODE_F_*); internal to RBT.
+    u_char rbt_flags;
+
     /// Client data (with key).
     void *rbt_data;
 };
@@ -88,6 +95,25 @@ struct _std_rbtree_node
 typedef struct _std_rbtree_node std_rbtree_node;
 
 
+/**
+ *  RBT node used by interval trees (see std_rbtree_create_interval).
+ *  Each node additionally caches the highest end point found in the
+ *  subtree rooted at it, which is what allows overlap searches to skip
+ *  whole subtrees.
+ */
+struct _std_rbtree_inode
+{
+    /// Basic RBT node; must be first.
+    struct _std_rbtree_node rbi_node;
+
+    /// Highest interval end point in this subtree.
+    uint64_t rbi_maxend;
+};
+
+/// Typedef for struct _std_rbtree_inode
+typedef struct _std_rbtree_inode std_rbtree_inode;
+
+
 /**
  *  Top level structure for a RBT tree. This maintains tree
  *  related information for each instance of a RBT tree
@@ -109,6 +135,12 @@ struct _std_rbtree_table
     /// Length of the key (in bytes) in user node.
     int rbtt_keylength;
 
+    /// Offset to the interval end point in user node; -1 if not an interval tree.
+    int rbtt_endoffset;
+
+    /// Size of the internal RBT node allocated for each user node.
+    size_t rbtt_nodesize;
+
     /// Root of this tree.
     struct _std_rbtree_node *rbtt_root;
 
@@ -139,6 +171,12 @@ struct _std_rbtree_table
     /// Number of frees called by RBT.
     u_long rbtt_numfrees;
 
+    /// Node blocks allocated by std_rbtree_build_sorted (internal).
+    void *rbtt_bulk;
+
+    /// Concurrent reader state, NULL unless std_rbtree_create_concurrent (internal).
+    void *rbtt_rcu;
+
     /// NIL node for this RBT tree.
     struct _std_rbtree_node nil;
 };
@@ -243,6 +281,89 @@ rbtree_handle std_rbtree_create(char *rbtt_name, int keyoffset, int keylength,
  */
 rbtree_handle std_rbtree_create_simple(char *rbtt_name, int keyoffset, int keylength);
 
+/**
+ *  Instantiate an interval tree. Each user node holds an interval
+ *  [start, end] made of two unsigned integers of the same width (for
+ *  example a VLAN range or an ACL L4 port range). Nodes are ordered by
+ *  start and then by end, and every internal node keeps the highest end
+ *  point of its subtree so that overlap and stabbing queries can prune
+ *  the search. All the std_rbtree calls work on an interval tree; the
+ *  key passed to them must contain both the start and the end.
+ *  Note that RBT nodes given to _std_rbtree_insert for an interval
+ *  tree must be std_rbtree_inode structures.
+ *  @param rbtt_name Pointer to character string for name of this tree.
+ *  @param startoffset Offset in bytes of the interval start in user node.
+ *  @param endoffset Offset in bytes of the interval end in user node.
+ *  @param keylength Width in bytes of start and end: 1, 2, 4 or 8. Both
+ *                   are in host byte order.
+ *  @return rbtree_handle - A handle to the instantiated tree or NULL
+ *          on failure.
+ */
+rbtree_handle std_rbtree_create_interval(char *rbtt_name, int startoffset,
+                                         int endoffset, int keylength);
+
+/**
+ *  Instantiate a RBT tree that may be read by many threads while it is
+ *  being updated. Lookups (std_rbtree_getfirst, std_rbtree_getexact,
+ *  std_rbtree_getexactornext, std_rbtree_getexactorprev and
+ *  std_rbtree_getnext) take no lock and never wait for a writer: they
+ *  walk down the tree and retry if a writer changed links meanwhile,
+ *  falling back to the tree mutex only after several tries in a row
+ *  were spoiled. Updates are serialized on a mutex internal to the
+ *  tree, as are walks. RBT nodes taken off the tree are
+ *  only freed once no reader can still be looking at them. The
+ *  underscore calls bypass all of this and must not be used on such a
+ *  tree, nor can it be an interval tree. std_rbtree_getnext returns
+ *  the first node with a greater key, stepping over duplicates.
+ *
+ *  A user node found by a lookup stays valid only while the caller
+ *  holds std_rbtree_read_lock, and a user node removed from the tree
+ *  must not be freed before std_rbtree_synchronize returns or must be
+ *  handed to std_rbtree_defer_free.
+ *  The parameters are as for std_rbtree_create.
+ *  @return rbtree_handle - A handle to the instantiated tree or NULL
+ *          on failure.
+ */
+rbtree_handle std_rbtree_create_concurrent(char *rbtt_name, int keyoffset, int keylength,
+                                           void *rbtt_malloc(size_t), void rbtt_free(void *),
+                                           int rbtt_compare(rbtree_handle rbtt, void *, void *));
+
+/**
+ *  Enter a read side critical section on a concurrent tree. User nodes
+ *  found on the tree remain valid until the matching
+ *  std_rbtree_read_unlock. Sections may nest. No-op on other trees.
+ *  The section must not include calls to std_rbtree_synchronize.
+ *  @param rbtt Handle to a RBT tree.
+ */
+void std_rbtree_read_lock(rbtree_handle rbtt);
+
+/**
+ *  Leave a read side critical section entered by std_rbtree_read_lock.
+ *  @param rbtt Handle to a RBT tree.
+ */
+void std_rbtree_read_unlock(rbtree_handle rbtt);
+
+/**
+ *  Wait until every reader that may have seen a node removed from a
+ *  concurrent tree has left its read side section, and release the
+ *  RBT nodes waiting for that. After the call user nodes removed
+ *  before it may be freed. No-op on other trees.
+ *  @param rbtt Handle to a RBT tree.
+ */
+void std_rbtree_synchronize(rbtree_handle rbtt);
+
+/**
+ *  Free a user node removed from a concurrent tree once no reader can
+ *  still be looking at it, without waiting for the readers.
+ *  On other trees the node is freed right away.
+ *  @param rbtt Handle to a RBT tree.
+ *  @param data User node already removed from the tree.
+ *  @param data_free Routine to free the user node with.
+ *  @return STD_ERR_OK, or STD_ERR if the request could not be queued;
+ *          the user node is then not freed.
+ */
+t_std_error std_rbtree_defer_free(rbtree_handle rbtt, void *data, void data_free(void *));
+
 /**
  *  Destruct a RBT tree. After the call the rbtt tree handle
  *  is no good. User must ensure that no user nodes are
@@ -277,12 +398,56 @@ t_std_error std_rbtree_insert(rbtree_handle rbtt, void *data);
  *              should contain the proper key in the right
  *              place for comparision callback to work properly.
  *              The parameter data need not be the same as the
- *              user node on the tree.
+ *              user node on the tree. On an interval tree holding
+ *              the same interval more than once, the node that is
+ *              data itself is removed if it is on the tree.
  *  @return Pointer to the user node removed from the tree.
  */
 void * std_rbtree_remove(rbtree_handle rbtt, void *data);
 
 
+/**
+ *  Build a tree from an array of user nodes that is already sorted in
+ *  ascending key order. On an empty tree this produces a perfectly balanced,
+ *  correctly colored tree in O(n) without any rebalancing and allocates all
+ *  the RBT internal nodes with a single call to the tree's malloc routine.
+ *  If the tree is not empty the user nodes are simply inserted one at a time.
+ *  Nodes built this way may be removed individually like any other node; the
+ *  block is released once its last node has been removed.
+ *  @param rbtt Handle to a RBT tree to operate upon.
+ *  @param data Array of pointers to user nodes, sorted by key (duplicates
+ *              are allowed). Each user node must contain the key at the
+ *              proper offset.
+ *  @param count Number of entries in data.
+ *  @return Returns STD_ERR_OK, or STD_ERR if the memory can not be allocated
+ *          or the array is not sorted. On failure the tree is unchanged.
+ */
+t_std_error std_rbtree_build_sorted(rbtree_handle rbtt, void **data, size_t count);
+
+
+/**
+ *  Remove all user nodes whose key lies in the range [lo, hi] in one pass.
+ *  Note that, as with std_rbtree_remove, the user nodes are only removed
+ *  from the tree but not freed by RBT. The callback is issued after the
+ *  node has been taken off the tree so the user may free it there.
+ *  @param rbtt Handle to a RBT tree to operate upon.
+ *  @param lo Pointer to a user node with the lowest key to remove
+ *            (inclusive). NULL means start from the first node.
+ *  @param hi Pointer to a user node with the highest key to remove
+ *            (inclusive). NULL means remove up to the last node.
+ *            When both lo and hi are NULL the whole tree is flushed
+ *            in O(n) without any rebalancing.
+ *  @param removecb User function called for each user node removed. The
+ *                  variable parameters are passed as a va_list in the
+ *                  same way as std_rbtree_walk. If the callback returns
+ *                  non-zero the removal stops after that node. May be
+ *                  NULL.
+ *  @return Number of user nodes removed from the tree.
+ */
+u_long std_rbtree_remove_range(rbtree_handle rbtt, void *lo, void *hi,
+                               int (* removecb)(rbtree_handle rbtt, void *, va_list ap), ...);
+
+
 /**
  *  Get the first user node on the tree. First means the node
  *  that has the lowest key value.
@@ -383,6 +548,47 @@ void * std_rbtree_walk(rbtree_handle rbtt, void *data,
                        int flag, ...);
 
 
+/**
+ *  Find the interval with the lowest start that overlaps [lo, hi].
+ *  Only valid on a tree created with std_rbtree_create_interval.
+ *  @param rbtt Handle to an interval tree.
+ *  @param lo Lowest point of the query range (inclusive).
+ *  @param hi Highest point of the query range (inclusive).
+ *  @return Pointer to the user node or NULL if nothing overlaps.
+ */
+void * std_rbtree_overlap_first(rbtree_handle rbtt, uint64_t lo, uint64_t hi);
+
+
+/**
+ *  Find the next interval (in tree order) after 'data' that overlaps
+ *  [lo, hi]. Use with std_rbtree_overlap_first to iterate over all the
+ *  overlapping intervals. Each call looks 'data' up again first; to
+ *  iterate over many intervals use _std_rbtree_overlap_next instead.
+ *  @param rbtt Handle to an interval tree.
+ *  @param data User node on the tree returned by a previous call.
+ *  @param lo Lowest point of the query range (inclusive).
+ *  @param hi Highest point of the query range (inclusive).
+ *  @return Pointer to the next overlapping user node or NULL.
+ */
+void * std_rbtree_overlap_next(rbtree_handle rbtt, void *data, uint64_t lo, uint64_t hi);
+
+
+/**
+ *  Stabbing query: call back for every interval that contains 'point',
+ *  in tree order. Subtrees whose highest end point is below 'point' or
+ *  whose start is above it are never visited.
+ *  @param rbtt Handle to an interval tree.
+ *  @param point The point to look up.
+ *  @param walkcb User function to call for each interval found. The
+ *                variable parameters are passed as a va_list as in
+ *                std_rbtree_walk. If the callback returns non-zero the
+ *                query stops. May be NULL to only count the intervals.
+ *  @return Number of intervals for which the callback was issued.
+ */
+u_long std_rbtree_stab(rbtree_handle rbtt, uint64_t point,
+                       int (* walkcb)(rbtree_handle rbtt, void *, va_list ap), ...);
+
+
 /**
  *  Enable/disable debugging.
  *  User may enable or disble debugging/validation checks via this call.
@@ -491,6 +697,33 @@ std_rbtree_node * _std_rbtree_getexactorprev(rbtree_handle rbtt, void *data);
 std_rbtree_node * _std_rbtree_getnext(rbtree_handle rbtt, std_rbtree_node *x);
 
 
+/**
+ *  Find the RBT node of the interval with the lowest start that overlaps
+ *  [lo, hi]. Only valid on a tree created with std_rbtree_create_interval.
+ *  @param rbtt Handle to an interval tree.
+ *  @param lo Lowest point of the query range (inclusive).
+ *  @param hi Highest point of the query range (inclusive).
+ *  @return Pointer to the RBT node or 0 if nothing overlaps.
+ */
+std_rbtree_node * _std_rbtree_overlap_first(rbtree_handle rbtt, uint64_t lo, uint64_t hi);
+
+
+/**
+ *  Find the RBT node of the next interval (in tree order) after x that
+ *  overlaps [lo, hi]. The search goes on from x itself and skips the
+ *  subtrees that can not overlap, so iterating from
+ *  _std_rbtree_overlap_first visits all k overlapping intervals in
+ *  O(log n + k) steps. The tree must not change during the iteration.
+ *  @param rbtt Handle to an interval tree.
+ *  @param x RBT node returned by a previous overlap call.
+ *  @param lo Lowest point of the query range (inclusive).
+ *  @param hi Highest point of the query range (inclusive).
+ *  @return Pointer to the next overlapping RBT node or 0.
+ */
+std_rbtree_node * _std_rbtree_overlap_next(rbtree_handle rbtt, std_rbtree_node *x,
+                                           uint64_t lo, uint64_t hi);
+
+
 /**
  *  Walk the tree with inorder or preorder callbacks.
  *  User is assumed not to manipulate the tree during the callbacks.
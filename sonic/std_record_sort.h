@@ -0,0 +1,79 @@
+/*
+ * Copyright (c) 2016 Dell Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * THIS CODE IS PROVIDED ON AN *AS IS* BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT
+ * LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS
+ * FOR A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+ *
+ * See the Apache Version 2.0 License for specific language governing
+ * permissions and limitations under the License.
+ */
+
+/*
+ * filename: std_record_sort.h
+ */
+
+/*!
+ * \file   std_record_sort.h
+ * \brief  Sort of arrays of fixed size records on a key at a known offset,
+ *         without per compare or per move callbacks
+ */
+
+#ifndef __STD_RECORD_SORT_H__
+#define __STD_RECORD_SORT_H__
+
+#include "std_error_codes.h"
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Type of the key of the records, which sets the order of the sort.
+ * Integer keys are in host byte order and need not be aligned.
+ */
+typedef enum {
+    STD_RECORD_KEY_U16,
+    STD_RECORD_KEY_U32,
+    STD_RECORD_KEY_U64,
+    STD_RECORD_KEY_I32,
+    STD_RECORD_KEY_I64,
+    /**
+     * key_len bytes compared as with memcmp. This is the numeric order of
+     * values in network byte order, like IPv4 (4) and IPv6 (16) addresses,
+     * as well as MAC addresses (6)
+     */
+    STD_RECORD_KEY_BYTES,
+} std_record_key_t;
+
+/**
+ * @brief sort an array of records of rec_size bytes in ascending order of their key.
+ *        The sort is stable. Keys up to 16 bytes are sorted with an LSD radix sort,
+ *        one pass per key byte that differs between records; other keys and short
+ *        arrays with a merge sort that compares the keys inline. Records are moved
+ *        with memcpy.
+ *
+ * @param array the records to sort
+ * @param count number of records in the array
+ * @param rec_size size of a record in bytes
+ * @param key_offset offset of the key in a record
+ * @param key_type type of the key
+ * @param key_len length of the key for STD_RECORD_KEY_BYTES, ignored otherwise
+ * @param tmp_array a temporary array of count records
+ * @return STD_ERR_OK or STD_ERR(COM,PARAM,0) if the key does not fit in the record
+ */
+t_std_error std_record_sort(void *array, size_t count, size_t rec_size,
+                            size_t key_offset, std_record_key_t key_type, size_t key_len,
+                            void *tmp_array);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __STD_RECORD_SORT_H__ */
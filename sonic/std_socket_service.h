@@ -44,6 +44,7 @@ typedef struct {
     bool (*new_client) (void *context,  int fd );  //!< New client connection established
     bool (*del_client) ( void *context, int fd ); //!< Client has closed connection
     void (*timeout)(void * context); //!< process a timeout (periodically called when no work to do)
+    bool (*writable) ( void *context, int fd ); //!< Socket can be written to, after std_socket_service_client_want_write
 } std_socket_server_t ;
 
 #ifdef __cplusplus
@@ -78,6 +79,27 @@ t_std_error std_socket_service_run(std_socket_server_handle_t handle);
  */
 t_std_error std_socket_service_client_close(std_socket_server_handle_t handle, int fd);
 
+/**
+ * Have the some_data callback called again for a client, as if its socket had data,
+ * once the current call for it (if any) returns.  For clients that have more to do
+ * than they do in one call, without hogging a thread.
+ * @param handle the handle to the socket service
+ * @param fd the file descriptor of the client
+ * @return STD_ERR_OK if things are good otherwise a specific failure condition.
+ */
+t_std_error std_socket_service_client_ready(std_socket_server_handle_t handle, int fd);
+
+/**
+ * Have the writable callback called for a client once its socket can be written to.
+ * Called once per request, from one of the service's threads and possibly along with
+ * a some_data call for the same client.  If the callback returns false the client is
+ * closed as when some_data fails, once any some_data call for it has returned.
+ * @param handle the handle to the socket service
+ * @param fd the file descriptor of the client
+ * @return STD_ERR_OK if things are good otherwise a specific failure condition.
+ */
+t_std_error std_socket_service_client_want_write(std_socket_server_handle_t handle, int fd);
+
 /**
  * Close down the socket service and clean up any open connections.
  * @param handle the handle to the socket service
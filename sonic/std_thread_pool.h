@@ -64,6 +64,7 @@ t_std_error std_thread_pool_create(std_thread_pool_handle_t *handle,
 
 /**
  * Delete an active thread pool.  Will attempt to shutdown all threads in the pool.
+ * Jobs that have not started are not run, but their free_job_func is called.
  * @param handle the handle to the thread pool
  * @return STD_ERR_OK on success otherwise a failure
  */
@@ -77,6 +78,26 @@ t_std_error std_thread_pool_delete(std_thread_pool_handle_t handle);
  */
 t_std_error std_thread_pool_job_add(std_thread_pool_handle_t handle,std_thread_pool_job_t *job);
 
+/**
+ * Get the number of threads in the thread pool
+ * @param handle the handle to the threadpool
+ * @return the number of threads the pool was created with
+ */
+size_t std_thread_pool_size(std_thread_pool_handle_t handle);
+
+/**
+ * Run task(context, ix) for each ix below num_tasks, on the pool's threads and the
+ * calling thread, and return once all of them are done.  Each thread takes the next
+ * task when it finishes one, so tasks of uneven length still keep all threads busy.
+ * With a NULL pool, or if the jobs can not be set up, the caller runs every task.
+ * @param handle the handle to the threadpool or NULL
+ * @param num_tasks the number of tasks
+ * @param task the function to call for each task
+ * @param context passed to each task
+ */
+void std_thread_pool_run_tasks(std_thread_pool_handle_t handle, size_t num_tasks,
+        void (*task)(void *context, size_t ix), void *context);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,401 @@
+/*
+ * Copyright (c) 2016 Dell Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * THIS CODE IS PROVIDED ON AN *AS IS* BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT
+ * LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS
+ * FOR A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+ *
+ * See the Apache Version 2.0 License for specific language governing
+ * permissions and limitations under the License.
+ */
+
+
+/*
+ * filename: std_tlv_compact.h
+ */
+
+#ifndef __STD_TLV_COMPACT_H
+#define __STD_TLV_COMPACT_H
+
+#include "std_tlv.h"
+#include "std_error_codes.h"
+
+/** @defgroup STDTLVCOMPACT "Compact TLV API"
+ * A compact encoding of the TLVs of std_tlv.h for small attributes: the
+ * tag and the length are varints (7 bits a byte, least significant first,
+ * the top bit set on all bytes but the last) instead of 8 bytes each, so
+ * a u32 attribute with a tag below 128 takes 6 bytes instead of 20.
+ * The data is the same as with std_tlv.h, u16/u32/u64 in little endian.
+ *
+ * The accessors follow std_tlv.h with std_tlv_compact_ names. A buffer
+ * can start with a format byte (std_tlv_format_set) so that a receiver
+ * can tell which of the two encodings the TLVs after it use, and
+ * std_tlv_to_compact/std_tlv_from_compact convert between them.
+ @{
+*/
+
+/** the longest varint, for 64 bits */
+#define STD_TLV_VARINT_MAX 10
+
+/**
+ * Encoding of the TLVs of a buffer, as found in its first byte
+ */
+typedef enum {
+    STD_TLV_FORMAT_FIXED = 'T',     //! the 16 byte headers of std_tlv.h
+    STD_TLV_FORMAT_COMPACT = 'C',   //! varint headers
+} std_tlv_format_t;
+
+/**
+ * Write the format byte at the start of a buffer
+ * @param data the buffer
+ * @param data_len the space in the buffer, updated
+ * @param format the encoding of the TLVs that will follow
+ * @return a pointer to where the first TLV goes, or NULL if no space
+ */
+static inline void * std_tlv_format_set(void *data, size_t *data_len, std_tlv_format_t format) {
+    if (*data_len < 1) return NULL;
+    *(uint8_t *)data = (uint8_t)format;
+    *data_len -= 1;
+    return (uint8_t *)data + 1;
+}
+
+/**
+ * Read the format byte at the start of a buffer
+ * @param data the buffer
+ * @param data_len the length of the buffer, updated to that of the TLVs
+ * @param first[out] the first TLV
+ * @return the format, or -1 if the buffer does not start with one
+ */
+static inline int std_tlv_format_get(void *data, size_t *data_len, void **first) {
+    uint8_t f;
+
+    if (*data_len < 1) return -1;
+    f = *(uint8_t *)data;
+    if (f != STD_TLV_FORMAT_FIXED && f != STD_TLV_FORMAT_COMPACT) return -1;
+    *data_len -= 1;
+    *first = (uint8_t *)data + 1;
+    return f;
+}
+
+/**
+ * The number of bytes of the varint of a value
+ * @param v the value
+ * @return 1 to STD_TLV_VARINT_MAX
+ */
+static inline size_t std_tlv_varint_len(uint64_t v) {
+    size_t n = 1;
+    while (v >= 0x80) {
+        v >>= 7;
+        ++n;
+    }
+    return n;
+}
+
+/**
+ * Write the varint of a value
+ * @param data where to write, with room for std_tlv_varint_len(v) bytes
+ * @param v the value
+ * @return the number of bytes written
+ */
+static inline size_t std_tlv_varint_put(void *data, uint64_t v) {
+    uint8_t *p = (uint8_t *)data;
+    size_t n = 0;
+    while (v >= 0x80) {
+        p[n++] = (uint8_t)v | 0x80;
+        v >>= 7;
+    }
+    p[n++] = (uint8_t)v;
+    return n;
+}
+
+/**
+ * Read a varint
+ * @param data the varint
+ * @param len the bytes that can be read
+ * @param v[out] the value
+ * @return the number of bytes read, or 0 if the varint is cut short, too long
+ *         or does not fit in 64 bits
+ */
+static inline size_t std_tlv_varint_get(const void *data, size_t len, uint64_t *v) {
+    const uint8_t *p = (const uint8_t *)data;
+    uint64_t r = 0;
+    size_t ix = 0;
+
+    if (len > 0 && p[0] < 0x80) {
+        *v = p[0];
+        return 1;
+    }
+    if (len > STD_TLV_VARINT_MAX) len = STD_TLV_VARINT_MAX;
+    for ( ; ix < len; ++ix) {
+        /* the last byte only has room for bit 63 */
+        if (ix == STD_TLV_VARINT_MAX - 1 && p[ix] > 0x01) return 0;
+        r |= (uint64_t)(p[ix] & 0x7f) << (7 * ix);
+        if ((p[ix] & 0x80) == 0) {
+            *v = r;
+            return ix + 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Parse the header of a compact TLV
+ * @param data the TLV
+ * @param len the bytes that can be read, or SIZE_MAX for a TLV known to be valid
+ * @param tag[out] the tag
+ * @param tlen[out] the length of the data
+ * @return the length of the header, or 0 if it is not valid
+ */
+static inline size_t std_tlv_compact_hdr(void *data, size_t len, std_tlv_tag_t *tag, std_tlv_len_t *tlen) {
+    size_t a = std_tlv_varint_get(data, len, tag), b;
+    if (a == 0) return 0;
+    b = std_tlv_varint_get((uint8_t *)data + a, len - a, tlen);
+    return (b == 0) ? 0 : a + b;
+}
+
+/**
+ * Get the tag of a compact TLV
+ * @param data the TLV
+ * @return the tag
+ */
+static inline std_tlv_tag_t std_tlv_compact_tag(void *data) {
+    std_tlv_tag_t tag = 0;
+    std_tlv_varint_get(data, STD_TLV_VARINT_MAX, &tag);
+    return tag;
+}
+
+/**
+ * Get the length of the data of a compact TLV
+ * @param data the TLV
+ * @return the length
+ */
+static inline std_tlv_len_t std_tlv_compact_len(void *data) {
+    std_tlv_tag_t tag;
+    std_tlv_len_t len = 0;
+    std_tlv_compact_hdr(data, SIZE_MAX, &tag, &len);
+    return len;
+}
+
+/**
+ * Get the total length of a compact TLV, header included
+ * @param data the TLV
+ * @return the length of the TLV
+ */
+static inline std_tlv_len_t std_tlv_compact_total_len(void *data) {
+    std_tlv_tag_t tag;
+    std_tlv_len_t len = 0;
+    size_t hl = std_tlv_compact_hdr(data, SIZE_MAX, &tag, &len);
+    return hl + len;
+}
+
+/**
+ * Get the data of a compact TLV
+ * @param data the TLV
+ */
+static inline void * std_tlv_compact_data(void *data) {
+    std_tlv_tag_t tag;
+    std_tlv_len_t len;
+    return (uint8_t *)data + std_tlv_compact_hdr(data, SIZE_MAX, &tag, &len);
+}
+
+/**
+ * Get the data of a compact TLV as a uint16_t (must use std_tlv_compact_add_u16)
+ * @param data the TLV
+ * @return the data as a uint16_t
+ */
+static inline uint16_t std_tlv_compact_data_u16(void *data) {
+    uint16_t v;
+    memcpy(&v, std_tlv_compact_data(data), sizeof(v));
+    return le16toh(v);
+}
+
+/**
+ * Get the data of a compact TLV as a uint32_t (must use std_tlv_compact_add_u32)
+ * @param data the TLV
+ * @return the data as a uint32_t
+ */
+static inline uint32_t std_tlv_compact_data_u32(void *data) {
+    uint32_t v;
+    memcpy(&v, std_tlv_compact_data(data), sizeof(v));
+    return le32toh(v);
+}
+
+/**
+ * Get the data of a compact TLV as a uint64_t (must use std_tlv_compact_add_u64)
+ * @param data the TLV
+ * @return the data as a uint64_t
+ */
+static inline uint64_t std_tlv_compact_data_u64(void *data) {
+    uint64_t v;
+    memcpy(&v, std_tlv_compact_data(data), sizeof(v));
+    return le64toh(v);
+}
+
+/**
+ * Create a compact TLV at "data" as long as data_len has enough space
+ * @param data the spot to place the TLV
+ * @param data_len the total reserved space, updated
+ * @param tag the tag of the data
+ * @param len the length of the data
+ * @param content the content to copy
+ * @return a pointer to the address directly after the new TLV or NULL if
+ *    there is not enough space
+ */
+static inline void * std_tlv_compact_add(void *data, size_t *data_len, std_tlv_tag_t tag, std_tlv_len_t len, const void *content) {
+    size_t hl = std_tlv_varint_len(tag) + std_tlv_varint_len(len);
+    uint8_t *p = (uint8_t *)data;
+
+    if (*data_len < hl || *data_len - hl < len) return NULL;
+    p += std_tlv_varint_put(p, tag);
+    p += std_tlv_varint_put(p, len);
+    memcpy(p, content, (size_t)len);
+    *data_len -= hl + (size_t)len;
+    return p + len;
+}
+
+/**
+ * Create a compact TLV of a uint16_t
+ * @param data the location at which to create the TLV
+ * @param data_len the remaining buffer space, updated
+ * @param tag the tag of the TLV
+ * @param content the uint16_t to add in an endian neutral way
+ * @return a pointer to the memory directly after the new TLV or NULL if not enough space
+ */
+static inline void * std_tlv_compact_add_u16(void *data, size_t *data_len, std_tlv_tag_t tag, uint16_t content) {
+    content = htole16(content);
+    return std_tlv_compact_add(data, data_len, tag, sizeof(content), &content);
+}
+
+/**
+ * Create a compact TLV of a uint32_t
+ * @param data the location at which to create the TLV
+ * @param data_len the remaining buffer space, updated
+ * @param tag the tag of the TLV
+ * @param content the uint32_t to add in an endian neutral way
+ * @return a pointer to the memory directly after the new TLV or NULL if not enough space
+ */
+static inline void * std_tlv_compact_add_u32(void *data, size_t *data_len, std_tlv_tag_t tag, uint32_t content) {
+    content = htole32(content);
+    return std_tlv_compact_add(data, data_len, tag, sizeof(content), &content);
+}
+
+/**
+ * Create a compact TLV of a uint64_t
+ * @param data the location at which to create the TLV
+ * @param data_len the remaining buffer space, updated
+ * @param tag the tag of the TLV
+ * @param content the uint64_t to add in an endian neutral way
+ * @return a pointer to the memory directly after the new TLV or NULL if not enough space
+ */
+static inline void * std_tlv_compact_add_u64(void *data, size_t *data_len, std_tlv_tag_t tag, uint64_t content) {
+    content = htole64(content);
+    return std_tlv_compact_add(data, data_len, tag, sizeof(content), &content);
+}
+
+/**
+ * Check that a compact TLV, header and data, fits in len bytes
+ * @param data the TLV
+ * @param len the length of memory pointed to by "data"
+ * @return true if the TLV is valid otherwise false
+ */
+static inline bool std_tlv_compact_valid(void *data, size_t len) {
+    std_tlv_tag_t tag;
+    std_tlv_len_t tlen;
+    size_t hl;
+
+    if (data == NULL) return false;
+    hl = std_tlv_compact_hdr(data, len, &tag, &tlen);
+    return hl != 0 && tlen <= len - hl;
+}
+
+/**
+ * Return a pointer to the next compact TLV or NULL if at the end
+ * @param data the pointer to the current TLV
+ * @param len the length of space that "data" contains, updated
+ * @return a pointer to the next TLV or NULL if no next
+ */
+static inline void * std_tlv_compact_next(void *data, size_t *len) {
+    size_t tlen;
+
+    if (!std_tlv_compact_valid(data, *len)) return NULL;
+    tlen = (size_t)std_tlv_compact_total_len(data);
+    *len -= tlen;
+    return (uint8_t *)data + tlen;
+}
+
+/**
+ * Find the next instance of a tag from a compact TLV on
+ * @param data the TLV to search from
+ * @param dlen the length of space that "data" contains (will be updated)
+ * @param tag the tag to find
+ * @return the pointer to the found TLV or NULL
+ */
+static inline void * std_tlv_compact_find_next(void *data, size_t *dlen, std_tlv_tag_t tag) {
+    do {
+        if (!std_tlv_compact_valid(data, *dlen)) return NULL;
+        if (std_tlv_compact_tag(data) == tag) return data;
+    } while ((data = std_tlv_compact_next(data, dlen)) != NULL);
+    return NULL;
+}
+
+/**
+ * Find a nested attribute of compact TLVs, as std_tlv_efind
+ * @param data the TLV starting position
+ * @param dlen[out] the length of the current TLV
+ * @param tags the array of attribute IDs
+ * @param tlen the length of the tag ID array
+ * @return a pointer to the TLV if found or NULL
+ */
+static inline void * std_tlv_compact_efind(void *data, size_t *dlen, std_tlv_tag_t *tags, size_t tlen) {
+    size_t ix = 0;
+    size_t len = *dlen;
+    for ( ; ix < tlen; ++ix) {
+        data = std_tlv_compact_find_next(data, &len, tags[ix]);
+        if (data == NULL) return NULL;
+        if (ix + 1 == tlen) break;
+        len = (size_t)std_tlv_compact_len(data);
+        data = std_tlv_compact_data(data);
+    }
+    *dlen = len;
+    return data;
+}
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Convert TLVs of std_tlv.h to compact TLVs. Only the outer TLVs are
+ * converted, the data of each (nested TLVs included) is copied as is.
+ * @param dst where to write the compact TLVs, or NULL to only get the length
+ * @param dst_len[in,out] the space at dst, set to the length written
+ * @param src the TLVs
+ * @param src_len the length of the TLVs
+ * @return STD_ERR_OK, STD_ERR(COM,PARAM,0) if the TLVs do not fill src_len exactly
+ *         or STD_ERR(COM,TOOBIG,0) if dst is too small
+ */
+t_std_error std_tlv_to_compact(void *dst, size_t *dst_len, void *src, size_t src_len);
+
+/**
+ * Convert compact TLVs to TLVs of std_tlv.h, as std_tlv_to_compact
+ * @param dst where to write the TLVs, or NULL to only get the length
+ * @param dst_len[in,out] the space at dst, set to the length written
+ * @param src the compact TLVs
+ * @param src_len the length of the compact TLVs
+ * @return STD_ERR_OK, STD_ERR(COM,PARAM,0) if the TLVs do not fill src_len exactly
+ *         or STD_ERR(COM,TOOBIG,0) if dst is too small
+ */
+t_std_error std_tlv_from_compact(void *dst, size_t *dst_len, void *src, size_t src_len);
+
+#ifdef __cplusplus
+}
+#endif
+
+/** @} */
+
+#endif /* __STD_TLV_COMPACT_H */
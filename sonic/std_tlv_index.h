@@ -0,0 +1,112 @@
+/*
+ * Copyright (c) 2016 Dell Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * THIS CODE IS PROVIDED ON AN *AS IS* BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT
+ * LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS
+ * FOR A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+ *
+ * See the Apache Version 2.0 License for specific language governing
+ * permissions and limitations under the License.
+ */
+
+/*
+ * filename: std_tlv_index.h
+ */
+
+/*!
+ * \file   std_tlv_index.h
+ * \brief  Index of the tags of a TLV buffer for constant time lookups
+ */
+
+#ifndef __STD_TLV_INDEX_H
+#define __STD_TLV_INDEX_H
+
+#include "std_error_codes.h"
+#include "std_tlv.h"
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * The tags of a buffer of TLVs, made in one walk of the buffer. Lookups
+ * of a tag, of any instance of a repeated tag, and of a path of nested
+ * tags (std_tlv_efind) then take constant time instead of a walk each.
+ * The content of an attribute is indexed as nested TLVs the first time a
+ * path goes through it.
+ *
+ * The buffer must stay in place and unchanged while indexed. An index is
+ * not thread safe, std_tlv_index_efind adds to it.
+ */
+typedef struct std_tlv_index_s std_tlv_index_t;
+
+/**
+ * @brief index a buffer of TLVs, checking that the TLVs fill the buffer exactly
+ * @param index[out] the new index
+ * @param data the TLVs
+ * @param len the length of the buffer
+ * @return STD_ERR_OK, STD_ERR(COM,PARAM,0) if a TLV runs past the end of the buffer
+ *         or STD_ERR(COM,NOMEM,0)
+ */
+t_std_error std_tlv_index_create(std_tlv_index_t **index, void *data, size_t len);
+
+/**
+ * @brief free an index; the buffer is left alone
+ * @param index the index
+ */
+void std_tlv_index_destroy(std_tlv_index_t *index);
+
+/**
+ * @brief the number of instances of a tag in the buffer, not counting nested TLVs
+ * @param index the index
+ * @param tag the tag
+ * @return the number of TLVs with the tag
+ */
+size_t std_tlv_index_count(const std_tlv_index_t *index, std_tlv_tag_t tag);
+
+/**
+ * @brief an instance of a tag, like the n+1th std_tlv_find_next from the start
+ * @param index the index
+ * @param tag the tag
+ * @param n the instance, 0 for the first in the buffer
+ * @return the TLV or NULL if the tag has n instances or less
+ */
+void * std_tlv_index_find_nth(const std_tlv_index_t *index, std_tlv_tag_t tag, size_t n);
+
+/**
+ * @brief the first instance of a tag, like std_tlv_find_next from the start
+ * @param index the index
+ * @param tag the tag
+ * @return the TLV or NULL if not found
+ */
+static inline void * std_tlv_index_find(const std_tlv_index_t *index, std_tlv_tag_t tag) {
+    return std_tlv_index_find_nth(index, tag, 0);
+}
+
+/**
+ * @brief find a nested attribute like std_tlv_efind from the start of the buffer.
+ *        Nested TLVs are walked once, the first time a path enters them; as with
+ *        std_tlv_find_next, the walk of nested TLVs stops at the first one that
+ *        is not valid.
+ * @param index the index
+ * @param tags the tags of the path, from the outermost
+ * @param tlen the number of tags
+ * @param dlen[out] if found, the length from the TLV to the end of the TLVs
+ *        around it, as set by std_tlv_efind
+ * @return the TLV or NULL if not found
+ */
+void * std_tlv_index_efind(std_tlv_index_t *index, const std_tlv_tag_t *tags, size_t tlen,
+                           size_t *dlen);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __STD_TLV_INDEX_H */
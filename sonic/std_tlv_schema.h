@@ -0,0 +1,142 @@
+/*
+ * Copyright (c) 2016 Dell Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * THIS CODE IS PROVIDED ON AN *AS IS* BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT
+ * LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS
+ * FOR A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+ *
+ * See the Apache Version 2.0 License for specific language governing
+ * permissions and limitations under the License.
+ */
+
+/*
+ * filename: std_tlv_schema.h
+ */
+
+/*!
+ * \file   std_tlv_schema.h
+ * \brief  Table driven decode of TLVs into C structs, and encode back
+ */
+
+#ifndef __STD_TLV_SCHEMA_H
+#define __STD_TLV_SCHEMA_H
+
+#include "std_error_codes.h"
+#include "std_tlv.h"
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** the most fields in a schema, one bit each in the present mask */
+#define STD_TLV_SCHEMA_MAX_FIELDS 64
+
+/**
+ * How the data of a TLV maps to a member of the struct
+ */
+typedef enum {
+    /** unsigned integer of 1, 2, 4 or 8 bytes, the TLV data of the same size */
+    STD_TLV_FIELD_UINT,
+    /** array of bytes, the TLV data of the size of the array */
+    STD_TLV_FIELD_BYTES,
+    /**
+     * char array holding a NUL terminated string, the TLV data the string
+     * with its NUL. Shorter data is padded with NULs when decoded
+     */
+    STD_TLV_FIELD_STRING,
+} std_tlv_field_type_t;
+
+/** the TLV must be in the message, and is always encoded */
+#define STD_TLV_FIELD_REQUIRED  0x1
+/**
+ * the integer is in network byte order in the TLV, instead of the little
+ * endian of std_tlv_add_u16/u32/u64
+ */
+#define STD_TLV_FIELD_BE        0x2
+
+/**
+ * A member of the struct and the tag of its TLV
+ */
+typedef struct {
+    std_tlv_tag_t tag;
+    std_tlv_field_type_t type;
+    size_t offset;              //! of the member in the struct
+    size_t size;                //! of the member
+    unsigned int flags;         //! STD_TLV_FIELD_ flags
+} std_tlv_field_t;
+
+/**
+ * Initializer of a std_tlv_field_t for a member of a struct, e.g.
+ *   STD_TLV_FIELD(ATTR_MTU, STD_TLV_FIELD_UINT, intf_t, mtu, STD_TLV_FIELD_REQUIRED)
+ */
+#define STD_TLV_FIELD(tag, type, st, member, flags) \
+    { (tag), (type), offsetof(st, member), sizeof(((st *)0)->member), (flags) }
+
+/**
+ * The fields of a struct compiled into a lookup table from tag to field,
+ * so that a message is decoded in one walk of its TLVs instead of a
+ * std_tlv_find_next for each field. A schema is read only once created
+ * and can be shared between threads.
+ */
+typedef struct std_tlv_schema_s std_tlv_schema_t;
+
+/**
+ * @brief compile a schema
+ * @param schema[out] the new schema
+ * @param fields the fields, in the order they are encoded
+ * @param num_fields the number of fields, at most STD_TLV_SCHEMA_MAX_FIELDS
+ * @return STD_ERR_OK, STD_ERR(COM,PARAM,0) if a field is not valid or two have
+ *         the same tag, or STD_ERR(COM,NOMEM,0)
+ */
+t_std_error std_tlv_schema_create(std_tlv_schema_t **schema, const std_tlv_field_t *fields,
+                                  size_t num_fields);
+
+/**
+ * @brief free a schema
+ * @param schema the schema
+ */
+void std_tlv_schema_destroy(std_tlv_schema_t *schema);
+
+/**
+ * @brief fill a struct from a buffer of TLVs. Tags not in the schema are skipped,
+ *        and of a repeated tag the first is used, as with std_tlv_find_next.
+ *        Members whose TLV is not in the buffer are left as they are, so defaults
+ *        can be set before. Nested TLVs are not looked into.
+ * @param schema the schema
+ * @param data the TLVs
+ * @param len the length of the TLVs
+ * @param obj the struct
+ * @param present[out] if not NULL, bit n is set if field n was found
+ * @return STD_ERR_OK, STD_ERR(COM,PARAM,0) if the TLVs do not fill len exactly or
+ *         the data of a field has the wrong length, or STD_ERR(COM,NEXIST,0) if a
+ *         required field is missing. The struct may be partly filled on error.
+ */
+t_std_error std_tlv_schema_decode(const std_tlv_schema_t *schema, const void *data, size_t len,
+                                  void *obj, uint64_t *present);
+
+/**
+ * @brief write the fields of a struct as TLVs, in the order of the schema
+ * @param schema the schema
+ * @param obj the struct
+ * @param present bit n set to encode optional field n; required fields are always
+ *        encoded. ~0 encodes all of them.
+ * @param dst where to write the TLVs, or NULL to only get the length
+ * @param dst_len[in,out] the space at dst, set to the length written
+ * @return STD_ERR_OK, STD_ERR(COM,PARAM,0) if a string field is not NUL terminated,
+ *         or STD_ERR(COM,TOOBIG,0) if dst is too small
+ */
+t_std_error std_tlv_schema_encode(const std_tlv_schema_t *schema, const void *obj,
+                                  uint64_t present, void *dst, size_t *dst_len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __STD_TLV_SCHEMA_H */
@@ -0,0 +1,169 @@
+/*
+ * Copyright (c) 2016 Dell Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * THIS CODE IS PROVIDED ON AN *AS IS* BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT
+ * LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS
+ * FOR A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+ *
+ * See the Apache Version 2.0 License for specific language governing
+ * permissions and limitations under the License.
+ */
+
+/*
+ * filename: std_tlv_sg.h
+ */
+
+/*!
+ * \file   std_tlv_sg.h
+ * \brief  Builder of TLV messages as scatter-gather lists
+ */
+
+#ifndef __STD_TLV_SG_H
+#define __STD_TLV_SG_H
+
+#include "std_error_codes.h"
+#include "std_tlv.h"
+
+#include <stddef.h>
+#include <sys/uio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** data up to this length is copied next to its header, longer data is referenced */
+#define STD_TLV_SG_COPY_MAX 128
+
+/**
+ * A message of std_tlv.h TLVs built as a list of iovecs, ready for
+ * writev or std_socket_op, instead of in one buffer. The headers and
+ * short data are written to a small arena, one iovec for a run of them;
+ * long data gets an iovec of its own that points at it where it is.
+ *
+ * Data added by reference must stay in place and unchanged until the
+ * message is sent. Not thread safe. Treat all fields as private
+ */
+typedef struct {
+    struct iovec *sg_iov;           //! the message so far
+    size_t sg_num_iov;
+    size_t sg_cap_iov;
+    struct std_tlv_sg_block_s *sg_blocks; //! the arena, newest block first
+    uint8_t *sg_pos;                //! free space in the newest block
+    size_t sg_left;
+    bool sg_last_arena;             //! the last iovec ends at sg_pos
+    size_t sg_len;                  //! bytes in the message
+} std_tlv_sg_t;
+
+/**
+ * A TLV whose data is the TLVs added between std_tlv_sg_nest_begin and
+ * std_tlv_sg_nest_end
+ */
+typedef struct {
+    void *sgn_hdr;
+    size_t sgn_start;
+} std_tlv_sg_nest_t;
+
+/**
+ * @brief initialize an empty message
+ * @param sg the builder
+ */
+void std_tlv_sg_init(std_tlv_sg_t *sg);
+
+/**
+ * @brief free the memory of the builder; referenced data is left alone
+ * @param sg the builder
+ */
+void std_tlv_sg_destroy(std_tlv_sg_t *sg);
+
+/**
+ * @brief empty the message to build another, keeping some of the memory
+ * @param sg the builder
+ */
+void std_tlv_sg_reset(std_tlv_sg_t *sg);
+
+/**
+ * @brief add a TLV, copying data up to STD_TLV_SG_COPY_MAX bytes and referencing longer data
+ * @param sg the builder
+ * @param tag the tag
+ * @param len the length of the data
+ * @param content the data
+ * @return STD_ERR_OK or STD_ERR(COM,NOMEM,0)
+ */
+t_std_error std_tlv_sg_add(std_tlv_sg_t *sg, std_tlv_tag_t tag, std_tlv_len_t len,
+                           const void *content);
+
+/**
+ * @brief add a TLV whose data is copied whatever its length, for data that
+ *        will not outlive the call
+ * @param sg the builder
+ * @param tag the tag
+ * @param len the length of the data
+ * @param content the data
+ * @return STD_ERR_OK or STD_ERR(COM,NOMEM,0)
+ */
+t_std_error std_tlv_sg_add_copy(std_tlv_sg_t *sg, std_tlv_tag_t tag, std_tlv_len_t len,
+                                const void *content);
+
+/**
+ * @brief add TLVs of integers in an endian neutral way, as std_tlv_add_u16/u32/u64
+ * @param sg the builder
+ * @param tag the tag
+ * @param content the value
+ * @return STD_ERR_OK or STD_ERR(COM,NOMEM,0)
+ */
+t_std_error std_tlv_sg_add_u16(std_tlv_sg_t *sg, std_tlv_tag_t tag, uint16_t content);
+t_std_error std_tlv_sg_add_u32(std_tlv_sg_t *sg, std_tlv_tag_t tag, uint32_t content);
+t_std_error std_tlv_sg_add_u64(std_tlv_sg_t *sg, std_tlv_tag_t tag, uint64_t content);
+
+/**
+ * @brief start a TLV whose data is the TLVs added until std_tlv_sg_nest_end.
+ *        Nests can be nested.
+ * @param sg the builder
+ * @param tag the tag
+ * @param nest[out] to pass to std_tlv_sg_nest_end
+ * @return STD_ERR_OK or STD_ERR(COM,NOMEM,0)
+ */
+t_std_error std_tlv_sg_nest_begin(std_tlv_sg_t *sg, std_tlv_tag_t tag, std_tlv_sg_nest_t *nest);
+
+/**
+ * @brief end a TLV started with std_tlv_sg_nest_begin, setting its length
+ * @param sg the builder
+ * @param nest from std_tlv_sg_nest_begin
+ */
+void std_tlv_sg_nest_end(std_tlv_sg_t *sg, std_tlv_sg_nest_t *nest);
+
+/**
+ * @brief the message as an iovec array, valid until the next change to the builder.
+ *        Writes of more than IOV_MAX iovecs have to be split by the caller.
+ * @param sg the builder
+ * @param num_iov[out] the number of iovecs
+ * @return the iovecs
+ */
+const struct iovec * std_tlv_sg_iov(const std_tlv_sg_t *sg, size_t *num_iov);
+
+/**
+ * @brief the length of the message
+ * @param sg the builder
+ * @return the sum of the lengths of the iovecs
+ */
+size_t std_tlv_sg_len(const std_tlv_sg_t *sg);
+
+/**
+ * @brief copy the message into one buffer, as std_tlv_add would have built it
+ * @param sg the builder
+ * @param buf the buffer
+ * @param len the length of the buffer
+ * @return STD_ERR_OK or STD_ERR(COM,TOOBIG,0) if the message is longer than len
+ */
+t_std_error std_tlv_sg_copy_out(const std_tlv_sg_t *sg, void *buf, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __STD_TLV_SG_H */
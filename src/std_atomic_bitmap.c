@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2016 Dell Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * THIS CODE IS PROVIDED ON AN *AS IS* BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT
+ * LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS
+ * FOR A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+ *
+ * See the Apache Version 2.0 License for specific language governing
+ * permissions and limitations under the License.
+ */
+
+/*
+ * filename: std_atomic_bitmap.c
+ */
+
+/*!
+ * \file   std_atomic_bitmap.c
+ * \brief  Bitmap that threads can update concurrently without a lock
+ */
+
+#include "std_atomic_bitmap.h"
+
+#include <stdlib.h>
+
+#define STD_ATOMIC_BITMAP_WORD_BITS 64
+
+static inline uint64_t *std_atomic_bitmap_word(std_atomic_bitmap_t *bm, size_t bit) {
+    return &bm->ab_words[bit / STD_ATOMIC_BITMAP_WORD_BITS];
+}
+
+static inline uint64_t std_atomic_bitmap_mask(size_t bit) {
+    return 1ULL << (bit % STD_ATOMIC_BITMAP_WORD_BITS);
+}
+
+t_std_error std_atomic_bitmap_init(std_atomic_bitmap_t *bm, size_t len) {
+    bm->ab_len = len;
+    bm->ab_num_words = (len + STD_ATOMIC_BITMAP_WORD_BITS - 1) / STD_ATOMIC_BITMAP_WORD_BITS;
+    bm->ab_words = (uint64_t *)calloc(bm->ab_num_words ? bm->ab_num_words : 1, sizeof(uint64_t));
+    return (bm->ab_words == NULL) ? STD_ERR(COM,NOMEM,0) : STD_ERR_OK;
+}
+
+void std_atomic_bitmap_destroy(std_atomic_bitmap_t *bm) {
+    free(bm->ab_words);
+    bm->ab_words = NULL;
+}
+
+bool std_atomic_bitmap_test_and_set(std_atomic_bitmap_t *bm, size_t bit) {
+    uint64_t *word = std_atomic_bitmap_word(bm, bit), mask = std_atomic_bitmap_mask(bit);
+
+    if (__atomic_load_n(word, __ATOMIC_ACQUIRE) & mask) return true;
+    return (__atomic_fetch_or(word, mask, __ATOMIC_ACQ_REL) & mask) != 0;
+}
+
+bool std_atomic_bitmap_test_and_clear(std_atomic_bitmap_t *bm, size_t bit) {
+    uint64_t *word = std_atomic_bitmap_word(bm, bit), mask = std_atomic_bitmap_mask(bit);
+
+    if (!(__atomic_load_n(word, __ATOMIC_ACQUIRE) & mask)) return false;
+    return (__atomic_fetch_and(word, ~mask, __ATOMIC_ACQ_REL) & mask) != 0;
+}
+
+bool std_atomic_bitmap_test(std_atomic_bitmap_t *bm, size_t bit) {
+    return (__atomic_load_n(std_atomic_bitmap_word(bm, bit), __ATOMIC_ACQUIRE) &
+            std_atomic_bitmap_mask(bit)) != 0;
+}
+
+uint64_t std_atomic_bitmap_fetch_and_clear_word(std_atomic_bitmap_t *bm, size_t word) {
+    uint64_t *w = &bm->ab_words[word];
+
+    /* no store for an empty word, which is the common case of a scan */
+    if (__atomic_load_n(w, __ATOMIC_RELAXED) == 0) return 0;
+    return __atomic_exchange_n(w, 0, __ATOMIC_ACQ_REL);
+}
+
+int std_atomic_bitmap_find_first(std_atomic_bitmap_t *bm, size_t from) {
+    size_t word = from / STD_ATOMIC_BITMAP_WORD_BITS, bit;
+    uint64_t w;
+
+    if (from >= bm->ab_len) return -1;
+
+    w = __atomic_load_n(&bm->ab_words[word], __ATOMIC_ACQUIRE) & (~0ULL << (from % STD_ATOMIC_BITMAP_WORD_BITS));
+    while (w == 0) {
+        if (++word == bm->ab_num_words) return -1;
+        w = __atomic_load_n(&bm->ab_words[word], __ATOMIC_ACQUIRE);
+    }
+    bit = word * STD_ATOMIC_BITMAP_WORD_BITS + __builtin_ctzll(w);
+    return (bit < bm->ab_len) ? (int)bit : -1;
+}
+
+size_t std_atomic_bitmap_drain(std_atomic_bitmap_t *bm, std_bit_visit_fn visit, void *context) {
+    size_t word, n = 0;
+    uint64_t w;
+
+    for (word = 0; word < bm->ab_num_words; ++word) {
+        for (w = std_atomic_bitmap_fetch_and_clear_word(bm, word); w != 0; w &= w - 1) {
+            ++n;
+            if (!visit(context, word * STD_ATOMIC_BITMAP_WORD_BITS + __builtin_ctzll(w))) {
+                /* put back the bits of the word that were not visited */
+                if ((w &= w - 1) != 0)
+                    __atomic_fetch_or(&bm->ab_words[word], w, __ATOMIC_ACQ_REL);
+                return n;
+            }
+        }
+    }
+    return n;
+}
+
+size_t std_atomic_bitmap_num_words(std_atomic_bitmap_t *bm) {
+    return bm->ab_num_words;
+}
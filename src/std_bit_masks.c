@@ -26,8 +26,14 @@
 #include <assert.h>
 #include <unistd.h>
 #include <netinet/in.h>
+#include <endian.h>
 #include "std_bit_masks.h"
 
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define STD_BIT_MASKS_X86 1
+#endif
+
 static inline unsigned int bittobytelen(unsigned int len) {
     return (len/8) + ((len%8)==0 ? 0 : 1);
 }
@@ -60,99 +66,518 @@ void std_bitmaparray_free_data (void *bitMap) {
     if (bitMap) { free (bitMap); }
 }
 
-static int highest_bit[] = {
-//    0 1 2 3 4 5 6 7 8 9 a b c d e f
-    0,1,2,2,3,3,3,3,4,4,4,4,4,4,4,4,        //0
-    5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,5,        //10
-    6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,        //20
-    6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,6,        //30
-    7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,        //40
-    7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,        //50
-    7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,        //60
-    7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,7,        //70
-    8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,        //80
-    8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,        //90
-    8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,        //a0
-    8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,        //b0
-    8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,        //c0
-    8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,        //d0
-    8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,        //e0
-    8,8,8,8,8,8,8,8,8,8,8,8,8,8,8,8          //f0
-};
+/*----------------------------------------------------------------*\
+                          Bit scans
+\*----------------------------------------------------------------*/
+
+/*
+ * The arrays are scanned 64 bits at a time. Word k of an array holds the
+ * bits 64k .. 64k+63 which are the bytes 8k .. 8k+7, loaded little endian
+ * so that bit n of the word is bit n of the array. The arrays need not be
+ * aligned and the last word only reads the bytes the array has.
+ *
+ * Runs of empty (or, for the zero bit search, full) bytes are skipped with
+ * SSE2 or AVX2 compares, and the words are counted with popcnt, picked at
+ * the first use after checking what the CPU supports.
+ */
+
+#define BITS_PER_WORD   64
+/* the number of std_bit_op_t */
+#define STD_BIT_OPS     4
+
+static inline uint64_t std_bit_load(const uint8_t *array, size_t word, size_t nbytes) {
+    uint64_t w = 0;
+    size_t ix = word * 8;
+
+    memcpy(&w, array + ix, (ix + 8 <= nbytes) ? 8 : nbytes - ix);
+    return le64toh(w);
+}
+
+/* the number of bytes holding len bits */
+static inline size_t std_bit_bytes(size_t len) {
+    return (len / BITS_PER_BYTE) + ((len % BITS_PER_BYTE) ? 1 : 0);
+}
+
+typedef struct {
+    /* first byte in [ix, end) that is not fill, or end */
+    size_t (*skip)(const uint8_t *array, size_t ix, size_t end, uint8_t fill);
+    /* one past the last byte in [ix, end) that is not fill, or ix */
+    size_t (*skip_back)(const uint8_t *array, size_t ix, size_t end, uint8_t fill);
+    /* bits set in nwords whole words from word */
+    size_t (*count)(const uint8_t *array, size_t word, size_t nwords);
+    /* dst = a op b over n bytes, for each std_bit_op_t */
+    void (*apply[STD_BIT_OPS])(uint8_t *dst, const uint8_t *a, const uint8_t *b, size_t n);
+    /* is a op b not all zero over n bytes */
+    bool (*any[STD_BIT_OPS])(const uint8_t *a, const uint8_t *b, size_t n);
+} std_bit_simd_ops_t;
+
+static size_t std_bit_skip_generic(const uint8_t *array, size_t ix, size_t end, uint8_t fill) {
+    uint64_t pattern = 0x0101010101010101ULL * fill, w;
+
+    for ( ; ix + 8 <= end; ix += 8) {
+        memcpy(&w, array + ix, 8);
+        if (w != pattern) break;
+    }
+    for ( ; ix < end && array[ix] == fill; ++ix)
+        ;
+    return ix;
+}
 
-static int lowest_bit[] = {
-//    0 1 2 3 4 5 6 7 8 9 a b c d e f
-    0,1,2,1,3,1,2,1,4,1,2,1,3,1,2,1,            //00
-    5,1,2,1,3,1,2,1,4,1,2,1,3,1,2,1,            //10
-    6,1,2,1,3,1,2,1,4,1,2,1,3,1,2,1,            //20
-    5,1,2,1,3,1,2,1,4,1,2,1,3,1,2,1,            //30
-    7,1,2,1,3,1,2,1,4,1,2,1,3,1,2,1,            //40
-    5,1,2,1,3,1,2,1,4,1,2,1,3,1,2,1,            //50
-    6,1,2,1,3,1,2,1,4,1,2,1,3,1,2,1,            //60
-    5,1,2,1,3,1,2,1,4,1,2,1,3,1,2,1,            //70
-    8,1,2,1,3,1,2,1,4,1,2,1,3,1,2,1,            //80
-    5,1,2,1,3,1,2,1,4,1,2,1,3,1,2,1,            //90
-    6,1,2,1,3,1,2,1,4,1,2,1,3,1,2,1,            //a0
-    5,1,2,1,3,1,2,1,4,1,2,1,3,1,2,1,            //b0
-    7,1,2,1,3,1,2,1,4,1,2,1,3,1,2,1,            //c0
-    5,1,2,1,3,1,2,1,4,1,2,1,3,1,2,1,            //d0
-    6,1,2,1,3,1,2,1,4,1,2,1,3,1,2,1,            //e0
-    5,1,2,1,3,1,2,1,4,1,2,1,3,1,2,1,            //f0
+static size_t std_bit_skip_back_generic(const uint8_t *array, size_t ix, size_t end, uint8_t fill) {
+    uint64_t pattern = 0x0101010101010101ULL * fill, w;
+
+    for ( ; end >= ix + 8; end -= 8) {
+        memcpy(&w, array + end - 8, 8);
+        if (w != pattern) break;
+    }
+    for ( ; end > ix && array[end - 1] == fill; --end)
+        ;
+    return end;
+}
+
+static size_t std_bit_count_generic(const uint8_t *array, size_t word, size_t nwords) {
+    size_t n = 0, mx = word + nwords;
+    uint64_t w;
+
+    for ( ; word < mx; ++word) {
+        memcpy(&w, array + word * 8, 8);
+        n += __builtin_popcountll(w);
+    }
+    return n;
+}
+
+/*
+ * The bulk operations, one function per operation so that the loops have
+ * nothing but the loads, the operation and the store. OP is applied to
+ * x and y, 64 bit words or bytes.
+ */
+#define STD_BIT_OP_GENERIC(NAME, OP) \
+static void std_bit_apply_##NAME##_generic(uint8_t *dst, const uint8_t *a, \
+                                           const uint8_t *b, size_t n) { \
+    uint64_t x, y; \
+    size_t ix; \
+    for (ix = 0; ix + 8 <= n; ix += 8) { \
+        memcpy(&x, a + ix, 8); \
+        memcpy(&y, b + ix, 8); \
+        x = (OP); \
+        memcpy(dst + ix, &x, 8); \
+    } \
+    for ( ; ix < n; ++ix) { \
+        x = a[ix]; \
+        y = b[ix]; \
+        dst[ix] = (uint8_t)(OP); \
+    } \
+} \
+static bool std_bit_any_##NAME##_generic(const uint8_t *a, const uint8_t *b, size_t n) { \
+    uint64_t x, y; \
+    size_t ix; \
+    for (ix = 0; ix + 8 <= n; ix += 8) { \
+        memcpy(&x, a + ix, 8); \
+        memcpy(&y, b + ix, 8); \
+        if ((OP) != 0) return true; \
+    } \
+    for ( ; ix < n; ++ix) { \
+        x = a[ix]; \
+        y = b[ix]; \
+        if ((uint8_t)(OP) != 0) return true; \
+    } \
+    return false; \
+}
+
+STD_BIT_OP_GENERIC(and, x & y)
+STD_BIT_OP_GENERIC(or, x | y)
+STD_BIT_OP_GENERIC(xor, x ^ y)
+STD_BIT_OP_GENERIC(andnot, x & ~y)
+
+#ifdef STD_BIT_MASKS_X86
+
+__attribute__((target("sse2")))
+static size_t std_bit_skip_sse2(const uint8_t *array, size_t ix, size_t end, uint8_t fill) {
+    __m128i f = _mm_set1_epi8((char)fill);
+    unsigned int m;
+
+    for ( ; ix + 16 <= end; ix += 16) {
+        m = ~_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(array + ix)), f)) & 0xffff;
+        if (m) return ix + __builtin_ctz(m);
+    }
+    return std_bit_skip_generic(array, ix, end, fill);
+}
+
+__attribute__((target("sse2")))
+static size_t std_bit_skip_back_sse2(const uint8_t *array, size_t ix, size_t end, uint8_t fill) {
+    __m128i f = _mm_set1_epi8((char)fill);
+    unsigned int m;
+
+    for ( ; end >= ix + 16; end -= 16) {
+        m = ~_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(array + end - 16)), f)) & 0xffff;
+        if (m) return end - 16 + (32 - __builtin_clz(m));
+    }
+    return std_bit_skip_back_generic(array, ix, end, fill);
+}
+
+__attribute__((target("avx2")))
+static size_t std_bit_skip_avx2(const uint8_t *array, size_t ix, size_t end, uint8_t fill) {
+    __m256i f = _mm256_set1_epi8((char)fill);
+    unsigned int m;
+
+    for ( ; ix + 32 <= end; ix += 32) {
+        m = ~(unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(
+                _mm256_loadu_si256((const __m256i *)(array + ix)), f));
+        if (m) return ix + __builtin_ctz(m);
+    }
+    return std_bit_skip_sse2(array, ix, end, fill);
+}
+
+__attribute__((target("avx2")))
+static size_t std_bit_skip_back_avx2(const uint8_t *array, size_t ix, size_t end, uint8_t fill) {
+    __m256i f = _mm256_set1_epi8((char)fill);
+    unsigned int m;
+
+    for ( ; end >= ix + 32; end -= 32) {
+        m = ~(unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(
+                _mm256_loadu_si256((const __m256i *)(array + end - 32)), f));
+        if (m) return end - 32 + (32 - __builtin_clz(m));
+    }
+    return std_bit_skip_back_sse2(array, ix, end, fill);
+}
+
+/* same as the generic count, built to use the popcnt instruction */
+__attribute__((target("popcnt")))
+static size_t std_bit_count_popcnt(const uint8_t *array, size_t word, size_t nwords) {
+    size_t n = 0, mx = word + nwords;
+    uint64_t w;
+
+    for ( ; word < mx; ++word) {
+        memcpy(&w, array + word * 8, 8);
+        n += __builtin_popcountll(w);
+    }
+    return n;
+}
+
+/*
+ * The same with SSE2 or AVX2 vectors; VOP is applied to the vectors x and
+ * y with the intrinsics PFX (_mm or _mm256) of SFX (128 or 256) bits.
+ */
+#define STD_BIT_OP_SIMD(NAME, ISA, VEC, PFX, SFX, VOP) \
+__attribute__((target(#ISA))) \
+static void std_bit_apply_##NAME##_##ISA(uint8_t *dst, const uint8_t *a, \
+                                         const uint8_t *b, size_t n) { \
+    VEC x, y; \
+    size_t ix; \
+    for (ix = 0; ix + sizeof(VEC) <= n; ix += sizeof(VEC)) { \
+        x = PFX##_loadu_si##SFX((const VEC *)(a + ix)); \
+        y = PFX##_loadu_si##SFX((const VEC *)(b + ix)); \
+        PFX##_storeu_si##SFX((VEC *)(dst + ix), VOP); \
+    } \
+    std_bit_apply_##NAME##_generic(dst + ix, a + ix, b + ix, n - ix); \
+} \
+__attribute__((target(#ISA))) \
+static bool std_bit_any_##NAME##_##ISA(const uint8_t *a, const uint8_t *b, size_t n) { \
+    VEC x, y, z; \
+    size_t ix; \
+    for (ix = 0; ix + sizeof(VEC) <= n; ix += sizeof(VEC)) { \
+        x = PFX##_loadu_si##SFX((const VEC *)(a + ix)); \
+        y = PFX##_loadu_si##SFX((const VEC *)(b + ix)); \
+        z = VOP; \
+        if ((unsigned int)PFX##_movemask_epi8(PFX##_cmpeq_epi8(z, PFX##_setzero_si##SFX())) != \
+            (unsigned int)((1ULL << sizeof(VEC)) - 1)) return true; \
+    } \
+    return std_bit_any_##NAME##_generic(a + ix, b + ix, n - ix); \
+}
+
+STD_BIT_OP_SIMD(and, sse2, __m128i, _mm, 128, _mm_and_si128(x, y))
+STD_BIT_OP_SIMD(or, sse2, __m128i, _mm, 128, _mm_or_si128(x, y))
+STD_BIT_OP_SIMD(xor, sse2, __m128i, _mm, 128, _mm_xor_si128(x, y))
+STD_BIT_OP_SIMD(andnot, sse2, __m128i, _mm, 128, _mm_andnot_si128(y, x))
+STD_BIT_OP_SIMD(and, avx2, __m256i, _mm256, 256, _mm256_and_si256(x, y))
+STD_BIT_OP_SIMD(or, avx2, __m256i, _mm256, 256, _mm256_or_si256(x, y))
+STD_BIT_OP_SIMD(xor, avx2, __m256i, _mm256, 256, _mm256_xor_si256(x, y))
+STD_BIT_OP_SIMD(andnot, avx2, __m256i, _mm256, 256, _mm256_andnot_si256(y, x))
+
+static std_bit_simd_ops_t std_bit_ops_x86;
+
+static const std_bit_simd_ops_t * std_bit_ops_select(void) {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        std_bit_ops_x86.skip = std_bit_skip_avx2;
+        std_bit_ops_x86.skip_back = std_bit_skip_back_avx2;
+    } else {
+        std_bit_ops_x86.skip = std_bit_skip_sse2;
+        std_bit_ops_x86.skip_back = std_bit_skip_back_sse2;
+    }
+    std_bit_ops_x86.count = __builtin_cpu_supports("popcnt") ?
+            std_bit_count_popcnt : std_bit_count_generic;
+
+#define STD_BIT_OPS_SET(ISA) \
+    std_bit_ops_x86.apply[STD_BIT_OP_AND] = std_bit_apply_and_##ISA; \
+    std_bit_ops_x86.apply[STD_BIT_OP_OR] = std_bit_apply_or_##ISA; \
+    std_bit_ops_x86.apply[STD_BIT_OP_XOR] = std_bit_apply_xor_##ISA; \
+    std_bit_ops_x86.apply[STD_BIT_OP_ANDNOT] = std_bit_apply_andnot_##ISA; \
+    std_bit_ops_x86.any[STD_BIT_OP_AND] = std_bit_any_and_##ISA; \
+    std_bit_ops_x86.any[STD_BIT_OP_OR] = std_bit_any_or_##ISA; \
+    std_bit_ops_x86.any[STD_BIT_OP_XOR] = std_bit_any_xor_##ISA; \
+    std_bit_ops_x86.any[STD_BIT_OP_ANDNOT] = std_bit_any_andnot_##ISA;
+
+    if (__builtin_cpu_supports("avx2")) {
+        STD_BIT_OPS_SET(avx2)
+    } else {
+        STD_BIT_OPS_SET(sse2)
+    }
+    return &std_bit_ops_x86;
+}
+
+#else
+
+static const std_bit_simd_ops_t std_bit_ops_generic = {
+    std_bit_skip_generic, std_bit_skip_back_generic, std_bit_count_generic,
+    { std_bit_apply_and_generic, std_bit_apply_or_generic,
+      std_bit_apply_xor_generic, std_bit_apply_andnot_generic },
+    { std_bit_any_and_generic, std_bit_any_or_generic,
+      std_bit_any_xor_generic, std_bit_any_andnot_generic }
 };
 
-static inline unsigned int std_find_last_bit8(register unsigned int byte, register unsigned int from) {
-    register unsigned int mask = ((unsigned int )(~0)) >> from;
-    return highest_bit[byte&mask];
+static const std_bit_simd_ops_t * std_bit_ops_select(void) {
+    return &std_bit_ops_generic;
 }
 
-static inline unsigned int std_find_first_bit8(register unsigned int byte, register unsigned int from) {
-    register unsigned int mask = ((unsigned int )(~0)) << from;
-    return lowest_bit[byte&mask];
+#endif
+
+static inline const std_bit_simd_ops_t * std_bit_ops(void) {
+    static const std_bit_simd_ops_t *ops;
+    const std_bit_simd_ops_t *o = __atomic_load_n(&ops, __ATOMIC_ACQUIRE);
+
+    /* the choice is the same in every thread, so a race only does it twice */
+    if (o == NULL) {
+        o = std_bit_ops_select();
+        __atomic_store_n(&ops, o, __ATOMIC_RELEASE);
+    }
+    return o;
+}
+
+/*
+ * First bit at or after 'from' and before len that is set, or clear if
+ * invert. Whole words of fill are skipped by the ops.
+ */
+static int std_find_bit(const uint8_t *array, size_t len, size_t from, bool invert) {
+    const std_bit_simd_ops_t *ops;
+    size_t nbytes = std_bit_bytes(len), word = from / BITS_PER_WORD, bit, ix;
+    uint64_t flip = invert ? ~0ULL : 0, w;
+
+    if (from >= len) return -1;
+
+    w = (std_bit_load(array, word, nbytes) ^ flip) & (~0ULL << (from % BITS_PER_WORD));
+    if (w == 0) {
+        ops = std_bit_ops();
+        ix = ops->skip(array, (word + 1) * 8, nbytes, (uint8_t)flip);
+        if (ix >= nbytes) return -1;
+        word = ix / 8;
+        w = std_bit_load(array, word, nbytes) ^ flip;
+    }
+    /* a zero bit past the array when inverted, or a bit set in the padding */
+    bit = word * BITS_PER_WORD + __builtin_ctzll(w);
+    return (bit < len) ? (int)bit : -1;
 }
 
 int std_find_first_bit(void *varray, size_t len, size_t from) {
-    register uint8_t *array = (uint8_t *)varray;
+    return std_find_bit((const uint8_t *)varray, len, from, false);
+}
+
+int std_find_next_zero_bit(void *varray, size_t len, size_t from) {
+    return std_find_bit((const uint8_t *)varray, len, from, true);
+}
+
+int std_find_last_bit(void *varray, size_t len, size_t from) {
+    const uint8_t *array = (const uint8_t *)varray;
+    size_t nbytes, top, word, end;
+    uint64_t w;
+
     if (from >= len) return -1;
 
-    size_t ix = from/8;
-    size_t mx = (len /8) + ((len%8)!=0 ? 1 : 0);
+    /* from counts back from the end of the array */
+    top = len - from - 1;
+    nbytes = std_bit_bytes(top + 1);
+    word = top / BITS_PER_WORD;
+    w = std_bit_load(array, word, nbytes) & (~0ULL >> (BITS_PER_WORD - 1 - top % BITS_PER_WORD));
+    if (w == 0) {
+        if (word == 0) return -1;
+        end = std_bit_ops()->skip_back(array, 0, word * 8, 0);
+        if (end == 0) return -1;
+        word = (end - 1) / 8;
+        w = std_bit_load(array, word, nbytes);
+    }
+    return (int)(word * BITS_PER_WORD + (BITS_PER_WORD - 1 - __builtin_clzll(w)));
+}
+
+size_t std_count_bits(void *varray, size_t from, size_t to) {
+    const uint8_t *array = (const uint8_t *)varray;
+    size_t nbytes = std_bit_bytes(to), first, last, n;
+    uint64_t head_mask, tail_mask;
+
+    if (from >= to) return 0;
+
+    first = from / BITS_PER_WORD;
+    last = (to - 1) / BITS_PER_WORD;
+    head_mask = ~0ULL << (from % BITS_PER_WORD);
+    tail_mask = ~0ULL >> (BITS_PER_WORD - 1 - (to - 1) % BITS_PER_WORD);
+
+    if (first == last)
+        return __builtin_popcountll(std_bit_load(array, first, nbytes) & head_mask & tail_mask);
+
+    n = __builtin_popcountll(std_bit_load(array, first, nbytes) & head_mask);
+    n += std_bit_ops()->count(array, first + 1, last - first - 1);
+    n += __builtin_popcountll(std_bit_load(array, last, nbytes) & tail_mask);
+    return n;
+}
 
-    size_t bit = from % 8;
-    if (bit) {
-        size_t pos = std_find_first_bit8(array[ix],bit);
-        if(pos!=0) { return pos-1+(ix*8); }
-        ++ix;
+size_t std_for_each_bit(void *varray, size_t len, std_bit_visit_fn visit, void *context) {
+    const uint8_t *array = (const uint8_t *)varray;
+    size_t nbytes = std_bit_bytes(len), word, bit, n = 0;
+    uint64_t w;
+    int first;
+
+    for (first = std_find_first_bit(varray, len, 0); first >= 0; ) {
+        word = first / BITS_PER_WORD;
+        w = std_bit_load(array, word, nbytes) & (~0ULL << (first % BITS_PER_WORD));
+        for ( ; w != 0; w &= w - 1) {
+            bit = word * BITS_PER_WORD + __builtin_ctzll(w);
+            if (bit >= len) return n;
+            ++n;
+            if (!visit(context, bit)) return n;
+        }
+        first = std_find_first_bit(varray, len, (word + 1) * BITS_PER_WORD);
     }
+    return n;
+}
+
+/*----------------------------------------------------------------*\
+                       Bulk operations
+\*----------------------------------------------------------------*/
 
-    for (; ix < mx ; ++ix ) {
-        if (array[ix]==0) { continue; }
-        return std_find_first_bit8(array[ix],0) -1 + (ix*8);
+/* bytes handled at once by std_bit_array_op_multi, to stay in the L1 cache */
+#define STD_BIT_OP_BLOCK    4096
+
+/* the bits of the last byte that are below len */
+static inline uint8_t std_bit_tail_mask(size_t len) {
+    return (uint8_t)((1U << (len % BITS_PER_BYTE)) - 1);
+}
+
+static inline uint8_t std_bit_op_byte(uint8_t a, uint8_t b, std_bit_op_t op) {
+    switch (op) {
+    case STD_BIT_OP_AND: return a & b;
+    case STD_BIT_OP_OR: return a | b;
+    case STD_BIT_OP_XOR: return a ^ b;
+    default: return a & ~b;
     }
-    return -1;
 }
 
-int std_find_last_bit(void *varray, size_t len, size_t from) {
-    register uint8_t *array = (uint8_t *)varray;
-    if (from >= len) return -1;
+/* the partial last byte of dst = a op b, leaving the bits past len alone */
+static inline void std_bit_apply_tail(uint8_t *dst, const uint8_t *a, const uint8_t *b,
+                                      size_t len, std_bit_op_t op) {
+    size_t ix = len / BITS_PER_BYTE;
+    uint8_t mask = std_bit_tail_mask(len);
+
+    if (mask != 0)
+        dst[ix] = (dst[ix] & ~mask) | (std_bit_op_byte(a[ix], b[ix], op) & mask);
+}
+
+void std_bit_array_op(void *dst, const void *a, const void *b, size_t len, std_bit_op_t op) {
+    std_bit_ops()->apply[op]((uint8_t *)dst, (const uint8_t *)a, (const uint8_t *)b,
+                             len / BITS_PER_BYTE);
+    std_bit_apply_tail((uint8_t *)dst, (const uint8_t *)a, (const uint8_t *)b, len, op);
+}
+
+void std_bit_array_and(void *dst, const void *a, const void *b, size_t len) {
+    std_bit_array_op(dst, a, b, len, STD_BIT_OP_AND);
+}
+
+void std_bit_array_or(void *dst, const void *a, const void *b, size_t len) {
+    std_bit_array_op(dst, a, b, len, STD_BIT_OP_OR);
+}
+
+void std_bit_array_xor(void *dst, const void *a, const void *b, size_t len) {
+    std_bit_array_op(dst, a, b, len, STD_BIT_OP_XOR);
+}
+
+void std_bit_array_andnot(void *dst, const void *a, const void *b, size_t len) {
+    std_bit_array_op(dst, a, b, len, STD_BIT_OP_ANDNOT);
+}
 
-    from = len - from;
-    register int mx = (from/8) + (from%8!=0 ? 1 : 0);
-    if (mx==0) { return -1; }
+void std_bit_array_op_multi(void *vdst, std_bit_op_t op, const void * const *srcs,
+                            size_t num, size_t len) {
+    const std_bit_simd_ops_t *ops = std_bit_ops();
+    uint8_t *dst = (uint8_t *)vdst;
+    size_t nbytes = len / BITS_PER_BYTE, ix, n, src;
 
-    --mx;
+    if (num == 0) return;
+    if (num == 1) {
+        /* x op x is not x for xor and andnot, so copy */
+        if (dst != srcs[0]) std_bit_array_or(dst, srcs[0], srcs[0], len);
+        return;
+    }
 
-    size_t bit = from % 8;
-    if (bit) {
-        size_t pos = std_find_last_bit8(array[mx],bit); //one based
-        if(pos!=0) { return (pos-1)+(mx*8);}
-        if (mx==0) {return -1;}
-        --mx;
+    /* all the sources one block at a time, which keeps dst in the cache */
+    for (ix = 0; ix < nbytes; ix += n) {
+        n = (nbytes - ix < STD_BIT_OP_BLOCK) ? nbytes - ix : STD_BIT_OP_BLOCK;
+        ops->apply[op](dst + ix, (const uint8_t *)srcs[0] + ix, (const uint8_t *)srcs[1] + ix, n);
+        for (src = 2; src < num; ++src)
+            ops->apply[op](dst + ix, dst + ix, (const uint8_t *)srcs[src] + ix, n);
     }
+    std_bit_apply_tail(dst, (const uint8_t *)srcs[0], (const uint8_t *)srcs[1], len, op);
+    for (src = 2; src < num; ++src)
+        std_bit_apply_tail(dst, dst, (const uint8_t *)srcs[src], len, op);
+}
 
-    for ( ; mx >=0 ; --mx) {
-        if (array[mx]!=0) {
-            return std_find_last_bit8(array[mx],0)-1 + (mx*8) ;
-        }
+/* is a op b not zero over the len bits */
+static bool std_bit_array_any(const uint8_t *a, const uint8_t *b, size_t len, std_bit_op_t op) {
+    size_t ix = len / BITS_PER_BYTE;
+    uint8_t mask = std_bit_tail_mask(len);
+
+    if (std_bit_ops()->any[op](a, b, ix)) return true;
+    return mask != 0 && (std_bit_op_byte(a[ix], b[ix], op) & mask) != 0;
+}
+
+bool std_bit_array_equal(const void *a, const void *b, size_t len) {
+    return !std_bit_array_any((const uint8_t *)a, (const uint8_t *)b, len, STD_BIT_OP_XOR);
+}
+
+bool std_bit_array_subset(const void *a, const void *b, size_t len) {
+    return !std_bit_array_any((const uint8_t *)a, (const uint8_t *)b, len, STD_BIT_OP_ANDNOT);
+}
+
+bool std_bit_array_is_empty(const void *varray, size_t len) {
+    const uint8_t *array = (const uint8_t *)varray;
+    size_t nbytes = len / BITS_PER_BYTE;
+    uint8_t mask = std_bit_tail_mask(len);
+
+    if (std_bit_ops()->skip(array, 0, nbytes, 0) != nbytes) return false;
+    return mask == 0 || (array[nbytes] & mask) == 0;
+}
+
+/* set or clear the bits [from, to) */
+static void std_bit_array_fill(uint8_t *array, size_t from, size_t to, bool set) {
+    size_t first = from / BITS_PER_BYTE, last = to / BITS_PER_BYTE;
+    uint8_t head = (uint8_t)(0xff << (from % BITS_PER_BYTE)), tail = std_bit_tail_mask(to);
+
+    if (from >= to) return;
+    if (first == last) {
+        head &= tail;
+        tail = 0;
+    } else {
+        array[first] = set ? (array[first] | head) : (array[first] & ~head);
+        head = 0;
+        memset(array + first + 1, set ? 0xff : 0, last - first - 1);
+    }
+    /* the byte of 'to' if it has bits below it */
+    if (head | tail) {
+        uint8_t mask = head | tail;
+        array[last] = set ? (array[last] | mask) : (array[last] & ~mask);
     }
-    return -1;
+}
+
+void std_bit_array_set_range(void *array, size_t from, size_t to) {
+    std_bit_array_fill((uint8_t *)array, from, to, true);
+}
+
+void std_bit_array_clear_range(void *array, size_t from, size_t to) {
+    std_bit_array_fill((uint8_t *)array, from, to, false);
 }
@@ -0,0 +1,885 @@
+/*
+ * Copyright (c) 2016 Dell Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * THIS CODE IS PROVIDED ON AN *AS IS* BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT
+ * LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS
+ * FOR A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+ *
+ * See the Apache Version 2.0 License for specific language governing
+ * permissions and limitations under the License.
+ */
+
+/*
+ * filename: std_compressed_bitmap.c
+ */
+
+/*!
+ * \file   std_compressed_bitmap.c
+ * \brief  Compressed bitmap for large, sparse sets of 32 bit values
+ */
+
+#include "std_compressed_bitmap.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <endian.h>
+
+#define CBM_CHUNK_BITS  65536   /* values of a container */
+#define CBM_WORDS       1024    /* 64 bit words of a bitmap container */
+#define CBM_ARRAY_MAX   4096    /* most values of an array container */
+#define CBM_RUNS_MAX    2048    /* most runs before a run container is larger than a bitmap */
+
+enum {
+    CBM_ARRAY,
+    CBM_BITMAP,
+    CBM_RUN,
+};
+
+/* consecutive values from start to last, both included */
+typedef struct {
+    uint16_t start;
+    uint16_t last;
+} std_cbm_run_t;
+
+typedef struct _std_cbitmap_container {
+    uint16_t key;       /* upper 16 bits of the values */
+    uint8_t type;
+    uint32_t card;      /* number of values */
+    uint32_t n;         /* values of an array, runs of a run container */
+    uint32_t cap;       /* entries allocated for an array or runs */
+    void *data;         /* uint16_t[n], uint64_t[CBM_WORDS] or std_cbm_run_t[n] */
+} std_cbm_t;
+
+#define CBM_VALUES(c)   ((uint16_t *)(c)->data)
+#define CBM_BITS(c)     ((uint64_t *)(c)->data)
+#define CBM_RUNS(c)     ((std_cbm_run_t *)(c)->data)
+
+/*----------------------------------------------------------------*\
+                     Bitmap words
+\*----------------------------------------------------------------*/
+
+static void cbm_words_set_range(uint64_t *w, uint32_t lo, uint32_t hi) {
+    uint32_t first = lo / 64, last = hi / 64, ix;
+    uint64_t head = ~0ULL << (lo % 64), tail = ~0ULL >> (63 - hi % 64);
+
+    if (first == last) {
+        w[first] |= head & tail;
+        return;
+    }
+    w[first] |= head;
+    for (ix = first + 1; ix < last; ++ix) w[ix] = ~0ULL;
+    w[last] |= tail;
+}
+
+static uint32_t cbm_words_count(const uint64_t *w, uint32_t first, uint32_t last) {
+    uint32_t n = 0;
+
+    for ( ; first <= last; ++first) n += __builtin_popcountll(w[first]);
+    return n;
+}
+
+/* first bit at or after 'from' that is set, or clear if !set; CBM_CHUNK_BITS if none */
+static uint32_t cbm_words_next(const uint64_t *w, uint32_t from, bool set) {
+    uint32_t ix = from / 64;
+    uint64_t flip = set ? 0 : ~0ULL, x;
+
+    if (from >= CBM_CHUNK_BITS) return CBM_CHUNK_BITS;
+    for (x = (w[ix] ^ flip) & (~0ULL << (from % 64)); x == 0; x = w[ix] ^ flip) {
+        if (++ix == CBM_WORDS) return CBM_CHUNK_BITS;
+    }
+    return ix * 64 + __builtin_ctzll(x);
+}
+
+/*----------------------------------------------------------------*\
+                        Containers
+\*----------------------------------------------------------------*/
+
+/* index of the first value of an array that is >= x */
+static uint32_t cbm_array_lower(const std_cbm_t *c, uint32_t x) {
+    const uint16_t *v = CBM_VALUES(c);
+    uint32_t lo = 0, hi = c->n, mid;
+
+    while (lo < hi) {
+        mid = (lo + hi) / 2;
+        if (v[mid] < x) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+/* index of the first run that starts after x */
+static uint32_t cbm_run_upper(const std_cbm_t *c, uint32_t x) {
+    const std_cbm_run_t *r = CBM_RUNS(c);
+    uint32_t lo = 0, hi = c->n, mid;
+
+    while (lo < hi) {
+        mid = (lo + hi) / 2;
+        if (r[mid].start <= x) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+static t_std_error cbm_reserve(std_cbm_t *c, uint32_t n, size_t size) {
+    uint32_t cap;
+    void *p;
+
+    if (n <= c->cap) return STD_ERR_OK;
+    cap = c->cap ? c->cap : 4;
+    while (cap < n) cap *= 2;
+    p = realloc(c->data, (size_t)cap * size);
+    if (p == NULL) return STD_ERR(COM,NOMEM,0);
+    c->data = p;
+    c->cap = cap;
+    return STD_ERR_OK;
+}
+
+/* OR the values of a container into bitmap words */
+static void cbm_materialize(const std_cbm_t *c, uint64_t *w) {
+    uint32_t ix;
+
+    switch (c->type) {
+    case CBM_ARRAY:
+        for (ix = 0; ix < c->n; ++ix)
+            w[CBM_VALUES(c)[ix] / 64] |= 1ULL << (CBM_VALUES(c)[ix] % 64);
+        break;
+    case CBM_BITMAP:
+        for (ix = 0; ix < CBM_WORDS; ++ix) w[ix] |= CBM_BITS(c)[ix];
+        break;
+    default:
+        for (ix = 0; ix < c->n; ++ix)
+            cbm_words_set_range(w, CBM_RUNS(c)[ix].start, CBM_RUNS(c)[ix].last);
+        break;
+    }
+}
+
+/*
+ * Give a container the values of bitmap words holding card values, taking
+ * over the words as a bitmap or making an array of them. The old data is
+ * freed. On failure the container is left as it was and the words freed.
+ */
+static t_std_error cbm_set_words(std_cbm_t *c, uint64_t *w, uint32_t card) {
+    uint16_t *v = NULL;
+    uint32_t ix, n = 0;
+    uint64_t x;
+
+    if (card <= CBM_ARRAY_MAX) {
+        v = (uint16_t *)malloc((card ? card : 1) * sizeof(*v));
+        if (v == NULL) {
+            free(w);
+            return STD_ERR(COM,NOMEM,0);
+        }
+        for (ix = 0; ix < CBM_WORDS; ++ix) {
+            for (x = w[ix]; x != 0; x &= x - 1) v[n++] = ix * 64 + __builtin_ctzll(x);
+        }
+        free(w);
+    }
+    free(c->data);
+    c->card = card;
+    if (v != NULL) {
+        c->type = CBM_ARRAY;
+        c->data = v;
+        c->n = c->cap = card;
+    } else {
+        c->type = CBM_BITMAP;
+        c->data = w;
+        c->n = c->cap = 0;
+    }
+    return STD_ERR_OK;
+}
+
+/* redo a container in the form it should have after a change */
+static t_std_error cbm_normalize(std_cbm_t *c) {
+    uint64_t *w;
+
+    if ((c->type == CBM_ARRAY && c->card <= CBM_ARRAY_MAX) ||
+        (c->type == CBM_BITMAP && c->card > CBM_ARRAY_MAX) ||
+        (c->type == CBM_RUN && c->n <= CBM_RUNS_MAX))
+        return STD_ERR_OK;
+
+    w = (uint64_t *)calloc(CBM_WORDS, sizeof(*w));
+    if (w == NULL) return STD_ERR(COM,NOMEM,0);
+    cbm_materialize(c, w);
+    return cbm_set_words(c, w, c->card);
+}
+
+static bool cbm_test(const std_cbm_t *c, uint32_t x) {
+    uint32_t ix;
+
+    switch (c->type) {
+    case CBM_ARRAY:
+        ix = cbm_array_lower(c, x);
+        return ix < c->n && CBM_VALUES(c)[ix] == x;
+    case CBM_BITMAP:
+        return (CBM_BITS(c)[x / 64] >> (x % 64)) & 1;
+    default:
+        ix = cbm_run_upper(c, x);
+        return ix > 0 && CBM_RUNS(c)[ix - 1].last >= x;
+    }
+}
+
+/* add the values lo to hi of a chunk */
+static t_std_error cbm_add_range(std_cbm_t *c, uint32_t lo, uint32_t hi) {
+    uint32_t a, b, ix, first, last, before, card, n = hi - lo + 1;
+    std_cbm_run_t *r;
+    uint16_t *v;
+    uint64_t *w;
+    t_std_error rc;
+
+    if (c->type == CBM_ARRAY) {
+        a = cbm_array_lower(c, lo);
+        b = cbm_array_lower(c, hi + 1);
+        card = c->card - (b - a) + n;
+        if (card <= CBM_ARRAY_MAX) {
+            if ((rc = cbm_reserve(c, card, sizeof(uint16_t))) != STD_ERR_OK) return rc;
+            v = CBM_VALUES(c);
+            memmove(v + a + n, v + b, (c->n - b) * sizeof(*v));
+            for (ix = 0; ix < n; ++ix) v[a + ix] = lo + ix;
+            c->n = c->card = card;
+            return STD_ERR_OK;
+        }
+        /* grows past an array, add to it as a bitmap */
+        w = (uint64_t *)calloc(CBM_WORDS, sizeof(*w));
+        if (w == NULL) return STD_ERR(COM,NOMEM,0);
+        cbm_materialize(c, w);
+        free(c->data);
+        c->type = CBM_BITMAP;
+        c->data = w;
+        c->n = c->cap = 0;
+    }
+
+    if (c->type == CBM_BITMAP) {
+        first = lo / 64;
+        last = hi / 64;
+        before = cbm_words_count(CBM_BITS(c), first, last);
+        cbm_words_set_range(CBM_BITS(c), lo, hi);
+        c->card += cbm_words_count(CBM_BITS(c), first, last) - before;
+        return STD_ERR_OK;
+    }
+
+    /* the runs from a to b - 1 touch or overlap the range and are merged with it */
+    r = CBM_RUNS(c);
+    for (a = 0, b = c->n; a < b; ) {
+        ix = (a + b) / 2;
+        if ((uint32_t)r[ix].last + 1 < lo) a = ix + 1;
+        else b = ix;
+    }
+    b = cbm_run_upper(c, hi + 1);
+    if (a == b) {
+        if ((rc = cbm_reserve(c, c->n + 1, sizeof(*r))) != STD_ERR_OK) return rc;
+        r = CBM_RUNS(c);
+        memmove(r + a + 1, r + a, (c->n - a) * sizeof(*r));
+        r[a].start = lo;
+        r[a].last = hi;
+        c->n++;
+        c->card += n;
+    } else {
+        if (r[a].start < lo) lo = r[a].start;
+        if (r[b - 1].last > hi) hi = r[b - 1].last;
+        for (ix = a; ix < b; ++ix) c->card -= r[ix].last - r[ix].start + 1;
+        c->card += hi - lo + 1;
+        r[a].start = lo;
+        r[a].last = hi;
+        memmove(r + a + 1, r + b, (c->n - b) * sizeof(*r));
+        c->n -= b - a - 1;
+    }
+    /* too many runs is not an error, just not compact */
+    cbm_normalize(c);
+    return STD_ERR_OK;
+}
+
+static t_std_error cbm_remove(std_cbm_t *c, uint32_t x) {
+    std_cbm_run_t *r;
+    uint32_t ix;
+    t_std_error rc;
+
+    if (!cbm_test(c, x)) return STD_ERR_OK;
+
+    switch (c->type) {
+    case CBM_ARRAY:
+        ix = cbm_array_lower(c, x);
+        memmove(CBM_VALUES(c) + ix, CBM_VALUES(c) + ix + 1, (c->n - ix - 1) * sizeof(uint16_t));
+        c->n--;
+        break;
+    case CBM_BITMAP:
+        CBM_BITS(c)[x / 64] &= ~(1ULL << (x % 64));
+        break;
+    default:
+        ix = cbm_run_upper(c, x) - 1;
+        r = CBM_RUNS(c);
+        if (r[ix].start == r[ix].last) {
+            memmove(r + ix, r + ix + 1, (c->n - ix - 1) * sizeof(*r));
+            c->n--;
+        } else if (r[ix].start == x) {
+            r[ix].start++;
+        } else if (r[ix].last == x) {
+            r[ix].last--;
+        } else {
+            /* split the run in two */
+            if ((rc = cbm_reserve(c, c->n + 1, sizeof(*r))) != STD_ERR_OK) return rc;
+            r = CBM_RUNS(c);
+            memmove(r + ix + 2, r + ix + 1, (c->n - ix - 1) * sizeof(*r));
+            r[ix + 1].start = x + 1;
+            r[ix + 1].last = r[ix].last;
+            r[ix].last = x - 1;
+            c->n++;
+        }
+        break;
+    }
+    c->card--;
+    /* a bitmap that became small stays a valid bitmap if this fails */
+    cbm_normalize(c);
+    return STD_ERR_OK;
+}
+
+/* number of values <= x */
+static uint32_t cbm_rank(const std_cbm_t *c, uint32_t x) {
+    uint32_t ix, n = 0;
+
+    switch (c->type) {
+    case CBM_ARRAY:
+        return cbm_array_lower(c, x + 1);
+    case CBM_BITMAP:
+        if (x / 64 > 0) n = cbm_words_count(CBM_BITS(c), 0, x / 64 - 1);
+        return n + __builtin_popcountll(CBM_BITS(c)[x / 64] & (~0ULL >> (63 - x % 64)));
+    default:
+        for (ix = 0; ix < c->n && CBM_RUNS(c)[ix].start <= x; ++ix) {
+            n += ((CBM_RUNS(c)[ix].last <= x) ? CBM_RUNS(c)[ix].last : x) -
+                 CBM_RUNS(c)[ix].start + 1;
+        }
+        return n;
+    }
+}
+
+/* lowest value >= x, or CBM_CHUNK_BITS */
+static uint32_t cbm_next(const std_cbm_t *c, uint32_t x) {
+    uint32_t ix;
+
+    switch (c->type) {
+    case CBM_ARRAY:
+        ix = cbm_array_lower(c, x);
+        return (ix < c->n) ? CBM_VALUES(c)[ix] : CBM_CHUNK_BITS;
+    case CBM_BITMAP:
+        return cbm_words_next(CBM_BITS(c), x, true);
+    default:
+        ix = cbm_run_upper(c, x);
+        if (ix > 0 && CBM_RUNS(c)[ix - 1].last >= x) return x;
+        return (ix < c->n) ? CBM_RUNS(c)[ix].start : CBM_CHUNK_BITS;
+    }
+}
+
+static size_t cbm_size(const std_cbm_t *c) {
+    switch (c->type) {
+    case CBM_ARRAY: return c->cap * sizeof(uint16_t);
+    case CBM_BITMAP: return CBM_WORDS * sizeof(uint64_t);
+    default: return c->cap * sizeof(std_cbm_run_t);
+    }
+}
+
+static t_std_error cbm_copy(std_cbm_t *dst, const std_cbm_t *src) {
+    size_t size = (src->type == CBM_BITMAP) ? CBM_WORDS * sizeof(uint64_t) :
+                  (src->type == CBM_ARRAY) ? src->n * sizeof(uint16_t) : src->n * sizeof(std_cbm_run_t);
+
+    *dst = *src;
+    dst->cap = (src->type == CBM_BITMAP) ? 0 : src->n;
+    dst->data = malloc(size ? size : 1);
+    if (dst->data == NULL) return STD_ERR(COM,NOMEM,0);
+    memcpy(dst->data, src->data, size);
+    return STD_ERR_OK;
+}
+
+static t_std_error cbm_or(std_cbm_t *out, const std_cbm_t *x, const std_cbm_t *y) {
+    uint32_t i = 0, j = 0, n = 0;
+    t_std_error rc;
+    uint64_t *w;
+    uint16_t *v;
+
+    memset(out, 0, sizeof(*out));
+    out->key = x->key;
+
+    if (x->type == CBM_RUN && y->type == CBM_RUN) {
+        if ((rc = cbm_copy(out, x)) != STD_ERR_OK) return rc;
+        for ( ; i < y->n; ++i) {
+            if ((rc = cbm_add_range(out, CBM_RUNS(y)[i].start, CBM_RUNS(y)[i].last)) != STD_ERR_OK)
+                return rc;
+        }
+        return STD_ERR_OK;
+    }
+
+    if (x->type == CBM_ARRAY && y->type == CBM_ARRAY && x->card + y->card <= CBM_ARRAY_MAX) {
+        v = (uint16_t *)malloc((x->card + y->card) * sizeof(*v));
+        if (v == NULL) return STD_ERR(COM,NOMEM,0);
+        while (i < x->n || j < y->n) {
+            if (j == y->n || (i < x->n && CBM_VALUES(x)[i] < CBM_VALUES(y)[j])) {
+                v[n++] = CBM_VALUES(x)[i++];
+            } else {
+                if (i < x->n && CBM_VALUES(x)[i] == CBM_VALUES(y)[j]) ++i;
+                v[n++] = CBM_VALUES(y)[j++];
+            }
+        }
+        out->type = CBM_ARRAY;
+        out->data = v;
+        out->n = out->card = n;
+        out->cap = x->card + y->card;
+        return STD_ERR_OK;
+    }
+
+    w = (uint64_t *)calloc(CBM_WORDS, sizeof(*w));
+    if (w == NULL) return STD_ERR(COM,NOMEM,0);
+    cbm_materialize(x, w);
+    cbm_materialize(y, w);
+    return cbm_set_words(out, w, cbm_words_count(w, 0, CBM_WORDS - 1));
+}
+
+static t_std_error cbm_and(std_cbm_t *out, const std_cbm_t *x, const std_cbm_t *y) {
+    const std_cbm_t *tmp;
+    uint64_t *w, *wy;
+    uint32_t i, n = 0;
+    uint16_t *v;
+
+    memset(out, 0, sizeof(*out));
+    out->key = x->key;
+
+    /* an array against anything: keep the values the other one has */
+    if (y->type == CBM_ARRAY && (x->type != CBM_ARRAY || y->card < x->card)) {
+        tmp = x;
+        x = y;
+        y = tmp;
+    }
+    if (x->type == CBM_ARRAY) {
+        v = (uint16_t *)malloc((x->card ? x->card : 1) * sizeof(*v));
+        if (v == NULL) return STD_ERR(COM,NOMEM,0);
+        for (i = 0; i < x->n; ++i) {
+            if (cbm_test(y, CBM_VALUES(x)[i])) v[n++] = CBM_VALUES(x)[i];
+        }
+        out->type = CBM_ARRAY;
+        out->data = v;
+        out->n = out->card = n;
+        out->cap = x->card;
+        return STD_ERR_OK;
+    }
+
+    w = (uint64_t *)calloc(CBM_WORDS, sizeof(*w));
+    wy = (uint64_t *)calloc(CBM_WORDS, sizeof(*wy));
+    if (w == NULL || wy == NULL) {
+        free(w);
+        free(wy);
+        return STD_ERR(COM,NOMEM,0);
+    }
+    cbm_materialize(x, w);
+    cbm_materialize(y, wy);
+    for (i = 0; i < CBM_WORDS; ++i) w[i] &= wy[i];
+    free(wy);
+    return cbm_set_words(out, w, cbm_words_count(w, 0, CBM_WORDS - 1));
+}
+
+/* turn a container into runs if that is smaller */
+static t_std_error cbm_optimize(std_cbm_t *c) {
+    uint32_t nruns = 0, ix, start, end;
+    uint64_t *w, x, carry = 0;
+    std_cbm_run_t *r;
+
+    if (c->type == CBM_RUN) {
+        /* runs are kept unless the others are smaller */
+        if (c->n * sizeof(std_cbm_run_t) <= ((c->card <= CBM_ARRAY_MAX) ?
+                c->card * sizeof(uint16_t) : CBM_WORDS * sizeof(uint64_t)))
+            return STD_ERR_OK;
+        w = (uint64_t *)calloc(CBM_WORDS, sizeof(*w));
+        if (w == NULL) return STD_ERR(COM,NOMEM,0);
+        cbm_materialize(c, w);
+        return cbm_set_words(c, w, c->card);
+    }
+
+    w = (uint64_t *)calloc(CBM_WORDS, sizeof(*w));
+    if (w == NULL) return STD_ERR(COM,NOMEM,0);
+    cbm_materialize(c, w);
+    /* a run starts on each bit set whose lower neighbour is clear */
+    for (ix = 0; ix < CBM_WORDS; ++ix) {
+        x = w[ix];
+        nruns += __builtin_popcountll(x & ~((x << 1) | carry));
+        carry = x >> 63;
+    }
+    if (nruns * sizeof(std_cbm_run_t) >= cbm_size(c)) {
+        free(w);
+        return STD_ERR_OK;
+    }
+
+    r = (std_cbm_run_t *)malloc(nruns * sizeof(*r));
+    if (r == NULL) {
+        free(w);
+        return STD_ERR(COM,NOMEM,0);
+    }
+    for (ix = 0, start = cbm_words_next(w, 0, true); start < CBM_CHUNK_BITS;
+         start = cbm_words_next(w, end, true), ++ix) {
+        end = cbm_words_next(w, start, false);
+        r[ix].start = start;
+        r[ix].last = end - 1;
+    }
+    free(w);
+    free(c->data);
+    c->type = CBM_RUN;
+    c->data = r;
+    c->n = c->cap = nruns;
+    return STD_ERR_OK;
+}
+
+/*----------------------------------------------------------------*\
+                          Bitmap
+\*----------------------------------------------------------------*/
+
+/* index of the first container whose key is >= key */
+static uint32_t std_cbitmap_lower(const std_cbitmap_t *bm, uint32_t key) {
+    uint32_t lo = 0, hi = bm->cb_num, mid;
+
+    while (lo < hi) {
+        mid = (lo + hi) / 2;
+        if (bm->cb_containers[mid].key < key) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+/* make room for a container at idx, filled in by the caller */
+static t_std_error std_cbitmap_insert_at(std_cbitmap_t *bm, uint32_t idx) {
+    std_cbm_t *p;
+    uint32_t cap;
+
+    if (bm->cb_num == bm->cb_cap) {
+        cap = bm->cb_cap ? bm->cb_cap * 2 : 4;
+        p = (std_cbm_t *)realloc(bm->cb_containers, cap * sizeof(*p));
+        if (p == NULL) return STD_ERR(COM,NOMEM,0);
+        bm->cb_containers = p;
+        bm->cb_cap = cap;
+    }
+    memmove(bm->cb_containers + idx + 1, bm->cb_containers + idx,
+            (bm->cb_num - idx) * sizeof(std_cbm_t));
+    memset(&bm->cb_containers[idx], 0, sizeof(std_cbm_t));
+    bm->cb_num++;
+    return STD_ERR_OK;
+}
+
+static void std_cbitmap_remove_at(std_cbitmap_t *bm, uint32_t idx) {
+    free(bm->cb_containers[idx].data);
+    memmove(bm->cb_containers + idx, bm->cb_containers + idx + 1,
+            (bm->cb_num - idx - 1) * sizeof(std_cbm_t));
+    bm->cb_num--;
+}
+
+/* the container of a key, created empty with type if there is none */
+static t_std_error std_cbitmap_get(std_cbitmap_t *bm, uint32_t key, uint8_t type, uint32_t *idx) {
+    t_std_error rc;
+
+    *idx = std_cbitmap_lower(bm, key);
+    if (*idx < bm->cb_num && bm->cb_containers[*idx].key == key) return STD_ERR_OK;
+    if ((rc = std_cbitmap_insert_at(bm, *idx)) != STD_ERR_OK) return rc;
+    bm->cb_containers[*idx].key = key;
+    bm->cb_containers[*idx].type = type;
+    return STD_ERR_OK;
+}
+
+void std_cbitmap_init(std_cbitmap_t *bm) {
+    memset(bm, 0, sizeof(*bm));
+}
+
+void std_cbitmap_destroy(std_cbitmap_t *bm) {
+    uint32_t ix;
+
+    for (ix = 0; ix < bm->cb_num; ++ix) free(bm->cb_containers[ix].data);
+    free(bm->cb_containers);
+    memset(bm, 0, sizeof(*bm));
+}
+
+t_std_error std_cbitmap_set_range(std_cbitmap_t *bm, uint32_t first, uint32_t last) {
+    uint32_t key, lo, hi, idx;
+    t_std_error rc;
+
+    if (last < first) return STD_ERR(COM,PARAM,0);
+
+    for (key = first >> 16; key <= last >> 16; ++key) {
+        lo = (key == first >> 16) ? first & 0xffff : 0;
+        hi = (key == last >> 16) ? last & 0xffff : 0xffff;
+        /* a new chunk starts as a single run, or as an array for one value */
+        rc = std_cbitmap_get(bm, key, (lo == hi) ? CBM_ARRAY : CBM_RUN, &idx);
+        if (rc == STD_ERR_OK) rc = cbm_add_range(&bm->cb_containers[idx], lo, hi);
+        if (rc != STD_ERR_OK) {
+            if (idx < bm->cb_num && bm->cb_containers[idx].card == 0)
+                std_cbitmap_remove_at(bm, idx);
+            return rc;
+        }
+    }
+    return STD_ERR_OK;
+}
+
+t_std_error std_cbitmap_set(std_cbitmap_t *bm, uint32_t value) {
+    return std_cbitmap_set_range(bm, value, value);
+}
+
+t_std_error std_cbitmap_clear(std_cbitmap_t *bm, uint32_t value) {
+    uint32_t idx = std_cbitmap_lower(bm, value >> 16);
+    t_std_error rc;
+
+    if (idx == bm->cb_num || bm->cb_containers[idx].key != value >> 16) return STD_ERR_OK;
+    rc = cbm_remove(&bm->cb_containers[idx], value & 0xffff);
+    if (bm->cb_containers[idx].card == 0) std_cbitmap_remove_at(bm, idx);
+    return rc;
+}
+
+bool std_cbitmap_test(const std_cbitmap_t *bm, uint32_t value) {
+    uint32_t idx = std_cbitmap_lower(bm, value >> 16);
+
+    return idx < bm->cb_num && bm->cb_containers[idx].key == value >> 16 &&
+           cbm_test(&bm->cb_containers[idx], value & 0xffff);
+}
+
+uint64_t std_cbitmap_cardinality(const std_cbitmap_t *bm) {
+    uint64_t n = 0;
+    uint32_t ix;
+
+    for (ix = 0; ix < bm->cb_num; ++ix) n += bm->cb_containers[ix].card;
+    return n;
+}
+
+uint64_t std_cbitmap_rank(const std_cbitmap_t *bm, uint32_t value) {
+    uint32_t idx = std_cbitmap_lower(bm, value >> 16), ix;
+    uint64_t n = 0;
+
+    for (ix = 0; ix < idx; ++ix) n += bm->cb_containers[ix].card;
+    if (idx < bm->cb_num && bm->cb_containers[idx].key == value >> 16)
+        n += cbm_rank(&bm->cb_containers[idx], value & 0xffff);
+    return n;
+}
+
+bool std_cbitmap_find_next(const std_cbitmap_t *bm, uint32_t from, uint32_t *value) {
+    uint32_t idx = std_cbitmap_lower(bm, from >> 16), low;
+
+    for ( ; idx < bm->cb_num; ++idx) {
+        low = cbm_next(&bm->cb_containers[idx],
+                       (bm->cb_containers[idx].key == from >> 16) ? from & 0xffff : 0);
+        if (low < CBM_CHUNK_BITS) {
+            *value = ((uint32_t)bm->cb_containers[idx].key << 16) | low;
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t std_cbitmap_for_each(const std_cbitmap_t *bm, std_bit_visit_fn visit, void *context) {
+    const std_cbm_t *c;
+    uint32_t idx, ix, v;
+    size_t base, n = 0;
+    uint64_t x;
+
+    for (idx = 0; idx < bm->cb_num; ++idx) {
+        c = &bm->cb_containers[idx];
+        base = (size_t)c->key << 16;
+        switch (c->type) {
+        case CBM_ARRAY:
+            for (ix = 0; ix < c->n; ++ix) {
+                ++n;
+                if (!visit(context, base + CBM_VALUES(c)[ix])) return n;
+            }
+            break;
+        case CBM_BITMAP:
+            for (ix = 0; ix < CBM_WORDS; ++ix) {
+                for (x = CBM_BITS(c)[ix]; x != 0; x &= x - 1) {
+                    ++n;
+                    if (!visit(context, base + ix * 64 + __builtin_ctzll(x))) return n;
+                }
+            }
+            break;
+        default:
+            for (ix = 0; ix < c->n; ++ix) {
+                for (v = CBM_RUNS(c)[ix].start; v <= CBM_RUNS(c)[ix].last; ++v) {
+                    ++n;
+                    if (!visit(context, base + v)) return n;
+                }
+            }
+            break;
+        }
+    }
+    return n;
+}
+
+/* append a container to a bitmap being built, or drop it if empty */
+static t_std_error std_cbitmap_append(std_cbitmap_t *bm, std_cbm_t *c) {
+    t_std_error rc;
+
+    if (c->card == 0) {
+        free(c->data);
+        return STD_ERR_OK;
+    }
+    if ((rc = std_cbitmap_insert_at(bm, bm->cb_num)) != STD_ERR_OK) {
+        free(c->data);
+        return rc;
+    }
+    bm->cb_containers[bm->cb_num - 1] = *c;
+    return STD_ERR_OK;
+}
+
+/* the result is built aside and only replaces dst once complete */
+static void std_cbitmap_replace(std_cbitmap_t *dst, std_cbitmap_t *res) {
+    std_cbitmap_destroy(dst);
+    *dst = *res;
+}
+
+t_std_error std_cbitmap_or(std_cbitmap_t *dst, const std_cbitmap_t *a, const std_cbitmap_t *b) {
+    std_cbitmap_t res;
+    uint32_t i = 0, j = 0;
+    t_std_error rc = STD_ERR_OK;
+    std_cbm_t c;
+
+    std_cbitmap_init(&res);
+    while (rc == STD_ERR_OK && (i < a->cb_num || j < b->cb_num)) {
+        if (j == b->cb_num || (i < a->cb_num && a->cb_containers[i].key < b->cb_containers[j].key)) {
+            rc = cbm_copy(&c, &a->cb_containers[i++]);
+        } else if (i == a->cb_num || b->cb_containers[j].key < a->cb_containers[i].key) {
+            rc = cbm_copy(&c, &b->cb_containers[j++]);
+        } else {
+            rc = cbm_or(&c, &a->cb_containers[i++], &b->cb_containers[j++]);
+        }
+        if (rc == STD_ERR_OK) rc = std_cbitmap_append(&res, &c);
+        else free(c.data);
+    }
+    if (rc != STD_ERR_OK) {
+        std_cbitmap_destroy(&res);
+        return rc;
+    }
+    std_cbitmap_replace(dst, &res);
+    return STD_ERR_OK;
+}
+
+t_std_error std_cbitmap_and(std_cbitmap_t *dst, const std_cbitmap_t *a, const std_cbitmap_t *b) {
+    std_cbitmap_t res;
+    uint32_t i = 0, j = 0;
+    t_std_error rc = STD_ERR_OK;
+    std_cbm_t c;
+
+    std_cbitmap_init(&res);
+    while (rc == STD_ERR_OK && i < a->cb_num && j < b->cb_num) {
+        if (a->cb_containers[i].key < b->cb_containers[j].key) {
+            ++i;
+        } else if (b->cb_containers[j].key < a->cb_containers[i].key) {
+            ++j;
+        } else {
+            rc = cbm_and(&c, &a->cb_containers[i++], &b->cb_containers[j++]);
+            if (rc == STD_ERR_OK) rc = std_cbitmap_append(&res, &c);
+            else free(c.data);
+        }
+    }
+    if (rc != STD_ERR_OK) {
+        std_cbitmap_destroy(&res);
+        return rc;
+    }
+    std_cbitmap_replace(dst, &res);
+    return STD_ERR_OK;
+}
+
+t_std_error std_cbitmap_optimize(std_cbitmap_t *bm) {
+    t_std_error rc;
+    uint32_t ix;
+
+    for (ix = 0; ix < bm->cb_num; ++ix) {
+        if ((rc = cbm_optimize(&bm->cb_containers[ix])) != STD_ERR_OK) return rc;
+    }
+    return STD_ERR_OK;
+}
+
+size_t std_cbitmap_size_in_bytes(const std_cbitmap_t *bm) {
+    size_t n = bm->cb_cap * sizeof(std_cbm_t);
+    uint32_t ix;
+
+    for (ix = 0; ix < bm->cb_num; ++ix) n += cbm_size(&bm->cb_containers[ix]);
+    return n;
+}
+
+t_std_error std_cbitmap_from_array(std_cbitmap_t *bm, const void *array, size_t len) {
+    const uint8_t *bytes = (const uint8_t *)array;
+    size_t base, end, nbytes;
+    std_cbitmap_t add;
+    uint32_t ix, card;
+    t_std_error rc = STD_ERR_OK;
+    std_cbm_t c;
+    uint64_t *w;
+
+    if (len > ((size_t)1 << 32)) len = (size_t)1 << 32;
+
+    /* a container for each chunk of the array, then all of them at once */
+    std_cbitmap_init(&add);
+    for (base = 0; base < len && rc == STD_ERR_OK; base += CBM_CHUNK_BITS) {
+        end = (base + CBM_CHUNK_BITS < len) ? base + CBM_CHUNK_BITS : len;
+        card = std_count_bits((void *)array, base, end);
+        if (card == 0) continue;
+
+        w = (uint64_t *)calloc(CBM_WORDS, sizeof(*w));
+        if (w == NULL) {
+            rc = STD_ERR(COM,NOMEM,0);
+            break;
+        }
+        nbytes = (end - base + 7) / 8;
+        memcpy(w, bytes + base / 8, nbytes);
+        for (ix = 0; ix < CBM_WORDS; ++ix) w[ix] = le64toh(w[ix]);
+        /* the bits past len in the last byte */
+        if ((end - base) % 64)
+            w[(end - base) / 64] &= ~0ULL >> (64 - (end - base) % 64);
+
+        memset(&c, 0, sizeof(c));
+        c.key = base >> 16;
+        if ((rc = cbm_set_words(&c, w, card)) == STD_ERR_OK)
+            rc = std_cbitmap_append(&add, &c);
+    }
+    if (rc == STD_ERR_OK) rc = std_cbitmap_or(bm, bm, &add);
+    std_cbitmap_destroy(&add);
+    return rc;
+}
+
+void std_cbitmap_to_array(const std_cbitmap_t *bm, void *array, size_t len) {
+    uint8_t *bytes = (uint8_t *)array;
+    const std_cbm_t *c;
+    uint32_t idx, ix;
+    size_t base, s, e;
+    uint64_t x;
+
+    std_bit_array_clear_range(array, 0, len);
+    for (idx = 0; idx < bm->cb_num; ++idx) {
+        c = &bm->cb_containers[idx];
+        base = (size_t)c->key << 16;
+        if (base >= len) break;
+
+        switch (c->type) {
+        case CBM_BITMAP:
+            if (base + CBM_CHUNK_BITS <= len) {
+                for (ix = 0; ix < CBM_WORDS; ++ix) {
+                    x = htole64(CBM_BITS(c)[ix]);
+                    memcpy(bytes + base / 8 + ix * 8, &x, 8);
+                }
+                break;
+            }
+            for (ix = 0; ix < CBM_WORDS; ++ix) {
+                for (x = CBM_BITS(c)[ix]; x != 0; x &= x - 1) {
+                    s = base + ix * 64 + __builtin_ctzll(x);
+                    if (s < len) STD_BIT_ARRAY_SET(bytes, s);
+                }
+            }
+            break;
+        case CBM_RUN:
+            for (ix = 0; ix < c->n; ++ix) {
+                s = base + CBM_RUNS(c)[ix].start;
+                e = base + CBM_RUNS(c)[ix].last + 1;
+                if (s >= len) break;
+                std_bit_array_set_range(array, s, (e < len) ? e : len);
+            }
+            break;
+        default:
+            for (ix = 0; ix < c->n; ++ix) {
+                s = base + CBM_VALUES(c)[ix];
+                if (s < len) STD_BIT_ARRAY_SET(bytes, s);
+            }
+            break;
+        }
+    }
+}
@@ -41,6 +41,20 @@
  */
 
 #include "std_crc32.h"
+#include "std_file_utils.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <endian.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define STD_CRC32_X86 1
+#endif
 
 static uint32_t crc32_tab[] = {
 	0x00000000, 0x77073096, 0xee0e612c, 0x990951ba, 0x076dc419, 0x706af48f,
@@ -88,16 +102,521 @@ static uint32_t crc32_tab[] = {
 	0xb40bbe37, 0xc30c8ea1, 0x5a05df1b, 0x2d02ef8d
 };
 
+/* bit reflected Castagnoli polynomial of CRC32C */
+#define CRC32C_POLY	0x82f63b78
+
+/*
+ * Slicing tables: crc32_slice[k][b] is the CRC of byte b followed by k
+ * zero bytes, so 16 (or 8) bytes are folded in with one lookup each
+ * instead of 16 dependent ones. crc32_slice[0] is crc32_tab. The same
+ * for CRC32C in crc32c_slice.
+ */
+static uint32_t crc32_slice[16][256];
+static uint32_t crc32c_slice[16][256];
+static pthread_once_t crc32_slice_once = PTHREAD_ONCE_INIT;
+
+/* x^(2^n) modulo each polynomial, for the combines */
+static uint32_t crc32_x2n[32];
+static uint32_t crc32c_x2n[32];
+
+/* product of two polynomials modulo the polynomial, bit reflected */
+static uint32_t
+crc32_multmodp(uint32_t poly, uint32_t a, uint32_t b)
+{
+	uint32_t m = 1U << 31, p = 0;
+
+	for (;;) {
+		if (a & m) {
+			p ^= b;
+			if ((a & (m - 1)) == 0)
+				break;
+		}
+		m >>= 1;
+		b = (b & 1) ? (b >> 1) ^ poly : b >> 1;
+	}
+	return p;
+}
+
+/* x^(n * 2^k) modulo the polynomial */
+static uint32_t
+crc32_x2nmodp(uint32_t poly, const uint32_t *x2n, uint64_t n, unsigned int k)
+{
+	uint32_t p = 1U << 31;		/* x^0 */
+
+	for ( ; n != 0; n >>= 1, k++) {
+		if (n & 1)
+			p = crc32_multmodp(poly, x2n[k & 31], p);
+	}
+	return p;
+}
+
+/* the tables of a polynomial; the byte table is computed unless given */
+static void
+crc32_tables_fill(uint32_t poly, const uint32_t *tab, uint32_t slice[16][256], uint32_t x2n[32])
+{
+	uint32_t b, k, crc;
+
+	crc = 1U << 30;			/* x^1 */
+	x2n[0] = crc;
+	for (k = 1; k < 32; k++)
+		x2n[k] = crc = crc32_multmodp(poly, crc, crc);
+
+	for (b = 0; b < 256; b++) {
+		for (crc = b, k = 0; tab == NULL && k < 8; k++)
+			crc = (crc & 1) ? (crc >> 1) ^ poly : crc >> 1;
+		slice[0][b] = (tab != NULL) ? tab[b] : crc;
+	}
+	for (b = 0; b < 256; b++) {
+		crc = slice[0][b];
+		for (k = 1; k < 16; k++) {
+			crc = slice[0][crc & 0xFF] ^ (crc >> 8);
+			slice[k][b] = crc;
+		}
+	}
+}
+
+#if defined(__x86_64__)
+static void crc32c_hw_init(void);
+#endif
+
+static void
+crc32_slice_init(void)
+{
+	crc32_tables_fill(0xedb88320, crc32_tab, crc32_slice, crc32_x2n);
+	crc32_tables_fill(CRC32C_POLY, NULL, crc32c_slice, crc32c_x2n);
+#if defined(__x86_64__)
+	crc32c_hw_init();
+#endif
+}
+
+static inline uint32_t
+crc32_load32(const uint8_t *p)
+{
+	uint32_t v;
+
+	memcpy(&v, p, sizeof(v));
+	return le32toh(v);
+}
+
+#define CRC32_SLICE4(tab, t, v) \
+	(tab[(t) + 3][(v) & 0xFF] ^ tab[(t) + 2][((v) >> 8) & 0xFF] ^ \
+	 tab[(t) + 1][((v) >> 16) & 0xFF] ^ tab[(t)][(v) >> 24])
+
+/* the CRC register is passed and returned without the final inversion */
+static inline uint32_t
+crc32_slice_sw(const uint32_t tab[16][256], uint32_t crc, const uint8_t *p, size_t size)
+{
+	uint32_t a, b, c, d;
+
+	while (size >= 16) {
+		a = crc32_load32(p) ^ crc;
+		b = crc32_load32(p + 4);
+		c = crc32_load32(p + 8);
+		d = crc32_load32(p + 12);
+		crc = CRC32_SLICE4(tab, 12, a) ^ CRC32_SLICE4(tab, 8, b) ^
+		      CRC32_SLICE4(tab, 4, c) ^ CRC32_SLICE4(tab, 0, d);
+		p += 16;
+		size -= 16;
+	}
+	if (size >= 8) {
+		a = crc32_load32(p) ^ crc;
+		b = crc32_load32(p + 4);
+		crc = CRC32_SLICE4(tab, 4, a) ^ CRC32_SLICE4(tab, 0, b);
+		p += 8;
+		size -= 8;
+	}
+	while (size--)
+		crc = tab[0][(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+
+	return crc;
+}
+
+static uint32_t
+crc32_sw(uint32_t crc, const uint8_t *p, size_t size)
+{
+	return crc32_slice_sw(crc32_slice, crc, p, size);
+}
+
+static uint32_t
+crc32c_sw(uint32_t crc, const uint8_t *p, size_t size)
+{
+	return crc32_slice_sw(crc32c_slice, crc, p, size);
+}
+
+#ifdef STD_CRC32_X86
+
+/* below this the folding setup costs more than the tables */
+#define CRC32_CLMUL_MIN	64
+
+/*
+ * Folding with carry-less multiplies, from "Fast CRC Computation for
+ * Generic Polynomials Using PCLMULQDQ Instruction" (Intel, 2009), with the
+ * bit reflected constants of 0xedb88320. Four 128 bit lanes are folded
+ * 64 bytes at a time, then into one lane, and Barrett reduced to 32 bits.
+ * Takes a multiple of 16 bytes, at least 64.
+ */
+__attribute__((target("pclmul,sse4.1")))
+static uint32_t
+crc32_clmul(uint32_t crc, const uint8_t *p, size_t size)
+{
+	const __m128i k1k2 = _mm_set_epi64x(0x01c6e41596, 0x0154442bd4);
+	const __m128i k3k4 = _mm_set_epi64x(0x00ccaa009e, 0x01751997d0);
+	const __m128i k5k0 = _mm_set_epi64x(0, 0x0163cd6124);
+	const __m128i poly = _mm_set_epi64x(0x01f7011641, 0x01db710641);
+	const __m128i mask32 = _mm_setr_epi32(~0, 0, ~0, 0);
+	__m128i x1, x2, x3, x4, x5, x6, x7, x8;
+
+	x1 = _mm_loadu_si128((const __m128i *)(p + 0x00));
+	x2 = _mm_loadu_si128((const __m128i *)(p + 0x10));
+	x3 = _mm_loadu_si128((const __m128i *)(p + 0x20));
+	x4 = _mm_loadu_si128((const __m128i *)(p + 0x30));
+	x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128(crc));
+	p += 64;
+	size -= 64;
+
+	while (size >= 64) {
+		x5 = _mm_clmulepi64_si128(x1, k1k2, 0x00);
+		x6 = _mm_clmulepi64_si128(x2, k1k2, 0x00);
+		x7 = _mm_clmulepi64_si128(x3, k1k2, 0x00);
+		x8 = _mm_clmulepi64_si128(x4, k1k2, 0x00);
+		x1 = _mm_clmulepi64_si128(x1, k1k2, 0x11);
+		x2 = _mm_clmulepi64_si128(x2, k1k2, 0x11);
+		x3 = _mm_clmulepi64_si128(x3, k1k2, 0x11);
+		x4 = _mm_clmulepi64_si128(x4, k1k2, 0x11);
+		x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), _mm_loadu_si128((const __m128i *)(p + 0x00)));
+		x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), _mm_loadu_si128((const __m128i *)(p + 0x10)));
+		x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), _mm_loadu_si128((const __m128i *)(p + 0x20)));
+		x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), _mm_loadu_si128((const __m128i *)(p + 0x30)));
+		p += 64;
+		size -= 64;
+	}
+
+	/* fold the four lanes into one */
+	x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+	x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+	x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+	x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+	x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+	x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+	x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+	x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+	x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+	while (size >= 16) {
+		x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+		x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+		x1 = _mm_xor_si128(_mm_xor_si128(x1, _mm_loadu_si128((const __m128i *)p)), x5);
+		p += 16;
+		size -= 16;
+	}
+
+	/* 128 to 64 bits */
+	x2 = _mm_clmulepi64_si128(x1, k3k4, 0x10);
+	x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+	x2 = _mm_srli_si128(x1, 4);
+	x1 = _mm_clmulepi64_si128(_mm_and_si128(x1, mask32), k5k0, 0x00);
+	x1 = _mm_xor_si128(x1, x2);
+
+	/* Barrett reduction to 32 bits */
+	x2 = _mm_clmulepi64_si128(_mm_and_si128(x1, mask32), poly, 0x10);
+	x2 = _mm_clmulepi64_si128(_mm_and_si128(x2, mask32), poly, 0x00);
+	x1 = _mm_xor_si128(x1, x2);
+
+	return (uint32_t)_mm_extract_epi32(x1, 1);
+}
+
+static uint32_t
+crc32_x86(uint32_t crc, const uint8_t *p, size_t size)
+{
+	size_t n;
+
+	if (size >= CRC32_CLMUL_MIN) {
+		n = size & ~(size_t)15;
+		crc = crc32_clmul(crc, p, n);
+		p += n;
+		size -= n;
+	}
+	return crc32_sw(crc, p, size);
+}
+
+#endif
+
+#if defined(__x86_64__)
+
+/* block lengths of the three way interleave */
+#define CRC32C_LONG	8192
+#define CRC32C_SHORT	256
+
+/*
+ * Tables to append CRC32C_LONG or CRC32C_SHORT zero bytes to a CRC
+ * register, one per byte of the register: as the shift is linear the
+ * four lookups are simply xored.
+ */
+static uint32_t crc32c_long[4][256];
+static uint32_t crc32c_short[4][256];
+
+static void
+crc32c_zeros_fill(uint32_t zeros[4][256], size_t len)
+{
+	uint32_t op = crc32_x2nmodp(CRC32C_POLY, crc32c_x2n, len, 3), n;
+	int k;
+
+	for (n = 0; n < 256; n++) {
+		for (k = 0; k < 4; k++)
+			zeros[k][n] = crc32_multmodp(CRC32C_POLY, op, n << (8 * k));
+	}
+}
+
+static void
+crc32c_hw_init(void)
+{
+	crc32c_zeros_fill(crc32c_long, CRC32C_LONG);
+	crc32c_zeros_fill(crc32c_short, CRC32C_SHORT);
+}
+
+static inline uint32_t
+crc32c_shift(uint32_t zeros[4][256], uint32_t crc)
+{
+	return zeros[0][crc & 0xFF] ^ zeros[1][(crc >> 8) & 0xFF] ^
+	    zeros[2][(crc >> 16) & 0xFF] ^ zeros[3][crc >> 24];
+}
+
+static inline uint64_t
+crc32c_load64(const uint8_t *p)
+{
+	uint64_t v;
+
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+/*
+ * The crc32 instruction of SSE4.2 has a latency of three cycles but can
+ * start every cycle, so three blocks are run side by side and their CRCs
+ * put together after each block by shifting them over the blocks that
+ * follow, in the manner of M. Adler's crc32c.c.
+ */
+__attribute__((target("sse4.2")))
+static uint32_t
+crc32c_hw(uint32_t crc, const uint8_t *p, size_t size)
+{
+	uint64_t crc0 = crc, crc1, crc2;
+	const uint8_t *end;
+
+	/* align the words on 8 bytes */
+	while (size != 0 && ((uintptr_t)p & 7) != 0) {
+		crc0 = _mm_crc32_u8((uint32_t)crc0, *p++);
+		size--;
+	}
+
+	while (size >= 3 * CRC32C_LONG) {
+		crc1 = 0;
+		crc2 = 0;
+		for (end = p + CRC32C_LONG; p < end; p += 8) {
+			crc0 = _mm_crc32_u64(crc0, crc32c_load64(p));
+			crc1 = _mm_crc32_u64(crc1, crc32c_load64(p + CRC32C_LONG));
+			crc2 = _mm_crc32_u64(crc2, crc32c_load64(p + 2 * CRC32C_LONG));
+		}
+		crc0 = crc32c_shift(crc32c_long, (uint32_t)crc0) ^ crc1;
+		crc0 = crc32c_shift(crc32c_long, (uint32_t)crc0) ^ crc2;
+		p += 2 * CRC32C_LONG;
+		size -= 3 * CRC32C_LONG;
+	}
+
+	while (size >= 3 * CRC32C_SHORT) {
+		crc1 = 0;
+		crc2 = 0;
+		for (end = p + CRC32C_SHORT; p < end; p += 8) {
+			crc0 = _mm_crc32_u64(crc0, crc32c_load64(p));
+			crc1 = _mm_crc32_u64(crc1, crc32c_load64(p + CRC32C_SHORT));
+			crc2 = _mm_crc32_u64(crc2, crc32c_load64(p + 2 * CRC32C_SHORT));
+		}
+		crc0 = crc32c_shift(crc32c_short, (uint32_t)crc0) ^ crc1;
+		crc0 = crc32c_shift(crc32c_short, (uint32_t)crc0) ^ crc2;
+		p += 2 * CRC32C_SHORT;
+		size -= 3 * CRC32C_SHORT;
+	}
+
+	for ( ; size >= 8; p += 8, size -= 8)
+		crc0 = _mm_crc32_u64(crc0, crc32c_load64(p));
+	while (size--)
+		crc0 = _mm_crc32_u8((uint32_t)crc0, *p++);
+
+	return (uint32_t)crc0;
+}
+
+#endif
+
+typedef uint32_t (*crc32_kernel_t)(uint32_t crc, const uint8_t *p, size_t size);
+
+static crc32_kernel_t
+crc32_select(void)
+{
+	pthread_once(&crc32_slice_once, crc32_slice_init);
+#ifdef STD_CRC32_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1"))
+		return crc32_x86;
+#endif
+	return crc32_sw;
+}
+
+static crc32_kernel_t
+crc32c_select(void)
+{
+	pthread_once(&crc32_slice_once, crc32_slice_init);
+#if defined(__x86_64__)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("sse4.2"))
+		return crc32c_hw;
+#endif
+	return crc32c_sw;
+}
+
+static inline crc32_kernel_t
+crc32_kernel(crc32_kernel_t *cache, crc32_kernel_t (*select)(void))
+{
+	crc32_kernel_t k = __atomic_load_n(cache, __ATOMIC_ACQUIRE);
+
+	/* the choice is the same in every thread, so a race only does it twice */
+	if (k == NULL) {
+		k = select();
+		__atomic_store_n(cache, k, __ATOMIC_RELEASE);
+	}
+	return k;
+}
+
+static crc32_kernel_t crc32_cached;
+static crc32_kernel_t crc32c_cached;
+
 uint32_t
 std_crc32(uint32_t crc, const void *buf, size_t size)
 {
-	const uint8_t *p;
+	return crc32_kernel(&crc32_cached, crc32_select)(crc ^ ~0U, buf, size) ^ ~0U;
+}
+
+uint32_t
+std_crc32c(uint32_t crc, const void *buf, size_t size)
+{
+	return crc32_kernel(&crc32c_cached, crc32c_select)(crc ^ ~0U, buf, size) ^ ~0U;
+}
 
-	p = buf;
-	crc = crc ^ ~0U;
+uint32_t
+std_crc32c_combine(uint32_t crc_a, uint32_t crc_b, uint64_t len_b)
+{
+	pthread_once(&crc32_slice_once, crc32_slice_init);
 
-	while (size--)
-		crc = crc32_tab[(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+	return crc32_multmodp(CRC32C_POLY, crc32_x2nmodp(CRC32C_POLY, crc32c_x2n, len_b, 3),
+	    crc_a) ^ crc_b;
+}
+
+
+uint32_t
+std_crc32_combine(uint32_t crc_a, uint32_t crc_b, uint64_t len_b)
+{
+	pthread_once(&crc32_slice_once, crc32_slice_init);
+
+	/* shift crc_a past len_b bytes (8 * len_b bits), then add crc_b */
+	return crc32_multmodp(0xedb88320, crc32_x2nmodp(0xedb88320, crc32_x2n, len_b, 3),
+	    crc_a) ^ crc_b;
+}
+
+/* smallest piece given to a thread */
+#define CRC32_PAR_MIN	(1 << 20)
+/* pieces per thread, so that a slow thread does not hold up the others */
+#define CRC32_PAR_SPLIT	4
+
+/* a buffer split in pieces checksummed by the pool threads and the caller */
+typedef struct {
+	const uint8_t *buf;
+	size_t piece;
+	size_t size;
+	size_t num_tasks;
+	uint32_t *crcs;
+} crc32_pieces_t;
+
+static size_t
+crc32_piece_len(const crc32_pieces_t *p, size_t ix)
+{
+	return (ix == p->num_tasks - 1) ? p->size - ix * p->piece : p->piece;
+}
+
+static void
+crc32_piece_task(void *context, size_t ix)
+{
+	crc32_pieces_t *p = (crc32_pieces_t *)context;
+
+	p->crcs[ix] = std_crc32(0, p->buf + ix * p->piece, crc32_piece_len(p, ix));
+}
+
+uint32_t
+std_crc32_parallel(std_thread_pool_handle_t pool, uint32_t crc, const void *buf, size_t size)
+{
+	crc32_pieces_t p;
+	size_t num_threads = (pool != NULL) ? std_thread_pool_size(pool) : 0;
+	size_t num_tasks = (num_threads + 1) * CRC32_PAR_SPLIT, ix;
+
+	if (num_tasks > size / CRC32_PAR_MIN)
+		num_tasks = size / CRC32_PAR_MIN;
+	if (num_tasks < 2)
+		return std_crc32(crc, buf, size);
+
+	p.crcs = (uint32_t *)malloc(num_tasks * sizeof(uint32_t));
+	if (p.crcs == NULL)
+		return std_crc32(crc, buf, size);
+	p.buf = (const uint8_t *)buf;
+	/* pieces of whole 64 byte blocks, the last one takes the rest */
+	p.piece = (size / num_tasks) & ~(size_t)63;
+	p.size = size;
+	p.num_tasks = num_tasks;
+
+	std_thread_pool_run_tasks(pool, num_tasks, crc32_piece_task, &p);
+
+	for (ix = 0; ix < num_tasks; ix++)
+		crc = std_crc32_combine(crc, p.crcs[ix], crc32_piece_len(&p, ix));
+	free(p.crcs);
+	return crc;
+}
+
+/* read size of a file that can not be mapped */
+#define CRC32_READ_SIZE	(1 << 20)
+
+t_std_error
+std_crc32_fd(std_thread_pool_handle_t pool, int fd, uint32_t *crc)
+{
+	t_std_error rc = STD_ERR_OK;
+	struct stat st;
+	uint8_t *buf;
+	off_t pos, start;
+	size_t len;
+	int n;
+
+	*crc = 0;
+	if (fstat(fd, &st) != 0)
+		return STD_ERR_FROM_ERRNO(e_std_err_COM, e_std_err_code_FAIL);
+
+	/* like the read() loop below, a mapped file is done from the current offset */
+	if (S_ISREG(st.st_mode) && (pos = lseek(fd, 0, SEEK_CUR)) >= 0) {
+		if (pos >= st.st_size)
+			return STD_ERR_OK;
+		start = pos & ~((off_t)sysconf(_SC_PAGESIZE) - 1);
+		len = st.st_size - start;
+		buf = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, start);
+		if (buf != MAP_FAILED) {
+			madvise(buf, len, MADV_SEQUENTIAL);
+			*crc = std_crc32_parallel(pool, 0, buf + (pos - start), st.st_size - pos);
+			munmap(buf, len);
+			lseek(fd, st.st_size, SEEK_SET);
+			return STD_ERR_OK;
+		}
+	}
 
-	return crc ^ ~0U;
+	/* pipes, sockets and files that could not be mapped are read in order */
+	buf = (uint8_t *)malloc(CRC32_READ_SIZE);
+	if (buf == NULL)
+		return STD_ERR(COM,NOMEM,0);
+	while ((n = std_read(fd, buf, CRC32_READ_SIZE, true, &rc)) > 0)
+		*crc = std_crc32(*crc, buf, n);
+	free(buf);
+	return (n < 0) ? rc : STD_ERR_OK;
 }
@@ -0,0 +1,274 @@
+/*
+ * Copyright (c) 2016 Dell Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * THIS CODE IS PROVIDED ON AN *AS IS* BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT
+ * LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS
+ * FOR A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+ *
+ * See the Apache Version 2.0 License for specific language governing
+ * permissions and limitations under the License.
+ */
+
+/*
+ * filename: std_event_ring.cpp
+ */
+
+/*
+ * Rings of events in memory shared between the event service and a client
+ */
+
+#include "private/std_event_ring.h"
+#include "std_time_tools.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+
+/* a chunk of a message, 8 byte aligned */
+struct std_event_ring_rec_t {
+    uint32_t len;
+    uint32_t flags;
+};
+
+#define STD_EVENT_RING_MORE (1)    /* the message goes on in the next chunk */
+#define STD_EVENT_RING_PAD  (2)    /* skip to the start of the ring */
+
+#define STD_EVENT_RING_ALIGN(x) (((x) + 7) & ~(uint64_t)7)
+
+/* largest message taken from a ring */
+#define STD_EVENT_RING_MAX_MSG (64*1024*1024)
+
+/* wait between checks for room in a full ring */
+#define STD_EVENT_RING_POLL_US (100)
+
+/*
+ * Seals the service wants on a client's memory. Without F_SEAL_SHRINK the
+ * client could truncate the memory under the service's mapping, and the
+ * service's next access to a ring would fault.
+ */
+#define STD_EVENT_SHM_SEALS (F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL)
+
+static void ring_setup(std_event_ring_t *r, uint8_t *base, size_t size) {
+    r->hdr = (std_event_ring_hdr_t *)base;
+    r->data = base + STD_EVENT_RING_HDR_LEN;
+    r->size = size;
+    r->pos = 0;
+}
+
+static void shm_setup(std_event_shm_t *shm, void *base, size_t size) {
+    shm->base = base;
+    shm->len = 2 * (STD_EVENT_RING_HDR_LEN + size);
+    ring_setup(&shm->pub, (uint8_t *)base, size);
+    ring_setup(&shm->sub, (uint8_t *)base + STD_EVENT_RING_HDR_LEN + size, size);
+}
+
+t_std_error std_event_shm_create(size_t ring_size, std_event_shm_t *shm, int *fd) {
+    size_t size = STD_EVENT_RING_MIN_SIZE;
+
+    while (size < ring_size && size < STD_EVENT_RING_MAX_SIZE) size *= 2;
+
+    int _fd = memfd_create("std_event", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (_fd < 0) return STD_ERR_FROM_ERRNO(e_std_err_COM, e_std_err_code_FAIL);
+
+    size_t len = 2 * (STD_EVENT_RING_HDR_LEN + size);
+    void *base = MAP_FAILED;
+    if (ftruncate(_fd, len) == 0 && fcntl(_fd, F_ADD_SEALS, STD_EVENT_SHM_SEALS) == 0) {
+        base = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0);
+    }
+    if (base == MAP_FAILED) {
+        t_std_error rc = STD_ERR_FROM_ERRNO(e_std_err_COM, e_std_err_code_FAIL);
+        close(_fd);
+        return rc;
+    }
+    shm_setup(shm, base, size);
+    shm->pub.hdr->size = size;
+    shm->sub.hdr->size = size;
+    /* the first event wakes the consumer */
+    shm->pub.hdr->consumer_idle = 1;
+    shm->sub.hdr->consumer_idle = 1;
+    *fd = _fd;
+    return STD_ERR_OK;
+}
+
+t_std_error std_event_shm_map(int fd, size_t ring_size, std_event_shm_t *shm) {
+    struct stat st;
+
+    if (ring_size < STD_EVENT_RING_MIN_SIZE || ring_size > STD_EVENT_RING_MAX_SIZE ||
+            (ring_size & (ring_size - 1)) != 0) {
+        return STD_ERR(COM,PARAM,0);
+    }
+    size_t len = 2 * (STD_EVENT_RING_HDR_LEN + ring_size);
+    /* sealed first, so that the size checked is the size for good */
+    int seals = fcntl(fd, F_GET_SEALS);
+    if (seals < 0 || (seals & F_SEAL_SHRINK) == 0) return STD_ERR(COM,PARAM,0);
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < len) return STD_ERR(COM,PARAM,0);
+
+    void *base = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) return STD_ERR_FROM_ERRNO(e_std_err_COM, e_std_err_code_FAIL);
+    shm_setup(shm, base, ring_size);
+    return STD_ERR_OK;
+}
+
+void std_event_shm_unmap(std_event_shm_t *shm) {
+    if (shm->base != NULL) munmap(shm->base, shm->len);
+    shm->base = NULL;
+}
+
+/* a consumer that is about to wait, or waiting, is sent one wakeup */
+static void ring_wake(std_event_ring_t *r, int wake_fd, size_t timeout) {
+    if (__atomic_load_n(&r->hdr->consumer_idle, __ATOMIC_SEQ_CST) == 0) return;
+    if (__atomic_exchange_n(&r->hdr->consumer_idle, 0, __ATOMIC_SEQ_CST) == 0) return;
+
+    event_serv_msg_t m;
+    m.op = event_serv_msg_t_WAKEUP;
+    std_event_util_event_send(wake_fd, &m, NULL, 0, timeout);
+}
+
+/*
+ * Add what there is room for of the total bytes of data, from done bytes in.
+ * Returns 1 once all of it is in the ring, 0 if the ring is full or -1 if
+ * the consumer corrupted the ring.
+ */
+static int ring_put(std_event_ring_t *r, std_event_msg_descr_t *data, size_t total, size_t &done) {
+    size_t part = 0, part_off = done;
+
+    while (part_off > 0 && part_off >= data[part].len) part_off -= data[part++].len;
+
+    while (done < total) {
+        uint64_t used = r->pos - __atomic_load_n(&r->hdr->tail, __ATOMIC_SEQ_CST);
+        if (used > r->size) return -1;
+
+        uint64_t offset = r->pos & (r->size - 1);
+        uint64_t contig = r->size - offset;
+        uint64_t room = r->size - used;
+        std_event_ring_rec_t *rec = (std_event_ring_rec_t *)(r->data + offset);
+
+        if (contig < 2 * sizeof(*rec) && room >= contig) {
+            /* too little left before the end for a chunk */
+            rec->len = 0;
+            rec->flags = STD_EVENT_RING_PAD;
+            r->pos += contig;
+            __atomic_store_n(&r->hdr->head, r->pos, __ATOMIC_RELEASE);
+            continue;
+        }
+        if (room > contig) room = contig;
+        if (room < 2 * sizeof(*rec)) return 0;
+
+        size_t chunk = room - sizeof(*rec);
+        if (chunk > total - done) chunk = total - done;
+        rec->len = chunk;
+        rec->flags = (done + chunk < total) ? STD_EVENT_RING_MORE : 0;
+
+        uint8_t *dst = (uint8_t *)(rec + 1);
+        for (size_t left = chunk; left > 0; ) {
+            size_t n = data[part].len - part_off;
+            if (n > left) n = left;
+            memcpy(dst, (uint8_t *)data[part].data + part_off, n);
+            dst += n;
+            left -= n;
+            part_off += n;
+            if (part_off == data[part].len) {
+                ++part;
+                part_off = 0;
+            }
+        }
+        done += chunk;
+        r->pos += sizeof(*rec) + STD_EVENT_RING_ALIGN(chunk);
+        __atomic_store_n(&r->hdr->head, r->pos, __ATOMIC_SEQ_CST);
+    }
+    return 1;
+}
+
+t_std_error std_event_ring_write(std_event_ring_t *r, std_event_msg_descr_t *data, size_t len,
+        int wake_fd, size_t timeout) {
+    size_t total = 0, done = 0;
+    uint64_t start = 0;
+
+    for (size_t ix = 0; ix < len; ++ix) total += data[ix].len;
+
+    while (true) {
+        int rc = ring_put(r, data, total, done);
+        if (rc < 0) return STD_ERR(COM,FAIL,0);
+        ring_wake(r, wake_fd, timeout);
+        if (rc > 0) return STD_ERR_OK;
+
+        if (start == 0) start = std_get_uptime(NULL);
+        else if (std_time_is_expired(start, MILLI_TO_MICRO(timeout))) return STD_ERR(COM,FAIL,0);
+        std_usleep(STD_EVENT_RING_POLL_US);
+    }
+}
+
+int std_event_ring_write_some(std_event_ring_t *r, std_event_msg_descr_t *data,
+        size_t &done, int wake_fd, size_t timeout) {
+    int rc = ring_put(r, data, data->len, done);
+    if (rc == 0) {
+        /* asks the consumer for a wakeup, then checks for room it made meanwhile */
+        __atomic_store_n(&r->hdr->producer_waiting, 1, __ATOMIC_SEQ_CST);
+        rc = ring_put(r, data, data->len, done);
+    }
+    if (rc >= 0) ring_wake(r, wake_fd, timeout);
+    return rc;
+}
+
+bool std_event_ring_fits(std_event_ring_t *r, size_t len) {
+    uint64_t used = r->pos - __atomic_load_n(&r->hdr->tail, __ATOMIC_ACQUIRE);
+    /* at worst a pad record, then two chunks around the end of the ring */
+    uint64_t need = STD_EVENT_RING_ALIGN(len) + 4 * sizeof(std_event_ring_rec_t);
+    return used <= r->size && r->size - used >= need;
+}
+
+int std_event_ring_read(std_event_ring_t *r, std::vector<uint8_t> &buff, size_t &len) {
+    std_event_ring_rec_t rec;
+
+    while (true) {
+        uint64_t avail = __atomic_load_n(&r->hdr->head, __ATOMIC_ACQUIRE) - r->pos;
+        if (avail == 0) return 0;
+        if (avail > r->size || avail < sizeof(rec)) return -1;
+
+        uint64_t offset = r->pos & (r->size - 1);
+        uint64_t contig = r->size - offset;
+        memcpy(&rec, r->data + offset, sizeof(rec));
+
+        uint64_t step = (rec.flags & STD_EVENT_RING_PAD) ? contig :
+                sizeof(rec) + STD_EVENT_RING_ALIGN(rec.len);
+        if (step > avail || step > contig) return -1;
+
+        if (!(rec.flags & STD_EVENT_RING_PAD)) {
+            if (len + rec.len > STD_EVENT_RING_MAX_MSG) return -1;
+            if (buff.size() < len + rec.len) {
+                try {
+                    buff.resize(len + rec.len);
+                } catch (...) {
+                    return -1;
+                }
+            }
+            memcpy(&buff[len], r->data + offset + sizeof(rec), rec.len);
+            len += rec.len;
+        }
+        r->pos += step;
+        __atomic_store_n(&r->hdr->tail, r->pos, __ATOMIC_RELEASE);
+        if (!(rec.flags & (STD_EVENT_RING_PAD | STD_EVENT_RING_MORE))) return 1;
+    }
+}
+
+bool std_event_ring_idle(std_event_ring_t *r, int wake_fd, size_t timeout) {
+    __atomic_store_n(&r->hdr->consumer_idle, 1, __ATOMIC_SEQ_CST);
+    bool idle = __atomic_load_n(&r->hdr->head, __ATOMIC_SEQ_CST) == r->pos;
+    if (!idle) __atomic_store_n(&r->hdr->consumer_idle, 0, __ATOMIC_SEQ_CST);
+
+    /* a producer waiting for room is sent one wakeup */
+    if (__atomic_load_n(&r->hdr->producer_waiting, __ATOMIC_SEQ_CST) != 0 &&
+            __atomic_exchange_n(&r->hdr->producer_waiting, 0, __ATOMIC_SEQ_CST) != 0) {
+        event_serv_msg_t m;
+        m.op = event_serv_msg_t_WAKEUP;
+        std_event_util_event_send(wake_fd, &m, NULL, 0, timeout);
+    }
+    return idle;
+}
@@ -30,6 +30,7 @@
 
 #include "std_event_service.h"
 #include "private/std_event_utils.h"
+#include "private/std_event_ring.h"
 
 #include "std_socket_tools.h"
 
@@ -45,6 +46,7 @@
 
 
 #include <stdio.h>
+#include <deque>
 #include <list>
 #include <map>
 #include <memory>
@@ -54,6 +56,8 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <errno.h>
+#include <sys/socket.h>
 #include <set>
 
 #define DEF_LISTENERS (10)
@@ -70,12 +74,29 @@
 #define EV_WRITE_TIMEOUT (100)
 #define EV_SEND_TIMEOUT (2000)
 
+/* events taken from a client's ring before the thread goes on to other clients */
+#define EV_RING_BUDGET (256)
+
+/* wait between checks of a full ring by a publisher waiting for room */
+#define EV_RING_POLL_US (100)
+
+/* queued events written to a client in one system call */
+#define EV_QUEUE_IOV (64)
+
+/* most bytes of events packed in one frame by std_client_publish_msg_batch */
+#define EV_BATCH_FRAME (256*1024)
+
 
 #define LE(strid,message,...) EV_LOG_ERR(ev_log_t_COM,0,strid,message,##__VA_ARGS__)
 #define LI(lvl,message,...) EV_LOG_ERR(ev_log_t_COM,lvl,"COM",message,##__VA_ARGS__)
 #define LT(lvl,message,...) EV_LOG_TRACE(ev_log_t_COM,lvl,"COM",message,##__VA_ARGS__)
 #define STD_ERR_RC(type,x) STD_ERR_MK(e_std_err_COM,e_std_err_code_##type,(x))
 
+struct std_socket_event_server_t;
+
+//an event as written to the clients' sockets, shared by their queues
+typedef std::shared_ptr<std::vector<uint8_t> > event_frame_t;
+
 struct std_node_t {
     typedef std::map<uint32_t,struct std_node_t*> node_type_t;
     typedef node_type_t::iterator iterator;
@@ -94,7 +115,8 @@ struct std_node_t {
     bool create_node(uint32_t node) ;
     bool insert(int fd) ;
     void remove(int fd) ;
-    void publish(std_socket_server_handle_t handle, std_event_msg_t *msg, std::set<int> &fds) ;
+    void publish(std_socket_event_server_t *serv, std_event_msg_t *msg, event_frame_t &frame,
+            std::set<int> &fds, std::set<int> &full) ;
     void remove_from_tree(int fd);
 
     bool empty() {
@@ -111,11 +133,47 @@ public:
     bool reg_client(int fd, std_event_key_t *key) ;
     bool dereg_client(int fd, std_event_key_t *key) ;
     void remove_from_tree(int fd) ;
-    void publish(std_socket_server_handle_t handle, std_event_msg_t *msg);
+    void publish(std_socket_event_server_t *serv, std_event_msg_t *msg, std::set<int> &full);
+};
+
+//events waiting for a client's socket or ring to take them
+struct event_queue_t {
+    std::deque<event_frame_t> frames;
+    size_t skip;                    //bytes at the start of each frame that are not written
+    size_t off;                     //bytes of the first one already written
+    size_t bytes;
+
+    event_queue_t() : skip(0), off(0), bytes(0) {}
+    size_t len(const event_frame_t &frame) const { return frame->size() - skip; }
 };
 
 struct event_service_client_data_t {
     std::vector<uint8_t> buff;
+
+    //the rings shared with the client, shm.base is NULL if it only uses the socket
+    std_event_shm_t shm;
+    std_mutex_type_t shm_lock;      //taken by the threads adding to shm.sub or ring_out
+    event_queue_t ring_out;         //the events that did not fit in shm.sub yet
+    std::vector<uint8_t> shm_buff;  //the event being taken from shm.pub
+    size_t shm_len;
+
+    //the events waiting for the socket to take them
+    event_queue_t out;
+    std_mutex_type_t out_lock;
+    bool closing;                   //being closed for not keeping up
+
+    event_service_client_data_t() {
+        shm.base = NULL;
+        shm_len = 0;
+        std_mutex_lock_init_non_recursive(&shm_lock);
+        std_mutex_lock_init_non_recursive(&out_lock);
+        closing = false;
+    }
+    ~event_service_client_data_t() {
+        std_event_shm_unmap(&shm);
+        std_mutex_destroy(&shm_lock);
+        std_mutex_destroy(&out_lock);
+    }
 };
 
 typedef std::map<int,event_service_client_data_t *> event_service_clients_t;
@@ -128,6 +186,10 @@ struct  std_socket_event_server_t {
     std_rw_lock_t m_tree_lock;
     std_client_tree m_reg_tree;
 
+    std_event_queue_policy_t m_policy;
+    size_t m_queue_max;
+    std_event_server_stats_t m_stats;   //updated atomically
+
     void close_client_connection(int fd);
     bool new_client_connection(int fd);
     bool reg_message(int fd, std_event_key_t *key);
@@ -135,6 +197,9 @@ struct  std_socket_event_server_t {
 
     std_socket_event_server_t() {
         m_sock_service = NULL;
+        m_policy = STD_EVENT_QUEUE_DISCONNECT;
+        m_queue_max = STD_EVENT_QUEUE_SIZE;
+        memset(&m_stats,0,sizeof(m_stats));
     }
     void cleanup() {
         if (m_sock_service!=NULL) {
@@ -148,6 +213,20 @@ struct  std_socket_event_server_t {
     }
 
     void publish(std_event_msg_t *msg);
+    bool publish_batch(uint8_t *data, size_t len);
+    bool send_event(int fd, std_event_msg_t *msg, event_frame_t &frame, std::set<int> &full);
+    bool queue_frame(int fd, event_service_client_data_t *c, event_frame_t &frame,
+            std::set<int> &full);
+    bool queue_add(int fd, event_queue_t &q, event_frame_t &frame, size_t off,
+            std::set<int> &full);
+    int flush(int fd, event_service_client_data_t *c);
+    int flush_ring(int fd, event_service_client_data_t *c);
+    bool caught_up(int fd, bool *ring);
+    void wait_for_clients(std::set<int> &full);
+    void drop_oldest(event_queue_t &q, size_t len);
+    void dequeued(event_queue_t &q, size_t len);
+    bool writable(int fd);
+    void close_slow_client(int fd);
 } ;
 
 
@@ -175,22 +254,16 @@ void std_node_t::remove(int fd) {
     clients.erase(fd);
 }
 
-void std_node_t::publish(std_socket_server_handle_t handle, std_event_msg_t *msg,
-        std::set<int> &fds) {
+void std_node_t::publish(std_socket_event_server_t *serv, std_event_msg_t *msg,
+        event_frame_t &frame, std::set<int> &fds, std::set<int> &full) {
     if (clients.size()==0) return;
 
     std::set<int>::iterator it = clients.begin();
     std::set<int>::iterator end = clients.end();
-    event_serv_msg_t m;
-    m.op = event_serv_msg_t_PUBLISH;
-    std_event_msg_descr_t d;
-    d.data = msg;
-    d.len = sizeof(*msg)+msg->data_len;
     for ( ; it != end ; ++it ) {
         if (fds.find(*it)!=fds.end()) continue;
-        if (std_event_util_event_send(*it,&m,&d,1,EV_WRITE_TIMEOUT)!=STD_ERR_OK) {
-            std_socket_service_client_close(handle,*it);
-            EV_LOG(ERR,COM,0,"COM-EVENT-SEND","Client not receiving messages.  Terminating (%d)",*it);
+        if (!serv->send_event(*it,msg,frame,full)) {
+            serv->close_slow_client(*it);
         }
         fds.insert(*it);
     }
@@ -253,25 +326,291 @@ void std_client_tree::remove_from_tree(int fd) {
     head.remove_from_tree(fd);
 }
 
-void std_client_tree::publish(std_socket_server_handle_t handle, std_event_msg_t *msg) {
+void std_client_tree::publish(std_socket_event_server_t *serv, std_event_msg_t *msg,
+        std::set<int> &full) {
     size_t ix = 0;
     std_node_t * cur = &head;
     size_t len = msg->key.len;
     std::set<int> already_sent;
+    event_frame_t frame;
     for ( ; ix < len; ++ix ) {
         std_node_t::iterator it = cur->find(msg->key.event_key[ix]);
         if (it==cur->end()) {
             return;
         }
         cur = it->second;
-        cur->publish(handle,msg,already_sent);
+        cur->publish(serv,msg,frame,already_sent,full);
     }
 }
 
 
 void std_socket_event_server_t::publish(std_event_msg_t *msg) {
+    std::set<int> full;
+    {
+        std_rw_lock_read_guard l(&m_tree_lock);
+        m_reg_tree.publish(this, msg, full);
+    }
+    wait_for_clients(full);
+}
+
+static void stats_max(uint64_t *max, uint64_t val) {
+    uint64_t cur = __atomic_load_n(max,__ATOMIC_RELAXED);
+    while (val > cur &&
+            !__atomic_compare_exchange_n(max,&cur,val,true,__ATOMIC_RELAXED,__ATOMIC_RELAXED)) ;
+}
+
+//the frame of an event, made once for all the clients
+static bool event_frame_make(std_event_msg_descr_t *d, event_frame_t &frame) {
+    if (frame.get()!=NULL) return true;
+    event_serv_msg_t m;
+    m.op = event_serv_msg_t_PUBLISH;
+    try {
+        frame.reset(new std::vector<uint8_t>);
+    } catch (...) {
+        return false;
+    }
+    if (std_event_util_event_frame(&m,d,1,*frame)!=STD_ERR_OK) {
+        frame.reset();
+        return false;
+    }
+    return true;
+}
+
+/*
+ * Called with the tree lock held, which keeps the client data. Under
+ * STD_EVENT_QUEUE_BLOCK the clients left over their limit are added to full,
+ * for the publishing thread to wait for once it lets go of the tree lock.
+ */
+bool std_socket_event_server_t::send_event(int fd, std_event_msg_t *msg, event_frame_t &frame,
+        std::set<int> &full) {
+    std_event_msg_descr_t d;
+    d.data = msg;
+    d.len = sizeof(*msg)+msg->data_len;
+
+    event_service_clients_t::iterator it = m_event_clients.find(fd);
+    if (it==m_event_clients.end()) return false;
+    event_service_client_data_t *c = it->second;
+    if (__atomic_load_n(&c->closing,__ATOMIC_RELAXED)) return true;
+
+    if (c->shm.base!=NULL) {
+        std_mutex_simple_lock_guard m(&c->shm_lock);
+        //what does not fit is queued, events larger than the ring go in pieces
+        size_t done = 0;
+        if (c->ring_out.frames.empty()) {
+            int rc = std_event_ring_write_some(&c->shm.sub,&d,done,fd,EV_WRITE_TIMEOUT);
+            if (rc!=0) return rc > 0;
+        }
+        if (!event_frame_make(&d,frame)) return false;
+        //the ring takes the event that ends the frame
+        c->ring_out.skip = frame->size() - d.len;
+        return queue_add(fd,c->ring_out,frame,done,full);
+    }
+
+    if (!event_frame_make(&d,frame)) return false;
+    return queue_frame(fd,c,frame,full);
+}
+
+/*
+ * Write a frame to the client right away if nothing is queued before it,
+ * otherwise queue it to be written when the socket can take it.
+ */
+bool std_socket_event_server_t::queue_frame(int fd, event_service_client_data_t *c,
+        event_frame_t &frame, std::set<int> &full) {
+    size_t len = frame->size();
+    std_mutex_simple_lock_guard l(&c->out_lock);
+
+    size_t off = 0;
+    if (c->out.frames.empty()) {
+        ssize_t by = send(fd,vector_offset(*frame,0),len,MSG_DONTWAIT|MSG_NOSIGNAL);
+        if (by==(ssize_t)len) return true;
+        if (by < 0) {
+            if (errno!=EAGAIN && errno!=EWOULDBLOCK && errno!=EINTR) return false;
+            by = 0;
+        }
+        off = by;
+    }
+    if (!queue_add(fd,c->out,frame,off,full)) return false;
+    if (c->out.frames.size()==1) std_socket_service_client_want_write(m_sock_service,fd);
+    return true;
+}
+
+//queue a frame, off bytes of which are written, as the policy allows
+bool std_socket_event_server_t::queue_add(int fd, event_queue_t &q, event_frame_t &frame,
+        size_t off, std::set<int> &full) {
+    size_t len = q.len(frame);
+    if (!q.frames.empty() && q.bytes + len > m_queue_max) {
+        if (m_policy==STD_EVENT_QUEUE_DISCONNECT) return false;
+        if (m_policy==STD_EVENT_QUEUE_DROP_OLDEST) drop_oldest(q,len);
+        else full.insert(fd);
+    }
+
+    try {
+        q.frames.push_back(frame);
+    } catch (...) {
+        return false;
+    }
+    if (q.frames.size()==1) q.off = off;
+    q.bytes += len;
+    __atomic_add_fetch(&m_stats.events_queued,1,__ATOMIC_RELAXED);
+    __atomic_add_fetch(&m_stats.queue_bytes,len,__ATOMIC_RELAXED);
+    __atomic_add_fetch(&m_stats.queue_depth,1,__ATOMIC_RELAXED);
+    stats_max(&m_stats.queue_max_depth,q.frames.size());
+    return true;
+}
+
+//account for a frame taken off a queue
+void std_socket_event_server_t::dequeued(event_queue_t &q, size_t len) {
+    q.bytes -= len;
+    __atomic_sub_fetch(&m_stats.queue_bytes,len,__ATOMIC_RELAXED);
+    __atomic_sub_fetch(&m_stats.queue_depth,1,__ATOMIC_RELAXED);
+}
+
+//make room for len bytes, leaving a frame that is partly written to go out whole
+void std_socket_event_server_t::drop_oldest(event_queue_t &q, size_t len) {
+    size_t keep = q.off > 0 ? 1 : 0;
+    while (q.frames.size() > keep && q.bytes + len > m_queue_max) {
+        std::deque<event_frame_t>::iterator it = q.frames.begin() + keep;
+        dequeued(q,q.len(*it));
+        q.frames.erase(it);
+        __atomic_add_fetch(&m_stats.events_dropped,1,__ATOMIC_RELAXED);
+    }
+}
+
+/*
+ * Write what the socket takes of the queue, with the queue lock held.
+ * Returns 1 if the queue was emptied, 0 if the socket is full or -1 on error.
+ */
+int std_socket_event_server_t::flush(int fd, event_service_client_data_t *c) {
+    event_queue_t &q = c->out;
+    while (!q.frames.empty()) {
+        struct iovec iov[EV_QUEUE_IOV];
+        size_t n = 0;
+        std::deque<event_frame_t>::iterator it = q.frames.begin();
+        for ( ; it != q.frames.end() && n < EV_QUEUE_IOV ; ++it, ++n) {
+            size_t off = (n==0) ? q.off : 0;
+            iov[n].iov_base = vector_offset(**it,off);
+            iov[n].iov_len = (*it)->size() - off;
+        }
+        struct msghdr m;
+        memset(&m,0,sizeof(m));
+        m.msg_iov = iov;
+        m.msg_iovlen = n;
+
+        ssize_t by = sendmsg(fd,&m,MSG_DONTWAIT|MSG_NOSIGNAL);
+        if (by < 0) {
+            if (errno==EINTR) continue;
+            return (errno==EAGAIN || errno==EWOULDBLOCK) ? 0 : -1;
+        }
+        for (size_t ix = 0; ix < n && by > 0 ; ++ix) {
+            if ((size_t)by < iov[ix].iov_len) {
+                q.off += by;
+                break;
+            }
+            by -= iov[ix].iov_len;
+            dequeued(q,q.frames.front()->size());
+            q.frames.pop_front();
+            q.off = 0;
+        }
+    }
+    return 1;
+}
+
+/*
+ * Write what the ring takes of the events queued for it, with the shm lock
+ * held. When the ring fills up the client sends a wakeup once it has made
+ * room, and the queue is written from there.
+ * Returns 1 if the queue was emptied, 0 if the ring is full or -1 on error.
+ */
+int std_socket_event_server_t::flush_ring(int fd, event_service_client_data_t *c) {
+    event_queue_t &q = c->ring_out;
+    while (!q.frames.empty()) {
+        std_event_msg_descr_t d;
+        d.data = vector_offset(*q.frames.front(),q.skip);
+        d.len = q.len(q.frames.front());
+        int rc = std_event_ring_write_some(&c->shm.sub,&d,q.off,fd,EV_WRITE_TIMEOUT);
+        if (rc <= 0) return rc;
+        dequeued(q,d.len);
+        q.frames.pop_front();
+        q.off = 0;
+    }
+    return 1;
+}
+
+//write what a client takes of its queue, true once it is under the limit or gone
+bool std_socket_event_server_t::caught_up(int fd, bool *ring) {
     std_rw_lock_read_guard l(&m_tree_lock);
-    m_reg_tree.publish(m_sock_service, msg);
+    event_service_clients_t::iterator it = m_event_clients.find(fd);
+    if (it==m_event_clients.end()) return true;
+    event_service_client_data_t *c = it->second;
+    if (__atomic_load_n(&c->closing,__ATOMIC_RELAXED)) return true;
+
+    *ring = c->shm.base!=NULL;
+    std_mutex_simple_lock_guard m(*ring ? &c->shm_lock : &c->out_lock);
+    int rc = *ring ? flush_ring(fd,c) : flush(fd,c);
+    if (rc < 0) {
+        close_slow_client(fd);
+        return true;
+    }
+    return (*ring ? c->ring_out.bytes : c->out.bytes) <= m_queue_max;
+}
+
+/*
+ * The publishing thread waits for the clients it left over their limit to
+ * take their queues, without the tree lock so that the other publishers go
+ * on, and closes those that do not.
+ */
+void std_socket_event_server_t::wait_for_clients(std::set<int> &full) {
+    std::set<int>::iterator it = full.begin();
+    for ( ; it != full.end() ; ++it ) {
+        int fd = *it;
+        uint64_t start = std_get_uptime(NULL);
+        __atomic_add_fetch(&m_stats.publisher_waits,1,__ATOMIC_RELAXED);
+
+        bool ring = false;
+        while (!caught_up(fd,&ring)) {
+            if (std_time_is_expired(start,MILLI_TO_MICRO(EV_SEND_TIMEOUT))) {
+                std_rw_lock_read_guard l(&m_tree_lock);
+                close_slow_client(fd);
+                break;
+            }
+            if (ring) {
+                std_usleep(EV_RING_POLL_US);
+                continue;
+            }
+            struct timeval tv = { 0, MILLI_TO_MICRO(EV_WRITE_TIMEOUT) };
+            fd_set wset;
+            FD_ZERO(&wset);
+            FD_SET(fd,&wset);
+            std_select_ignore_intr(fd+1,NULL,&wset,NULL,&tv,NULL);
+        }
+    }
+}
+
+//called with the tree lock held
+void std_socket_event_server_t::close_slow_client(int fd) {
+    event_service_clients_t::iterator it = m_event_clients.find(fd);
+    if (it!=m_event_clients.end()) {
+        if (__atomic_exchange_n(&it->second->closing,true,__ATOMIC_RELAXED)) return;
+    }
+    std_socket_service_client_close(m_sock_service,fd);
+    __atomic_add_fetch(&m_stats.clients_closed,1,__ATOMIC_RELAXED);
+    EV_LOG(ERR,COM,0,"COM-EVENT-SEND","Client not receiving messages.  Terminating (%d)",fd);
+}
+
+//the client's socket can take more of its queue
+bool std_socket_event_server_t::writable(int fd) {
+    std_rw_lock_read_guard l(&m_tree_lock);
+    event_service_clients_t::iterator it = m_event_clients.find(fd);
+    if (it==m_event_clients.end()) return true;
+    event_service_client_data_t *c = it->second;
+    if (__atomic_load_n(&c->closing,__ATOMIC_RELAXED)) return true;
+
+    std_mutex_simple_lock_guard m(&c->out_lock);
+    int rc = flush(fd,c);
+    if (rc==0) std_socket_service_client_want_write(m_sock_service,fd);
+    //stop queueing to it until the socket service closes it
+    if (rc < 0) __atomic_store_n(&c->closing,true,__ATOMIC_RELAXED);
+    return rc >= 0;
 }
 
 bool std_socket_event_server_t::new_client_connection(int fd) {
@@ -287,7 +626,11 @@ void std_socket_event_server_t::close_client_connection(int fd) {
 
     event_service_clients_t::iterator it = m_event_clients.find(fd);
     if (it!=m_event_clients.end()) {
-        delete it->second;
+        event_service_client_data_t *c = it->second;
+        __atomic_sub_fetch(&m_stats.queue_bytes,c->out.bytes+c->ring_out.bytes,__ATOMIC_RELAXED);
+        __atomic_sub_fetch(&m_stats.queue_depth,c->out.frames.size()+c->ring_out.frames.size(),
+                __ATOMIC_RELAXED);
+        delete c;
         m_event_clients.erase(it);
     }
     m_reg_tree.remove_from_tree(fd);
@@ -317,22 +660,134 @@ static void setup_address(std_socket_address_t *address, const char * event_chan
     address->addr_type = e_std_socket_a_t_STRING;
 }
 
-static bool event_some_data ( void *context, int fd ) {
-    std_socket_event_server_t *p = (std_socket_event_server_t*)context;
+static bool event_msg_valid(std_event_msg_t *msg, size_t len) {
+    return len >= sizeof(*msg) && len-sizeof(*msg) >= msg->data_len &&
+            msg->key.len <= STD_EVENT_KEY_MAX;
+}
 
-    event_service_clients_t::iterator it = p->m_event_clients.find(fd);
-    if (it==p->m_event_clients.end()) {
+/*
+ * Events packed by std_client_publish_msg_batch, published under one hold
+ * of the tree lock.  The batch is dropped unless its events fill the len
+ * bytes of the message exactly.
+ */
+bool std_socket_event_server_t::publish_batch(uint8_t *data, size_t len) {
+    uint32_t count;
+    if (len < sizeof(count)) return false;
+    memcpy(&count,data,sizeof(count));
+
+    size_t off = sizeof(count);
+    for (uint32_t ix = 0; ix < count ; ++ix) {
+        std_event_msg_t *msg = (std_event_msg_t *)(data+off);
+        if (off > len || !event_msg_valid(msg,len-off)) return false;
+        off += STD_EVENT_BATCH_ALIGN(sizeof(*msg)+msg->data_len);
+    }
+    if (off!=len) return false;
+
+    std::set<int> full;
+    {
+        std_rw_lock_read_guard l(&m_tree_lock);
+        for (off = sizeof(count) ; count > 0 ; --count) {
+            std_event_msg_t *msg = (std_event_msg_t *)(data+off);
+            m_reg_tree.publish(this,msg,full);
+            off += STD_EVENT_BATCH_ALIGN(sizeof(*msg)+msg->data_len);
+        }
+    }
+    wait_for_clients(full);
+    return true;
+}
+
+/*
+ * Publish what the client added to its ring, up to a budget, after which
+ * the client is handled again later. The client is sent a wakeup for
+ * what it adds once the ring is seen empty.
+ */
+static bool event_drain_ring(std_socket_event_server_t *p, int fd, event_service_client_data_t *c) {
+    size_t ix = 0;
+    while (ix < EV_RING_BUDGET) {
+        int rc = std_event_ring_read(&c->shm.pub,c->shm_buff,c->shm_len);
+        if (rc < 0) {
+            EV_LOG(ERR,COM,0,"COM-EVENT-RING","Client ring corrupted.  Terminating (%d)",fd);
+            return false;
+        }
+        if (rc==0) {
+            if (std_event_ring_idle(&c->shm.pub,fd,EV_WRITE_TIMEOUT)) return true;
+            continue;
+        }
+        std_event_msg_t *msg = (std_event_msg_t *)&(c->shm_buff[0]);
+        size_t len = c->shm_len;
+        c->shm_len = 0;
+        if (!event_msg_valid(msg,len)) return false;
+        p->publish(msg);
+        ++ix;
+    }
+    std_socket_service_client_ready(p->m_sock_service,fd);
+    return true;
+}
+
+static bool event_shm_setup(std_socket_event_server_t *p, int fd, event_service_client_data_t *c,
+        void *data, size_t len, int shm_fd) {
+    uint32_t status = 1;
+    uint64_t ring_size = 0;
+    std_event_shm_t shm;
+    shm.base = NULL;
+
+    if (len >= sizeof(ring_size)) memcpy(&ring_size,data,sizeof(ring_size));
+    if (ring_size!=0 && shm_fd!=-1 && c->shm.base==NULL) {
+        std_event_shm_map(shm_fd,ring_size,&shm);
+    }
+    if (shm_fd!=-1) close(shm_fd);
+
+    event_serv_msg_t m;
+    m.op = event_serv_msg_t_SHM;
+    std_event_msg_descr_t d;
+    d.data = &status;
+    d.len = sizeof(status);
+    event_frame_t frame;
+
+    /*
+     * Events already queued to the socket would reach the client after
+     * later ones put in the ring. The reply goes before any wakeup.
+     */
+    std_rw_lock_write_guard l(&p->m_tree_lock);
+    if (shm.base!=NULL && c->out.frames.empty()) {
+        c->shm = shm;
+        status = 0;
+    } else {
+        std_event_shm_unmap(&shm);
+    }
+    try {
+        frame.reset(new std::vector<uint8_t>);
+    } catch (...) {
         return false;
     }
-    std::vector<uint8_t> &buff =(*it).second->buff;
-    if (std_event_util_event_recv(fd,buff,true)!=STD_ERR_OK) {
+    if (std_event_util_event_frame(&m,&d,1,*frame)!=STD_ERR_OK) return false;
+    std::set<int> full;
+    return p->queue_frame(fd,c,frame,full);
+}
+
+//handle a message from the client's socket
+static bool event_client_msg(std_socket_event_server_t *p, int fd, event_service_client_data_t *c) {
+    std::vector<uint8_t> &buff =c->buff;
+    int shm_fd = -1;
+    size_t msg_len = 0;
+    if (std_event_util_event_recv(fd,buff,true,&shm_fd,&msg_len)!=STD_ERR_OK) {
+        if (shm_fd!=-1) close(shm_fd);
         return false;
     }
 
-    if (buff.size()< sizeof(event_serv_msg_t)) return false;
+    if (msg_len < sizeof(event_serv_msg_t)) {
+        if (shm_fd!=-1) close(shm_fd);
+        return false;
+    }
+    size_t len = msg_len - sizeof(event_serv_msg_t);
 
     event_serv_msg_t *serv_msg = (event_serv_msg_t*) &(buff[0]);
     void * data = vector_offset(buff,sizeof(event_serv_msg_t));
+    if (serv_msg->op==event_serv_msg_t_SHM) {
+        return event_shm_setup(p,fd,c,data,len,shm_fd);
+    }
+    if (shm_fd!=-1) close(shm_fd);
+
     if (serv_msg->op==event_serv_msg_t_ADD_REG) {
         std_event_key_t *key = (std_event_key_t *)data;
         return p->reg_message(fd,key);
@@ -343,9 +798,12 @@ static bool event_some_data ( void *context, int fd ) {
     }
     if (serv_msg->op == event_serv_msg_t_PUBLISH) {
         std_event_msg_t *msg = (std_event_msg_t *)data;
-        if (buff.size()< (sizeof(event_serv_msg_t)+ sizeof(std_event_msg_t)+msg->data_len)) return false;
+        if (!event_msg_valid(msg,len)) return false;
         p->publish(msg);
     }
+    if (serv_msg->op == event_serv_msg_t_PUBLISH_BATCH) {
+        return p->publish_batch((uint8_t*)data,len);
+    }
     if (serv_msg->op == event_serv_msg_t_BUFFER) {
         size_t buff_len = *(size_t*)data;
         if (buff_len < SOCKET_BUFFER_MIN_SIZE) { //if less then some minimum, ignore it
@@ -360,21 +818,60 @@ static bool event_some_data ( void *context, int fd ) {
     return true;
 }
 
+static bool event_some_data ( void *context, int fd ) {
+    std_socket_event_server_t *p = (std_socket_event_server_t*)context;
+
+    event_service_clients_t::iterator it = p->m_event_clients.find(fd);
+    if (it==p->m_event_clients.end()) {
+        return false;
+    }
+    event_service_client_data_t *c = it->second;
+    if (c->shm.base==NULL) return event_client_msg(p,fd,c);
+
+    /*
+     * Registrations come before the events the client publishes after
+     * them. The socket may have nothing when called for the ring only.
+     */
+    char b;
+    ssize_t by = recv(fd,&b,sizeof(b),MSG_PEEK|MSG_DONTWAIT);
+    if (by==0) return false;
+    if (by > 0) {
+        if (!event_client_msg(p,fd,c)) return false;
+    } else if (errno!=EAGAIN && errno!=EWOULDBLOCK && errno!=EINTR) {
+        return false;
+    }
+
+    //a wakeup from the client can also mean it made room for what is queued
+    {
+        std_mutex_simple_lock_guard m(&c->shm_lock);
+        if (p->flush_ring(fd,c) < 0) return false;
+    }
+    return event_drain_ring(p,fd,c);
+}
+
 //New client connection established
 static bool event_new_client(void *context,  int fd ) {
     std_socket_event_server_t *p = (std_socket_event_server_t*)context;
     std_rw_lock_write_guard l(&p->m_tree_lock);
 
     if (p->m_event_clients.find(fd)!=p->m_event_clients.end()) {
-        //something wrong.. cleanup and exit
+        //left by a client closed for not keeping up, whose fd is reused
         p->close_client_connection(fd);
-        return false;
     }
     //set the default socket buffer for the events to something high
     std_sock_set_sndbuf(fd,SOCKET_BUFFER_SIZE);
     return p->new_client_connection(fd);
 }
 
+//Client's socket can take more of the events queued for it
+static bool event_writable ( void *context, int fd ) {
+    std_socket_event_server_t *p = (std_socket_event_server_t*)context;
+    if (p->writable(fd)) return true;
+    __atomic_add_fetch(&p->m_stats.clients_closed,1,__ATOMIC_RELAXED);
+    EV_LOG(ERR,COM,0,"COM-EVENT-SEND","Client not receiving messages.  Terminating (%d)",fd);
+    return false;
+}
+
 //Client has closed connection
 static bool event_del_client ( void *context, int fd ) {
     std_socket_event_server_t *p = (std_socket_event_server_t*)context;
@@ -402,6 +899,7 @@ t_std_error std_event_server_init(std_event_server_handle_t *handle,
     serv.new_client = event_new_client;
     serv.del_client = event_del_client;
     serv.some_data = event_some_data;
+    serv.writable = event_writable;
 
     setup_address(&serv.address, event_channel_name);
 
@@ -425,6 +923,33 @@ t_std_error std_event_server_init(std_event_server_handle_t *handle,
 }
 
 
+t_std_error std_event_server_set_queue_policy(std_event_server_handle_t handle,
+        std_event_queue_policy_t policy, size_t max_bytes) {
+    std_socket_event_server_t *p = to_context(handle);
+    if (policy!=STD_EVENT_QUEUE_DISCONNECT && policy!=STD_EVENT_QUEUE_DROP_OLDEST &&
+            policy!=STD_EVENT_QUEUE_BLOCK) {
+        return STD_ERR(COM,PARAM,0);
+    }
+    std_rw_lock_write_guard l(&p->m_tree_lock);
+    p->m_policy = policy;
+    p->m_queue_max = max_bytes==0 ? STD_EVENT_QUEUE_SIZE : max_bytes;
+    return STD_ERR_OK;
+}
+
+t_std_error std_event_server_get_stats(std_event_server_handle_t handle,
+        std_event_server_stats_t *stats) {
+    std_socket_event_server_t *p = to_context(handle);
+    std_event_server_stats_t *s = &p->m_stats;
+    stats->events_queued = __atomic_load_n(&s->events_queued,__ATOMIC_RELAXED);
+    stats->events_dropped = __atomic_load_n(&s->events_dropped,__ATOMIC_RELAXED);
+    stats->publisher_waits = __atomic_load_n(&s->publisher_waits,__ATOMIC_RELAXED);
+    stats->clients_closed = __atomic_load_n(&s->clients_closed,__ATOMIC_RELAXED);
+    stats->queue_depth = __atomic_load_n(&s->queue_depth,__ATOMIC_RELAXED);
+    stats->queue_bytes = __atomic_load_n(&s->queue_bytes,__ATOMIC_RELAXED);
+    stats->queue_max_depth = __atomic_load_n(&s->queue_max_depth,__ATOMIC_RELAXED);
+    return STD_ERR_OK;
+}
+
 t_std_error std_server_client_connect(std_event_client_handle * handle, const char *event_channel_name) {
     std_socket_address_t addr;
     setup_address(&addr,event_channel_name);
@@ -441,11 +966,142 @@ t_std_error std_server_client_connect(std_event_client_handle * handle, const ch
     return STD_ERR_OK;
 }
 
+/*
+ * The rings of the handles connected with std_server_client_connect_shm.
+ * Handles of plain connections are not looked up while there are none.
+ */
+struct event_client_shm_t {
+    std_event_shm_t shm;
+    std_mutex_type_t pub_lock;
+    std::vector<uint8_t> ctl;   //replies and wakeups from the service
+    std::vector<uint8_t> rx;    //events for std_client_wait_for_event_data
+
+    event_client_shm_t() {
+        shm.base = NULL;
+        std_mutex_lock_init_non_recursive(&pub_lock);
+    }
+    ~event_client_shm_t() {
+        std_event_shm_unmap(&shm);
+        std_mutex_destroy(&pub_lock);
+    }
+};
+
+typedef std::map<int,event_client_shm_t *> event_client_shms_t;
+
+static event_client_shms_t client_shms;
+static size_t client_shms_count = 0;
+static std_mutex_lock_create_static_init_fast(client_shms_lock);
+
+static event_client_shm_t * client_shm_get(std_event_client_handle handle) {
+    if (__atomic_load_n(&client_shms_count,__ATOMIC_ACQUIRE)==0) return NULL;
+    std_mutex_simple_lock_guard l(&client_shms_lock);
+    event_client_shms_t::iterator it = client_shms.find(handle);
+    return it==client_shms.end() ? NULL : it->second;
+}
+
+static t_std_error client_shm_reply(std_event_client_handle handle, std::vector<uint8_t> &buff) {
+    struct timeval tv = { EV_SEND_TIMEOUT/1000, (EV_SEND_TIMEOUT%1000)*1000 };
+    t_std_error rc = STD_ERR_OK;
+    fd_set set;
+
+    std_sel_adds_set(&handle,1,&set,NULL,true);
+    int n = std_select_ignore_intr(handle+1,&set,NULL,NULL,&tv,&rc);
+    if (n < 0) return rc;
+    //a service that does not know of shared memory does not reply
+    if (n == 0) return STD_ERR(COM,FAIL,ETIMEDOUT);
+
+    if ((rc=std_event_util_event_recv(handle,buff))!=STD_ERR_OK) return rc;
+    if (buff.size() < sizeof(event_serv_msg_t)+sizeof(uint32_t)) return STD_ERR(COM,FAIL,0);
+    event_serv_msg_t *m = (event_serv_msg_t*)vector_offset(buff,0);
+    uint32_t *status = (uint32_t*)vector_offset(buff,sizeof(event_serv_msg_t));
+    if (m->op!=event_serv_msg_t_SHM || *status!=0) return STD_ERR(COM,FAIL,0);
+    return STD_ERR_OK;
+}
+
+t_std_error std_server_client_connect_shm(std_event_client_handle * handle,
+        const char *event_channel_name, size_t ring_size) {
+    std_event_client_handle h;
+    t_std_error rc = std_server_client_connect(&h,event_channel_name);
+    if (rc!=STD_ERR_OK) return rc;
+
+    event_client_shm_t *c = NULL;
+    try {
+        c = new event_client_shm_t;
+    } catch (...) {
+        close(h);
+        return STD_ERR(COM,NOMEM,0);
+    }
+
+    do {
+        int fd = -1;
+        if ((rc=std_event_shm_create(ring_size==0 ? STD_EVENT_SHM_RING_SIZE : ring_size,
+                &c->shm,&fd))!=STD_ERR_OK) break;
+
+        event_serv_msg_t m;
+        m.op = event_serv_msg_t_SHM;
+        uint64_t size = c->shm.pub.size;
+        std_event_msg_descr_t d;
+        d.data = &size;
+        d.len = sizeof(size);
+        rc = std_event_util_event_send(h,&m,&d,1,EV_SEND_TIMEOUT,fd);
+        close(fd);
+        if (rc!=STD_ERR_OK) break;
+        if ((rc=client_shm_reply(h,c->ctl))!=STD_ERR_OK) break;
+
+        try {
+            std_mutex_simple_lock_guard l(&client_shms_lock);
+            client_shms[h] = c;
+            __atomic_add_fetch(&client_shms_count,1,__ATOMIC_RELEASE);
+        } catch (...) {
+            rc = STD_ERR(COM,NOMEM,0);
+            break;
+        }
+        *handle = h;
+        return STD_ERR_OK;
+    } while (0);
+
+    delete c;
+    close(h);
+    return rc;
+}
+
 t_std_error std_server_client_disconnect(std_event_client_handle handle) {
-    if (handle!=-1) close(handle);
+    if (handle==-1) return STD_ERR_OK;
+
+    event_client_shm_t *c = NULL;
+    if (__atomic_load_n(&client_shms_count,__ATOMIC_ACQUIRE)!=0) {
+        std_mutex_simple_lock_guard l(&client_shms_lock);
+        event_client_shms_t::iterator it = client_shms.find(handle);
+        if (it!=client_shms.end()) {
+            c = it->second;
+            client_shms.erase(it);
+            __atomic_sub_fetch(&client_shms_count,1,__ATOMIC_RELEASE);
+        }
+    }
+    close(handle);
+    delete c;
     return STD_ERR_OK;
 }
 
+static t_std_error client_shm_publish(std_event_client_handle handle, event_client_shm_t *c,
+        std_event_msg_descr_t *d, size_t len) {
+    std_mutex_simple_lock_guard l(&c->pub_lock);
+    return std_event_ring_write(&c->shm.pub,d,len,handle,EV_SEND_TIMEOUT);
+}
+
+//the next event from the ring, appended to buff after len bytes
+static t_std_error client_shm_recv(std_event_client_handle handle, event_client_shm_t *c,
+        std::vector<uint8_t> &buff, size_t &len) {
+    while (true) {
+        int rc = std_event_ring_read(&c->shm.sub,buff,len);
+        if (rc > 0) return STD_ERR_OK;
+        if (rc < 0) return STD_ERR(COM,FAIL,0);
+        if (!std_event_ring_idle(&c->shm.sub,handle,EV_SEND_TIMEOUT)) continue;
+        //the service only sends wakeups once the rings are set up
+        if (std_event_util_event_recv(handle,c->ctl)!=STD_ERR_OK) return STD_ERR(COM,FAIL,0);
+    }
+}
+
 t_std_error std_client_publish_msg(std_event_client_handle handle, std_event_msg_t *msg) {
     event_serv_msg_t m;
     m.op = event_serv_msg_t_PUBLISH;
@@ -453,6 +1109,10 @@ t_std_error std_client_publish_msg(std_event_client_handle handle, std_event_msg
     std_event_msg_descr_t d;
     d.data  = msg;
     d.len = sizeof(*msg)+msg->data_len;
+
+    event_client_shm_t *c = client_shm_get(handle);
+    if (c!=NULL) return client_shm_publish(handle,c,&d,1);
+
     return std_event_util_event_send(handle,&m,&d,1,EV_SEND_TIMEOUT);
 }
 
@@ -470,9 +1130,61 @@ t_std_error std_client_publish_msg_data(std_event_client_handle handle,
     d[0].len = sizeof(msg);
     d[1].data = data;
     d[1].len = len;
+
+    event_client_shm_t *c = client_shm_get(handle);
+    if (c!=NULL) return client_shm_publish(handle,c,d,sizeof(d)/sizeof(*d));
+
     return std_event_util_event_send(handle,&m,d,sizeof(d)/sizeof(*d),EV_SEND_TIMEOUT);
 }
 
+t_std_error std_client_publish_msg_batch(std_event_client_handle handle,
+        std_event_msg_t **msgs, size_t count) {
+    event_client_shm_t *c = client_shm_get(handle);
+    if (c!=NULL) {
+        std_mutex_simple_lock_guard l(&c->pub_lock);
+        for (size_t ix = 0; ix < count ; ++ix ) {
+            std_event_msg_descr_t d;
+            d.data = msgs[ix];
+            d.len = sizeof(*msgs[ix])+msgs[ix]->data_len;
+            t_std_error rc = std_event_ring_write(&c->shm.pub,&d,1,handle,EV_SEND_TIMEOUT);
+            if (rc!=STD_ERR_OK) return rc;
+        }
+        return STD_ERR_OK;
+    }
+
+    event_serv_msg_t m;
+    m.op = event_serv_msg_t_PUBLISH_BATCH;
+    std::vector<uint8_t> buff;
+    size_t ix = 0;
+
+    while (ix < count) {
+        //as many events as fit in a frame, and at least one, after their number
+        uint32_t n = 0;
+        size_t len = sizeof(n);
+        try {
+            buff.resize(len);
+            for ( ; ix < count ; ++ix, ++n ) {
+                size_t ev_len = sizeof(*msgs[ix])+msgs[ix]->data_len;
+                if (n > 0 && len + ev_len > EV_BATCH_FRAME) break;
+                buff.resize(len + STD_EVENT_BATCH_ALIGN(ev_len));
+                memcpy(vector_offset(buff,len),msgs[ix],ev_len);
+                for (len += ev_len ; len < buff.size() ; ++len) buff[len] = 0;
+            }
+        } catch (...) {
+            return STD_ERR(COM,NOMEM,0);
+        }
+
+        memcpy(vector_offset(buff,0),&n,sizeof(n));
+
+        std_event_msg_descr_t d;
+        d.data = vector_offset(buff,0);
+        d.len = len;
+        t_std_error rc = std_event_util_event_send(handle,&m,&d,1,EV_SEND_TIMEOUT);
+        if (rc!=STD_ERR_OK) return rc;
+    }
+    return STD_ERR_OK;
+}
+
 static t_std_error client_send_key_op(std_event_client_handle handle,
         event_serv_msg_types_t op,std_event_key_t *keys, size_t len) {
     size_t ix = 0;
@@ -506,7 +1218,7 @@ struct event_msg_buff_t {
 
 std_event_msg_buff_t std_client_allocate_msg_buff(unsigned int buffer_space, bool limit_max) {
     event_msg_buff_t *p = new event_msg_buff_t;
-    if (p==NULL) return false;
+    if (p==NULL) return NULL;
 
     try {
         p->buff.resize(buffer_space);
@@ -524,8 +1236,9 @@ std_event_msg_buff_t std_client_allocate_msg_buff(unsigned int buffer_space, boo
  * @param msg to free
  */
 void std_client_free_msg_buff(std_event_msg_buff_t *buff) {
-    event_msg_buff_t *p = (event_msg_buff_t*)buff;
+    event_msg_buff_t *p = (event_msg_buff_t*)*buff;
     delete p;
+    *buff = NULL;
 }
 
 std_event_msg_t * std_event_msg_from_buff(std_event_msg_buff_t buff) {
@@ -538,6 +1251,18 @@ std_event_msg_t * std_event_msg_from_buff(std_event_msg_buff_t buff) {
 
 t_std_error std_client_wait_for_event_data(std_event_client_handle handle,
         std_event_msg_t *msg, void *buff, size_t len) {
+    event_client_shm_t *c = client_shm_get(handle);
+    if (c!=NULL) {
+        size_t have = 0;
+        t_std_error rc = client_shm_recv(handle,c,c->rx,have);
+        if (rc!=STD_ERR_OK) return rc;
+        if (have < sizeof(*msg)) return STD_ERR(COM,FAIL,0);
+        memcpy(msg,vector_offset(c->rx,0),sizeof(*msg));
+        if (have-sizeof(*msg) != msg->data_len) return STD_ERR(COM,FAIL,0);
+        if (msg->data_len > len) return STD_ERR(COM,TOOBIG,0);
+        memcpy(buff,vector_offset(c->rx,sizeof(*msg)),msg->data_len);
+        return STD_ERR_OK;
+    }
     return std_event_util_event_recv_msg(handle,msg,buff,len);
 }
 
@@ -545,9 +1270,166 @@ t_std_error std_client_wait_for_event_data(std_event_client_handle handle,
 t_std_error std_client_wait_for_event(std_event_client_handle handle, std_event_msg_buff_t buff) {
     event_msg_buff_t *p = (event_msg_buff_t*)buff;
 
+    event_client_shm_t *c = client_shm_get(handle);
+    if (c!=NULL) {
+        //laid out as received from the socket, for std_event_msg_from_buff
+        size_t len = sizeof(event_serv_msg_t);
+        if (p->buff.size() < len) p->buff.resize(len);
+        t_std_error rc = client_shm_recv(handle,c,p->buff,len);
+        if (rc!=STD_ERR_OK) return rc;
+        ((event_serv_msg_t*)vector_offset(p->buff,0))->op = event_serv_msg_t_PUBLISH;
+        if (p->limit_max && len > p->max_len) return STD_ERR(COM,TOOBIG,0);
+        return STD_ERR_OK;
+    }
+
     return std_event_util_event_recv(handle,p->buff, !p->limit_max);
 }
 
+struct event_batch_buff_t {
+    std::vector<uint8_t> buff;
+    size_t space;                   //bytes read at most at a time
+    size_t start;                   //an event not whole yet, from start to end
+    size_t end;
+    std::vector<size_t> events;     //offset of each event received
+    size_t next;                    //the next event for std_event_batch_next
+};
+
+std_event_batch_buff_t std_client_allocate_batch_buff(size_t buffer_space) {
+    event_batch_buff_t *p = NULL;
+    try {
+        p = new event_batch_buff_t;
+        p->buff.resize(buffer_space);
+    } catch (...) {
+        delete p;
+        return NULL;
+    }
+    p->space = buffer_space;
+    p->start = 0;
+    p->end = 0;
+    p->next = 0;
+    return p;
+}
+
+void std_client_free_batch_buff(std_event_batch_buff_t *buff) {
+    event_batch_buff_t *p = (event_batch_buff_t*)*buff;
+    delete p;
+    *buff = NULL;
+}
+
+std_event_msg_t * std_event_batch_next(std_event_batch_buff_t buff) {
+    event_batch_buff_t *p = (event_batch_buff_t*)buff;
+    if (p->next >= p->events.size()) return NULL;
+    return (std_event_msg_t *)vector_offset(p->buff,p->events[p->next++]);
+}
+
+/*
+ * Take the whole frames from start to end. The events are moved back to
+ * be aligned, over the header of their frame.
+ */
+static bool batch_parse_frames(event_batch_buff_t *p) {
+    size_t msg_off, frame_len;
+    while (true) {
+        int rc = std_event_util_frame_parse(vector_offset(p->buff,p->start),p->end-p->start,
+                &msg_off,&frame_len);
+        if (rc < 0) return false;
+        if (rc == 0) {
+            //a frame larger than the buffer gets the room it needs
+            if (p->start + frame_len > p->buff.size()) {
+                try {
+                    p->buff.resize(p->start + frame_len);
+                } catch (...) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        size_t len = frame_len - msg_off;
+        uint8_t *m = vector_offset(p->buff,p->start+msg_off);
+        event_serv_msg_t op;
+        if (len < sizeof(op)) return false;
+        memcpy(&op,m,sizeof(op));
+        if (op.op==event_serv_msg_t_PUBLISH) {
+            std_event_msg_t msg;
+            len -= sizeof(op);
+            if (len < sizeof(msg)) return false;
+            memcpy(&msg,m+sizeof(op),sizeof(msg));
+            if (len-sizeof(msg)!=msg.data_len) return false;
+
+            size_t at = (p->start + msg_off + sizeof(op)) & ~(__alignof__(std_event_msg_t)-1);
+            memmove(vector_offset(p->buff,at),m+sizeof(op),len);
+            p->events.push_back(at);
+        }
+        p->start += frame_len;
+    }
+}
+
+//take the events in the ring, blocking for the first one
+static t_std_error batch_read_ring(std_event_client_handle handle, event_client_shm_t *c,
+        event_batch_buff_t *p) {
+    size_t len = p->end;
+    t_std_error rc = client_shm_recv(handle,c,p->buff,len);
+    if (rc!=STD_ERR_OK) return rc;
+    size_t at = 0;
+
+    while (true) {
+        if (len - at < sizeof(std_event_msg_t) ||
+                len - at - sizeof(std_event_msg_t) !=
+                        ((std_event_msg_t *)vector_offset(p->buff,at))->data_len) {
+            return STD_ERR(COM,FAIL,0);
+        }
+        p->events.push_back(at);
+        if (len >= p->space) break;
+
+        at = (len + __alignof__(std_event_msg_t) - 1) & ~(__alignof__(std_event_msg_t)-1);
+        len = at;
+        int got = std_event_ring_read(&c->shm.sub,p->buff,len);
+        if (got < 0) return STD_ERR(COM,FAIL,0);
+        if (got == 0) {
+            //keep what there is of the next event for the next call
+            p->start = at;
+            p->end = len;
+            return STD_ERR_OK;
+        }
+    }
+    p->start = p->end = 0;
+    return STD_ERR_OK;
+}
+
+t_std_error std_client_wait_for_events(std_event_client_handle handle, std_event_batch_buff_t buff) {
+    event_batch_buff_t *p = (event_batch_buff_t*)buff;
+    p->events.clear();
+    p->next = 0;
+
+    //what there is of the next event goes to the start
+    if (p->start > 0) {
+        memmove(vector_offset(p->buff,0),vector_offset(p->buff,p->start),p->end-p->start);
+        p->end -= p->start;
+        p->start = 0;
+    }
+
+    event_client_shm_t *c = client_shm_get(handle);
+    if (c!=NULL) return batch_read_ring(handle,c,p);
+
+    if (!batch_parse_frames(p)) return STD_ERR(COM,FAIL,0);
+    while (p->events.empty()) {
+        //there is room for at least the rest of the frame being read
+        ssize_t by = recv(handle,vector_offset(p->buff,p->end),p->buff.size()-p->end,0);
+        if (by < 0 && errno==EINTR) continue;
+        if (by <= 0) return STD_ERR_RC(CLOSED,handle);
+        p->end += by;
+
+        if (!batch_parse_frames(p)) return STD_ERR(COM,FAIL,0);
+        //no events left in the buffer, make room from its start
+        if (p->events.empty() && p->start > 0) {
+            memmove(vector_offset(p->buff,0),vector_offset(p->buff,p->start),p->end-p->start);
+            p->end -= p->start;
+            p->start = 0;
+        }
+    }
+    return STD_ERR_OK;
+}
+
 t_std_error std_client_set_receive_buffer(std_event_client_handle handle,
         size_t len)  {
     event_serv_msg_t m;
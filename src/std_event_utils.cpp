@@ -32,6 +32,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
 
 #define STD_ERR_RC(type,x) STD_ERR_MK(e_std_err_COM,e_std_err_code_##type,(x))
 
@@ -48,11 +49,24 @@ struct std_event_ipc_data_t {
     uint32_t size;
 };
 
-t_std_error std_event_util_event_send(std_event_client_handle handle,
-        event_serv_msg_t *msg, std_event_msg_descr_t *data, size_t len, size_t timeout) {
-    t_std_error rc = STD_ERR_OK;
+int std_event_util_frame_parse(const void *data, size_t len, size_t *msg_off,
+        size_t *frame_len) {
     std_event_ipc_data_t hdr;
+    *msg_off = sizeof(hdr);
+    *frame_len = sizeof(hdr.hdr);
+    if (len < sizeof(hdr.hdr)) return 0;
+    memcpy(&hdr.hdr,data,sizeof(hdr.hdr));
+    //the sizes of the message are in the rest of the header
+    if (hdr.hdr.size!=sizeof(hdr)-sizeof(hdr.hdr)) return -1;
+
+    *frame_len = sizeof(hdr);
+    if (len < sizeof(hdr)) return 0;
+    memcpy(&hdr,data,sizeof(hdr));
+    *frame_len = sizeof(hdr) + (size_t)hdr.size;
+    return len < *frame_len ? 0 : 1;
+}
 
+static void fill_header(std_event_ipc_data_t &hdr, std_event_msg_descr_t *data, size_t len) {
     hdr.hdr.version = STD_CMN_IPC_VER;
     hdr.hdr.size =sizeof(std_event_ipc_data_t)-sizeof(std_event_ipc_hdr_t);
     hdr.version=0;
@@ -61,7 +75,37 @@ t_std_error std_event_util_event_send(std_event_client_handle handle,
     for (size_t ix = 0 ; ix < len ; ++ix ) {
         hdr.size += data[ix].len;
     }
-    hdr.size += sizeof(*msg) ;
+    hdr.size += sizeof(event_serv_msg_t) ;
+}
+
+t_std_error std_event_util_event_frame(event_serv_msg_t *msg, std_event_msg_descr_t *data,
+        size_t len, std::vector<uint8_t> &frame) {
+    std_event_ipc_data_t hdr;
+    fill_header(hdr,data,len);
+
+    try {
+        frame.resize(sizeof(hdr)+hdr.size);
+    } catch (...) {
+        return STD_ERR(COM,NOMEM,0);
+    }
+    uint8_t *p = vector_offset(frame,0);
+    memcpy(p,&hdr,sizeof(hdr));
+    p += sizeof(hdr);
+    memcpy(p,msg,sizeof(*msg));
+    p += sizeof(*msg);
+    for (size_t ix = 0 ; ix < len ; ++ix ) {
+        memcpy(p,data[ix].data,data[ix].len);
+        p += data[ix].len;
+    }
+    return STD_ERR_OK;
+}
+
+t_std_error std_event_util_event_send(std_event_client_handle handle,
+        event_serv_msg_t *msg, std_event_msg_descr_t *data, size_t len, size_t timeout,
+        int pass_fd) {
+    t_std_error rc = STD_ERR_OK;
+    std_event_ipc_data_t hdr;
+    fill_header(hdr,data,len);
 
     struct iovec _iov[len+2];
     size_t ix = 0;
@@ -83,6 +127,21 @@ t_std_error std_event_util_event_send(std_event_client_handle handle,
     _pkt.msg_iov = _iov;
     _pkt.msg_iovlen = mx;
 
+    union {
+        struct cmsghdr hdr;
+        char buff[CMSG_SPACE(sizeof(int))];
+    } ctl;
+    if (pass_fd!=-1) {
+        memset(&ctl,0,sizeof(ctl));
+        _pkt.msg_control = ctl.buff;
+        _pkt.msg_controllen = sizeof(ctl.buff);
+        struct cmsghdr *c = CMSG_FIRSTHDR(&_pkt);
+        c->cmsg_level = SOL_SOCKET;
+        c->cmsg_type = SCM_RIGHTS;
+        c->cmsg_len = CMSG_LEN(sizeof(int));
+        memcpy(CMSG_DATA(c),&pass_fd,sizeof(int));
+    }
+
     std_socket_op(std_socket_transit_o_WRITE,handle,&_pkt,
             (std_socket_transit_flags_t)(std_socket_transit_f_NONBLOCK|
                     std_socket_transit_f_ALL),timeout,&rc);
@@ -90,9 +149,47 @@ t_std_error std_event_util_event_send(std_event_client_handle handle,
     return rc;
 }
 
-static bool read_header(std_event_client_handle handle,std_event_ipc_data_t &hdr) {
+/* the first bytes of a frame, and the fd passed along with it if asked for */
+static int read_first(std_event_client_handle handle, void *data, size_t len, int *passed_fd) {
+    t_std_error rc = STD_ERR_OK;
+    if (passed_fd==NULL) return std_read(handle,data,len,true,&rc);
+
+    *passed_fd = -1;
+    union {
+        struct cmsghdr hdr;
+        char buff[CMSG_SPACE(sizeof(int))];
+    } ctl;
+    struct iovec iov;
+    iov.iov_base = data;
+    iov.iov_len = len;
+    struct msghdr m;
+    memset(&m,0,sizeof(m));
+    m.msg_iov = &iov;
+    m.msg_iovlen = 1;
+    m.msg_control = ctl.buff;
+    m.msg_controllen = sizeof(ctl.buff);
+
+    ssize_t by;
+    do {
+        by = recvmsg(handle,&m,MSG_WAITALL|MSG_CMSG_CLOEXEC);
+    } while (by==-1 && errno==EINTR);
+
+    struct cmsghdr *c = by > 0 ? CMSG_FIRSTHDR(&m) : NULL;
+    if (c!=NULL && c->cmsg_level==SOL_SOCKET && c->cmsg_type==SCM_RIGHTS &&
+            c->cmsg_len==CMSG_LEN(sizeof(int))) {
+        memcpy(passed_fd,CMSG_DATA(c),sizeof(int));
+    }
+    if (by > 0 && (size_t)by < len) {
+        int more = std_read(handle,(char*)data+by,len-by,true,&rc);
+        by = more > 0 ? by + more : more;
+    }
+    return by;
+}
+
+static bool read_header(std_event_client_handle handle,std_event_ipc_data_t &hdr,
+        int *passed_fd=NULL) {
     t_std_error rc = STD_ERR_OK;
-    int by = std_read(handle,&hdr,sizeof(hdr.hdr),true,&rc);
+    int by = read_first(handle,&hdr,sizeof(hdr.hdr),passed_fd);
     if (by!=sizeof(hdr.hdr)) return false;
     if (hdr.hdr.size >(sizeof(std_event_ipc_data_t)-sizeof(hdr.hdr))) {
         return false;
@@ -105,10 +202,11 @@ static bool read_header(std_event_client_handle handle,std_event_ipc_data_t &hdr
     return true;
 }
 
-t_std_error std_event_util_event_recv(std_event_client_handle handle, std::vector<uint8_t> &buff, bool allow_resize) {
+t_std_error std_event_util_event_recv(std_event_client_handle handle, std::vector<uint8_t> &buff,
+        bool allow_resize, int *passed_fd, size_t *msg_len) {
     t_std_error rc = STD_ERR_OK;
     std_event_ipc_data_t hdr;
-    if (!read_header(handle,hdr)) return STD_ERR(COM,FAIL,0);
+    if (!read_header(handle,hdr,passed_fd)) return STD_ERR(COM,FAIL,0);
     if (hdr.size > buff.size()) {
         if (!allow_resize) {
             return STD_ERR(COM,TOOBIG,0);
@@ -120,7 +218,9 @@ t_std_error std_event_util_event_recv(std_event_client_handle handle, std::vecto
         }
     }
     int by = std_read(handle,&(buff[0]),hdr.size,true,&rc);
-    return by==(int)hdr.size ? STD_ERR_OK : STD_ERR_RC(FAIL,by);
+    if (by!=(int)hdr.size) return STD_ERR_RC(FAIL,by);
+    if (msg_len!=NULL) *msg_len = hdr.size;
+    return STD_ERR_OK;
 }
 
 t_std_error std_event_util_event_recv_msg(std_event_client_handle handle,
@@ -0,0 +1,549 @@
+/*
+ * Copyright (c) 2016 Dell Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * THIS CODE IS PROVIDED ON AN *AS IS* BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT
+ * LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS
+ * FOR A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+ *
+ * See the Apache Version 2.0 License for specific language governing
+ * permissions and limitations under the License.
+ */
+
+/*
+ * filename: std_hash.c
+ */
+
+/*!
+ * \file   std_hash.c
+ * \brief  Open addressing hash table for exact match lookups.
+ */
+
+
+/*---------------------------------------------------------------*\
+ *                    Includes.
+\*---------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "std_hash.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+
+/*---------------------------------------------------------------*\
+ *                    Defines and Macros.
+\*---------------------------------------------------------------*/
+
+#define HASH_ASSERT    assert
+#define HASH_MALLOC    malloc
+#define HASH_FREE    free
+#define HASH_MAGIC    0xfeedf00d
+#define HASH_NAME_MAX_LEN    50
+
+/// Slots per group; one SSE2 register worth of metadata bytes.
+#define HASH_GROUP    16
+
+/**
+ * Metadata byte values. A full slot holds the low 7 bits of the hash
+ * (0..0x7f) so both free states have the top bit set.
+ */
+#define HASH_CTRL_EMPTY    ((int8_t)0x80)
+#define HASH_CTRL_DELETED    ((int8_t)0xfe)
+
+#define HASH_H1(hash)    ((hash) >> 7)
+#define HASH_H2(hash)    ((int8_t)((hash) & 0x7f))
+
+/// Keep at most 7/8 of the slots in use (including deleted ones).
+#define HASH_MAX_LOAD(s)    (((s)->ngroups * HASH_GROUP) - ((s)->ngroups * HASH_GROUP) / 8)
+
+/// Number of old groups moved to the new slots on every update.
+#define HASH_MIGRATE_GROUPS    2
+
+#define HASH_VALIDATE_HANDLE(h) \
+            HASH_ASSERT(h); \
+            HASH_ASSERT((h)->magic == HASH_MAGIC);
+
+
+/*---------------------------------------------------------------*\
+ *                    Data structures.
+\*---------------------------------------------------------------*/
+
+/**
+ *  One generation of slots. The metadata bytes and the slot pointers
+ *  are allocated in a single block starting at ctrl.
+ */
+typedef struct _std_hash_slots
+{
+    int8_t *ctrl;
+    void **slots;
+    size_t ngroups;
+    size_t used;
+    size_t deleted;
+} std_hash_slots;
+
+struct _std_hash_table
+{
+    u_long magic;
+    char name[HASH_NAME_MAX_LEN+1];
+    int keyoffset;
+    int keylength;
+
+    int (*compare)(std_hash_handle h, void *data1, void *data2);
+    uint64_t (*hash)(std_hash_handle h, void *data);
+    void *(*hmalloc)(size_t size);
+    void (*hfree)(void *);
+
+    /// Slots receiving all inserts.
+    std_hash_slots cur;
+
+    /// Slots being migrated into cur; ngroups is 0 when not resizing.
+    std_hash_slots old;
+
+    /// Next group of old to migrate.
+    size_t migrate_pos;
+
+    u_long count;
+};
+
+
+/*---------------------------------------------------------------*\
+ *            Private methods
+\*---------------------------------------------------------------*/
+
+static void * std_hash_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+static void std_hash_free(void *ptr)
+{
+    free(ptr);
+}
+
+static int std_hash_gen_cmp(std_hash_handle h, void *lhs, void *rhs)
+{
+    return memcmp(((char *)lhs) + h->keyoffset,
+                  ((char *)rhs) + h->keyoffset,
+                  h->keylength);
+}
+
+static inline uint64_t std_hash_mix(uint64_t x)
+{
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+/// Bit i set when metadata byte i of the group equals 'c'.
+static inline uint32_t std_hash_group_match(const int8_t *ctrl, int8_t c)
+{
+#if defined(__SSE2__)
+    __m128i g = _mm_loadu_si128((const __m128i *)ctrl);
+    return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(g, _mm_set1_epi8(c)));
+#else
+    uint32_t m = 0;
+    int i;
+
+    for (i = 0; i < HASH_GROUP; i++)
+    {
+        if (ctrl[i] == c)
+            m |= 1u << i;
+    }
+    return m;
+#endif
+}
+
+/// Bit i set when slot i of the group is empty or deleted.
+static inline uint32_t std_hash_group_match_free(const int8_t *ctrl)
+{
+#if defined(__SSE2__)
+    return (uint32_t)_mm_movemask_epi8(_mm_loadu_si128((const __m128i *)ctrl));
+#else
+    uint32_t m = 0;
+    int i;
+
+    for (i = 0; i < HASH_GROUP; i++)
+    {
+        if (ctrl[i] < 0)
+            m |= 1u << i;
+    }
+    return m;
+#endif
+}
+
+static t_std_error std_hash_slots_alloc(std_hash_handle h, std_hash_slots *s, size_t ngroups)
+{
+    size_t nslots = ngroups * HASH_GROUP;
+    char *block;
+
+    if ((block = (char *)h->hmalloc(nslots + nslots * sizeof(void *))) == (char *)0)
+        return (STD_ERR_FROM_ERRNO(e_std_err_COM, e_std_err_code_NOMEM));
+
+    s->ctrl = (int8_t *)block;
+    s->slots = (void **)(block + nslots);
+    s->ngroups = ngroups;
+    s->used = 0;
+    s->deleted = 0;
+    memset(s->ctrl, HASH_CTRL_EMPTY, nslots);
+    return STD_ERR_OK;
+} // std_hash_slots_alloc()
+
+
+static void std_hash_slots_release(std_hash_handle h, std_hash_slots *s)
+{
+    if (s->ctrl)
+        h->hfree(s->ctrl);
+    memset(s, 0, sizeof(*s));
+} // std_hash_slots_release()
+
+
+/**
+ *  Look for the key of 'data' in one generation of slots. Groups are
+ *  probed in triangular order, which visits every group once when the
+ *  number of groups is a power of 2. A group with an empty slot ends
+ *  the probe since an insert would have stopped there.
+ *  @return The slot index or -1 if not found.
+ */
+static long std_hash_find(std_hash_handle h, std_hash_slots *s, void *data, uint64_t hash)
+{
+    size_t mask, g, step, slot;
+    const int8_t *ctrl;
+    uint32_t m;
+
+    if (!s->ngroups)
+        return -1;
+
+    mask = s->ngroups - 1;
+    g = HASH_H1(hash) & mask;
+    for (step = 0; step <= mask; g = (g + ++step) & mask)
+    {
+        ctrl = s->ctrl + g * HASH_GROUP;
+        for (m = std_hash_group_match(ctrl, HASH_H2(hash)); m; m &= m - 1)
+        {
+            slot = g * HASH_GROUP + __builtin_ctz(m);
+            if (h->compare(h, data, s->slots[slot]) == 0)
+                return (long)slot;
+        }
+        if (std_hash_group_match(ctrl, HASH_CTRL_EMPTY))
+            break;
+    }
+    return -1;
+} // std_hash_find()
+
+
+/// Put 'data' in the first free slot of its probe sequence.
+static void std_hash_place(std_hash_slots *s, void *data, uint64_t hash)
+{
+    size_t mask, g, step, slot;
+    uint32_t m;
+
+    mask = s->ngroups - 1;
+    g = HASH_H1(hash) & mask;
+    for (step = 0; ; g = (g + ++step) & mask)
+    {
+        if ((m = std_hash_group_match_free(s->ctrl + g * HASH_GROUP)))
+            break;
+        HASH_ASSERT(step <= mask);
+    }
+
+    slot = g * HASH_GROUP + __builtin_ctz(m);
+    if (s->ctrl[slot] == HASH_CTRL_DELETED)
+        s->deleted--;
+    s->ctrl[slot] = HASH_H2(hash);
+    s->slots[slot] = data;
+    s->used++;
+} // std_hash_place()
+
+
+/**
+ *  Free a slot. If its group still has an empty slot no probe has ever
+ *  gone past this group, so the slot can be made empty again; otherwise
+ *  it has to stay as a deleted marker.
+ */
+static void std_hash_clear(std_hash_slots *s, size_t slot)
+{
+    const int8_t *ctrl = s->ctrl + (slot & ~(size_t)(HASH_GROUP - 1));
+
+    if (std_hash_group_match(ctrl, HASH_CTRL_EMPTY))
+    {
+        s->ctrl[slot] = HASH_CTRL_EMPTY;
+    }
+    else
+    {
+        s->ctrl[slot] = HASH_CTRL_DELETED;
+        s->deleted++;
+    }
+    s->used--;
+} // std_hash_clear()
+
+
+/**
+ *  Move up to 'groups' groups of the old slots into the current ones.
+ *  Moved slots are left as deleted markers, not empty, so lookups in the
+ *  old slots still probe past them to keys placed further along.
+ */
+static void std_hash_migrate(std_hash_handle h, size_t groups)
+{
+    size_t ix, slot;
+
+    while (groups-- && h->old.ngroups)
+    {
+        slot = h->migrate_pos * HASH_GROUP;
+        for (ix = 0; ix < HASH_GROUP; ix++, slot++)
+        {
+            if (h->old.ctrl[slot] < 0)
+                continue;
+            std_hash_place(&h->cur, h->old.slots[slot], h->hash(h, h->old.slots[slot]));
+            h->old.ctrl[slot] = HASH_CTRL_DELETED;
+            h->old.used--;
+            h->old.deleted++;
+        }
+
+        if (++h->migrate_pos == h->old.ngroups)
+        {
+            std_hash_slots_release(h, &h->old);
+            h->migrate_pos = 0;
+        }
+    }
+} // std_hash_migrate()
+
+
+/**
+ *  Start a resize when the current slots are full. The table doubles if
+ *  more than half of the load is live entries, otherwise it is rebuilt
+ *  at the same size to get rid of the deleted markers.
+ */
+static t_std_error std_hash_grow(std_hash_handle h)
+{
+    std_hash_slots s;
+    size_t ngroups;
+    t_std_error rc;
+
+    if (h->cur.used + h->cur.deleted < HASH_MAX_LOAD(&h->cur))
+        return STD_ERR_OK;
+
+    /* only one migration at a time; finish the previous one first */
+    if (h->old.ngroups)
+        std_hash_migrate(h, h->old.ngroups);
+
+    ngroups = h->cur.ngroups;
+    if (h->cur.used >= HASH_MAX_LOAD(&h->cur) / 2)
+        ngroups *= 2;
+
+    if ((rc = std_hash_slots_alloc(h, &s, ngroups)) != STD_ERR_OK)
+        return rc;
+
+    h->old = h->cur;
+    h->cur = s;
+    h->migrate_pos = 0;
+    return STD_ERR_OK;
+} // std_hash_grow()
+
+
+static void * std_hash_walk_slots(std_hash_handle h, std_hash_slots *s,
+                                  int (* walk_fn)(std_hash_handle h, void *, va_list ap),
+                                  va_list ap)
+{
+    size_t ix, mx;
+    va_list ap1;
+    int stop;
+
+    mx = s->ngroups * HASH_GROUP;
+    for (ix = 0; ix < mx; ix++)
+    {
+        if (s->ctrl[ix] < 0)
+            continue;
+        va_copy(ap1, ap);
+        stop = walk_fn(h, s->slots[ix], ap1);
+        va_end(ap1);
+        if (stop)
+            return s->slots[ix];
+    }
+    return (void *)0;
+} // std_hash_walk_slots()
+
+
+/*---------------------------------------------------------------*\
+ *            Public methods
+\*---------------------------------------------------------------*/
+
+uint64_t std_hash_bytes(const void *buf, size_t len)
+{
+    const uint8_t *p = (const uint8_t *)buf;
+    uint64_t h = 0x9e3779b97f4a7c15ULL ^ len;
+    uint64_t v;
+
+    for ( ; len >= sizeof(v); len -= sizeof(v), p += sizeof(v))
+    {
+        memcpy(&v, p, sizeof(v));
+        h = std_hash_mix(h ^ v) * 0x9e3779b97f4a7c15ULL;
+    }
+    if (len)
+    {
+        v = 0;
+        memcpy(&v, p, len);
+        h = std_hash_mix(h ^ v) * 0x9e3779b97f4a7c15ULL;
+    }
+    return std_hash_mix(h);
+} // std_hash_bytes()
+
+
+uint64_t std_hash_gen_hash(std_hash_handle h, void *data)
+{
+    return std_hash_bytes(((char *)data) + h->keyoffset, h->keylength);
+} // std_hash_gen_hash()
+
+
+std_hash_handle std_hash_create(char *name, int keyoffset, int keylength,
+                                void *hash_malloc(size_t), void hash_free(void *),
+                                int compare(std_hash_handle h, void *, void *),
+                                uint64_t hash(std_hash_handle h, void *))
+{
+    std_hash_handle h;
+
+    HASH_ASSERT(name);
+
+    if ((h = (std_hash_handle)HASH_MALLOC(sizeof(*h))) == (std_hash_handle)0)
+        return (std_hash_handle)0;
+
+    memset(h, 0, sizeof(*h));
+    h->magic = HASH_MAGIC;
+    strncpy(h->name, name, HASH_NAME_MAX_LEN);
+    h->name[HASH_NAME_MAX_LEN] = '\0';
+    h->keyoffset = keyoffset;
+    h->keylength = keylength;
+    h->compare = compare ? compare : std_hash_gen_cmp;
+    h->hash = hash ? hash : std_hash_gen_hash;
+    h->hmalloc = hash_malloc ? hash_malloc : std_hash_malloc;
+    h->hfree = hash_free ? hash_free : std_hash_free;
+
+    if (std_hash_slots_alloc(h, &h->cur, 1) != STD_ERR_OK)
+    {
+        HASH_FREE(h);
+        return (std_hash_handle)0;
+    }
+    return h;
+} // std_hash_create()
+
+
+std_hash_handle std_hash_create_simple(char *name, int keyoffset, int keylength)
+{
+    return std_hash_create(name, keyoffset, keylength, NULL, NULL, NULL, NULL);
+} // std_hash_create_simple()
+
+
+void std_hash_destroy(std_hash_handle h)
+{
+    HASH_VALIDATE_HANDLE(h);
+
+    std_hash_slots_release(h, &h->cur);
+    std_hash_slots_release(h, &h->old);
+    h->magic = 0;
+    HASH_FREE(h);
+} // std_hash_destroy()
+
+
+t_std_error std_hash_insert(std_hash_handle h, void *data)
+{
+    uint64_t hash;
+    t_std_error rc;
+
+    HASH_VALIDATE_HANDLE(h);
+    HASH_ASSERT(data);
+
+    hash = h->hash(h, data);
+    if (std_hash_find(h, &h->cur, data, hash) >= 0 ||
+        std_hash_find(h, &h->old, data, hash) >= 0)
+        return STD_ERR(COM, PARAM, 0);
+
+    if ((rc = std_hash_grow(h)) != STD_ERR_OK)
+        return rc;
+
+    std_hash_place(&h->cur, data, hash);
+    h->count++;
+
+    std_hash_migrate(h, HASH_MIGRATE_GROUPS);
+    return STD_ERR_OK;
+} // std_hash_insert()
+
+
+void * std_hash_remove(std_hash_handle h, void *data)
+{
+    uint64_t hash;
+    long slot;
+    void *found;
+    std_hash_slots *s = &h->cur;
+
+    HASH_VALIDATE_HANDLE(h);
+    HASH_ASSERT(data);
+
+    hash = h->hash(h, data);
+    if ((slot = std_hash_find(h, s, data, hash)) < 0)
+    {
+        s = &h->old;
+        if ((slot = std_hash_find(h, s, data, hash)) < 0)
+            return (void *)0;
+    }
+
+    found = s->slots[slot];
+    std_hash_clear(s, (size_t)slot);
+    h->count--;
+
+    std_hash_migrate(h, HASH_MIGRATE_GROUPS);
+    return found;
+} // std_hash_remove()
+
+
+void * std_hash_getexact(std_hash_handle h, void *data)
+{
+    uint64_t hash;
+    long slot;
+
+    HASH_VALIDATE_HANDLE(h);
+    HASH_ASSERT(data);
+
+    hash = h->hash(h, data);
+    if ((slot = std_hash_find(h, &h->cur, data, hash)) >= 0)
+        return h->cur.slots[slot];
+    if ((slot = std_hash_find(h, &h->old, data, hash)) >= 0)
+        return h->old.slots[slot];
+    return (void *)0;
+} // std_hash_getexact()
+
+
+void * std_hash_walk(std_hash_handle h, int (* walkcb)(std_hash_handle h, void *, va_list ap), ...)
+{
+    va_list ap;
+    void *stop = (void *)0;
+
+    HASH_VALIDATE_HANDLE(h);
+
+    if (!walkcb)
+        return (void *)0;
+
+    va_start(ap, walkcb);
+    if (!(stop = std_hash_walk_slots(h, &h->cur, walkcb, ap)) && h->old.ngroups)
+        stop = std_hash_walk_slots(h, &h->old, walkcb, ap);
+    va_end(ap);
+    return stop;
+} // std_hash_walk()
+
+
+u_long std_hash_count(std_hash_handle h)
+{
+    HASH_VALIDATE_HANDLE(h);
+
+    return h->count;
+} // std_hash_count()
@@ -0,0 +1,290 @@
+/*
+ * Copyright (c) 2016 Dell Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * THIS CODE IS PROVIDED ON AN *AS IS* BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT
+ * LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS
+ * FOR A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+ *
+ * See the Apache Version 2.0 License for specific language governing
+ * permissions and limitations under the License.
+ */
+
+/*
+ * filename: std_id_allocator.c
+ */
+
+/*!
+ * \file   std_id_allocator.c
+ * \brief  Allocator of integer IDs from a range, like VLAN, LAG or nexthop IDs
+ */
+
+#include "std_id_allocator.h"
+#include "std_bit_masks.h"
+#include "std_mutex_lock.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+/* bits summed up by a bit of the level above */
+#define STD_ID_ALLOC_FANOUT     64
+/* enough levels for INT_MAX IDs */
+#define STD_ID_ALLOC_LEVELS     6
+
+struct std_id_allocator_s {
+    uint32_t first_id;
+    uint32_t num_ids;
+    uint32_t num_free;
+    int num_levels;
+    size_t level_len[STD_ID_ALLOC_LEVELS];  /* bits of each level, a multiple of 64 */
+    uint8_t *level[STD_ID_ALLOC_LEVELS];    /* level[0] has the bit of each ID */
+    bool thread_safe;
+    std_mutex_type_t lock;
+};
+
+static inline void std_id_allocator_lock(std_id_allocator_t *alloc) {
+    if (alloc->thread_safe) std_mutex_lock(&alloc->lock);
+}
+
+static inline void std_id_allocator_unlock(std_id_allocator_t *alloc) {
+    if (alloc->thread_safe) std_mutex_unlock(&alloc->lock);
+}
+
+static inline size_t std_id_allocator_round(size_t bits) {
+    return (bits + STD_ID_ALLOC_FANOUT - 1) / STD_ID_ALLOC_FANOUT * STD_ID_ALLOC_FANOUT;
+}
+
+/* is any bit set in the group of 64 bits 'group' of a level */
+static inline bool std_id_allocator_group_set(std_id_allocator_t *alloc, int level, size_t group) {
+    return std_find_first_bit(alloc->level[level], (group + 1) * STD_ID_ALLOC_FANOUT,
+                              group * STD_ID_ALLOC_FANOUT) >= 0;
+}
+
+/* clear the bit of an ID, and the summary bits above it that no longer have a bit set */
+static void std_id_allocator_mark_used(std_id_allocator_t *alloc, size_t bit) {
+    int level;
+
+    for (level = 0; level < alloc->num_levels; ++level) {
+        STD_BIT_ARRAY_CLR(alloc->level[level], bit);
+        bit /= STD_ID_ALLOC_FANOUT;
+        if (std_id_allocator_group_set(alloc, level, bit)) break;
+    }
+    alloc->num_free--;
+}
+
+/* set the bit of an ID, and the summary bits above it that were clear */
+static void std_id_allocator_mark_free(std_id_allocator_t *alloc, size_t bit) {
+    bool was_set;
+    int level;
+
+    for (level = 0; level < alloc->num_levels; ++level) {
+        was_set = std_id_allocator_group_set(alloc, level, bit / STD_ID_ALLOC_FANOUT);
+        STD_BIT_ARRAY_SET(alloc->level[level], bit);
+        if (was_set) break;
+        bit /= STD_ID_ALLOC_FANOUT;
+    }
+    alloc->num_free++;
+}
+
+/*
+ * First bit set at or after 'from' in a level. Only the group of 'from'
+ * is searched there; past it the level above says which group to look in.
+ */
+static int std_id_allocator_next_free(std_id_allocator_t *alloc, int level, size_t from) {
+    size_t group = from / STD_ID_ALLOC_FANOUT;
+    int bit;
+
+    if (from >= alloc->level_len[level]) return -1;
+
+    bit = std_find_first_bit(alloc->level[level], (group + 1) * STD_ID_ALLOC_FANOUT, from);
+    if (bit >= 0 || level + 1 == alloc->num_levels) return bit;
+
+    bit = std_id_allocator_next_free(alloc, level + 1, group + 1);
+    if (bit < 0) return -1;
+    return std_find_first_bit(alloc->level[level], ((size_t)bit + 1) * STD_ID_ALLOC_FANOUT,
+                              (size_t)bit * STD_ID_ALLOC_FANOUT);
+}
+
+/* is [id, id + count) within the allocator */
+static inline bool std_id_allocator_in_range(std_id_allocator_t *alloc, uint32_t id, uint32_t count) {
+    return id >= alloc->first_id &&
+           (uint64_t)(id - alloc->first_id) + count <= alloc->num_ids;
+}
+
+t_std_error std_id_allocator_create(std_id_allocator_t **alloc, uint32_t first_id,
+                                    uint32_t num_ids, bool thread_safe) {
+    std_id_allocator_t *a;
+    size_t bits;
+    int level;
+
+    if (num_ids == 0 || num_ids > INT_MAX || (uint64_t)first_id + num_ids - 1 > UINT32_MAX)
+        return STD_ERR(COM,PARAM,0);
+
+    a = (std_id_allocator_t *)calloc(1, sizeof(*a));
+    if (a == NULL) return STD_ERR(COM,NOMEM,0);
+    a->first_id = first_id;
+    a->num_ids = num_ids;
+    a->num_free = num_ids;
+    a->thread_safe = thread_safe;
+
+    /* the bits past the IDs stay clear on every level */
+    for (bits = num_ids; ; bits = (bits + STD_ID_ALLOC_FANOUT - 1) / STD_ID_ALLOC_FANOUT) {
+        level = a->num_levels++;
+        a->level_len[level] = std_id_allocator_round(bits);
+        a->level[level] = (uint8_t *)std_bitmap_create_array_clear_bits(a->level_len[level]);
+        if (a->level[level] == NULL) {
+            std_id_allocator_destroy(a);
+            return STD_ERR(COM,NOMEM,0);
+        }
+        std_bit_array_set_range(a->level[level], 0, bits);
+        if (a->level_len[level] == STD_ID_ALLOC_FANOUT) break;
+    }
+
+    if (thread_safe && std_mutex_lock_init_non_recursive(&a->lock) != STD_ERR_OK) {
+        a->thread_safe = false;
+        std_id_allocator_destroy(a);
+        return STD_ERR(COM,FAIL,0);
+    }
+    *alloc = a;
+    return STD_ERR_OK;
+}
+
+void std_id_allocator_destroy(std_id_allocator_t *alloc) {
+    int level;
+
+    for (level = 0; level < alloc->num_levels; ++level)
+        std_bitmaparray_free_data(alloc->level[level]);
+    if (alloc->thread_safe) std_mutex_destroy(&alloc->lock);
+    free(alloc);
+}
+
+t_std_error std_id_allocator_alloc(std_id_allocator_t *alloc, uint32_t *id) {
+    int bit;
+
+    std_id_allocator_lock(alloc);
+    bit = std_id_allocator_next_free(alloc, 0, 0);
+    if (bit >= 0) std_id_allocator_mark_used(alloc, bit);
+    std_id_allocator_unlock(alloc);
+
+    if (bit < 0) return STD_ERR(COM,NORESOURCE,0);
+    *id = alloc->first_id + bit;
+    return STD_ERR_OK;
+}
+
+t_std_error std_id_allocator_alloc_specific(std_id_allocator_t *alloc, uint32_t id) {
+    t_std_error rc = STD_ERR_OK;
+    size_t bit;
+
+    if (!std_id_allocator_in_range(alloc, id, 1)) return STD_ERR(COM,PARAM,0);
+    bit = id - alloc->first_id;
+
+    std_id_allocator_lock(alloc);
+    if (STD_BIT_ARRAY_TEST(alloc->level[0], bit))
+        std_id_allocator_mark_used(alloc, bit);
+    else
+        rc = STD_ERR(COM,NORESOURCE,0);
+    std_id_allocator_unlock(alloc);
+    return rc;
+}
+
+t_std_error std_id_allocator_alloc_range(std_id_allocator_t *alloc, uint32_t count,
+                                         uint32_t *first_id) {
+    int start, used;
+    size_t ix;
+
+    if (count == 0) return STD_ERR(COM,PARAM,0);
+
+    std_id_allocator_lock(alloc);
+    /* from each free ID, look for one in use before count of them */
+    for (start = std_id_allocator_next_free(alloc, 0, 0); start >= 0;
+         start = std_id_allocator_next_free(alloc, 0, used + 1)) {
+        if ((uint64_t)start + count > alloc->num_ids) break;
+        used = std_find_next_zero_bit(alloc->level[0], start + count, start);
+        if (used < 0) {
+            for (ix = start; ix < (size_t)start + count; ++ix)
+                std_id_allocator_mark_used(alloc, ix);
+            std_id_allocator_unlock(alloc);
+            *first_id = alloc->first_id + start;
+            return STD_ERR_OK;
+        }
+    }
+    std_id_allocator_unlock(alloc);
+    return STD_ERR(COM,NORESOURCE,0);
+}
+
+t_std_error std_id_allocator_reserve(std_id_allocator_t *alloc, uint32_t first_id,
+                                     uint32_t count) {
+    t_std_error rc = STD_ERR_OK;
+    size_t start, ix;
+
+    if (count == 0 || !std_id_allocator_in_range(alloc, first_id, count))
+        return STD_ERR(COM,PARAM,0);
+    start = first_id - alloc->first_id;
+
+    std_id_allocator_lock(alloc);
+    if (std_find_next_zero_bit(alloc->level[0], start + count, start) < 0) {
+        for (ix = start; ix < start + count; ++ix)
+            std_id_allocator_mark_used(alloc, ix);
+    } else {
+        rc = STD_ERR(COM,NORESOURCE,0);
+    }
+    std_id_allocator_unlock(alloc);
+    return rc;
+}
+
+t_std_error std_id_allocator_free(std_id_allocator_t *alloc, uint32_t id) {
+    t_std_error rc = STD_ERR_OK;
+    size_t bit;
+
+    if (!std_id_allocator_in_range(alloc, id, 1)) return STD_ERR(COM,PARAM,0);
+    bit = id - alloc->first_id;
+
+    std_id_allocator_lock(alloc);
+    if (!STD_BIT_ARRAY_TEST(alloc->level[0], bit))
+        std_id_allocator_mark_free(alloc, bit);
+    else
+        rc = STD_ERR(COM,NEXIST,0);
+    std_id_allocator_unlock(alloc);
+    return rc;
+}
+
+t_std_error std_id_allocator_free_range(std_id_allocator_t *alloc, uint32_t first_id,
+                                        uint32_t count) {
+    size_t start, ix;
+
+    if (!std_id_allocator_in_range(alloc, first_id, count)) return STD_ERR(COM,PARAM,0);
+    start = first_id - alloc->first_id;
+
+    std_id_allocator_lock(alloc);
+    for (ix = start; ix < start + count; ++ix) {
+        if (!STD_BIT_ARRAY_TEST(alloc->level[0], ix))
+            std_id_allocator_mark_free(alloc, ix);
+    }
+    std_id_allocator_unlock(alloc);
+    return STD_ERR_OK;
+}
+
+bool std_id_allocator_is_allocated(std_id_allocator_t *alloc, uint32_t id) {
+    bool used;
+
+    if (!std_id_allocator_in_range(alloc, id, 1)) return false;
+
+    std_id_allocator_lock(alloc);
+    used = !STD_BIT_ARRAY_TEST(alloc->level[0], id - alloc->first_id);
+    std_id_allocator_unlock(alloc);
+    return used;
+}
+
+uint32_t std_id_allocator_num_free(std_id_allocator_t *alloc) {
+    uint32_t n;
+
+    std_id_allocator_lock(alloc);
+    n = alloc->num_free;
+    std_id_allocator_unlock(alloc);
+    return n;
+}
@@ -31,10 +31,13 @@
 #include <stdio.h>
 
 #define DLL_MAGIC   0xF10D1F10
+#define DLL_SKIP_MAGIC   0xF10D5C1F
 #define DLL_DEBUG   0
 
+#define DLL_IS_SKIP(head)   ((head)->dll_magic == DLL_SKIP_MAGIC)
+
 #if DLL_DEBUG
-#define DLL_VALIDATE(head)  assert((head)->dll_magic == DLL_MAGIC)
+#define DLL_VALIDATE(head)  assert((head)->dll_magic == DLL_MAGIC || DLL_IS_SKIP(head))
 #else
 #define DLL_VALIDATE(head)
 #endif
@@ -133,7 +136,14 @@ int std_compare_binary_function(const void *current, const void *node,unsigned i
     return memcmp(current,node,len);
 }
 
+static void std_dll_skip_insert(std_dll_skip_head *head, std_dll_skip *new);
+static void std_dll_skip_remove(std_dll_skip_head *head, std_dll_skip *item);
+
 void std_dll_insert(std_dll_head *head, std_dll *new) {
+    if (DLL_IS_SKIP(head)) {
+        std_dll_skip_insert((std_dll_skip_head *)head,(std_dll_skip *)new);
+        return;
+    }
     if (head->compare==NULL) {
         std_dll_insertatback(head,new);
         return;
@@ -214,6 +224,9 @@ std_dll_remove(std_dll_head *head, std_dll *item)
     std_dll *front, *back;
     DLL_VALIDATE(head);
 
+    if (DLL_IS_SKIP(head))
+        std_dll_skip_remove((std_dll_skip_head *)head, (std_dll_skip *)item);
+
     front = item->dll_back;
     back = item->dll_next;
 
@@ -224,6 +237,215 @@ std_dll_remove(std_dll_head *head, std_dll *item)
     item->dll_next = (std_dll *)0;
 }
 
+/*----------------------------------------------------------------*\
+                            Sort
+\*----------------------------------------------------------------*/
+
+/* enough bins for a list of any size that fits in memory */
+#define DLL_SORT_BINS   (sizeof(void *) * 8)
+
+/*
+ * Merge two sorted NULL terminated chains of dll_next links, the elements
+ * of a going first on equal keys.
+ */
+static std_dll * std_dll_sort_merge(std_dll *a, std_dll *b, std_compare_function compare,
+        unsigned int off, unsigned int len) {
+    std_dll first, *last = &first;
+
+    while (a != NULL && b != NULL) {
+        if (compare(offset(a, off), offset(b, off), len) <= 0) {
+            last->dll_next = a;
+            a = a->dll_next;
+        } else {
+            last->dll_next = b;
+            b = b->dll_next;
+        }
+        last = last->dll_next;
+    }
+    last->dll_next = (a != NULL) ? a : b;
+    return first.dll_next;
+}
+
+/*
+ * The elements are taken off the list one at a time and bin[i] holds a
+ * sorted chain of 2^i of them, like a binary counter: an element is merged
+ * with the full bins below the first empty one and goes in there. The
+ * bins are then merged from the smallest, each being older than what was
+ * merged so far, and the back links are rebuilt at the end.
+ */
+void std_dll_sort(std_dll_head *head, std_compare_function compare, unsigned int off, unsigned int len) {
+    std_dll *bin[DLL_SORT_BINS];
+    std_dll *walk, *next, *carry, *prev;
+    size_t ix, used = 0;
+
+    DLL_VALIDATE(head);
+    if (DLL_IS_SKIP(head)) return;
+
+    if (compare == NULL) {
+        compare = head->compare;
+        off = head->offset;
+        len = head->len;
+        if (compare == NULL) return;
+    }
+
+    for (walk = head->head.dll_next; walk != &head->tail; walk = next) {
+        next = walk->dll_next;
+        walk->dll_next = NULL;
+        carry = walk;
+        for (ix = 0; ix < used && bin[ix] != NULL; ++ix) {
+            carry = std_dll_sort_merge(bin[ix], carry, compare, off, len);
+            bin[ix] = NULL;
+        }
+        if (ix == used) ++used;
+        bin[ix] = carry;
+    }
+
+    carry = NULL;
+    for (ix = 0; ix < used; ++ix) {
+        if (bin[ix] != NULL) carry = std_dll_sort_merge(bin[ix], carry, compare, off, len);
+    }
+
+    prev = &head->head;
+    for (walk = carry; walk != NULL; walk = walk->dll_next) {
+        prev->dll_next = walk;
+        walk->dll_back = prev;
+        prev = walk;
+    }
+    prev->dll_next = &head->tail;
+    head->tail.dll_back = prev;
+}
+
+/*----------------------------------------------------------------*\
+                          Skip List
+\*----------------------------------------------------------------*/
+
+/*
+ * The std_dll links hold every element in order. Above them each element is
+ * also on the first skip_height index levels, a level holding about a quarter
+ * of the elements of the one below, so a search drops down from the top level
+ * and only walks a few elements on each one.
+ */
+
+#define DLL_SKIP_KEY(head, node) offset((node), (head)->dll.offset)
+#define DLL_SKIP_CMP(head, k1, k2) \
+    (head)->dll.compare((k1), (k2), (head)->dll.len)
+
+void std_dll_init_skip(std_dll_skip_head *head, std_compare_function compare, unsigned int offset, unsigned int len) {
+    std_dll_init_sort(&head->dll, compare, offset, len);
+    head->dll.dll_magic = DLL_SKIP_MAGIC;
+    memset(head->skip_next, 0, sizeof(head->skip_next));
+    head->skip_height = 0;
+    head->skip_seed = 0x9e3779b9;
+}
+
+/* each level up is taken with a probability of 1/4 */
+static unsigned char std_dll_skip_height(std_dll_skip_head *head) {
+    unsigned int r = head->skip_seed;
+    unsigned char h = 0;
+
+    r ^= r << 13;
+    r ^= r >> 17;
+    r ^= r << 5;
+    head->skip_seed = r;
+
+    while (h < STD_DLL_SKIP_LEVELS && (r & 3) == 0) {
+        ++h;
+        r >>= 2;
+    }
+    return h;
+}
+
+/*
+ * Drop down the index levels to the last element (head if none) with a key
+ * below 'key' - or not above it when 'after_equal' is set. The next array
+ * of that element on each level is stored in 'update' if not NULL.
+ */
+static std_dll * std_dll_skip_search(std_dll_skip_head *head, const void *key,
+        bool after_equal, std_dll_skip ***update) {
+    std_dll_skip **fwd = head->skip_next;
+    std_dll *walk = &head->dll.head;
+    int lvl;
+
+    for (lvl = head->skip_height - 1; lvl >= 0; --lvl) {
+        while (fwd[lvl] != NULL) {
+            int cmp = DLL_SKIP_CMP(head, DLL_SKIP_KEY(head, fwd[lvl]), key);
+            if (cmp > 0 || (cmp == 0 && !after_equal)) break;
+            walk = &fwd[lvl]->dll;
+            fwd = fwd[lvl]->skip_next;
+        }
+        if (update != NULL) update[lvl] = fwd;
+    }
+
+    /* finish on the list itself, a handful of elements at most */
+    while (walk->dll_next != &head->dll.tail) {
+        int cmp = DLL_SKIP_CMP(head, DLL_SKIP_KEY(head, walk->dll_next), key);
+        if (cmp > 0 || (cmp == 0 && !after_equal)) break;
+        walk = walk->dll_next;
+    }
+    return walk;
+}
+
+static void std_dll_skip_insert(std_dll_skip_head *head, std_dll_skip *new) {
+    std_dll_skip **update[STD_DLL_SKIP_LEVELS];
+    unsigned char h = std_dll_skip_height(head);
+    std_dll *after;
+    int lvl;
+
+    after = std_dll_skip_search(head, DLL_SKIP_KEY(head, new), true, update);
+    for (lvl = head->skip_height; lvl < h; ++lvl) update[lvl] = head->skip_next;
+    if (h > head->skip_height) head->skip_height = h;
+
+    std_dll_insertafter(&head->dll, after, &new->dll);
+
+    new->skip_height = h;
+    for (lvl = 0; lvl < h; ++lvl) {
+        new->skip_next[lvl] = update[lvl][lvl];
+        update[lvl][lvl] = new;
+    }
+}
+
+/* unlinks the element from the index levels, std_dll_remove does the rest */
+static void std_dll_skip_remove(std_dll_skip_head *head, std_dll_skip *item) {
+    std_dll_skip **update[STD_DLL_SKIP_LEVELS];
+    std_dll_skip **fwd;
+    int lvl;
+
+    if (item->skip_height == 0) return;
+
+    std_dll_skip_search(head, DLL_SKIP_KEY(head, item), false, update);
+    for (lvl = 0; lvl < item->skip_height; ++lvl) {
+        /* step over the elements with an equal key inserted before this one */
+        for (fwd = update[lvl]; fwd[lvl] != item; fwd = fwd[lvl]->skip_next)
+            assert(fwd[lvl] != NULL);
+        fwd[lvl] = item->skip_next[lvl];
+    }
+    while (head->skip_height > 0 && head->skip_next[head->skip_height - 1] == NULL)
+        --head->skip_height;
+    item->skip_height = 0;
+}
+
+std_dll * std_dll_find_ge(std_dll_head *head, const void *key) {
+    std_dll *walk;
+    DLL_VALIDATE(head);
+
+    if (DLL_IS_SKIP(head)) {
+        walk = std_dll_skip_search((std_dll_skip_head *)head, key, false, NULL);
+        return std_dll_getnext(head, walk);
+    }
+    for (walk = std_dll_getfirst(head); walk != NULL; walk = std_dll_getnext(head, walk)) {
+        if (head->compare(offset(walk, head->offset), key, head->len) >= 0) break;
+    }
+    return walk;
+}
+
+std_dll * std_dll_find(std_dll_head *head, const void *key) {
+    std_dll *node = std_dll_find_ge(head, key);
+
+    if (node != NULL && head->compare(offset(node, head->offset), key, head->len) != 0)
+        return NULL;
+    return node;
+}
+
 /*----------------------------------------------------------------*\
                     First In First Out
 \*----------------------------------------------------------------*/
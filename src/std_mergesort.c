@@ -29,8 +29,12 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include "std_mergesort.h"
+#include "std_file_utils.h"
+#include <limits.h>
+#include <unistd.h>
 
 /*******************************************************************************
  * NAME          : std_merge_sort_merge_arrays
@@ -219,3 +223,594 @@ void std_merge_sort(void *context, void *array, int num_elements,
     std_merge_sort_divide_n_sort (context,
                       array, 0, num_elements-1, tmp_array, cmp_func, copy_func);
 }
+
+/*******************************************************************************
+ *                         Parallel Merge Sort
+ ******************************************************************************/
+
+/* below this many elements per thread the sort is left to the caller */
+#define STD_MERGE_SORT_PAR_MIN    4096
+
+typedef struct std_merge_sort_par_s {
+    void *context;
+    void *array;
+    void *tmp_array;
+    int num_elements;
+    std_merge_sort_cmp cmp_func;
+    std_merge_sort_copyfn copy_func;
+
+    int num_runs;      /* runs sorted in the first round, a power of 2 */
+    int width;         /* runs per input of the current merge round */
+    int segs;          /* tasks each merge of the round is split into */
+    void *src;         /* current merge round reads src and writes dst */
+    void *dst;
+} std_merge_sort_par_t;
+
+static inline int std_merge_sort_run_start (std_merge_sort_par_t *ps, int run)
+{
+    return (int)(((long long)ps->num_elements * run) / ps->num_runs);
+}
+
+static void std_merge_sort_sort_task (void *param, size_t run)
+{
+    std_merge_sort_par_t *ps = (std_merge_sort_par_t *)param;
+
+    std_merge_sort_divide_n_sort(ps->context, ps->array,
+                                 std_merge_sort_run_start(ps, (int)run),
+                                 std_merge_sort_run_start(ps, (int)run + 1) - 1,
+                                 ps->tmp_array, ps->cmp_func, ps->copy_func);
+}
+
+/*
+ * Number of elements of a[0..na) among the first k elements of the stable
+ * merge of a and b, where on equal keys the elements of a go first.
+ */
+static int std_merge_sort_corank (std_merge_sort_par_t *ps, int k,
+                                  int a, int na, int b, int nb)
+{
+    int lo = (k > nb) ? k - nb : 0;
+    int hi = (k < na) ? k : na;
+    int i, j;
+
+    while (lo < hi)
+    {
+        i = lo + (hi - lo) / 2;
+        j = k - i;
+        /* a[i] is not after b[j-1]: more of a belongs in the first k */
+        if (j > 0 && ps->cmp_func(ps->context, ps->src, a + i, ps->src, b + j - 1) <= 0)
+            lo = i + 1;
+        else
+            hi = i;
+    }
+    return lo;
+}
+
+/* merge a slice of the output of one pair of runs, found by co-ranking */
+static void std_merge_sort_merge_task (void *param, size_t ix)
+{
+    std_merge_sort_par_t *ps = (std_merge_sort_par_t *)param;
+    int pair = (int)ix / ps->segs;
+    int seg = (int)ix % ps->segs;
+    int a = std_merge_sort_run_start(ps, pair * 2 * ps->width);
+    int b = std_merge_sort_run_start(ps, pair * 2 * ps->width + ps->width);
+    int end = std_merge_sort_run_start(ps, (pair + 1) * 2 * ps->width);
+    int na = b - a, nb = end - b, m = na + nb;
+    int k0 = (int)(((long long)m * seg) / ps->segs);
+    int k1 = (int)(((long long)m * (seg + 1)) / ps->segs);
+    int i0 = std_merge_sort_corank(ps, k0, a, na, b, nb);
+    int i1 = std_merge_sort_corank(ps, k1, a, na, b, nb);
+    int left = a + i0, left_end = a + i1;
+    int right = b + (k0 - i0), right_end = b + (k1 - i1);
+    int pos = a + k0;
+
+    while (left < left_end && right < right_end)
+    {
+        if (ps->cmp_func(ps->context, ps->src, left, ps->src, right) <= 0)
+            ps->copy_func(ps->context, ps->dst, pos++, ps->src, left++);
+        else
+            ps->copy_func(ps->context, ps->dst, pos++, ps->src, right++);
+    }
+    while (left < left_end)
+        ps->copy_func(ps->context, ps->dst, pos++, ps->src, left++);
+    while (right < right_end)
+        ps->copy_func(ps->context, ps->dst, pos++, ps->src, right++);
+}
+
+/* copy the result back into 'array' when the last round left it in tmp */
+static void std_merge_sort_copy_task (void *param, size_t ix)
+{
+    std_merge_sort_par_t *ps = (std_merge_sort_par_t *)param;
+    int lo = std_merge_sort_run_start(ps, (int)ix);
+    int hi = std_merge_sort_run_start(ps, (int)ix + 1);
+
+    for ( ; lo < hi; lo++)
+        ps->copy_func(ps->context, ps->array, lo, ps->tmp_array, lo);
+}
+
+void std_merge_sort_parallel (std_thread_pool_handle_t pool, void *context,
+             void *array, int num_elements, void *tmp_array,
+             std_merge_sort_cmp cmp_func, std_merge_sort_copyfn copy_func)
+{
+    std_merge_sort_par_t ps;
+    int num_threads = (pool != NULL) ? (int)std_thread_pool_size(pool) : 0;
+    int pairs;
+    void *swap;
+
+    ps.context = context;
+    ps.array = array;
+    ps.tmp_array = tmp_array;
+    ps.num_elements = num_elements;
+    ps.cmp_func = cmp_func;
+    ps.copy_func = copy_func;
+
+    /* one run per thread including the caller, rounded up to a power of 2 */
+    for (ps.num_runs = 1; ps.num_runs < num_threads + 1; ps.num_runs *= 2)
+        ;
+    while (ps.num_runs > 1 && num_elements / ps.num_runs < STD_MERGE_SORT_PAR_MIN)
+        ps.num_runs /= 2;
+
+    if (ps.num_runs == 1)
+    {
+        std_merge_sort(context, array, num_elements, tmp_array, cmp_func, copy_func);
+        return;
+    }
+
+    std_thread_pool_run_tasks(pool, ps.num_runs, std_merge_sort_sort_task, &ps);
+
+    ps.src = array;
+    ps.dst = tmp_array;
+    for (ps.width = 1; ps.width < ps.num_runs; ps.width *= 2)
+    {
+        /* fewer pairs every round: split each merge to keep all threads busy */
+        pairs = ps.num_runs / (2 * ps.width);
+        ps.segs = (num_threads + 1 + pairs - 1) / pairs;
+        std_thread_pool_run_tasks(pool, pairs * ps.segs, std_merge_sort_merge_task, &ps);
+        swap = ps.src;
+        ps.src = ps.dst;
+        ps.dst = swap;
+    }
+
+    if (ps.src != array)
+        std_thread_pool_run_tasks(pool, ps.num_runs, std_merge_sort_copy_task, &ps);
+}
+
+/*******************************************************************************
+ *                           K-way merge of runs
+ ******************************************************************************/
+
+typedef struct {
+    std_merge_run_t run;
+    int pos;        /* next element in run.buffer */
+    int count;      /* elements in run.buffer */
+} std_kway_merge_input_t;
+
+struct std_kway_merge_s {
+    void *context;
+    std_merge_sort_cmp cmp_func;
+    int num_runs;
+    int advance;    /* the winner was handed out and is to be moved past */
+    int *tree;      /* tree[0] is the winner, tree[1..num_runs-1] the losers */
+    std_kway_merge_input_t *inputs;
+};
+
+static int std_kway_merge_done (std_kway_merge_input_t *in)
+{
+    return in->pos >= in->count;
+}
+
+/* refill an input whose buffer has been handed out */
+static t_std_error std_kway_merge_fill (std_kway_merge_t *merge, std_kway_merge_input_t *in)
+{
+    int n;
+
+    if (in->run.read == NULL)
+        return STD_ERR_OK;
+
+    n = in->run.read(merge->context, in->run.run_arg, in->run.buffer, in->run.num_elements);
+    in->pos = 0;
+    in->count = (n > 0) ? n : 0;
+    return (n < 0) ? STD_ERR(COM,FAIL,0) : STD_ERR_OK;
+}
+
+/* does run a win against run b; ties go to the first run for stability */
+static int std_kway_merge_beats (std_kway_merge_t *merge, int a, int b)
+{
+    std_kway_merge_input_t *ia = &merge->inputs[a], *ib = &merge->inputs[b];
+    int rc;
+
+    if (std_kway_merge_done(ia))
+        return 0;
+    if (std_kway_merge_done(ib))
+        return 1;
+    rc = merge->cmp_func(merge->context, ia->run.buffer, ia->pos, ib->run.buffer, ib->pos);
+    return (rc < 0) || (rc == 0 && a < b);
+}
+
+/*
+ * The tree is laid out as a heap with the runs as the leaves num_runs ..
+ * 2 * num_runs - 1, which is a complete tree for any number of runs.
+ */
+static int std_kway_merge_build (std_kway_merge_t *merge, int node)
+{
+    int left, right;
+
+    if (node >= merge->num_runs)
+        return node - merge->num_runs;
+
+    left = std_kway_merge_build(merge, 2 * node);
+    right = std_kway_merge_build(merge, 2 * node + 1);
+    if (std_kway_merge_beats(merge, left, right))
+    {
+        merge->tree[node] = right;
+        return left;
+    }
+    merge->tree[node] = left;
+    return right;
+}
+
+/* play the winner's next element up against the losers on its path */
+static void std_kway_merge_replay (std_kway_merge_t *merge)
+{
+    int winner = merge->tree[0], node, tmp;
+
+    for (node = (merge->num_runs + winner) / 2; node > 0; node /= 2)
+    {
+        if (std_kway_merge_beats(merge, merge->tree[node], winner))
+        {
+            tmp = merge->tree[node];
+            merge->tree[node] = winner;
+            winner = tmp;
+        }
+    }
+    merge->tree[0] = winner;
+}
+
+t_std_error std_kway_merge_create (std_kway_merge_t **merge, void *context,
+             std_merge_run_t *runs, int num_runs, std_merge_sort_cmp cmp_func)
+{
+    std_kway_merge_t *m;
+    t_std_error rc;
+    int ix;
+
+    if (num_runs < 1)
+        return STD_ERR(COM,PARAM,0);
+
+    m = (std_kway_merge_t *)calloc(1, sizeof(*m));
+    if (m == NULL)
+        return STD_ERR(COM,NOMEM,0);
+    m->tree = (int *)calloc(num_runs, sizeof(*m->tree));
+    m->inputs = (std_kway_merge_input_t *)calloc(num_runs, sizeof(*m->inputs));
+    if (m->tree == NULL || m->inputs == NULL)
+    {
+        std_kway_merge_destroy(m);
+        return STD_ERR(COM,NOMEM,0);
+    }
+    m->context = context;
+    m->cmp_func = cmp_func;
+    m->num_runs = num_runs;
+
+    for (ix = 0; ix < num_runs; ix++)
+    {
+        m->inputs[ix].run = runs[ix];
+        m->inputs[ix].count = runs[ix].num_elements;
+        if ((rc = std_kway_merge_fill(m, &m->inputs[ix])) != STD_ERR_OK)
+        {
+            std_kway_merge_destroy(m);
+            return rc;
+        }
+    }
+    m->tree[0] = std_kway_merge_build(m, 1);
+
+    *merge = m;
+    return STD_ERR_OK;
+}
+
+t_std_error std_kway_merge_next (std_kway_merge_t *merge, void **array, int *index)
+{
+    std_kway_merge_input_t *in;
+    t_std_error rc;
+
+    if (merge->advance)
+    {
+        in = &merge->inputs[merge->tree[0]];
+        merge->advance = 0;
+        if (++in->pos == in->count && (rc = std_kway_merge_fill(merge, in)) != STD_ERR_OK)
+            return rc;
+        std_kway_merge_replay(merge);
+    }
+
+    in = &merge->inputs[merge->tree[0]];
+    if (std_kway_merge_done(in))
+        return STD_ERR(COM,NEXIST,0);
+
+    *array = in->run.buffer;
+    *index = in->pos;
+    merge->advance = 1;
+    return STD_ERR_OK;
+}
+
+void std_kway_merge_destroy (std_kway_merge_t *merge)
+{
+    free(merge->tree);
+    free(merge->inputs);
+    free(merge);
+}
+
+/*******************************************************************************
+ *                              External sort
+ ******************************************************************************/
+
+/* smallest buffer for a run while merging; sets how many runs merge at once */
+#define STD_EXTERNAL_SORT_MIN_BUF   256
+/* largest single read or write of a run file */
+#define STD_EXTERNAL_SORT_MAX_IO    (1 << 30)
+
+typedef struct {
+    int fd;
+    size_t remaining;   /* elements not read back yet */
+    size_t elem_size;
+} std_external_sort_run_t;
+
+typedef struct {
+    void *context;
+    size_t elem_size;
+    const char *tmp_dir;
+    std_merge_sort_cmp cmp_func;
+    std_merge_sort_copyfn copy_func;
+    std_external_sort_run_t *runs;
+    int num_runs;
+    int max_runs;
+} std_external_sort_t;
+
+static t_std_error std_external_sort_io (int fd, char *buf, size_t len, int is_write)
+{
+    t_std_error rc = STD_ERR_OK;
+    int chunk, n;
+
+    while (len > 0)
+    {
+        chunk = (len > STD_EXTERNAL_SORT_MAX_IO) ? STD_EXTERNAL_SORT_MAX_IO : (int)len;
+        n = is_write ? std_write(fd, buf, chunk, true, &rc) : std_read(fd, buf, chunk, true, &rc);
+        if (n != chunk)
+        {
+            if (rc == STD_ERR_OK)
+                rc = STD_ERR(COM,FAIL,0);
+            return rc;
+        }
+        buf += chunk;
+        len -= chunk;
+    }
+    return STD_ERR_OK;
+}
+
+/* a new unlinked file for a run; it goes away when closed */
+static t_std_error std_external_sort_new_run (std_external_sort_t *es,
+                                              std_external_sort_run_t **run)
+{
+    std_external_sort_run_t *runs;
+    char path[PATH_MAX];
+    int fd;
+
+    if (es->num_runs == es->max_runs)
+    {
+        es->max_runs = es->max_runs ? 2 * es->max_runs : 16;
+        runs = (std_external_sort_run_t *)realloc(es->runs, es->max_runs * sizeof(*runs));
+        if (runs == NULL)
+            return STD_ERR(COM,NOMEM,0);
+        es->runs = runs;
+    }
+
+    snprintf(path, sizeof(path), "%s/std_sort_XXXXXX", es->tmp_dir);
+    fd = mkstemp(path);
+    if (fd < 0)
+        return STD_ERR_FROM_ERRNO(e_std_err_COM, e_std_err_code_FAIL);
+    unlink(path);
+
+    *run = &es->runs[es->num_runs++];
+    (*run)->fd = fd;
+    (*run)->remaining = 0;
+    (*run)->elem_size = es->elem_size;
+    return STD_ERR_OK;
+}
+
+static int std_external_sort_read (void *context, void *run_arg, void *buffer, int max)
+{
+    std_external_sort_run_t *run = (std_external_sort_run_t *)run_arg;
+    size_t n = (run->remaining < (size_t)max) ? run->remaining : (size_t)max;
+
+    (void)context;
+    if (n > 0 && std_external_sort_io(run->fd, (char *)buffer, n * run->elem_size, 0) != STD_ERR_OK)
+        return -1;
+    run->remaining -= n;
+    return (int)n;
+}
+
+/* fill the array as far as the input goes */
+static int std_external_sort_fill (void *context, std_external_sort_input input,
+                                   char *array, size_t elem_size, int max)
+{
+    int count = 0, n;
+
+    while (count < max)
+    {
+        n = input(context, array + count * elem_size, max - count);
+        if (n < 0)
+            return -1;
+        if (n == 0)
+            break;
+        count += n;
+    }
+    return count;
+}
+
+/*
+ * Merge num_runs runs starting at first with the memory split evenly between
+ * their buffers, plus one for the output if it goes to a new run file.
+ */
+static t_std_error std_external_sort_merge (std_external_sort_t *es, int first, int num_runs,
+                                            char *mem, int mem_elements,
+                                            std_external_sort_output output)
+{
+    std_merge_run_t *runs;
+    std_kway_merge_t *merge = NULL;
+    std_external_sort_run_t *out = NULL;
+    char *out_buf;
+    int buf_elements, out_count = 0, ix, index;
+    void *array;
+    t_std_error rc;
+
+    /* before pointing at the runs, as a new run may move them */
+    if (output == NULL && (rc = std_external_sort_new_run(es, &out)) != STD_ERR_OK)
+        return rc;
+
+    buf_elements = mem_elements / (num_runs + (output == NULL ? 1 : 0));
+    if (buf_elements == 0)
+        return STD_ERR(COM,PARAM,0);
+    runs = (std_merge_run_t *)calloc(num_runs, sizeof(*runs));
+    if (runs == NULL)
+        return STD_ERR(COM,NOMEM,0);
+    for (ix = 0; ix < num_runs; ix++)
+    {
+        std_external_sort_run_t *run = &es->runs[first + ix];
+        lseek(run->fd, 0, SEEK_SET);
+        runs[ix].buffer = mem + (size_t)ix * buf_elements * es->elem_size;
+        runs[ix].num_elements = buf_elements;
+        runs[ix].read = std_external_sort_read;
+        runs[ix].run_arg = run;
+    }
+    out_buf = mem + (size_t)num_runs * buf_elements * es->elem_size;
+
+    rc = std_kway_merge_create(&merge, es->context, runs, num_runs, es->cmp_func);
+    free(runs);
+    if (rc != STD_ERR_OK)
+        return rc;
+
+    while ((rc = std_kway_merge_next(merge, &array, &index)) == STD_ERR_OK)
+    {
+        if (output != NULL)
+        {
+            if ((rc = output(es->context, array, index)) != STD_ERR_OK)
+                break;
+            continue;
+        }
+        es->copy_func(es->context, out_buf, out_count++, array, index);
+        if (out_count == buf_elements)
+        {
+            if ((rc = std_external_sort_io(out->fd, out_buf,
+                                           out_count * es->elem_size, 1)) != STD_ERR_OK)
+                break;
+            out->remaining += out_count;
+            out_count = 0;
+        }
+    }
+    std_kway_merge_destroy(merge);
+    if (rc != (t_std_error)STD_ERR(COM,NEXIST,0))
+        return rc;
+
+    if (out_count > 0)
+    {
+        if ((rc = std_external_sort_io(out->fd, out_buf, out_count * es->elem_size, 1)) != STD_ERR_OK)
+            return rc;
+        out->remaining += out_count;
+    }
+    return STD_ERR_OK;
+}
+
+t_std_error std_external_sort (void *context, size_t elem_size, int mem_elements,
+             const char *tmp_dir, std_external_sort_input input,
+             std_external_sort_output output, std_merge_sort_cmp cmp_func,
+             std_merge_sort_copyfn copy_func)
+{
+    std_external_sort_t es;
+    std_external_sort_run_t *run;
+    int chunk, count, fan_in, first, last, ix;
+    char *mem, *tmp;
+    t_std_error rc = STD_ERR_OK;
+
+    if (elem_size == 0 || mem_elements < 3)
+        return STD_ERR(COM,PARAM,0);
+
+    memset(&es, 0, sizeof(es));
+    es.context = context;
+    es.elem_size = elem_size;
+    es.tmp_dir = (tmp_dir != NULL) ? tmp_dir : "/tmp";
+    es.cmp_func = cmp_func;
+    es.copy_func = copy_func;
+
+    mem = (char *)malloc((size_t)mem_elements * elem_size);
+    if (mem == NULL)
+        return STD_ERR(COM,NOMEM,0);
+    chunk = mem_elements / 2;
+    tmp = mem + (size_t)chunk * elem_size;
+
+    /* sorted runs of a chunk each */
+    for (;;)
+    {
+        count = std_external_sort_fill(context, input, mem, elem_size, chunk);
+        if (count < 0)
+        {
+            rc = STD_ERR(COM,FAIL,0);
+            goto done;
+        }
+        if (count == 0)
+            break;
+        std_merge_sort(context, mem, count, tmp, cmp_func, copy_func);
+
+        if (count < chunk && es.num_runs == 0)
+        {
+            /* all of it fits in memory */
+            for (ix = 0; ix < count && rc == STD_ERR_OK; ix++)
+                rc = output(context, mem, ix);
+            goto done;
+        }
+        if ((rc = std_external_sort_new_run(&es, &run)) != STD_ERR_OK ||
+            (rc = std_external_sort_io(run->fd, mem, (size_t)count * elem_size, 1)) != STD_ERR_OK)
+            goto done;
+        run->remaining = count;
+        if (count < chunk)
+            break;
+    }
+    if (es.num_runs == 0)
+        goto done;
+
+    /*
+     * Until they can all be merged at once, merge the runs in groups into
+     * a new level of runs. The groups are taken in input order so that the
+     * run order still breaks the ties as the input did. A merge into a new
+     * run needs a buffer for each run and one for the output, so there can
+     * be at most mem_elements - 1 runs in a group.
+     */
+    fan_in = mem_elements / STD_EXTERNAL_SORT_MIN_BUF;
+    if (fan_in < 2)
+        fan_in = 2;
+    if (fan_in > mem_elements - 1)
+        fan_in = mem_elements - 1;
+    first = 0;
+    while (es.num_runs - first > fan_in)
+    {
+        last = es.num_runs;
+        for (ix = first; ix < last; ix += count)
+        {
+            count = (last - ix < fan_in) ? last - ix : fan_in;
+            if ((rc = std_external_sort_merge(&es, ix, count, mem, mem_elements,
+                                              NULL)) != STD_ERR_OK)
+                goto done;
+        }
+        for ( ; first < last; first++)
+        {
+            close(es.runs[first].fd);
+            es.runs[first].fd = -1;
+        }
+    }
+    rc = std_external_sort_merge(&es, first, es.num_runs - first, mem, mem_elements, output);
+
+done:
+    for (ix = 0; ix < es.num_runs; ix++)
+    {
+        if (es.runs[ix].fd >= 0)
+            close(es.runs[ix].fd);
+    }
+    free(es.runs);
+    free(mem);
+    return rc;
+}
@@ -0,0 +1,167 @@
+/*
+ * Copyright (c) 2016 Dell Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * THIS CODE IS PROVIDED ON AN *AS IS* BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT
+ * LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS
+ * FOR A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+ *
+ * See the Apache Version 2.0 License for specific language governing
+ * permissions and limitations under the License.
+ */
+
+/*
+ * filename: std_mpsc_queue.c
+ */
+
+/*!
+ * \file   std_mpsc_queue.c
+ * \brief  Lock-free multi producer, single consumer intrusive queue
+ */
+
+#include "std_mpsc_queue.h"
+#include "std_select_tools.h"
+
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <sched.h>
+#include <errno.h>
+
+/*
+ * The queue is the one of D. Vyukov: elements are chained from the oldest
+ * (stub.mpsc_next) to the newest (mpsc_head). A producer swaps itself in
+ * as the head and only then links the previous head to itself, so between
+ * the two steps the chain is briefly cut; the consumer waits out that
+ * window where it has to.
+ *
+ * The stub is always first in the chain. The consumer takes all the
+ * elements at once by swapping the head back to the stub, and hands them
+ * out of mpsc_cache for std_mpsc_queue_pop.
+ */
+
+t_std_error std_mpsc_queue_init(std_mpsc_queue_t *q, bool wakeup) {
+    q->mpsc_stub.mpsc_next = NULL;
+    q->mpsc_head = &q->mpsc_stub;
+    q->mpsc_cache = NULL;
+    q->mpsc_fd = -1;
+
+    if (wakeup) {
+        q->mpsc_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (q->mpsc_fd < 0) return STD_ERR_FROM_ERRNO(e_std_err_COM, e_std_err_code_FAIL);
+    }
+    return STD_ERR_OK;
+}
+
+void std_mpsc_queue_destroy(std_mpsc_queue_t *q) {
+    if (q->mpsc_fd >= 0) close(q->mpsc_fd);
+    q->mpsc_fd = -1;
+}
+
+void std_mpsc_queue_push(std_mpsc_queue_t *q, std_mpsc_node_t *node) {
+    std_mpsc_node_t *prev;
+
+    __atomic_store_n(&node->mpsc_next, NULL, __ATOMIC_RELAXED);
+    prev = __atomic_exchange_n(&q->mpsc_head, node, __ATOMIC_ACQ_REL);
+    __atomic_store_n(&prev->mpsc_next, node, __ATOMIC_RELEASE);
+
+    /*
+     * Only the first push after the consumer emptied the queue finds the
+     * stub as the head, so there is one wakeup per batch at most.
+     */
+    if (prev == &q->mpsc_stub && q->mpsc_fd >= 0) {
+        eventfd_write(q->mpsc_fd, 1);
+    }
+}
+
+/* wait for a producer in the middle of a push to link the next element */
+static std_mpsc_node_t * std_mpsc_queue_next(std_mpsc_node_t *node) {
+    std_mpsc_node_t *next;
+
+    while ((next = __atomic_load_n(&node->mpsc_next, __ATOMIC_ACQUIRE)) == NULL) {
+        sched_yield();
+    }
+    return next;
+}
+
+/* take everything pushed so far off the queue as a NULL terminated chain */
+static std_mpsc_node_t * std_mpsc_queue_grab(std_mpsc_queue_t *q) {
+    std_mpsc_node_t *first, *last, *node;
+
+    first = __atomic_load_n(&q->mpsc_stub.mpsc_next, __ATOMIC_ACQUIRE);
+    if (first == NULL) return NULL;
+
+    /*
+     * The head is past the stub, so no producer writes stub.mpsc_next
+     * until the head is the stub again.
+     */
+    q->mpsc_stub.mpsc_next = NULL;
+    last = __atomic_exchange_n(&q->mpsc_head, &q->mpsc_stub, __ATOMIC_ACQ_REL);
+
+    for (node = first; node != last; node = std_mpsc_queue_next(node))
+        ;
+    return first;
+}
+
+std_mpsc_node_t * std_mpsc_queue_pop(std_mpsc_queue_t *q) {
+    std_mpsc_node_t *node = q->mpsc_cache;
+
+    if (node == NULL && (node = std_mpsc_queue_grab(q)) == NULL) return NULL;
+    q->mpsc_cache = node->mpsc_next;
+    node->mpsc_next = NULL;
+    return node;
+}
+
+std_mpsc_node_t * std_mpsc_queue_pop_all(std_mpsc_queue_t *q) {
+    std_mpsc_node_t *first = q->mpsc_cache, *node;
+
+    q->mpsc_cache = NULL;
+    if (first == NULL) return std_mpsc_queue_grab(q);
+
+    for (node = first; node->mpsc_next != NULL; node = node->mpsc_next)
+        ;
+    node->mpsc_next = std_mpsc_queue_grab(q);
+    return first;
+}
+
+int std_mpsc_queue_get_fd(std_mpsc_queue_t *q) {
+    return q->mpsc_fd;
+}
+
+void std_mpsc_queue_wakeup_clear(std_mpsc_queue_t *q) {
+    eventfd_t val;
+
+    if (q->mpsc_fd >= 0) eventfd_read(q->mpsc_fd, &val);
+}
+
+t_std_error std_mpsc_queue_wait(std_mpsc_queue_t *q, int timeout_ms) {
+    struct timeval tv, *ptv = NULL;
+    t_std_error rc;
+    fd_set set;
+    ssize_t n;
+
+    if (q->mpsc_fd < 0) return STD_ERR(COM,PARAM,0);
+
+    /* something may be left from before the last wakeup was cleared */
+    if (q->mpsc_cache != NULL ||
+        __atomic_load_n(&q->mpsc_stub.mpsc_next, __ATOMIC_ACQUIRE) != NULL) {
+        std_mpsc_queue_wakeup_clear(q);
+        return STD_ERR_OK;
+    }
+
+    if (timeout_ms >= 0) {
+        tv.tv_sec = timeout_ms / 1000;
+        tv.tv_usec = (timeout_ms % 1000) * 1000;
+        ptv = &tv;
+    }
+    std_sel_adds_set(&q->mpsc_fd, 1, &set, NULL, true);
+    n = std_select_ignore_intr(q->mpsc_fd + 1, &set, NULL, NULL, ptv, &rc);
+    if (n < 0) return rc;
+    if (n == 0) return STD_ERR(COM,FAIL,ETIMEDOUT);
+
+    std_mpsc_queue_wakeup_clear(q);
+    return STD_ERR_OK;
+}
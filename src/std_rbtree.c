@@ -32,7 +32,10 @@
 #include "stdlib.h"
 #include "string.h"
 #include "assert.h"
+#include "limits.h"
+#include "sched.h"
 #include "std_rbtree.h"
+#include "std_mutex_lock.h"
 
 
 /*---------------------------------------------------------------*\
@@ -55,6 +58,24 @@
 #define TRUE            1
 #define FALSE           0
 
+#define RBT_IS_INTERVAL(rbtt) ((rbtt)->rbtt_endoffset >= 0)
+#define RBT_INODE(x)    ((std_rbtree_inode *)(x))
+#define RBT_START(rbtt, d)    std_rbtree_ival((rbtt), (d), (rbtt)->rbtt_keyoffset)
+#define RBT_END(rbtt, d)    std_rbtree_ival((rbtt), (d), (rbtt)->rbtt_endoffset)
+
+/// Max slots of threads reading concurrent trees; others fall back to the tree mutex.
+#define RBT_RCU_MAX_READERS    256
+/// Number of removed nodes a writer collects before trying to free them.
+#define RBT_RCU_RECLAIM_BATCH    64
+/// Lockless descents a lookup tries before it falls back to the tree mutex.
+#define RBT_RCU_RETRIES    16
+/// A descent longer than this can only be the result of a concurrent update.
+#define RBT_RCU_MAX_DEPTH    128
+
+/// Links followed by lockless lookups are loaded and stored with these.
+#define RBT_RCU_LOAD(p)    __atomic_load_n(&(p), __ATOMIC_ACQUIRE)
+#define RBT_RCU_STORE(p, v)    __atomic_store_n(&(p), (v), __ATOMIC_RELEASE)
+
 #define RBT_IS_LESS(rbtt, d1, d2) ((rbtt)->rbtt_compare((rbtt), (d1), (d2)) < 0)
 #define RBT_IS_EQUAL(rbtt, d1, d2) ((rbtt)->rbtt_compare((rbtt), (d1), (d2)) == 0)
 
@@ -86,12 +107,530 @@ static void std_rbtree_free(void *ptr)
     return;
 }
 
+/**
+ *  Memory released while readers may still be walking over it. Parked
+ *  on the tree until every reader that entered before the release has
+ *  left its read side section.
+ */
+typedef struct _std_rbtree_retired
+{
+    struct _std_rbtree_retired *next;
+    void *ptr;
+    void (* ptr_free)(void *);  /* NULL: free with the tree's free routine */
+    u_long epoch;
+    int owned;                  /* record itself was allocated with RBT_MALLOC */
+} std_rbtree_retired;
+
+/**
+ *  Per tree state of a concurrent tree. Writers hold 'lock' for the
+ *  whole update and make 'seq' odd only while they change links; a
+ *  lookup that may have been misled by a change is retried.
+ */
+typedef struct _std_rbtree_rcu
+{
+    std_mutex_type_t lock;
+    u_long seq;
+    int depth;
+    std_rbtree_retired *retired;
+    u_long numretired;
+} std_rbtree_rcu;
+
+/**
+ *  Per thread reader slot. 'epoch' is the global epoch seen on entry to
+ *  the outermost read side section, 0 outside of one. Only the owning
+ *  thread writes to its slot, so each slot has a cache line of its own.
+ */
+typedef struct _std_rbtree_reader
+{
+    u_long epoch;
+    u_long inuse;
+    u_long nest;
+} __attribute__((aligned(64))) std_rbtree_reader;
+
+static std_rbtree_reader rbt_rcu_readers[RBT_RCU_MAX_READERS];
+static u_long rbt_rcu_numreaders = 0;
+static u_long rbt_rcu_epoch = 1;
+static pthread_once_t rbt_rcu_once = PTHREAD_ONCE_INIT;
+static pthread_key_t rbt_rcu_key;
+
+static __thread std_rbtree_reader *rbt_rcu_self = (std_rbtree_reader *)0;
+static __thread int rbt_rcu_claimed = FALSE;
+
+#define RBT_RCU(rbtt)    ((std_rbtree_rcu *)(rbtt)->rbtt_rcu)
+#define RBT_NODE_RETIRED(rbtt, x) \
+            ((std_rbtree_retired *)(((char *)(x)) + (rbtt)->rbtt_nodesize - \
+                                    sizeof(std_rbtree_retired)))
+
+
+static void std_rbtree_rcu_thread_exit(void *arg)
+{
+    std_rbtree_reader *r = (std_rbtree_reader *)arg;
+
+    __atomic_store_n(&r->epoch, 0, __ATOMIC_RELEASE);
+    r->nest = 0;
+    __atomic_store_n(&r->inuse, 0, __ATOMIC_RELEASE);
+} // std_rbtree_rcu_thread_exit()
+
+
+static void std_rbtree_rcu_key_init(void)
+{
+    pthread_key_create(&rbt_rcu_key, std_rbtree_rcu_thread_exit);
+} // std_rbtree_rcu_key_init()
+
+
+/**
+ *  Get the reader slot of the calling thread, claiming a free one on the
+ *  first call. The slot is given back when the thread exits. Returns
+ *  NULL when all the slots are taken.
+ */
+static std_rbtree_reader * std_rbtree_rcu_self(void)
+{
+    u_long ix, n, zero;
+
+    if (rbt_rcu_self || rbt_rcu_claimed)
+        return rbt_rcu_self;
+    rbt_rcu_claimed = TRUE;
+
+    pthread_once(&rbt_rcu_once, std_rbtree_rcu_key_init);
+    for (ix = 0; ix < RBT_RCU_MAX_READERS; ix++)
+    {
+        zero = 0;
+        if (__atomic_compare_exchange_n(&rbt_rcu_readers[ix].inuse, &zero, 1, FALSE,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+            break;
+    }
+    if (ix == RBT_RCU_MAX_READERS)
+        return (std_rbtree_reader *)0;
+
+    n = __atomic_load_n(&rbt_rcu_numreaders, __ATOMIC_RELAXED);
+    while (n < ix + 1 &&
+           !__atomic_compare_exchange_n(&rbt_rcu_numreaders, &n, ix + 1, FALSE,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+        ;
+
+    rbt_rcu_self = &rbt_rcu_readers[ix];
+    rbt_rcu_self->nest = 0;
+    pthread_setspecific(rbt_rcu_key, rbt_rcu_self);
+    return rbt_rcu_self;
+} // std_rbtree_rcu_self()
+
+
+/**
+ *  Lowest epoch any reader is in, ULONG_MAX if no reader is active.
+ *  Memory retired in an epoch lower than that can no longer be seen.
+ */
+static u_long std_rbtree_rcu_min_epoch(void)
+{
+    u_long ix, n, e, min = ULONG_MAX;
+
+    n = __atomic_load_n(&rbt_rcu_numreaders, __ATOMIC_ACQUIRE);
+    for (ix = 0; ix < n; ix++)
+    {
+        e = __atomic_load_n(&rbt_rcu_readers[ix].epoch, __ATOMIC_SEQ_CST);
+        if (e && e < min)
+            min = e;
+    }
+    return min;
+} // std_rbtree_rcu_min_epoch()
+
+
+static void std_rbtree_rcu_release(std_rbtree_table *rbtt, std_rbtree_retired *r)
+{
+    /* a record that is not owned lives in the memory being released */
+    int owned = r->owned;
+
+    if (r->ptr_free)
+        r->ptr_free(r->ptr);
+    else
+        rbtt->rbtt_free(r->ptr);
+    if (owned)
+        RBT_FREE(r);
+} // std_rbtree_rcu_release()
+
+
+/**
+ *  Release everything on 'list' retired before 'min'. Returns what is
+ *  left. The record may live inside the memory it describes so it is
+ *  unlinked before the memory is released.
+ */
+static std_rbtree_retired * std_rbtree_rcu_release_list(std_rbtree_table *rbtt,
+                                                        std_rbtree_retired *list,
+                                                        u_long min, u_long *nreleased)
+{
+    std_rbtree_retired *r, *next, *keep = (std_rbtree_retired *)0;
+
+    for (r = list; r; r = next)
+    {
+        next = r->next;
+        if (r->epoch < min)
+        {
+            std_rbtree_rcu_release(rbtt, r);
+            (*nreleased)++;
+        }
+        else
+        {
+            r->next = keep;
+            keep = r;
+        }
+    }
+    return keep;
+} // std_rbtree_rcu_release_list()
+
+
+/**
+ *  Start a new epoch and release what no reader can see any more.
+ *  Called by the writer; never waits for readers.
+ */
+static void std_rbtree_rcu_reclaim(std_rbtree_table *rbtt)
+{
+    std_rbtree_rcu *rcu = RBT_RCU(rbtt);
+    u_long nreleased = 0;
+
+    __atomic_fetch_add(&rbt_rcu_epoch, 1, __ATOMIC_SEQ_CST);
+    rcu->retired = std_rbtree_rcu_release_list(rbtt, rcu->retired,
+                                               std_rbtree_rcu_min_epoch(), &nreleased);
+    rcu->numretired -= nreleased;
+} // std_rbtree_rcu_reclaim()
+
+
+static void std_rbtree_rcu_retire(std_rbtree_table *rbtt, std_rbtree_retired *r)
+{
+    std_rbtree_rcu *rcu = RBT_RCU(rbtt);
+
+    r->epoch = __atomic_load_n(&rbt_rcu_epoch, __ATOMIC_RELAXED);
+    r->next = rcu->retired;
+    rcu->retired = r;
+    rcu->numretired++;
+} // std_rbtree_rcu_retire()
+
+
+/**
+ *  Release memory of a RBT node or node block. On a concurrent tree it is
+ *  parked on 'r' until the readers are done with it.
+ */
+static void std_rbtree_release_mem(std_rbtree_table *rbtt, void *ptr, std_rbtree_retired *r)
+{
+    if (!rbtt->rbtt_rcu)
+    {
+        rbtt->rbtt_free(ptr);
+        return;
+    }
+    r->ptr = ptr;
+    r->ptr_free = NULL;
+    r->owned = FALSE;
+    std_rbtree_rcu_retire(rbtt, r);
+} // std_rbtree_release_mem()
+
+
+/**
+ *  Writers are serialized on the tree mutex. The mutex is recursive so
+ *  that callbacks issued while updating may update the tree as well;
+ *  only the outermost section reclaims.
+ */
+static void std_rbtree_write_begin(std_rbtree_table *rbtt)
+{
+    std_rbtree_rcu *rcu = RBT_RCU(rbtt);
+
+    if (!rcu)
+        return;
+    std_mutex_lock(&rcu->lock);
+    rcu->depth++;
+} // std_rbtree_write_begin()
+
+
+static void std_rbtree_write_end(std_rbtree_table *rbtt)
+{
+    std_rbtree_rcu *rcu = RBT_RCU(rbtt);
+
+    if (!rcu)
+        return;
+    if (--rcu->depth == 0 && rcu->numretired >= RBT_RCU_RECLAIM_BATCH)
+        std_rbtree_rcu_reclaim(rbtt);
+    std_mutex_unlock(&rcu->lock);
+} // std_rbtree_write_end()
+
+
+/**
+ *  Bracket the link changes of one insert or remove, inside a write
+ *  section. User callbacks and memory management stay outside so that
+ *  'seq' is odd for as short a time as possible.
+ */
+static void std_rbtree_links_begin(std_rbtree_table *rbtt)
+{
+    std_rbtree_rcu *rcu = RBT_RCU(rbtt);
+
+    if (!rcu)
+        return;
+    __atomic_store_n(&rcu->seq, rcu->seq + 1, __ATOMIC_RELAXED);
+    /* odd before any of the link stores that follow */
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+} // std_rbtree_links_begin()
+
+
+static void std_rbtree_links_end(std_rbtree_table *rbtt)
+{
+    std_rbtree_rcu *rcu = RBT_RCU(rbtt);
+
+    if (rcu)
+        __atomic_store_n(&rcu->seq, rcu->seq + 1, __ATOMIC_RELEASE);
+} // std_rbtree_links_end()
+
+
+/// Walks do not change the tree; they only keep writers out.
+static void std_rbtree_walk_begin(std_rbtree_table *rbtt)
+{
+    if (rbtt->rbtt_rcu)
+        std_mutex_lock(&RBT_RCU(rbtt)->lock);
+} // std_rbtree_walk_begin()
+
+
+static void std_rbtree_walk_end(std_rbtree_table *rbtt)
+{
+    if (rbtt->rbtt_rcu)
+        std_mutex_unlock(&RBT_RCU(rbtt)->lock);
+} // std_rbtree_walk_end()
+
+
+enum { RBT_RCU_FIRST, RBT_RCU_EXACT, RBT_RCU_EXACTORNEXT, RBT_RCU_EXACTORPREV, RBT_RCU_NEXT };
+
+/**
+ *  One descent for std_rbtree_rcu_lookup. Only the child links are
+ *  followed: the descent remembers the last node left of which it
+ *  turned (the successor) and the last right of which it turned (the
+ *  predecessor), so the parent links, which are the least consistent
+ *  during a rotation, are never needed. '*equal' tells whether the node
+ *  found holds a key equal to 'data'. Returns NIL when the descent ran
+ *  too deep, which only a concurrent update can cause.
+ */
+static std_rbtree_node * std_rbtree_rcu_descend(std_rbtree_table *rbtt, void *data, int op,
+                                                int *equal)
+{
+    std_rbtree_node *x, *next, *prev;
+    int cmp, depth;
+
+    *equal = FALSE;
+    next = prev = (std_rbtree_node *)0;
+    x = RBT_RCU_LOAD(rbtt->rbtt_root);
+    for (depth = 0; x != NIL(rbtt); depth++)
+    {
+        if (depth == RBT_RCU_MAX_DEPTH)
+            return NIL(rbtt);
+        cmp = (op == RBT_RCU_FIRST) ? -1 :
+              rbtt->rbtt_compare(rbtt, data, RBT_RCU_LOAD(x->rbt_data));
+        if (cmp == 0 && op != RBT_RCU_NEXT)
+        {
+            *equal = TRUE;
+            return x;
+        }
+        if (cmp < 0)
+        {
+            next = x;
+            x = RBT_RCU_LOAD(x->rbt_left);
+        }
+        else
+        {
+            prev = x;
+            x = RBT_RCU_LOAD(x->rbt_right);
+        }
+    }
+    if (op == RBT_RCU_EXACTORPREV)
+        return prev;
+    return (op == RBT_RCU_EXACT) ? (std_rbtree_node *)0 : next;
+} // std_rbtree_rcu_descend()
+
+
+/**
+ *  Lockless lookup on a concurrent tree. Nodes the descent reaches are
+ *  never freed under it, so a node with an equal key was on the tree at
+ *  some point of the lookup and is returned as it is. Any other answer
+ *  may be wrong if a writer changed links meanwhile: it stands only if
+ *  'seq' was even and did not move, otherwise the descent is repeated.
+ *  Readers never wait for a writer to get out of the way; only after
+ *  RBT_RCU_RETRIES descents that all overlapped link changes does a
+ *  lookup take the tree mutex instead.
+ */
+static void * std_rbtree_rcu_lookup(std_rbtree_table *rbtt, void *data, int op)
+{
+    std_rbtree_rcu *rcu = RBT_RCU(rbtt);
+    std_rbtree_node *found;
+    void *rbt_data = (void *)0;
+    u_long seq, tries;
+    int equal;
+
+    std_rbtree_read_lock(rbtt);
+    for (tries = 0; tries < RBT_RCU_RETRIES; tries++)
+    {
+        seq = __atomic_load_n(&rcu->seq, __ATOMIC_ACQUIRE);
+        found = std_rbtree_rcu_descend(rbtt, data, op, &equal);
+        if (found == NIL(rbtt))
+            continue;
+        rbt_data = found ? RBT_RCU_LOAD(found->rbt_data) : (void *)0;
+        if (equal)
+            break;
+
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (!(seq & 1) && __atomic_load_n(&rcu->seq, __ATOMIC_RELAXED) == seq)
+            break;
+    }
+
+    if (tries == RBT_RCU_RETRIES)
+    {
+        /* the mutex is recursive, so this works inside an update callback */
+        std_mutex_lock(&rcu->lock);
+        found = std_rbtree_rcu_descend(rbtt, data, op, &equal);
+        rbt_data = found ? found->rbt_data : (void *)0;
+        std_mutex_unlock(&rcu->lock);
+    }
+    std_rbtree_read_unlock(rbtt);
+    return rbt_data;
+} // std_rbtree_rcu_lookup()
+
+
+/**
+ *  Header of a block of RBT nodes allocated by std_rbtree_build_sorted.
+ *  The nodes follow the header in the same allocation. The block is
+ *  released when the last of its nodes has been removed from the tree.
+ */
+typedef struct _std_rbtree_bulk
+{
+    struct _std_rbtree_bulk *next;
+    u_long count;
+    u_long inuse;
+    std_rbtree_retired rcu;
+} std_rbtree_bulk;
+
+#define RBT_BULK_NODE(rbtt, b, i) \
+            ((std_rbtree_node *)(((char *)((b) + 1)) + (i) * (rbtt)->rbtt_nodesize))
+
+
+static std_rbtree_bulk * std_rbtree_bulk_find(std_rbtree_table *rbtt, std_rbtree_node *x)
+{
+    std_rbtree_bulk *b;
+
+    for (b = (std_rbtree_bulk *)rbtt->rbtt_bulk; b; b = b->next)
+    {
+        if (x >= RBT_BULK_NODE(rbtt, b, 0) && x < RBT_BULK_NODE(rbtt, b, b->count))
+            return b;
+    }
+    return (std_rbtree_bulk *)0;
+} // std_rbtree_bulk_find()
+
+
+static void std_rbtree_bulk_unlink(std_rbtree_table *rbtt, std_rbtree_bulk *b)
+{
+    std_rbtree_bulk **pp;
+
+    for (pp = (std_rbtree_bulk **)&rbtt->rbtt_bulk; *pp; pp = &(*pp)->next)
+    {
+        if (*pp == b)
+        {
+            *pp = b->next;
+            break;
+        }
+    }
+    std_rbtree_release_mem(rbtt, b, &b->rcu);
+    rbtt->rbtt_numfrees++;
+} // std_rbtree_bulk_unlink()
+
+
+/**
+ *  Release a RBT node that was allocated by RBT, either individually by
+ *  std_rbtree_insert or as part of a std_rbtree_build_sorted block.
+ */
+static void std_rbtree_node_release(std_rbtree_table *rbtt, std_rbtree_node *x)
+{
+    std_rbtree_bulk *b;
+
+    if (!(x->rbt_flags & RBT_NODE_F_BULK))
+    {
+        std_rbtree_release_mem(rbtt, x,
+                               rbtt->rbtt_rcu ? RBT_NODE_RETIRED(rbtt, x) : NULL);
+        rbtt->rbtt_numfrees++;
+        return;
+    }
+
+    b = std_rbtree_bulk_find(rbtt, x);
+    RBT_ASSERT(b);
+    if (b && --b->inuse == 0)
+        std_rbtree_bulk_unlink(rbtt, b);
+} // std_rbtree_node_release()
+
+
+/**
+ *  Read an interval end point (or start) of the tree's key width
+ *  from a user node.
+ */
+static inline uint64_t std_rbtree_ival(std_rbtree_table *rbtt, void *data, int offset)
+{
+    char *p = ((char *)data) + offset;
+
+    switch (rbtt->rbtt_keylength)
+    {
+    case 1:
+        return *(uint8_t *)p;
+    case 2:
+        return *(uint16_t *)p;
+    case 4:
+        return *(uint32_t *)p;
+    default:
+        return *(uint64_t *)p;
+    }
+} // std_rbtree_ival()
+
+
+static int std_rbtree_interval_cmp(rbtree_handle rbtt, void *one, void *two)
+{
+    uint64_t v1, v2;
+
+    RBT_ASSERT(one);
+    RBT_ASSERT(two);
+
+    v1 = RBT_START(rbtt, one);
+    v2 = RBT_START(rbtt, two);
+    if (v1 == v2)
+    {
+        v1 = RBT_END(rbtt, one);
+        v2 = RBT_END(rbtt, two);
+    }
+
+    if (v1 == v2)
+        return 0;
+    else
+        return (v1 < v2) ? -1 : 1;
+} // std_rbtree_interval_cmp()
+
+
+/**
+ *  Recompute the highest end point of the subtree rooted at x from
+ *  its own interval and the cached values of its children.
+ */
+static void std_rbtree_interval_update(std_rbtree_table *rbtt, std_rbtree_node *x)
+{
+    uint64_t maxend;
+
+    maxend = RBT_END(rbtt, x->rbt_data);
+    if (x->rbt_left != NIL(rbtt) && RBT_INODE(x->rbt_left)->rbi_maxend > maxend)
+        maxend = RBT_INODE(x->rbt_left)->rbi_maxend;
+    if (x->rbt_right != NIL(rbtt) && RBT_INODE(x->rbt_right)->rbi_maxend > maxend)
+        maxend = RBT_INODE(x->rbt_right)->rbi_maxend;
+    RBT_INODE(x)->rbi_maxend = maxend;
+} // std_rbtree_interval_update()
+
+
+/// Recompute the highest end point from x up to the root.
+static void std_rbtree_interval_fixup(std_rbtree_table *rbtt, std_rbtree_node *x)
+{
+    for ( ; x != NIL(rbtt); x = x->rbt_parent)
+        std_rbtree_interval_update(rbtt, x);
+} // std_rbtree_interval_fixup()
+
+
 static void std_rbtree_rotateleft(std_rbtree_table *rbtt, std_rbtree_node *x)
 {
     std_rbtree_node *y;
 
     y = x->rbt_right;
-    x->rbt_right = y->rbt_left;
+    RBT_RCU_STORE(x->rbt_right, y->rbt_left);
     if (y->rbt_left != NIL(rbtt))
         y->rbt_left->rbt_parent = x;
 
@@ -99,18 +638,25 @@ static void std_rbtree_rotateleft(std_rbtree_table *rbtt, std_rbtree_node *x)
     if (x->rbt_parent != NIL(rbtt))
     {
         if (x == x->rbt_parent->rbt_left)
-            x->rbt_parent->rbt_left = y;
+            RBT_RCU_STORE(x->rbt_parent->rbt_left, y);
         else
-            x->rbt_parent->rbt_right = y;
+            RBT_RCU_STORE(x->rbt_parent->rbt_right, y);
     }
     else
     {
-        rbtt->rbtt_root = y;
+        RBT_RCU_STORE(rbtt->rbtt_root, y);
     }
 
-    y->rbt_left = x;
+    RBT_RCU_STORE(y->rbt_left, x);
     x->rbt_parent = y;
 
+    /* x is now below y; both subtrees changed */
+    if (RBT_IS_INTERVAL(rbtt))
+    {
+        std_rbtree_interval_update(rbtt, x);
+        std_rbtree_interval_update(rbtt, y);
+    }
+
 } // std_rbtree_rotateleft()
 
 
@@ -119,7 +665,7 @@ static void std_rbtree_rotateright(std_rbtree_table *rbtt, std_rbtree_node *x)
     std_rbtree_node *y;
 
     y = x->rbt_left;
-    x->rbt_left = y->rbt_right;
+    RBT_RCU_STORE(x->rbt_left, y->rbt_right);
     if (y->rbt_right != NIL(rbtt))
         y->rbt_right->rbt_parent = x;
 
@@ -127,18 +673,24 @@ static void std_rbtree_rotateright(std_rbtree_table *rbtt, std_rbtree_node *x)
     if (x->rbt_parent != NIL(rbtt))
     {
         if (x == x->rbt_parent->rbt_right)
-            x->rbt_parent->rbt_right = y;
+            RBT_RCU_STORE(x->rbt_parent->rbt_right, y);
         else
-            x->rbt_parent->rbt_left = y;
+            RBT_RCU_STORE(x->rbt_parent->rbt_left, y);
     }
     else
     {
-        rbtt->rbtt_root = y;
+        RBT_RCU_STORE(rbtt->rbtt_root, y);
     }
 
-    y->rbt_right = x;
+    RBT_RCU_STORE(y->rbt_right, x);
     x->rbt_parent = y;
 
+    if (RBT_IS_INTERVAL(rbtt))
+    {
+        std_rbtree_interval_update(rbtt, x);
+        std_rbtree_interval_update(rbtt, y);
+    }
+
 } // std_rbtree_rotateright()
 
 
@@ -318,7 +870,9 @@ void std_rbtree_rwalk(rbtree_handle rbtt,
     RBT_ASSERT(rbtt->rbtt_magic == RBT_MAGIC);
 
     va_start(ap, ncount);
+    std_rbtree_walk_begin(rbtt);
     _std_rbtree_rwalk(rbtt, rbtt->rbtt_root, walk_callback, ap);
+    std_rbtree_walk_end(rbtt);
     va_end(ap);
 } // std_rbtree_RWalk()
 
@@ -355,6 +909,9 @@ void * std_rbtree_getfirst(rbtree_handle rbtt)
     RBT_DEBUG_START(rbtt);
     RBT_DEBUG_END;
 
+    if (rbtt->rbtt_rcu)
+        return std_rbtree_rcu_lookup(rbtt, (void *)0, RBT_RCU_FIRST);
+
     x = _std_rbtree_getfirst(rbtt);
 
     if (x)
@@ -402,6 +959,9 @@ void * std_rbtree_getexact(rbtree_handle rbtt, void *data)
     RBT_ASSERT(data);
     RBT_DEBUG_END;
 
+    if (rbtt->rbtt_rcu)
+        return std_rbtree_rcu_lookup(rbtt, data, RBT_RCU_EXACT);
+
     x = _std_rbtree_getexact(rbtt, data);
 
     if (x)
@@ -435,11 +995,14 @@ std_rbtree_node * _std_rbtree_insert(rbtree_handle rbtt, std_rbtree_node *z)
     z->rbt_left = z->rbt_right = NIL(rbtt);
 
     if (y == NIL(rbtt))
-        rbtt->rbtt_root = z;
+        RBT_RCU_STORE(rbtt->rbtt_root, z);
     else if (RBT_IS_LESS(rbtt, z->rbt_data, y->rbt_data))
-        y->rbt_left = z;
+        RBT_RCU_STORE(y->rbt_left, z);
     else
-        y->rbt_right = z;
+        RBT_RCU_STORE(y->rbt_right, z);
+
+    if (RBT_IS_INTERVAL(rbtt))
+        std_rbtree_interval_fixup(rbtt, z);
 
     std_rbtree_balanceoninsert(rbtt, z);
 
@@ -451,23 +1014,31 @@ std_rbtree_node * _std_rbtree_insert(rbtree_handle rbtt, std_rbtree_node *z)
 
 t_std_error std_rbtree_insert(rbtree_handle rbtt, void *data)
 {
-    std_rbtree_node *z;
+    std_rbtree_node *z, *x;
 
     RBT_DEBUG_START(rbtt);
     RBT_ASSERT(data);
     RBT_DEBUG_END;
 
-    if ((z = (std_rbtree_node *)rbtt->rbtt_malloc(sizeof(std_rbtree_node))) == (std_rbtree_node *)0)
+    if ((z = (std_rbtree_node *)rbtt->rbtt_malloc(rbtt->rbtt_nodesize)) == (std_rbtree_node *)0)
         return (STD_ERR_FROM_ERRNO(e_std_err_COM, e_std_err_code_FAIL));
-    rbtt->rbtt_nummallocs++;
     z->rbt_data = data;
+    z->rbt_flags = 0;
+
+    std_rbtree_write_begin(rbtt);
+    rbtt->rbtt_nummallocs++;
+    std_rbtree_links_begin(rbtt);
+    x = _std_rbtree_insert(rbtt, z);
+    std_rbtree_links_end(rbtt);
+    if (!x)
+        rbtt->rbtt_numfrees++;
+    std_rbtree_write_end(rbtt);
 
-    if (_std_rbtree_insert(rbtt, z))
+    if (x)
         return STD_ERR_OK;
     else
     {
         rbtt->rbtt_free(z);
-        rbtt->rbtt_numfrees++;
         return (STD_ERR_FROM_ERRNO(e_std_err_COM, e_std_err_code_FAIL));
     }
 
@@ -517,6 +1088,9 @@ void * std_rbtree_getnext(rbtree_handle rbtt, void *data)
     if (!data)
         return (void *)0;
 
+    if (rbtt->rbtt_rcu)
+        return std_rbtree_rcu_lookup(rbtt, data, RBT_RCU_NEXT);
+
     if ((x = _std_rbtree_getexact(rbtt, data)))
         y = _std_rbtree_getnext(rbtt, x);
     else
@@ -558,35 +1132,39 @@ void _std_rbtree_remove(rbtree_handle rbtt,  std_rbtree_node *z)
     x->rbt_parent = y->rbt_parent;
     if (y->rbt_parent == NIL(rbtt))
     {
-        rbtt->rbtt_root = x;
+        RBT_RCU_STORE(rbtt->rbtt_root, x);
     }
     else
     {
         if (y == y->rbt_parent->rbt_left)
-            y->rbt_parent->rbt_left = x;
+            RBT_RCU_STORE(y->rbt_parent->rbt_left, x);
         else
-            y->rbt_parent->rbt_right = x;
+            RBT_RCU_STORE(y->rbt_parent->rbt_right, x);
     }
 
+    /* z is still on the tree here; it is accounted for below */
+    if (RBT_IS_INTERVAL(rbtt))
+        std_rbtree_interval_fixup(rbtt, y->rbt_parent);
+
     if (y->rbt_color == RBT_BLACK)
         std_rbtree_balanceonremove(rbtt, x);
 
     if (y != z)
     {
         if (rbtt->rbtt_root == z)
-            rbtt->rbtt_root = y;
+            RBT_RCU_STORE(rbtt->rbtt_root, y);
 
         y->rbt_parent = z->rbt_parent;
-        y->rbt_left = z->rbt_left;
-        y->rbt_right = z->rbt_right;
+        RBT_RCU_STORE(y->rbt_left, z->rbt_left);
+        RBT_RCU_STORE(y->rbt_right, z->rbt_right);
         y->rbt_color = z->rbt_color;
 
         if (y->rbt_parent != NIL(rbtt))
         {
             if (y->rbt_parent->rbt_left == z)
-                y->rbt_parent->rbt_left = y;
+                RBT_RCU_STORE(y->rbt_parent->rbt_left, y);
             else
-                y->rbt_parent->rbt_right = y;
+                RBT_RCU_STORE(y->rbt_parent->rbt_right, y);
         }
 
         if (y->rbt_left != NIL(rbtt))
@@ -594,15 +1172,71 @@ void _std_rbtree_remove(rbtree_handle rbtt,  std_rbtree_node *z)
 
         if (y->rbt_right != NIL(rbtt))
             y->rbt_right->rbt_parent = y;
+
+        if (RBT_IS_INTERVAL(rbtt))
+            std_rbtree_interval_fixup(rbtt, y);
     }
 
-    z->rbt_left = z->rbt_right = z->rbt_parent = NIL(rbtt);
+    RBT_RCU_STORE(z->rbt_left, NIL(rbtt));
+    RBT_RCU_STORE(z->rbt_right, NIL(rbtt));
+    z->rbt_parent = NIL(rbtt);
 
     rbtt->rbtt_numremoved++;
     rbtt->rbtt_numinodes--;
 } // _std_rbtree_remove()
 
 
+static std_rbtree_node * std_rbtree_getprev_node(rbtree_handle rbtt, std_rbtree_node *x)
+{
+    std_rbtree_node *y;
+
+    if (x->rbt_left != NIL(rbtt))
+    {
+        y = x->rbt_left;
+        while (y->rbt_right != NIL(rbtt))
+            y = y->rbt_right;
+    }
+    else
+    {
+        y = x->rbt_parent;
+        while (y != NIL(rbtt) && x == y->rbt_left) {
+            x = y;
+            y = x->rbt_parent;
+        }
+    }
+
+    if (y == NIL(rbtt))
+      return (std_rbtree_node *)0;
+    else
+      return y;
+} // std_rbtree_getprev_node()
+
+
+/**
+ *  Find the RBT node holding exactly this user node. Identical
+ *  intervals may be on the tree more than once; they are adjacent
+ *  in order so scan them for the matching user node.
+ */
+static std_rbtree_node * std_rbtree_node_of(rbtree_handle rbtt, void *data)
+{
+    std_rbtree_node *x, *y;
+
+    if ((x = _std_rbtree_getexact(rbtt, data)) == (std_rbtree_node *)0)
+        return (std_rbtree_node *)0;
+
+    while ((y = std_rbtree_getprev_node(rbtt, x)) && RBT_IS_EQUAL(rbtt, data, y->rbt_data))
+        x = y;
+
+    while (x && x->rbt_data != data)
+    {
+        x = _std_rbtree_getnext(rbtt, x);
+        if (x && !RBT_IS_EQUAL(rbtt, data, x->rbt_data))
+            return (std_rbtree_node *)0;
+    }
+    return x;
+} // std_rbtree_node_of()
+
+
 void * std_rbtree_remove(rbtree_handle rbtt,  void *data)
 {
     void *rbt_data;
@@ -612,17 +1246,262 @@ void * std_rbtree_remove(rbtree_handle rbtt,  void *data)
     RBT_ASSERT(data);
     RBT_DEBUG_END;
 
-    if ((x = _std_rbtree_getexact(rbtt, data)) == (std_rbtree_node *)0)
+    std_rbtree_write_begin(rbtt);
+    /*
+     * An interval tree can hold the same interval more than once; remove
+     * the caller's own node, or the first equal one if given only a key.
+     */
+    x = RBT_IS_INTERVAL(rbtt) ? std_rbtree_node_of(rbtt, data) : (std_rbtree_node *)0;
+    if (!x && (x = _std_rbtree_getexact(rbtt, data)) == (std_rbtree_node *)0)
+    {
+        std_rbtree_write_end(rbtt);
         return (void *)0;
+    }
 
+    std_rbtree_links_begin(rbtt);
     _std_rbtree_remove(rbtt, x);
+    std_rbtree_links_end(rbtt);
 
     rbt_data = x->rbt_data;
-    rbtt->rbtt_free(x);
-    rbtt->rbtt_numfrees++;
+    std_rbtree_node_release(rbtt, x);
+    std_rbtree_write_end(rbtt);
     return rbt_data;
 } // std_rbtree_remove()
 
+
+/**
+ *  Link nodes[lo..hi] into a subtree rooted at the middle element.
+ *  Splitting on the midpoint keeps the sizes of the two subtrees of
+ *  every node within one of each other, so all levels above
+ *  'red_depth' are complete and the only partial level is 'red_depth'.
+ *  Coloring that level red and every other level black satisfies the
+ *  RBT invariants without any rotation.
+ */
+static std_rbtree_node * std_rbtree_build_subtree(std_rbtree_table *rbtt,
+                                                  std_rbtree_bulk *b, void **data,
+                                                  long lo, long hi, int depth, int red_depth,
+                                                  std_rbtree_node *parent)
+{
+    long mid;
+    std_rbtree_node *x;
+
+    if (lo > hi)
+        return NIL(rbtt);
+
+    mid = lo + (hi - lo) / 2;
+    x = RBT_BULK_NODE(rbtt, b, mid);
+    x->rbt_data = data[mid];
+    x->rbt_flags = RBT_NODE_F_BULK;
+    x->rbt_parent = parent;
+    x->rbt_color = (depth == red_depth) ? RBT_RED : RBT_BLACK;
+    x->rbt_left = std_rbtree_build_subtree(rbtt, b, data, lo, mid - 1,
+                                           depth + 1, red_depth, x);
+    x->rbt_right = std_rbtree_build_subtree(rbtt, b, data, mid + 1, hi,
+                                            depth + 1, red_depth, x);
+    if (RBT_IS_INTERVAL(rbtt))
+        std_rbtree_interval_update(rbtt, x);
+    return x;
+} // std_rbtree_build_subtree()
+
+
+static t_std_error std_rbtree_build(rbtree_handle rbtt, void **data, size_t count)
+{
+    size_t ix;
+    int red_depth;
+    std_rbtree_bulk *b;
+    std_rbtree_node *x;
+
+    if (!count)
+        return STD_ERR_OK;
+
+    for (ix = 1; ix < count; ix++)
+    {
+        if (RBT_IS_LESS(rbtt, data[ix], data[ix - 1]))
+            return STD_ERR(COM, PARAM, 0);
+    }
+
+    if (rbtt->rbtt_root != NIL(rbtt))
+    {
+        for (ix = 0; ix < count; ix++)
+        {
+            if (std_rbtree_insert(rbtt, data[ix]) != STD_ERR_OK)
+            {
+                while (ix--)
+                    std_rbtree_remove(rbtt, data[ix]);
+                return (STD_ERR_FROM_ERRNO(e_std_err_COM, e_std_err_code_FAIL));
+            }
+        }
+        return STD_ERR_OK;
+    }
+
+    if ((b = (std_rbtree_bulk *)rbtt->rbtt_malloc(sizeof(std_rbtree_bulk) +
+                                                  count * rbtt->rbtt_nodesize))
+        == (std_rbtree_bulk *)0)
+        return (STD_ERR_FROM_ERRNO(e_std_err_COM, e_std_err_code_FAIL));
+    rbtt->rbtt_nummallocs++;
+
+    b->count = count;
+    b->inuse = count;
+    b->next = (std_rbtree_bulk *)rbtt->rbtt_bulk;
+    rbtt->rbtt_bulk = b;
+
+    /* levels 0 .. red_depth-1 are complete: red_depth = floor(log2(count+1)) */
+    for (red_depth = 0; ((size_t)2 << red_depth) - 1 <= count; red_depth++)
+        ;
+
+    /* the tree is empty, so lookups see either nothing or all of it */
+    x = std_rbtree_build_subtree(rbtt, b, data, 0, (long)count - 1, 0, red_depth, NIL(rbtt));
+    x->rbt_color = RBT_BLACK;
+    RBT_RCU_STORE(rbtt->rbtt_root, x);
+
+    rbtt->rbtt_numinserts += count;
+    rbtt->rbtt_numinodes += count;
+    return STD_ERR_OK;
+} // std_rbtree_build()
+
+
+t_std_error std_rbtree_build_sorted(rbtree_handle rbtt, void **data, size_t count)
+{
+    t_std_error rc;
+
+    RBT_DEBUG_START(rbtt);
+    RBT_ASSERT(data || !count);
+    RBT_DEBUG_END;
+
+    std_rbtree_write_begin(rbtt);
+    rc = std_rbtree_build(rbtt, data, count);
+    std_rbtree_write_end(rbtt);
+    return rc;
+} // std_rbtree_build_sorted()
+
+
+/**
+ *  Free every node of the tree without rebalancing. Post-order walk
+ *  along the parent links so no stack is needed.
+ */
+static u_long std_rbtree_flush(rbtree_handle rbtt,
+                               int (* walk_fn)(rbtree_handle rbtt, void *, va_list ap),
+                               va_list ap)
+{
+    u_long lcnt = 0;
+    std_rbtree_node *x, *y;
+    void *rbt_data;
+    va_list ap1;
+    int stop = FALSE;
+
+    /* once the root is gone lookups can only see nodes on their way out */
+    x = rbtt->rbtt_root;
+    std_rbtree_links_begin(rbtt);
+    RBT_RCU_STORE(rbtt->rbtt_root, NIL(rbtt));
+    std_rbtree_links_end(rbtt);
+
+    while (x != NIL(rbtt))
+    {
+        if (x->rbt_left != NIL(rbtt))
+        {
+            x = x->rbt_left;
+            continue;
+        }
+        if (x->rbt_right != NIL(rbtt))
+        {
+            x = x->rbt_right;
+            continue;
+        }
+
+        /* x is a leaf: detach it from its parent and release it */
+        y = x->rbt_parent;
+        if (y != NIL(rbtt))
+        {
+            if (y->rbt_left == x)
+                RBT_RCU_STORE(y->rbt_left, NIL(rbtt));
+            else
+                RBT_RCU_STORE(y->rbt_right, NIL(rbtt));
+        }
+
+        rbt_data = x->rbt_data;
+        RBT_RCU_STORE(x->rbt_left, NIL(rbtt));
+        RBT_RCU_STORE(x->rbt_right, NIL(rbtt));
+        x->rbt_parent = NIL(rbtt);
+        std_rbtree_node_release(rbtt, x);
+        rbtt->rbtt_numremoved++;
+        rbtt->rbtt_numinodes--;
+        lcnt++;
+
+        /* once the user asked to stop, keep releasing nodes silently */
+        if (walk_fn && !stop)
+        {
+            va_copy(ap1, ap);
+            if (walk_fn(rbtt, rbt_data, ap1))
+                stop = TRUE;
+            va_end(ap1);
+        }
+        x = y;
+    }
+
+    return lcnt;
+} // std_rbtree_flush()
+
+
+u_long std_rbtree_remove_range(rbtree_handle rbtt, void *lo, void *hi,
+                               int (* removecb)(rbtree_handle rbtt, void *, va_list ap), ...)
+{
+    va_list ap, ap1;
+    u_long lcnt = 0;
+    std_rbtree_node *x, *next;
+    void *rbt_data;
+
+    RBT_DEBUG_START(rbtt);
+    RBT_DEBUG_END;
+
+    va_start(ap, removecb);
+    std_rbtree_write_begin(rbtt);
+
+    if (!lo && !hi)
+    {
+        lcnt = std_rbtree_flush(rbtt, removecb, ap);
+        std_rbtree_write_end(rbtt);
+        va_end(ap);
+        return lcnt;
+    }
+
+    if (lo)
+        x = _std_rbtree_getexactornext(rbtt, lo);
+    else
+        x = _std_rbtree_getfirst(rbtt);
+
+    while (x)
+    {
+        if (hi && RBT_IS_LESS(rbtt, hi, x->rbt_data))
+            break;
+
+        /*
+         * _std_rbtree_remove relinks the successor node in place of x
+         * rather than copying user data, so 'next' stays valid.
+         */
+        next = _std_rbtree_getnext(rbtt, x);
+        std_rbtree_links_begin(rbtt);
+        _std_rbtree_remove(rbtt, x);
+        std_rbtree_links_end(rbtt);
+
+        rbt_data = x->rbt_data;
+        std_rbtree_node_release(rbtt, x);
+        lcnt++;
+
+        if (removecb)
+        {
+            va_copy(ap1, ap);
+            if (removecb(rbtt, rbt_data, ap1))
+                next = (std_rbtree_node *)0;
+            va_end(ap1);
+        }
+        x = next;
+    }
+
+    std_rbtree_write_end(rbtt);
+    va_end(ap);
+    return lcnt;
+} // std_rbtree_remove_range()
+
 /** Macro for callback. This macro calls the user callback
  *  with a certain set of parameters. It passes on the
  *  variale parameters to the callback. Note that we need
@@ -762,10 +1641,12 @@ void * std_rbtree_walk(rbtree_handle rbtt, void *data,
 {
     va_list ap;
     std_rbtree_node *x, *y;
+    void *rbt_data;
 
     RBT_DEBUG_START(rbtt);
     RBT_DEBUG_END;
 
+    std_rbtree_walk_begin(rbtt);
     if (data)
         x = _std_rbtree_getexactornext(rbtt, data);
     else
@@ -775,10 +1656,9 @@ void * std_rbtree_walk(rbtree_handle rbtt, void *data,
     y = _std_rbtree_walk(rbtt, x, walk_fn, cnt, flag, ap);
     va_end(ap);
 
-    if (!y || y == NIL(rbtt))
-        return (void *) 0;
-    else
-        return y->rbt_data;
+    rbt_data = (!y || y == NIL(rbtt)) ? (void *)0 : y->rbt_data;
+    std_rbtree_walk_end(rbtt);
+    return rbt_data;
 
 } // std_rbtree_Walk()
 
@@ -841,6 +1721,9 @@ void * std_rbtree_getexactornext(rbtree_handle rbtt, void *data)
     RBT_ASSERT(data);
     RBT_DEBUG_END;
 
+    if (rbtt->rbtt_rcu)
+        return std_rbtree_rcu_lookup(rbtt, data, RBT_RCU_EXACTORNEXT);
+
     if ((x = _std_rbtree_getexactornext(rbtt, data)))
         return x->rbt_data;
     else
@@ -903,6 +1786,9 @@ void * std_rbtree_getexactorprev(rbtree_handle rbtt, void *data)
     RBT_ASSERT(data);
     RBT_DEBUG_END;
 
+    if (rbtt->rbtt_rcu)
+        return std_rbtree_rcu_lookup(rbtt, data, RBT_RCU_EXACTORPREV);
+
     if ((x = _std_rbtree_getexactorprev(rbtt, data)))
         return x->rbt_data;
     else
@@ -910,6 +1796,160 @@ void * std_rbtree_getexactorprev(rbtree_handle rbtt, void *data)
 } // std_rbtree_getexactorprev()
 
 
+/**
+ *  Find the lowest node in the subtree rooted at x overlapping [lo, hi].
+ *  A subtree whose highest end point is below lo can not overlap, and
+ *  once a start above hi is seen nothing to its right can either.
+ */
+static std_rbtree_node * std_rbtree_overlap_min(rbtree_handle rbtt, std_rbtree_node *x,
+                                                uint64_t lo, uint64_t hi)
+{
+    std_rbtree_node *y;
+
+    while (x != NIL(rbtt) && RBT_INODE(x)->rbi_maxend >= lo)
+    {
+        if ((y = std_rbtree_overlap_min(rbtt, x->rbt_left, lo, hi)))
+            return y;
+        if (RBT_START(rbtt, x->rbt_data) > hi)
+            break;
+        if (RBT_END(rbtt, x->rbt_data) >= lo)
+            return x;
+        x = x->rbt_right;
+    }
+    return (std_rbtree_node *)0;
+} // std_rbtree_overlap_min()
+
+
+std_rbtree_node * _std_rbtree_overlap_first(rbtree_handle rbtt, uint64_t lo, uint64_t hi)
+{
+    RBT_DEBUG_START(rbtt);
+    RBT_ASSERT(RBT_IS_INTERVAL(rbtt));
+    RBT_DEBUG_END;
+
+    if (!RBT_IS_INTERVAL(rbtt))
+        return (std_rbtree_node *)0;
+
+    return std_rbtree_overlap_min(rbtt, rbtt->rbtt_root, lo, hi);
+} // _std_rbtree_overlap_first()
+
+
+std_rbtree_node * _std_rbtree_overlap_next(rbtree_handle rbtt, std_rbtree_node *x,
+                                           uint64_t lo, uint64_t hi)
+{
+    std_rbtree_node *y, *z;
+
+    RBT_DEBUG_START(rbtt);
+    RBT_ASSERT(RBT_IS_INTERVAL(rbtt));
+    RBT_ASSERT(x);
+    RBT_DEBUG_END;
+
+    if (!RBT_IS_INTERVAL(rbtt) || !x)
+        return (std_rbtree_node *)0;
+
+    if ((z = std_rbtree_overlap_min(rbtt, x->rbt_right, lo, hi)))
+        return z;
+
+    /* climb; every parent reached from its left side comes next in order */
+    for (y = x->rbt_parent; y != NIL(rbtt); x = y, y = y->rbt_parent)
+    {
+        if (x != y->rbt_left)
+            continue;
+        if (RBT_START(rbtt, y->rbt_data) > hi)
+            break;
+        if (RBT_END(rbtt, y->rbt_data) >= lo)
+            return y;
+        if ((z = std_rbtree_overlap_min(rbtt, y->rbt_right, lo, hi)))
+            return z;
+    }
+    return (std_rbtree_node *)0;
+} // _std_rbtree_overlap_next()
+
+
+void * std_rbtree_overlap_first(rbtree_handle rbtt, uint64_t lo, uint64_t hi)
+{
+    std_rbtree_node *x;
+
+    if ((x = _std_rbtree_overlap_first(rbtt, lo, hi)))
+        return x->rbt_data;
+    else
+        return (void *)0;
+} // std_rbtree_overlap_first()
+
+
+void * std_rbtree_overlap_next(rbtree_handle rbtt, void *data, uint64_t lo, uint64_t hi)
+{
+    std_rbtree_node *x;
+
+    RBT_DEBUG_START(rbtt);
+    RBT_ASSERT(RBT_IS_INTERVAL(rbtt));
+    RBT_ASSERT(data);
+    RBT_DEBUG_END;
+
+    if (!RBT_IS_INTERVAL(rbtt) || !data)
+        return (void *)0;
+
+    /* only the user node is known here; its RBT node has to be found first */
+    if ((x = std_rbtree_node_of(rbtt, data)) == (std_rbtree_node *)0)
+        return (void *)0;
+
+    if ((x = _std_rbtree_overlap_next(rbtt, x, lo, hi)))
+        return x->rbt_data;
+    else
+        return (void *)0;
+} // std_rbtree_overlap_next()
+
+
+static int std_rbtree_stab_walk(rbtree_handle rbtt, std_rbtree_node *x, uint64_t point,
+                                int (* walk_fn)(rbtree_handle rbtt, void *, va_list ap),
+                                va_list ap, u_long *lcnt)
+{
+    va_list ap1;
+    int stop;
+
+    while (x != NIL(rbtt) && RBT_INODE(x)->rbi_maxend >= point)
+    {
+        if (std_rbtree_stab_walk(rbtt, x->rbt_left, point, walk_fn, ap, lcnt))
+            return TRUE;
+        if (RBT_START(rbtt, x->rbt_data) > point)
+            break;
+        if (RBT_END(rbtt, x->rbt_data) >= point)
+        {
+            (*lcnt)++;
+            if (walk_fn)
+            {
+                va_copy(ap1, ap);
+                stop = walk_fn(rbtt, x->rbt_data, ap1);
+                va_end(ap1);
+                if (stop)
+                    return TRUE;
+            }
+        }
+        x = x->rbt_right;
+    }
+    return FALSE;
+} // std_rbtree_stab_walk()
+
+
+u_long std_rbtree_stab(rbtree_handle rbtt, uint64_t point,
+                       int (* walkcb)(rbtree_handle rbtt, void *, va_list ap), ...)
+{
+    va_list ap;
+    u_long lcnt = 0;
+
+    RBT_DEBUG_START(rbtt);
+    RBT_ASSERT(RBT_IS_INTERVAL(rbtt));
+    RBT_DEBUG_END;
+
+    if (!RBT_IS_INTERVAL(rbtt))
+        return 0;
+
+    va_start(ap, walkcb);
+    std_rbtree_stab_walk(rbtt, rbtt->rbtt_root, point, walkcb, ap, &lcnt);
+    va_end(ap);
+    return lcnt;
+} // std_rbtree_stab()
+
+
 void std_rbtree_Debug(rbtree_handle rbtt, int rb_bool)
 {
     RBT_DEBUG_START(rbtt);
@@ -938,6 +1978,8 @@ rbtree_handle std_rbtree_create(char *rbtt_name, int keyoffset, int keylength,
     strncpy(rbtt->rbtt_name,rbtt_name,RBT_NAME_MAX_LEN);
     rbtt->rbtt_name[RBT_NAME_MAX_LEN] = '\0';
     rbtt->rbtt_keyoffset = keyoffset;
+    rbtt->rbtt_endoffset = -1;
+    rbtt->rbtt_nodesize = sizeof(std_rbtree_node);
     rbtt->rbtt_root = NIL(rbtt);
     rbtt->rbtt_debug = TRUE;
     rbtt->rbtt_compare = rbtt_compare;
@@ -962,6 +2004,8 @@ rbtree_handle std_rbtree_create(char *rbtt_name, int keyoffset, int keylength,
     rbtt->rbtt_numremoved = 0;
     rbtt->rbtt_nummallocs = 0;
     rbtt->rbtt_numfrees = 0;
+    rbtt->rbtt_bulk = (void *)0;
+    rbtt->rbtt_rcu = (void *)0;
 
     RBT_DEBUG_START(rbtt);
     RBT_ASSERT(rbtt_name);
@@ -972,13 +2016,180 @@ rbtree_handle std_rbtree_create(char *rbtt_name, int keyoffset, int keylength,
 } // std_rbtree_create()
 
 
+rbtree_handle std_rbtree_create_interval(char *rbtt_name, int startoffset,
+                                         int endoffset, int keylength)
+{
+    std_rbtree_table *rbtt;
+
+    if (keylength != 1 && keylength != 2 && keylength != 4 && keylength != 8)
+        return (rbtree_handle)0;
+
+    if ((rbtt = std_rbtree_create(rbtt_name, startoffset, keylength, NULL, NULL,
+                                  std_rbtree_interval_cmp)) == (rbtree_handle)0)
+        return (rbtree_handle)0;
+
+    rbtt->rbtt_endoffset = endoffset;
+    rbtt->rbtt_nodesize = sizeof(std_rbtree_inode);
+    return rbtt;
+} // std_rbtree_create_interval()
+
+
+rbtree_handle std_rbtree_create_concurrent(char *rbtt_name, int keyoffset, int keylength,
+                                           void *rbtt_malloc(size_t), void rbtt_free(void *),
+                                           int rbtt_compare(rbtree_handle rbtt, void *, void *))
+{
+    std_rbtree_table *rbtt;
+    std_rbtree_rcu *rcu;
+
+    if ((rcu = (std_rbtree_rcu *) RBT_MALLOC(sizeof(std_rbtree_rcu))) == (std_rbtree_rcu *)0)
+        return (rbtree_handle)0;
+    memset(rcu, 0, sizeof(*rcu));
+    if (std_mutex_lock_init_recursive(&rcu->lock) != STD_ERR_OK)
+    {
+        RBT_FREE(rcu);
+        return (rbtree_handle)0;
+    }
+
+    if ((rbtt = std_rbtree_create(rbtt_name, keyoffset, keylength, rbtt_malloc, rbtt_free,
+                                  rbtt_compare)) == (rbtree_handle)0)
+    {
+        std_mutex_destroy(&rcu->lock);
+        RBT_FREE(rcu);
+        return (rbtree_handle)0;
+    }
+
+    /* removed nodes carry the record that parks them until readers are done */
+    rbtt->rbtt_nodesize += sizeof(std_rbtree_retired);
+    rbtt->rbtt_rcu = rcu;
+    return rbtt;
+} // std_rbtree_create_concurrent()
+
+
+void std_rbtree_read_lock(rbtree_handle rbtt)
+{
+    std_rbtree_reader *r;
+
+    if (!rbtt->rbtt_rcu)
+        return;
+
+    if ((r = std_rbtree_rcu_self()) == (std_rbtree_reader *)0)
+    {
+        std_mutex_lock(&RBT_RCU(rbtt)->lock);
+        return;
+    }
+
+    if (r->nest++ == 0)
+    {
+        __atomic_store_n(&r->epoch, __atomic_load_n(&rbt_rcu_epoch, __ATOMIC_ACQUIRE),
+                         __ATOMIC_RELAXED);
+        /* the slot must be visible before any link of the tree is read */
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    }
+} // std_rbtree_read_lock()
+
+
+void std_rbtree_read_unlock(rbtree_handle rbtt)
+{
+    std_rbtree_reader *r = rbt_rcu_self;
+
+    if (!rbtt->rbtt_rcu)
+        return;
+
+    if (r == (std_rbtree_reader *)0)
+    {
+        std_mutex_unlock(&RBT_RCU(rbtt)->lock);
+        return;
+    }
+
+    if (--r->nest == 0)
+        __atomic_store_n(&r->epoch, 0, __ATOMIC_RELEASE);
+} // std_rbtree_read_unlock()
+
+
+void std_rbtree_synchronize(rbtree_handle rbtt)
+{
+    std_rbtree_rcu *rcu = RBT_RCU(rbtt);
+    std_rbtree_retired *list;
+    u_long epoch, nreleased = 0;
+
+    RBT_DEBUG_START(rbtt);
+    RBT_DEBUG_END;
+
+    if (!rcu)
+        return;
+
+    std_mutex_lock(&rcu->lock);
+    list = rcu->retired;
+    rcu->retired = (std_rbtree_retired *)0;
+    rcu->numretired = 0;
+    epoch = __atomic_add_fetch(&rbt_rcu_epoch, 1, __ATOMIC_SEQ_CST);
+    std_mutex_unlock(&rcu->lock);
+
+    /*
+     * Wait outside of the mutex: a reader without a slot of its own
+     * holds it for the length of its read side section.
+     */
+    while (std_rbtree_rcu_min_epoch() < epoch)
+        sched_yield();
+
+    std_rbtree_rcu_release_list(rbtt, list, epoch, &nreleased);
+} // std_rbtree_synchronize()
+
+
+t_std_error std_rbtree_defer_free(rbtree_handle rbtt, void *data, void data_free(void *))
+{
+    std_rbtree_retired *r;
+
+    RBT_DEBUG_START(rbtt);
+    RBT_ASSERT(data_free);
+    RBT_DEBUG_END;
+
+    if (!rbtt->rbtt_rcu)
+    {
+        data_free(data);
+        return STD_ERR_OK;
+    }
+
+    if ((r = (std_rbtree_retired *) RBT_MALLOC(sizeof(std_rbtree_retired)))
+        == (std_rbtree_retired *)0)
+        return (STD_ERR_FROM_ERRNO(e_std_err_COM, e_std_err_code_FAIL));
+    r->ptr = data;
+    r->ptr_free = data_free;
+    r->owned = TRUE;
+
+    /* the tree links do not change, so readers need not retry */
+    std_mutex_lock(&RBT_RCU(rbtt)->lock);
+    std_rbtree_rcu_retire(rbtt, r);
+    if (RBT_RCU(rbtt)->numretired >= RBT_RCU_RECLAIM_BATCH)
+        std_rbtree_rcu_reclaim(rbtt);
+    std_mutex_unlock(&RBT_RCU(rbtt)->lock);
+    return STD_ERR_OK;
+} // std_rbtree_defer_free()
+
+
 void std_rbtree_destroy(rbtree_handle rbtt)
 {
+    std_rbtree_rcu *rcu = RBT_RCU(rbtt);
+    u_long nreleased = 0;
+
     RBT_DEBUG_START(rbtt);
     RBT_DEBUG_END;
 
     rbtt->rbtt_magic = 0; /* daggling ptr may give problem; clear it anyway */
 
+    /* no reader may be left on a tree being destroyed */
+    if (rcu)
+    {
+        std_rbtree_rcu_release_list(rbtt, rcu->retired, ULONG_MAX, &nreleased);
+        rbtt->rbtt_rcu = (void *)0;
+        std_mutex_destroy(&rcu->lock);
+        RBT_FREE(rcu);
+    }
+
+    /* release build blocks still holding nodes the user did not remove */
+    while (rbtt->rbtt_bulk)
+        std_rbtree_bulk_unlink(rbtt, (std_rbtree_bulk *)rbtt->rbtt_bulk);
+
     RBT_FREE(rbtt);
 } // std_rbtree_destroy()
 
@@ -0,0 +1,278 @@
+/*
+ * Copyright (c) 2016 Dell Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * THIS CODE IS PROVIDED ON AN *AS IS* BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT
+ * LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS
+ * FOR A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+ *
+ * See the Apache Version 2.0 License for specific language governing
+ * permissions and limitations under the License.
+ */
+
+/*
+ * filename: std_record_sort.c
+ */
+
+/**
+ *      @file  std_record_sort.c
+ *      @brief  Callback free sort of fixed size records
+ */
+
+#include "std_record_sort.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* longest key sorted by radix, one pass per byte */
+#define STD_RECORD_RADIX_MAX_KEY    16
+/* below this the radix passes cost more than they save */
+#define STD_RECORD_RADIX_MIN_COUNT  64
+/* runs sorted by insertion before merging */
+#define STD_RECORD_INSERT_RUN       16
+
+/*
+ * Moves of common record sizes are expanded inline by the compiler
+ * instead of calling memcpy with a variable length.
+ */
+static inline void std_record_move(void *dst, const void *src, size_t rec_size)
+{
+    switch (rec_size) {
+    case 4:  memcpy(dst, src, 4); break;
+    case 8:  memcpy(dst, src, 8); break;
+    case 12: memcpy(dst, src, 12); break;
+    case 16: memcpy(dst, src, 16); break;
+    case 24: memcpy(dst, src, 24); break;
+    case 32: memcpy(dst, src, 32); break;
+    default: memcpy(dst, src, rec_size); break;
+    }
+}
+
+/*******************************************************************************
+ *                              Merge sort
+ ******************************************************************************/
+
+#define STD_RECORD_CMP_INT(NAME, TYPE) \
+static inline int NAME(const char *a, const char *b, size_t len) \
+{ \
+    TYPE x, y; \
+    (void)len; \
+    memcpy(&x, a, sizeof(x)); \
+    memcpy(&y, b, sizeof(y)); \
+    return (x > y) - (x < y); \
+}
+
+STD_RECORD_CMP_INT(std_record_cmp_u16, uint16_t)
+STD_RECORD_CMP_INT(std_record_cmp_u32, uint32_t)
+STD_RECORD_CMP_INT(std_record_cmp_u64, uint64_t)
+STD_RECORD_CMP_INT(std_record_cmp_i32, int32_t)
+STD_RECORD_CMP_INT(std_record_cmp_i64, int64_t)
+
+static inline int std_record_cmp_bytes(const char *a, const char *b, size_t len)
+{
+    return memcmp(a, b, len);
+}
+
+/*
+ * One merge sort per key type so that the compare is inlined. Runs are
+ * sorted by insertion in place, then merged bottom up between the array
+ * and tmp. On equal keys the left record is taken first, which keeps the
+ * sort stable.
+ */
+#define STD_RECORD_MERGE_SORT(NAME, CMP) \
+static void NAME(char *array, char *tmp, size_t count, size_t rs, size_t ko, size_t kl) \
+{ \
+    char *src = array, *dst = tmp, *save = tmp, *swap; \
+    size_t lo, hi, ix, jx, width, mid, end, l, r, pos; \
+    \
+    for (lo = 0; lo < count; lo += STD_RECORD_INSERT_RUN) { \
+        hi = (lo + STD_RECORD_INSERT_RUN < count) ? lo + STD_RECORD_INSERT_RUN : count; \
+        for (ix = lo + 1; ix < hi; ix++) { \
+            if (CMP(array + (ix - 1) * rs + ko, array + ix * rs + ko, kl) <= 0) \
+                continue; \
+            std_record_move(save, array + ix * rs, rs); \
+            for (jx = ix - 1; jx > lo && \
+                 CMP(array + (jx - 1) * rs + ko, save + ko, kl) > 0; jx--) \
+                ; \
+            memmove(array + (jx + 1) * rs, array + jx * rs, (ix - jx) * rs); \
+            std_record_move(array + jx * rs, save, rs); \
+        } \
+    } \
+    \
+    for (width = STD_RECORD_INSERT_RUN; width < count; width *= 2) { \
+        for (lo = 0; lo < count; lo += 2 * width) { \
+            mid = (lo + width < count) ? lo + width : count; \
+            end = (lo + 2 * width < count) ? lo + 2 * width : count; \
+            l = lo; r = mid; pos = lo; \
+            while (l < mid && r < end) { \
+                if (CMP(src + l * rs + ko, src + r * rs + ko, kl) <= 0) \
+                    std_record_move(dst + pos++ * rs, src + l++ * rs, rs); \
+                else \
+                    std_record_move(dst + pos++ * rs, src + r++ * rs, rs); \
+            } \
+            memcpy(dst + pos * rs, src + l * rs, (mid - l) * rs); \
+            pos += mid - l; \
+            memcpy(dst + pos * rs, src + r * rs, (end - r) * rs); \
+        } \
+        swap = src; src = dst; dst = swap; \
+    } \
+    \
+    if (src != array) \
+        memcpy(array, src, count * rs); \
+}
+
+STD_RECORD_MERGE_SORT(std_record_merge_u16, std_record_cmp_u16)
+STD_RECORD_MERGE_SORT(std_record_merge_u32, std_record_cmp_u32)
+STD_RECORD_MERGE_SORT(std_record_merge_u64, std_record_cmp_u64)
+STD_RECORD_MERGE_SORT(std_record_merge_i32, std_record_cmp_i32)
+STD_RECORD_MERGE_SORT(std_record_merge_i64, std_record_cmp_i64)
+STD_RECORD_MERGE_SORT(std_record_merge_bytes, std_record_cmp_bytes)
+
+/*******************************************************************************
+ *                              Radix sort
+ ******************************************************************************/
+
+/*
+ * Key as an unsigned integer whose order is the order of the key; signed
+ * keys get their sign bit flipped.
+ */
+static inline uint64_t std_record_radix_key(const char *key, std_record_key_t key_type)
+{
+    uint16_t u16;
+    uint32_t u32;
+    uint64_t u64;
+
+    switch (key_type) {
+    case STD_RECORD_KEY_U16:
+        memcpy(&u16, key, sizeof(u16));
+        return u16;
+    case STD_RECORD_KEY_U32:
+        memcpy(&u32, key, sizeof(u32));
+        return u32;
+    case STD_RECORD_KEY_I32:
+        memcpy(&u32, key, sizeof(u32));
+        return u32 ^ 0x80000000U;
+    case STD_RECORD_KEY_I64:
+        memcpy(&u64, key, sizeof(u64));
+        return u64 ^ 0x8000000000000000ULL;
+    default:
+        memcpy(&u64, key, sizeof(u64));
+        return u64;
+    }
+}
+
+/* byte 'pass' of the key, counting from the least significant one */
+static inline unsigned int std_record_radix_digit(const char *key, std_record_key_t key_type,
+                                                  size_t key_len, size_t pass)
+{
+    if (key_type == STD_RECORD_KEY_BYTES)
+        return (unsigned char)key[key_len - 1 - pass];
+    return (unsigned int)(std_record_radix_key(key, key_type) >> (8 * pass)) & 0xff;
+}
+
+/*
+ * LSD radix sort, one stable counting pass per key byte. All the
+ * histograms are collected in a single read of the array, and a pass
+ * where every record has the same byte is skipped.
+ */
+static int std_record_radix_sort(char *array, char *tmp, size_t count, size_t rs,
+                                 size_t ko, std_record_key_t key_type, size_t key_len)
+{
+    size_t (*hist)[256];
+    size_t ix, pass, sum, n;
+    char *src = array, *dst = tmp, *swap, *rec;
+    unsigned int d;
+
+    hist = (size_t (*)[256])calloc(key_len, sizeof(*hist));
+    if (hist == NULL)
+        return 0;
+
+    for (ix = 0; ix < count; ix++) {
+        rec = array + ix * rs + ko;
+        if (key_type == STD_RECORD_KEY_BYTES) {
+            for (pass = 0; pass < key_len; pass++)
+                hist[pass][(unsigned char)rec[key_len - 1 - pass]]++;
+        } else {
+            uint64_t k = std_record_radix_key(rec, key_type);
+            for (pass = 0; pass < key_len; pass++, k >>= 8)
+                hist[pass][k & 0xff]++;
+        }
+    }
+
+    for (pass = 0; pass < key_len; pass++) {
+        d = std_record_radix_digit(array + ko, key_type, key_len, pass);
+        if (hist[pass][d] == count)
+            continue;
+
+        /* turn the counts into the start of each bucket */
+        for (d = 0, sum = 0; d < 256; d++) {
+            n = hist[pass][d];
+            hist[pass][d] = sum;
+            sum += n;
+        }
+        for (ix = 0; ix < count; ix++) {
+            rec = src + ix * rs;
+            d = std_record_radix_digit(rec + ko, key_type, key_len, pass);
+            std_record_move(dst + hist[pass][d]++ * rs, rec, rs);
+        }
+        swap = src; src = dst; dst = swap;
+    }
+
+    if (src != array)
+        memcpy(array, src, count * rs);
+    free(hist);
+    return 1;
+}
+
+t_std_error std_record_sort(void *array, size_t count, size_t rec_size,
+                            size_t key_offset, std_record_key_t key_type, size_t key_len,
+                            void *tmp_array)
+{
+    char *a = (char *)array, *t = (char *)tmp_array;
+
+    switch (key_type) {
+    case STD_RECORD_KEY_U16: key_len = sizeof(uint16_t); break;
+    case STD_RECORD_KEY_U32:
+    case STD_RECORD_KEY_I32: key_len = sizeof(uint32_t); break;
+    case STD_RECORD_KEY_U64:
+    case STD_RECORD_KEY_I64: key_len = sizeof(uint64_t); break;
+    case STD_RECORD_KEY_BYTES: break;
+    default: return STD_ERR(COM,PARAM,0);
+    }
+    if (key_len == 0 || key_offset + key_len > rec_size)
+        return STD_ERR(COM,PARAM,0);
+
+    if (count < 2)
+        return STD_ERR_OK;
+
+    if (count >= STD_RECORD_RADIX_MIN_COUNT && key_len <= STD_RECORD_RADIX_MAX_KEY &&
+        std_record_radix_sort(a, t, count, rec_size, key_offset, key_type, key_len))
+        return STD_ERR_OK;
+
+    switch (key_type) {
+    case STD_RECORD_KEY_U16:
+        std_record_merge_u16(a, t, count, rec_size, key_offset, key_len);
+        break;
+    case STD_RECORD_KEY_U32:
+        std_record_merge_u32(a, t, count, rec_size, key_offset, key_len);
+        break;
+    case STD_RECORD_KEY_U64:
+        std_record_merge_u64(a, t, count, rec_size, key_offset, key_len);
+        break;
+    case STD_RECORD_KEY_I32:
+        std_record_merge_i32(a, t, count, rec_size, key_offset, key_len);
+        break;
+    case STD_RECORD_KEY_I64:
+        std_record_merge_i64(a, t, count, rec_size, key_offset, key_len);
+        break;
+    default:
+        std_record_merge_bytes(a, t, count, rec_size, key_offset, key_len);
+        break;
+    }
+    return STD_ERR_OK;
+}
@@ -50,6 +50,9 @@ struct std_socket_service_data_t {
 
     //access by callback function
     std::set<int> m_pending_close;
+    std::set<int> m_ready;
+    std::set<int> m_want_write;
+    std::set<int> m_close_returned;     //to close once the job using them is done
 
     typedef std::set<int>::iterator fd_iterator;
 
@@ -101,17 +104,77 @@ struct std_socket_service_data_t {
             FD_CLR(fd,&pending);
             if (m_clients.find(fd)!=m_clients.end()) m_clients.erase(fd);
             m_pending_close.erase(fd);
+            m_ready.erase(fd);
+            m_want_write.erase(fd);
+            m_close_returned.erase(fd);
         }
         setup_max_fd();
     }
 
-    void returned(int fd) {
+    void ready(int fd) {
+        std_mutex_simple_lock_guard m(&m_mutex);
+        m_ready.insert(fd);
+        server_wakeup();
+    }
+
+    //the clients marked ready that are not busy
+    void take_ready(fd_set *set) {
+        std_mutex_simple_lock_guard m(&m_mutex);
+        fd_iterator it = m_ready.begin();
+        while (it != m_ready.end()) {
+            if (FD_ISSET(*it,&pending)) {
+                FD_SET(*it,set);
+                m_ready.erase(it++);
+            } else ++it;
+        }
+    }
+
+    void want_write(int fd) {
+        std_mutex_simple_lock_guard m(&m_mutex);
+        m_want_write.insert(fd);
+        server_wakeup();
+    }
+
+    //the clients waiting to write
+    void fill_write_set(fd_set *set) {
+        std_mutex_simple_lock_guard m(&m_mutex);
+        FD_ZERO(set);
+        fd_iterator it = m_want_write.begin();
+        for ( ; it != m_want_write.end() ; ++it) {
+            FD_SET(*it,set);
+        }
+    }
+
+    //stop waiting for the clients that can be written to, true if the client was waiting
+    bool take_writable(int fd) {
+        std_mutex_simple_lock_guard m(&m_mutex);
+        return m_want_write.erase(fd)!=0;
+    }
+
+    //give the client back to the server, false if it is to be closed instead
+    bool returned(int fd) {
         std_mutex_simple_lock_guard m(&m_mutex);
         if (m_clients.find(fd)==m_clients.end()) {
-            return;
+            return true;
         }
+        if (m_close_returned.erase(fd)!=0) return false;
         FD_SET(fd,&pending);
         server_wakeup();
+        return true;
+    }
+
+    //take the client to close it, or leave that to the job using it when it returns
+    bool take_for_close(int fd) {
+        std_mutex_simple_lock_guard m(&m_mutex);
+        if (m_clients.find(fd)==m_clients.end()) {
+            return false;
+        }
+        if (!FD_ISSET(fd,&pending)) {
+            m_close_returned.insert(fd);
+            return false;
+        }
+        FD_CLR(fd,&pending);
+        return true;
     }
 
     void cleanup() {
@@ -162,16 +225,31 @@ static bool queue_job(std_socket_service_data_t *service, int fd, void (*func)(v
     return true;
 }
 
+static void close_client(std_socket_service_data_t *service, int fd) {
+    service->server_init.del_client(service->server_init.context,fd);
+    service->pend_close(fd);
+}
+
 static void process_socket_data(void * context) {
     job_entry_t *p = (job_entry_t*)context;
 
-    if (!p->service->server_init.some_data(p->service->server_init.context,p->fd)) {
-        p->service->server_init.del_client(p->service->server_init.context,p->fd);
-        p->service->pend_close(p->fd);
-        return;
+    if (!p->service->server_init.some_data(p->service->server_init.context,p->fd) ||
+            !p->service->returned(p->fd)) {
+        close_client(p->service,p->fd);
     }
-    p->service->returned(p->fd);
+}
+
+/*
+ * The writable call can run along with a some_data call for the client, so
+ * when it fails the client is only closed once that call is done with it.
+ */
+static void process_socket_writable(void * context) {
+    job_entry_t *p = (job_entry_t*)context;
 
+    if (!p->service->server_init.writable(p->service->server_init.context,p->fd) &&
+            p->service->take_for_close(p->fd)) {
+        close_client(p->service,p->fd);
+    }
 }
 
 static void queue_and_add_socket(void * context) {
@@ -181,14 +259,19 @@ static void queue_and_add_socket(void * context) {
         p->service->pend_close(p->fd);
         return;
     }
-    std_mutex_simple_lock_guard m(&p->service->m_mutex);
-    p->service->new_conn(p->fd);
-    p->service->returned(p->fd);
+    bool keep;
+    {
+        std_mutex_simple_lock_guard m(&p->service->m_mutex);
+        p->service->new_conn(p->fd);
+        keep = p->service->returned(p->fd);
+    }
+    if (!keep) close_client(p->service,p->fd);
 }
 
-static void process_sockets(std_socket_service_data_t *p, fd_set &rset ) {
+static void process_sockets(std_socket_service_data_t *p, fd_set &rset, fd_set &wset ) {
 
     p->drain_server_wakeup(&rset);
+    p->take_ready(&rset);
 
     if (FD_ISSET(p->sock.socket,&rset)) {
         struct sockaddr_storage sa;
@@ -213,6 +296,11 @@ static void process_sockets(std_socket_service_data_t *p, fd_set &rset ) {
                 p->pend_close(*it);
             }
         }
+        if (FD_ISSET(*it,&wset) && p->take_writable(*it)) {
+            if (!queue_job(p,*it,process_socket_writable)) {
+                p->pend_close(*it);
+            }
+        }
     }
 }
 
@@ -221,12 +309,14 @@ static void socket_service(void *param) {
     FD_SET(p->sock.socket,&p->pending);
     FD_SET(p->server_ctl_sock[0],&p->pending);
     fd_set rset;
+    fd_set wset;
     p->setup_max_fd();
 
     while(true) {
         p->process_closed();
 
         rset = p->pending;
+        p->fill_write_set(&wset);
 
         struct timeval tv = { 1,0};
 
@@ -237,7 +327,7 @@ static void socket_service(void *param) {
 
         t_std_error serr = STD_ERR_OK;
 
-        int rc = std_select_ignore_intr(p->max_fd+1,&rset,NULL,NULL,&tv,&serr);
+        int rc = std_select_ignore_intr(p->max_fd+1,&rset,&wset,NULL,&tv,&serr);
 
         if (rc==-1) {
             //find the bad socket and repair
@@ -250,7 +340,7 @@ static void socket_service(void *param) {
             tv.tv_usec =0;
             fd_set s ;
             for ( ; ix < mx ; ++ix ) {
-                if (!FD_ISSET((int)ix,&rset)) continue;
+                if (!FD_ISSET((int)ix,&rset) && !FD_ISSET((int)ix,&wset)) continue;
                 FD_ZERO(&s);
                 FD_SET((int)ix,&s);
                 if (std_select_ignore_intr(ix+1,&s,NULL,NULL,&tv,&serr)==-1) {
@@ -268,7 +358,7 @@ static void socket_service(void *param) {
             }
             continue;
         }
-        process_sockets(p,rset);
+        process_sockets(p,rset,wset);
     }
 }
 
@@ -319,6 +409,8 @@ t_std_error std_socket_service_init(std_socket_server_handle_t *handle,
         p->server_init.del_client = _user_stub_function;
     if (p->server_init.some_data==NULL)
         p->server_init.some_data = _user_stub_function_false;
+    if (p->server_init.writable==NULL)
+        p->server_init.writable = _user_stub_function;
 
     FD_ZERO(&p->pending);
     std_mutex_lock_init_recursive(&p->m_mutex);
@@ -343,6 +435,18 @@ t_std_error std_socket_service_client_close(std_socket_server_handle_t handle, i
     return STD_ERR_OK;
 }
 
+t_std_error std_socket_service_client_ready(std_socket_server_handle_t handle, int fd) {
+    std_socket_service_data_t *p = (std_socket_service_data_t*)handle;
+    p->ready(fd);
+    return STD_ERR_OK;
+}
+
+t_std_error std_socket_service_client_want_write(std_socket_server_handle_t handle, int fd) {
+    std_socket_service_data_t *p = (std_socket_service_data_t*)handle;
+    p->want_write(fd);
+    return STD_ERR_OK;
+}
+
 t_std_error std_socket_service_destroy(std_socket_server_handle_t handle) {
     std_socket_service_data_t *p = (std_socket_service_data_t*)handle;
     delete p;
@@ -30,6 +30,7 @@
 
 #include <vector>
 #include <list>
+#include <new>
 
 struct std_thread_pool_context_t {
     enum {SHUTDOWN_WAIT_TIME=10000};
@@ -41,6 +42,7 @@ struct std_thread_pool_context_t {
     std::list<std_thread_pool_job_t> jobs;
 
     bool shutdown;
+    size_t exited;      //threads out of the work loop after shutdown
 
     bool dequeue();
 
@@ -75,7 +77,12 @@ bool std_thread_pool_context_t::add_work(std_thread_pool_job_t *job) {
 }
 
 void std_thread_pool_context_t::do_shutdown() {
+    std::list<std_thread_pool_job_t> pending;
+    lock();
     shutdown = true;
+    pending.swap(jobs);
+    unlock();
+
     size_t ix = 0;
     size_t mx = list.size();
     for ( ; ix < mx ; ++ix ) {
@@ -83,9 +90,23 @@ void std_thread_pool_context_t::do_shutdown() {
         signal();
         unlock();
     }
+    //the jobs not started are not run, but what they hold is freed
+    std::list<std_thread_pool_job_t>::iterator it = pending.begin();
+    for ( ; it != pending.end() ; ++it ) {
+        if (it->free_job_func!=NULL) it->free_job_func(it->context);
+    }
+
+    //give the threads still in a job some time to leave before the lock goes
+    uint64_t start = std_get_uptime(NULL);
+    lock();
+    while (exited < list.size() && !std_time_is_expired(start,SHUTDOWN_WAIT_TIME)) {
+        unlock();
+        std_usleep(SHUTDOWN_WAIT_TIME/10);
+        lock();
+    }
+    unlock();
     std_condition_var_destroy(&m_cond);
     std_mutex_destroy(&m_lock);
-    std_usleep(SHUTDOWN_WAIT_TIME);
 }
 
 bool std_thread_pool_context_t::dequeue() {
@@ -117,6 +138,7 @@ static void * worker_thread(void *param) {
         if (ctx->dequeue()) continue;
         ctx->wait();
     }
+    ++ctx->exited;
     ctx->unlock();
     return NULL;
 }
@@ -129,6 +151,7 @@ t_std_error std_thread_pool_create(std_thread_pool_handle_t *handle,
     if (p==NULL) return STD_ERR(COM,FAIL,0);
 
     p->shutdown = false;
+    p->exited = 0;
     params->param = p;
 
     std_mutex_lock_init_non_recursive(&p->m_lock);
@@ -167,3 +190,88 @@ t_std_error std_thread_pool_job_add(std_thread_pool_handle_t handle,std_thread_p
     std_thread_pool_context_t *p = (std_thread_pool_context_t *)handle;
     return (p->add_work(job)) ? STD_ERR_OK : STD_ERR(COM,FAIL,0);
 }
+
+size_t std_thread_pool_size(std_thread_pool_handle_t handle) {
+    std_thread_pool_context_t *p = (std_thread_pool_context_t *)handle;
+    return p->list.size();
+}
+
+/*
+ * The tasks of a std_thread_pool_run_tasks call, taken one at a time by the
+ * caller and the pool jobs.  A job can start after the caller has returned
+ * and then finds no task left, so the round is freed by whoever drops it last.
+ */
+struct std_thread_pool_round_t {
+    void (*task)(void *context, size_t ix);
+    void *context;
+    size_t num_tasks;
+    size_t next;
+    size_t done;
+    int refs;
+    std_mutex_type_t lock;
+    std_condition_var_t cond;
+};
+
+static void round_release(void *param) {
+    std_thread_pool_round_t *r = (std_thread_pool_round_t *)param;
+    if (__atomic_sub_fetch(&r->refs,1,__ATOMIC_ACQ_REL)==0) {
+        std_condition_var_destroy(&r->cond);
+        std_mutex_destroy(&r->lock);
+        delete r;
+    }
+}
+
+static void round_work(void *param) {
+    std_thread_pool_round_t *r = (std_thread_pool_round_t *)param;
+    size_t ix;
+    while ((ix=__atomic_fetch_add(&r->next,1,__ATOMIC_RELAXED)) < r->num_tasks) {
+        r->task(r->context,ix);
+        if (__atomic_add_fetch(&r->done,1,__ATOMIC_ACQ_REL)==r->num_tasks) {
+            std_mutex_lock(&r->lock);
+            std_condition_var_signal(&r->cond);
+            std_mutex_unlock(&r->lock);
+        }
+    }
+}
+
+void std_thread_pool_run_tasks(std_thread_pool_handle_t handle, size_t num_tasks,
+        void (*task)(void *context, size_t ix), void *context) {
+    size_t num_threads = (handle!=NULL) ? std_thread_pool_size(handle) : 0;
+    std_thread_pool_round_t *r = NULL;
+    if (num_threads > 0 && num_tasks > 1) r = new (std::nothrow) std_thread_pool_round_t;
+
+    if (r==NULL) {
+        for (size_t ix = 0; ix < num_tasks ; ++ix ) task(context,ix);
+        return;
+    }
+    r->task = task;
+    r->context = context;
+    r->num_tasks = num_tasks;
+    r->next = 0;
+    r->done = 0;
+    r->refs = 1;
+    std_mutex_lock_init_non_recursive(&r->lock);
+    std_condition_var_init(&r->cond);
+
+    std_thread_pool_job_t job;
+    job.context = r;
+    job.funct = round_work;
+    job.free_job_func = round_release;
+    for (size_t ix = 0; ix < num_threads && ix < num_tasks-1 ; ++ix ) {
+        __atomic_add_fetch(&r->refs,1,__ATOMIC_RELAXED);
+        if (std_thread_pool_job_add(handle,&job)!=STD_ERR_OK) {
+            __atomic_sub_fetch(&r->refs,1,__ATOMIC_RELAXED);
+            break;
+        }
+    }
+
+    round_work(r);
+
+    std_mutex_lock(&r->lock);
+    while (__atomic_load_n(&r->done,__ATOMIC_ACQUIRE) < num_tasks) {
+        std_condition_var_wait(&r->cond,&r->lock);
+    }
+    std_mutex_unlock(&r->lock);
+
+    round_release(r);
+}
@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) 2016 Dell Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * THIS CODE IS PROVIDED ON AN *AS IS* BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT
+ * LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS
+ * FOR A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+ *
+ * See the Apache Version 2.0 License for specific language governing
+ * permissions and limitations under the License.
+ */
+
+/*
+ * filename: std_tlv_compact.c
+ */
+
+/*!
+ * \file   std_tlv_compact.c
+ * \brief  Conversion between the TLV encodings
+ */
+
+#include "std_tlv_compact.h"
+
+/*
+ * Both conversions check the whole source before writing anything, and
+ * work out the length of the result on the way.
+ */
+
+t_std_error std_tlv_to_compact(void *dst, size_t *dst_len, void *src, size_t src_len) {
+    uint8_t *s = (uint8_t *)src, *d = (uint8_t *)dst;
+    size_t len = src_len, need = 0, tl;
+    std_tlv_tag_t tag;
+
+    while (len > 0) {
+        if (len < STD_TLV_HDR_LEN || std_tlv_len(s) > len - STD_TLV_HDR_LEN)
+            return STD_ERR(COM,PARAM,0);
+        tl = (size_t)std_tlv_len(s);
+        need += std_tlv_varint_len(std_tlv_tag(s)) + std_tlv_varint_len(tl) + tl;
+        s += tl + STD_TLV_HDR_LEN;
+        len -= tl + STD_TLV_HDR_LEN;
+    }
+    if (dst == NULL) {
+        *dst_len = need;
+        return STD_ERR_OK;
+    }
+    if (need > *dst_len) return STD_ERR(COM,TOOBIG,0);
+
+    for (s = (uint8_t *)src; s < (uint8_t *)src + src_len; s += tl + STD_TLV_HDR_LEN) {
+        tag = std_tlv_tag(s);
+        tl = (size_t)std_tlv_len(s);
+        d += std_tlv_varint_put(d, tag);
+        d += std_tlv_varint_put(d, tl);
+        memcpy(d, std_tlv_data(s), tl);
+        d += tl;
+    }
+    *dst_len = need;
+    return STD_ERR_OK;
+}
+
+t_std_error std_tlv_from_compact(void *dst, size_t *dst_len, void *src, size_t src_len) {
+    uint8_t *s = (uint8_t *)src, *d = (uint8_t *)dst;
+    size_t len = src_len, need = 0, hl;
+    std_tlv_tag_t tag;
+    std_tlv_len_t tl;
+
+    while (len > 0) {
+        hl = std_tlv_compact_hdr(s, len, &tag, &tl);
+        if (hl == 0 || tl > len - hl) return STD_ERR(COM,PARAM,0);
+        need += STD_TLV_HDR_LEN + tl;
+        s += hl + tl;
+        len -= hl + tl;
+    }
+    if (dst == NULL) {
+        *dst_len = need;
+        return STD_ERR_OK;
+    }
+    if (need > *dst_len) return STD_ERR(COM,TOOBIG,0);
+
+    for (s = (uint8_t *)src; s < (uint8_t *)src + src_len; s += hl + tl) {
+        hl = std_tlv_compact_hdr(s, SIZE_MAX, &tag, &tl);
+        std_tlv_set_tag(d, tag);
+        std_tlv_set_len(d, tl);
+        memcpy(d + STD_TLV_HDR_LEN, s + hl, (size_t)tl);
+        d += STD_TLV_HDR_LEN + tl;
+    }
+    *dst_len = need;
+    return STD_ERR_OK;
+}
@@ -0,0 +1,284 @@
+/*
+ * Copyright (c) 2016 Dell Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * THIS CODE IS PROVIDED ON AN *AS IS* BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT
+ * LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS
+ * FOR A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+ *
+ * See the Apache Version 2.0 License for specific language governing
+ * permissions and limitations under the License.
+ */
+
+/*
+ * filename: std_tlv_index.c
+ */
+
+/*!
+ * \file   std_tlv_index.c
+ * \brief  Index of the tags of a TLV buffer for constant time lookups
+ */
+
+#include "std_tlv_index.h"
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+/* the content of the TLV has not been indexed */
+#define STD_TLV_INDEX_NONE      (-1)
+
+typedef struct {
+    size_t offset;      /* of the TLV from the start of the buffer */
+    uint32_t group;     /* of its tag in its level */
+    int32_t child;      /* level of the TLVs in its content */
+} std_tlv_index_entry_t;
+
+/* the instances of a tag in a level */
+typedef struct {
+    std_tlv_tag_t tag;
+    uint32_t level;
+    uint32_t start;     /* first instance in ix_order */
+    uint32_t count;
+} std_tlv_index_group_t;
+
+/*
+ * The TLVs of a level (the buffer, or the content of an attribute) are
+ * entries first_entry and up, in buffer order. ix_order has the same
+ * entries grouped by tag, in buffer order within a tag, so instance n of
+ * a tag is ix_order[group.start + n]. A hash table of the groups is keyed
+ * by tag and level.
+ */
+struct std_tlv_index_s {
+    uint8_t *ix_base;
+    std_tlv_index_entry_t *ix_entries;
+    uint32_t *ix_order;
+    uint32_t ix_num_entries;
+    uint32_t ix_cap_entries;
+    std_tlv_index_group_t *ix_groups;
+    uint32_t ix_num_groups;
+    uint32_t ix_cap_groups;
+    int32_t *ix_table;          /* group of each slot, or -1 */
+    uint32_t ix_table_mask;
+    size_t *ix_level_end;       /* offset of the end of each level */
+    uint32_t ix_num_levels;
+    uint32_t ix_cap_levels;
+};
+
+static inline uint32_t std_tlv_index_hash(std_tlv_tag_t tag, uint32_t level) {
+    uint64_t h = (tag ^ ((uint64_t)level << 32 | level)) * 0x9e3779b97f4a7c15ULL;
+    return (uint32_t)(h >> 32);
+}
+
+/* the slot of a group, or the empty slot where it goes */
+static uint32_t std_tlv_index_slot(const std_tlv_index_t *ix, std_tlv_tag_t tag, uint32_t level) {
+    uint32_t slot = std_tlv_index_hash(tag, level) & ix->ix_table_mask;
+    int32_t g;
+
+    while ((g = ix->ix_table[slot]) >= 0) {
+        if (ix->ix_groups[g].tag == tag && ix->ix_groups[g].level == level) break;
+        slot = (slot + 1) & ix->ix_table_mask;
+    }
+    return slot;
+}
+
+static t_std_error std_tlv_index_grow(void **array, uint32_t *cap, uint32_t need, size_t size) {
+    uint32_t n = *cap ? *cap : 16;
+    void *p;
+
+    if (need <= *cap) return STD_ERR_OK;
+    while (n < need) n *= 2;
+    p = realloc(*array, (size_t)n * size);
+    if (p == NULL) return STD_ERR(COM,NOMEM,0);
+    *array = p;
+    *cap = n;
+    return STD_ERR_OK;
+}
+
+/* room for n more entries and groups, and a table at most half full */
+static t_std_error std_tlv_index_reserve(std_tlv_index_t *ix, uint32_t n) {
+    uint32_t need = ix->ix_num_entries + n, cap = ix->ix_cap_entries, size, ig;
+    int32_t *table;
+    void *order;
+
+    if (std_tlv_index_grow((void **)&ix->ix_entries, &ix->ix_cap_entries, need,
+                           sizeof(*ix->ix_entries)) != STD_ERR_OK ||
+        std_tlv_index_grow((void **)&ix->ix_groups, &ix->ix_cap_groups,
+                           ix->ix_num_groups + n, sizeof(*ix->ix_groups)) != STD_ERR_OK ||
+        std_tlv_index_grow((void **)&ix->ix_level_end, &ix->ix_cap_levels,
+                           ix->ix_num_levels + 1, sizeof(*ix->ix_level_end)) != STD_ERR_OK)
+        return STD_ERR(COM,NOMEM,0);
+    if (ix->ix_order == NULL || cap != ix->ix_cap_entries) {
+        order = realloc(ix->ix_order, (size_t)ix->ix_cap_entries * sizeof(*ix->ix_order));
+        if (order == NULL) return STD_ERR(COM,NOMEM,0);
+        ix->ix_order = (uint32_t *)order;
+    }
+
+    if (ix->ix_table != NULL && (ix->ix_num_groups + n) * 2 <= ix->ix_table_mask + 1)
+        return STD_ERR_OK;
+    for (size = 32; size < (ix->ix_num_groups + n) * 2; size *= 2)
+        ;
+    table = (int32_t *)malloc(size * sizeof(*table));
+    if (table == NULL) return STD_ERR(COM,NOMEM,0);
+    memset(table, 0xff, size * sizeof(*table));
+    free(ix->ix_table);
+    ix->ix_table = table;
+    ix->ix_table_mask = size - 1;
+    for (ig = 0; ig < ix->ix_num_groups; ++ig) {
+        table[std_tlv_index_slot(ix, ix->ix_groups[ig].tag, ix->ix_groups[ig].level)] = ig;
+    }
+    return STD_ERR_OK;
+}
+
+/*
+ * Number of TLVs from offset to offset + len, up to the first one that
+ * does not fit. valid tells whether they fill the length exactly.
+ */
+static uint32_t std_tlv_index_walk(const std_tlv_index_t *ix, size_t offset, size_t len,
+                                   bool *valid) {
+    uint32_t n = 0;
+    size_t tl;
+
+    *valid = false;
+    while (len > 0) {
+        if (len < STD_TLV_HDR_LEN) return n;
+        tl = std_tlv_len(ix->ix_base + offset);
+        if (tl > len - STD_TLV_HDR_LEN || n == UINT32_MAX) return n;
+        offset += tl + STD_TLV_HDR_LEN;
+        len -= tl + STD_TLV_HDR_LEN;
+        ++n;
+    }
+    *valid = true;
+    return n;
+}
+
+/* index the TLVs from offset to offset + len as a new level */
+static t_std_error std_tlv_index_level(std_tlv_index_t *ix, size_t offset, size_t len,
+                                       bool *valid, uint32_t *level) {
+    uint32_t n = std_tlv_index_walk(ix, offset, len, valid), first = ix->ix_num_entries;
+    uint32_t first_group = ix->ix_num_groups, ie, ig, slot, pos;
+    std_tlv_index_group_t *g;
+    std_tlv_tag_t tag;
+    t_std_error rc;
+
+    if ((rc = std_tlv_index_reserve(ix, n)) != STD_ERR_OK) return rc;
+    *level = ix->ix_num_levels++;
+    ix->ix_level_end[*level] = offset + len;
+
+    /* count the instances of each tag */
+    for (ie = first; ie < first + n; ++ie) {
+        tag = std_tlv_tag(ix->ix_base + offset);
+        slot = std_tlv_index_slot(ix, tag, *level);
+        if (ix->ix_table[slot] < 0) {
+            g = &ix->ix_groups[ix->ix_num_groups];
+            g->tag = tag;
+            g->level = *level;
+            g->count = 0;
+            ix->ix_table[slot] = ix->ix_num_groups++;
+        }
+        ig = ix->ix_table[slot];
+        ix->ix_groups[ig].count++;
+        ix->ix_entries[ie].offset = offset;
+        ix->ix_entries[ie].group = ig;
+        ix->ix_entries[ie].child = STD_TLV_INDEX_NONE;
+        offset += std_tlv_total_len(ix->ix_base + offset);
+    }
+
+    /* then lay the instances out by tag */
+    for (ig = first_group, pos = first; ig < ix->ix_num_groups; ++ig) {
+        ix->ix_groups[ig].start = pos;
+        pos += ix->ix_groups[ig].count;
+        ix->ix_groups[ig].count = 0;
+    }
+    for (ie = first; ie < first + n; ++ie) {
+        g = &ix->ix_groups[ix->ix_entries[ie].group];
+        ix->ix_order[g->start + g->count++] = ie;
+    }
+    ix->ix_num_entries += n;
+    return STD_ERR_OK;
+}
+
+static const std_tlv_index_group_t * std_tlv_index_group(const std_tlv_index_t *ix,
+                                                         std_tlv_tag_t tag, uint32_t level) {
+    int32_t g = ix->ix_table[std_tlv_index_slot(ix, tag, level)];
+
+    return (g < 0) ? NULL : &ix->ix_groups[g];
+}
+
+t_std_error std_tlv_index_create(std_tlv_index_t **index, void *data, size_t len) {
+    std_tlv_index_t *ix;
+    t_std_error rc;
+    uint32_t level;
+    bool valid;
+
+    ix = (std_tlv_index_t *)calloc(1, sizeof(*ix));
+    if (ix == NULL) return STD_ERR(COM,NOMEM,0);
+    ix->ix_base = (uint8_t *)data;
+
+    rc = std_tlv_index_level(ix, 0, len, &valid, &level);
+    if (rc == STD_ERR_OK && !valid) rc = STD_ERR(COM,PARAM,0);
+    if (rc != STD_ERR_OK) {
+        std_tlv_index_destroy(ix);
+        return rc;
+    }
+    *index = ix;
+    return STD_ERR_OK;
+}
+
+void std_tlv_index_destroy(std_tlv_index_t *index) {
+    if (index == NULL) return;
+    free(index->ix_entries);
+    free(index->ix_order);
+    free(index->ix_groups);
+    free(index->ix_table);
+    free(index->ix_level_end);
+    free(index);
+}
+
+size_t std_tlv_index_count(const std_tlv_index_t *index, std_tlv_tag_t tag) {
+    const std_tlv_index_group_t *g = std_tlv_index_group(index, tag, 0);
+
+    return (g == NULL) ? 0 : g->count;
+}
+
+void * std_tlv_index_find_nth(const std_tlv_index_t *index, std_tlv_tag_t tag, size_t n) {
+    const std_tlv_index_group_t *g = std_tlv_index_group(index, tag, 0);
+
+    if (g == NULL || n >= g->count) return NULL;
+    return index->ix_base + index->ix_entries[index->ix_order[g->start + n]].offset;
+}
+
+void * std_tlv_index_efind(std_tlv_index_t *index, const std_tlv_tag_t *tags, size_t tlen,
+                           size_t *dlen) {
+    const std_tlv_index_group_t *g;
+    std_tlv_index_entry_t *e = NULL;
+    uint32_t level = 0, child, ie;
+    size_t ix;
+    bool valid;
+
+    if (tlen == 0) return NULL;
+    for (ix = 0; ; ++ix) {
+        g = std_tlv_index_group(index, tags[ix], level);
+        if (g == NULL) return NULL;
+        ie = index->ix_order[g->start];
+        e = &index->ix_entries[ie];
+        if (ix + 1 == tlen) break;
+
+        if (e->child == STD_TLV_INDEX_NONE) {
+            if (std_tlv_index_level(index, e->offset + STD_TLV_HDR_LEN,
+                                    std_tlv_len(index->ix_base + e->offset),
+                                    &valid, &child) != STD_ERR_OK)
+                return NULL;
+            /* the entries may have moved */
+            e = &index->ix_entries[ie];
+            e->child = child;
+        }
+        level = e->child;
+    }
+    *dlen = index->ix_level_end[level] - e->offset;
+    return index->ix_base + e->offset;
+}
@@ -0,0 +1,355 @@
+/*
+ * Copyright (c) 2016 Dell Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * THIS CODE IS PROVIDED ON AN *AS IS* BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT
+ * LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS
+ * FOR A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+ *
+ * See the Apache Version 2.0 License for specific language governing
+ * permissions and limitations under the License.
+ */
+
+/*
+ * filename: std_tlv_schema.c
+ */
+
+/*!
+ * \file   std_tlv_schema.c
+ * \brief  Table driven decode of TLVs into C structs, and encode back
+ */
+
+#include "std_tlv_schema.h"
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+/* tags below this are looked up in a table indexed by tag, others hashed */
+#define STD_TLV_SCHEMA_DIRECT   1024
+
+/* what a field does, so that decode and encode are one switch */
+typedef enum {
+    STD_TLV_SCHEMA_OP_U8,
+    STD_TLV_SCHEMA_OP_U16,
+    STD_TLV_SCHEMA_OP_U32,
+    STD_TLV_SCHEMA_OP_U64,
+    STD_TLV_SCHEMA_OP_BE16,
+    STD_TLV_SCHEMA_OP_BE32,
+    STD_TLV_SCHEMA_OP_BE64,
+    STD_TLV_SCHEMA_OP_BYTES,
+    STD_TLV_SCHEMA_OP_STRING,
+} std_tlv_schema_op_t;
+
+typedef struct {
+    std_tlv_tag_t tag;
+    size_t offset;
+    size_t size;
+    std_tlv_schema_op_t op;
+} std_tlv_schema_field_t;
+
+/*
+ * Small tags, the usual case, map to their field through sc_direct, the
+ * field index plus one or 0 for none. When some tag is too large for
+ * that, all of them are in an open addressing hash table instead.
+ */
+struct std_tlv_schema_s {
+    std_tlv_schema_field_t *sc_fields;
+    size_t sc_num_fields;
+    uint64_t sc_required;
+    uint8_t *sc_direct;
+    size_t sc_direct_len;
+    std_tlv_tag_t *sc_hash_tags;
+    uint8_t *sc_hash_fields;    /* field index plus one, or 0 for an empty slot */
+    uint32_t sc_hash_mask;
+};
+
+static inline uint32_t std_tlv_schema_hash(std_tlv_tag_t tag) {
+    return (uint32_t)((tag * 0x9e3779b97f4a7c15ULL) >> 32);
+}
+
+/* the index of the field of a tag, or -1 */
+static inline int std_tlv_schema_lookup(const std_tlv_schema_t *s, std_tlv_tag_t tag) {
+    uint32_t slot;
+
+    if (tag < s->sc_direct_len) return (int)s->sc_direct[tag] - 1;
+    if (s->sc_hash_fields == NULL) return -1;
+    for (slot = std_tlv_schema_hash(tag) & s->sc_hash_mask; s->sc_hash_fields[slot] != 0;
+         slot = (slot + 1) & s->sc_hash_mask) {
+        if (s->sc_hash_tags[slot] == tag) return (int)s->sc_hash_fields[slot] - 1;
+    }
+    return -1;
+}
+
+static t_std_error std_tlv_schema_op(const std_tlv_field_t *f, std_tlv_schema_op_t *op) {
+    bool be = (f->flags & STD_TLV_FIELD_BE) != 0;
+
+    switch (f->type) {
+    case STD_TLV_FIELD_UINT:
+        switch (f->size) {
+        case 1: *op = STD_TLV_SCHEMA_OP_U8; return STD_ERR_OK;
+        case 2: *op = be ? STD_TLV_SCHEMA_OP_BE16 : STD_TLV_SCHEMA_OP_U16; return STD_ERR_OK;
+        case 4: *op = be ? STD_TLV_SCHEMA_OP_BE32 : STD_TLV_SCHEMA_OP_U32; return STD_ERR_OK;
+        case 8: *op = be ? STD_TLV_SCHEMA_OP_BE64 : STD_TLV_SCHEMA_OP_U64; return STD_ERR_OK;
+        }
+        break;
+    case STD_TLV_FIELD_BYTES:
+        *op = STD_TLV_SCHEMA_OP_BYTES;
+        if (f->size > 0) return STD_ERR_OK;
+        break;
+    case STD_TLV_FIELD_STRING:
+        *op = STD_TLV_SCHEMA_OP_STRING;
+        if (f->size > 0) return STD_ERR_OK;
+        break;
+    }
+    return STD_ERR(COM,PARAM,0);
+}
+
+t_std_error std_tlv_schema_create(std_tlv_schema_t **schema, const std_tlv_field_t *fields,
+                                  size_t num_fields) {
+    std_tlv_schema_t *s;
+    std_tlv_tag_t max_tag = 0;
+    uint32_t slot, size;
+    size_t ix;
+
+    if (num_fields > STD_TLV_SCHEMA_MAX_FIELDS) return STD_ERR(COM,PARAM,0);
+    s = (std_tlv_schema_t *)calloc(1, sizeof(*s));
+    if (s == NULL) return STD_ERR(COM,NOMEM,0);
+    s->sc_fields = (std_tlv_schema_field_t *)calloc(num_fields + 1, sizeof(*s->sc_fields));
+    if (s->sc_fields == NULL) goto nomem;
+    s->sc_num_fields = num_fields;
+
+    for (ix = 0; ix < num_fields; ++ix) {
+        if (std_tlv_schema_op(&fields[ix], &s->sc_fields[ix].op) != STD_ERR_OK) goto param;
+        s->sc_fields[ix].tag = fields[ix].tag;
+        s->sc_fields[ix].offset = fields[ix].offset;
+        s->sc_fields[ix].size = fields[ix].size;
+        if (fields[ix].flags & STD_TLV_FIELD_REQUIRED) s->sc_required |= 1ULL << ix;
+        if (fields[ix].tag > max_tag) max_tag = fields[ix].tag;
+    }
+
+    if (max_tag < STD_TLV_SCHEMA_DIRECT) {
+        s->sc_direct_len = num_fields ? max_tag + 1 : 0;
+        s->sc_direct = (uint8_t *)calloc(s->sc_direct_len + 1, 1);
+        if (s->sc_direct == NULL) goto nomem;
+        for (ix = 0; ix < num_fields; ++ix) {
+            if (s->sc_direct[fields[ix].tag] != 0) goto param;
+            s->sc_direct[fields[ix].tag] = ix + 1;
+        }
+    } else {
+        /* at most half full */
+        for (size = 8; size < 2 * num_fields; size *= 2)
+            ;
+        s->sc_hash_mask = size - 1;
+        s->sc_hash_tags = (std_tlv_tag_t *)calloc(size, sizeof(*s->sc_hash_tags));
+        s->sc_hash_fields = (uint8_t *)calloc(size, 1);
+        if (s->sc_hash_tags == NULL || s->sc_hash_fields == NULL) goto nomem;
+        for (ix = 0; ix < num_fields; ++ix) {
+            if (std_tlv_schema_lookup(s, fields[ix].tag) >= 0) goto param;
+            for (slot = std_tlv_schema_hash(fields[ix].tag) & s->sc_hash_mask;
+                 s->sc_hash_fields[slot] != 0; slot = (slot + 1) & s->sc_hash_mask)
+                ;
+            s->sc_hash_tags[slot] = fields[ix].tag;
+            s->sc_hash_fields[slot] = ix + 1;
+        }
+    }
+    *schema = s;
+    return STD_ERR_OK;
+
+param:
+    std_tlv_schema_destroy(s);
+    return STD_ERR(COM,PARAM,0);
+nomem:
+    std_tlv_schema_destroy(s);
+    return STD_ERR(COM,NOMEM,0);
+}
+
+void std_tlv_schema_destroy(std_tlv_schema_t *schema) {
+    if (schema == NULL) return;
+    free(schema->sc_fields);
+    free(schema->sc_direct);
+    free(schema->sc_hash_tags);
+    free(schema->sc_hash_fields);
+    free(schema);
+}
+
+/* the data of a TLV into its member, false if it has the wrong length */
+static inline bool std_tlv_schema_get(const std_tlv_schema_field_t *f, uint8_t *dst,
+                                      const uint8_t *src, size_t len) {
+    uint16_t u16;
+    uint32_t u32;
+    uint64_t u64;
+
+    if (len != f->size && f->op != STD_TLV_SCHEMA_OP_STRING) return false;
+
+    switch (f->op) {
+    case STD_TLV_SCHEMA_OP_U8:
+        *dst = *src;
+        break;
+    case STD_TLV_SCHEMA_OP_U16:
+        memcpy(&u16, src, sizeof(u16));
+        u16 = le16toh(u16);
+        memcpy(dst, &u16, sizeof(u16));
+        break;
+    case STD_TLV_SCHEMA_OP_U32:
+        memcpy(&u32, src, sizeof(u32));
+        u32 = le32toh(u32);
+        memcpy(dst, &u32, sizeof(u32));
+        break;
+    case STD_TLV_SCHEMA_OP_U64:
+        memcpy(&u64, src, sizeof(u64));
+        u64 = le64toh(u64);
+        memcpy(dst, &u64, sizeof(u64));
+        break;
+    case STD_TLV_SCHEMA_OP_BE16:
+        memcpy(&u16, src, sizeof(u16));
+        u16 = be16toh(u16);
+        memcpy(dst, &u16, sizeof(u16));
+        break;
+    case STD_TLV_SCHEMA_OP_BE32:
+        memcpy(&u32, src, sizeof(u32));
+        u32 = be32toh(u32);
+        memcpy(dst, &u32, sizeof(u32));
+        break;
+    case STD_TLV_SCHEMA_OP_BE64:
+        memcpy(&u64, src, sizeof(u64));
+        u64 = be64toh(u64);
+        memcpy(dst, &u64, sizeof(u64));
+        break;
+    case STD_TLV_SCHEMA_OP_BYTES:
+        memcpy(dst, src, len);
+        break;
+    case STD_TLV_SCHEMA_OP_STRING:
+        /* the member has to end up NUL terminated */
+        if (len > f->size || (len == f->size && src[len - 1] != 0)) return false;
+        memcpy(dst, src, len);
+        memset(dst + len, 0, f->size - len);
+        break;
+    }
+    return true;
+}
+
+t_std_error std_tlv_schema_decode(const std_tlv_schema_t *schema, const void *data, size_t len,
+                                  void *obj, uint64_t *present) {
+    const uint8_t *p = (const uint8_t *)data;
+    const std_tlv_schema_field_t *f;
+    uint64_t found = 0, bit;
+    std_tlv_len_t tlen;
+    int ix;
+
+    while (len > 0) {
+        if (len < STD_TLV_HDR_LEN) return STD_ERR(COM,PARAM,0);
+        tlen = std_tlv_len((void *)p);
+        if (tlen > len - STD_TLV_HDR_LEN) return STD_ERR(COM,PARAM,0);
+
+        ix = std_tlv_schema_lookup(schema, std_tlv_tag((void *)p));
+        if (ix >= 0 && !(found & (bit = 1ULL << ix))) {
+            f = &schema->sc_fields[ix];
+            if (!std_tlv_schema_get(f, (uint8_t *)obj + f->offset, p + STD_TLV_HDR_LEN,
+                                    (size_t)tlen))
+                return STD_ERR(COM,PARAM,0);
+            found |= bit;
+        }
+        p += STD_TLV_HDR_LEN + tlen;
+        len -= STD_TLV_HDR_LEN + tlen;
+    }
+
+    if (present != NULL) *present = found;
+    if ((found & schema->sc_required) != schema->sc_required) return STD_ERR(COM,NEXIST,0);
+    return STD_ERR_OK;
+}
+
+/* the member as TLV data */
+static inline void std_tlv_schema_put(const std_tlv_schema_field_t *f, uint8_t *dst,
+                                      const uint8_t *src, size_t len) {
+    uint16_t u16;
+    uint32_t u32;
+    uint64_t u64;
+
+    switch (f->op) {
+    case STD_TLV_SCHEMA_OP_U8:
+        *dst = *src;
+        break;
+    case STD_TLV_SCHEMA_OP_U16:
+        memcpy(&u16, src, sizeof(u16));
+        u16 = htole16(u16);
+        memcpy(dst, &u16, sizeof(u16));
+        break;
+    case STD_TLV_SCHEMA_OP_U32:
+        memcpy(&u32, src, sizeof(u32));
+        u32 = htole32(u32);
+        memcpy(dst, &u32, sizeof(u32));
+        break;
+    case STD_TLV_SCHEMA_OP_U64:
+        memcpy(&u64, src, sizeof(u64));
+        u64 = htole64(u64);
+        memcpy(dst, &u64, sizeof(u64));
+        break;
+    case STD_TLV_SCHEMA_OP_BE16:
+        memcpy(&u16, src, sizeof(u16));
+        u16 = htobe16(u16);
+        memcpy(dst, &u16, sizeof(u16));
+        break;
+    case STD_TLV_SCHEMA_OP_BE32:
+        memcpy(&u32, src, sizeof(u32));
+        u32 = htobe32(u32);
+        memcpy(dst, &u32, sizeof(u32));
+        break;
+    case STD_TLV_SCHEMA_OP_BE64:
+        memcpy(&u64, src, sizeof(u64));
+        u64 = htobe64(u64);
+        memcpy(dst, &u64, sizeof(u64));
+        break;
+    case STD_TLV_SCHEMA_OP_BYTES:
+    case STD_TLV_SCHEMA_OP_STRING:
+        memcpy(dst, src, len);
+        break;
+    }
+}
+
+/* the length of the TLV data of a member, 0 for a string that is not terminated */
+static inline size_t std_tlv_schema_data_len(const std_tlv_schema_field_t *f, const uint8_t *src) {
+    const uint8_t *nul;
+
+    if (f->op != STD_TLV_SCHEMA_OP_STRING) return f->size;
+    nul = (const uint8_t *)memchr(src, 0, f->size);
+    return (nul != NULL) ? (size_t)(nul - src) + 1 : 0;
+}
+
+t_std_error std_tlv_schema_encode(const std_tlv_schema_t *schema, const void *obj,
+                                  uint64_t present, void *dst, size_t *dst_len) {
+    const uint8_t *base = (const uint8_t *)obj;
+    const std_tlv_schema_field_t *f;
+    uint8_t *p = (uint8_t *)dst;
+    size_t ix, need = 0, n;
+
+    present |= schema->sc_required;
+    for (ix = 0; ix < schema->sc_num_fields; ++ix) {
+        if (!(present & (1ULL << ix))) continue;
+        f = &schema->sc_fields[ix];
+        if ((n = std_tlv_schema_data_len(f, base + f->offset)) == 0)
+            return STD_ERR(COM,PARAM,0);
+        need += STD_TLV_HDR_LEN + n;
+    }
+    if (dst == NULL) {
+        *dst_len = need;
+        return STD_ERR_OK;
+    }
+    if (need > *dst_len) return STD_ERR(COM,TOOBIG,0);
+
+    for (ix = 0; ix < schema->sc_num_fields; ++ix) {
+        if (!(present & (1ULL << ix))) continue;
+        f = &schema->sc_fields[ix];
+        n = std_tlv_schema_data_len(f, base + f->offset);
+        std_tlv_set_tag(p, f->tag);
+        std_tlv_set_len(p, n);
+        std_tlv_schema_put(f, p + STD_TLV_HDR_LEN, base + f->offset, n);
+        p += STD_TLV_HDR_LEN + n;
+    }
+    *dst_len = need;
+    return STD_ERR_OK;
+}
@@ -0,0 +1,217 @@
+/*
+ * Copyright (c) 2016 Dell Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * THIS CODE IS PROVIDED ON AN *AS IS* BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT
+ * LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS
+ * FOR A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+ *
+ * See the Apache Version 2.0 License for specific language governing
+ * permissions and limitations under the License.
+ */
+
+/*
+ * filename: std_tlv_sg.c
+ */
+
+/*!
+ * \file   std_tlv_sg.c
+ * \brief  Builder of TLV messages as scatter-gather lists
+ */
+
+#include "std_tlv_sg.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/* arena block, larger for data copied with std_tlv_sg_add_copy */
+#define STD_TLV_SG_BLOCK    4096
+
+typedef struct std_tlv_sg_block_s {
+    struct std_tlv_sg_block_s *next;
+    size_t size;
+    uint8_t data[];
+} std_tlv_sg_block_t;
+
+void std_tlv_sg_init(std_tlv_sg_t *sg) {
+    memset(sg, 0, sizeof(*sg));
+}
+
+void std_tlv_sg_destroy(std_tlv_sg_t *sg) {
+    std_tlv_sg_block_t *b, *next;
+
+    for (b = sg->sg_blocks; b != NULL; b = next) {
+        next = b->next;
+        free(b);
+    }
+    free(sg->sg_iov);
+    memset(sg, 0, sizeof(*sg));
+}
+
+void std_tlv_sg_reset(std_tlv_sg_t *sg) {
+    std_tlv_sg_block_t *b = sg->sg_blocks, *next;
+
+    /* keep the oldest block, which is of the usual size unless alone */
+    while (b != NULL && b->next != NULL) {
+        next = b->next;
+        free(b);
+        b = next;
+    }
+    sg->sg_blocks = b;
+    sg->sg_pos = (b != NULL) ? b->data : NULL;
+    sg->sg_left = (b != NULL) ? b->size : 0;
+    sg->sg_num_iov = 0;
+    sg->sg_last_arena = false;
+    sg->sg_len = 0;
+}
+
+/* n bytes of arena */
+static uint8_t * std_tlv_sg_alloc(std_tlv_sg_t *sg, size_t n) {
+    std_tlv_sg_block_t *b;
+    size_t size = (n > STD_TLV_SG_BLOCK) ? n : STD_TLV_SG_BLOCK;
+    uint8_t *p;
+
+    if (n > sg->sg_left) {
+        b = (std_tlv_sg_block_t *)malloc(sizeof(*b) + size);
+        if (b == NULL) return NULL;
+        b->size = size;
+        b->next = sg->sg_blocks;
+        sg->sg_blocks = b;
+        sg->sg_pos = b->data;
+        sg->sg_left = size;
+        sg->sg_last_arena = false;
+    }
+    p = sg->sg_pos;
+    sg->sg_pos += n;
+    sg->sg_left -= n;
+    return p;
+}
+
+/* add bytes to the message, in the last iovec if they follow it in the arena */
+static t_std_error std_tlv_sg_emit(std_tlv_sg_t *sg, const void *p, size_t n, bool arena) {
+    struct iovec *iov;
+    size_t cap;
+
+    if (n == 0) return STD_ERR_OK;
+    sg->sg_len += n;
+    if (arena && sg->sg_last_arena) {
+        sg->sg_iov[sg->sg_num_iov - 1].iov_len += n;
+        return STD_ERR_OK;
+    }
+    if (sg->sg_num_iov == sg->sg_cap_iov) {
+        cap = sg->sg_cap_iov ? sg->sg_cap_iov * 2 : 16;
+        iov = (struct iovec *)realloc(sg->sg_iov, cap * sizeof(*iov));
+        if (iov == NULL) {
+            sg->sg_len -= n;
+            return STD_ERR(COM,NOMEM,0);
+        }
+        sg->sg_iov = iov;
+        sg->sg_cap_iov = cap;
+    }
+    sg->sg_iov[sg->sg_num_iov].iov_base = (void *)p;
+    sg->sg_iov[sg->sg_num_iov].iov_len = n;
+    sg->sg_num_iov++;
+    sg->sg_last_arena = arena;
+    return STD_ERR_OK;
+}
+
+/*
+ * The header, and the data when copied, go to the arena. A failed add
+ * leaves at most some unused arena behind.
+ */
+static t_std_error std_tlv_sg_put(std_tlv_sg_t *sg, std_tlv_tag_t tag, std_tlv_len_t len,
+                                  const void *content, bool copy) {
+    size_t n = STD_TLV_HDR_LEN + (copy ? (size_t)len : 0);
+    std_tlv_sg_block_t *b = sg->sg_blocks;
+    bool last = sg->sg_last_arena;
+    uint8_t *p = std_tlv_sg_alloc(sg, n);
+    t_std_error rc;
+
+    if (p == NULL) return STD_ERR(COM,NOMEM,0);
+    std_tlv_set_tag(p, tag);
+    std_tlv_set_len(p, len);
+    if (copy && len > 0) memcpy(p + STD_TLV_HDR_LEN, content, (size_t)len);
+
+    if ((rc = std_tlv_sg_emit(sg, p, n, true)) != STD_ERR_OK) {
+        /* give the arena back if it was not a new block */
+        if (sg->sg_blocks == b) {
+            sg->sg_pos -= n;
+            sg->sg_left += n;
+            sg->sg_last_arena = last;
+        }
+        return rc;
+    }
+    if (!copy && (rc = std_tlv_sg_emit(sg, content, (size_t)len, false)) != STD_ERR_OK) {
+        /* leave the header out of the message, its arena is lost */
+        sg->sg_iov[sg->sg_num_iov - 1].iov_len -= n;
+        if (sg->sg_iov[sg->sg_num_iov - 1].iov_len == 0) sg->sg_num_iov--;
+        sg->sg_len -= n;
+        sg->sg_last_arena = false;
+        return rc;
+    }
+    return STD_ERR_OK;
+}
+
+t_std_error std_tlv_sg_add(std_tlv_sg_t *sg, std_tlv_tag_t tag, std_tlv_len_t len,
+                           const void *content) {
+    return std_tlv_sg_put(sg, tag, len, content, len <= STD_TLV_SG_COPY_MAX);
+}
+
+t_std_error std_tlv_sg_add_copy(std_tlv_sg_t *sg, std_tlv_tag_t tag, std_tlv_len_t len,
+                                const void *content) {
+    return std_tlv_sg_put(sg, tag, len, content, true);
+}
+
+t_std_error std_tlv_sg_add_u16(std_tlv_sg_t *sg, std_tlv_tag_t tag, uint16_t content) {
+    content = htole16(content);
+    return std_tlv_sg_put(sg, tag, sizeof(content), &content, true);
+}
+
+t_std_error std_tlv_sg_add_u32(std_tlv_sg_t *sg, std_tlv_tag_t tag, uint32_t content) {
+    content = htole32(content);
+    return std_tlv_sg_put(sg, tag, sizeof(content), &content, true);
+}
+
+t_std_error std_tlv_sg_add_u64(std_tlv_sg_t *sg, std_tlv_tag_t tag, uint64_t content) {
+    content = htole64(content);
+    return std_tlv_sg_put(sg, tag, sizeof(content), &content, true);
+}
+
+t_std_error std_tlv_sg_nest_begin(std_tlv_sg_t *sg, std_tlv_tag_t tag, std_tlv_sg_nest_t *nest) {
+    t_std_error rc = std_tlv_sg_put(sg, tag, 0, NULL, true);
+
+    if (rc != STD_ERR_OK) return rc;
+    /* the header just written ends at the arena position */
+    nest->sgn_hdr = sg->sg_pos - STD_TLV_HDR_LEN;
+    nest->sgn_start = sg->sg_len;
+    return STD_ERR_OK;
+}
+
+void std_tlv_sg_nest_end(std_tlv_sg_t *sg, std_tlv_sg_nest_t *nest) {
+    std_tlv_set_len(nest->sgn_hdr, sg->sg_len - nest->sgn_start);
+}
+
+const struct iovec * std_tlv_sg_iov(const std_tlv_sg_t *sg, size_t *num_iov) {
+    *num_iov = sg->sg_num_iov;
+    return sg->sg_iov;
+}
+
+size_t std_tlv_sg_len(const std_tlv_sg_t *sg) {
+    return sg->sg_len;
+}
+
+t_std_error std_tlv_sg_copy_out(const std_tlv_sg_t *sg, void *buf, size_t len) {
+    uint8_t *p = (uint8_t *)buf;
+    size_t ix;
+
+    if (sg->sg_len > len) return STD_ERR(COM,TOOBIG,0);
+    for (ix = 0; ix < sg->sg_num_iov; ++ix) {
+        memcpy(p, sg->sg_iov[ix].iov_base, sg->sg_iov[ix].iov_len);
+        p += sg->sg_iov[ix].iov_len;
+    }
+    return STD_ERR_OK;
+}
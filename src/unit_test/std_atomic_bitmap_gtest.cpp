@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) 2016 Dell Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * THIS CODE IS PROVIDED ON AN *AS IS* BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT
+ * LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS
+ * FOR A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+ *
+ * See the Apache Version 2.0 License for specific language governing
+ * permissions and limitations under the License.
+ */
+
+/*
+ * filename: std_atomic_bitmap_gtest.cpp
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "gtest/gtest.h"
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "std_atomic_bitmap.h"
+
+TEST(std_atomic_bitmap_test, bits)
+{
+    std_atomic_bitmap_t bm;
+    ASSERT_EQ(std_atomic_bitmap_init(&bm, 200), STD_ERR_OK);
+    ASSERT_EQ(std_atomic_bitmap_num_words(&bm), 4);
+    ASSERT_EQ(std_atomic_bitmap_find_first(&bm, 0), -1);
+
+    ASSERT_FALSE(std_atomic_bitmap_test_and_set(&bm, 130));
+    ASSERT_TRUE(std_atomic_bitmap_test_and_set(&bm, 130));
+    ASSERT_FALSE(std_atomic_bitmap_test_and_set(&bm, 199));
+    ASSERT_TRUE(std_atomic_bitmap_test(&bm, 130));
+    ASSERT_FALSE(std_atomic_bitmap_test(&bm, 131));
+    ASSERT_EQ(std_atomic_bitmap_find_first(&bm, 0), 130);
+    ASSERT_EQ(std_atomic_bitmap_find_first(&bm, 131), 199);
+    ASSERT_EQ(std_atomic_bitmap_find_first(&bm, 200), -1);
+
+    ASSERT_EQ(std_atomic_bitmap_fetch_and_clear_word(&bm, 2), 1ULL << 2);
+    ASSERT_EQ(std_atomic_bitmap_fetch_and_clear_word(&bm, 2), 0);
+    ASSERT_TRUE(std_atomic_bitmap_test_and_clear(&bm, 199));
+    ASSERT_FALSE(std_atomic_bitmap_test_and_clear(&bm, 199));
+    ASSERT_EQ(std_atomic_bitmap_find_first(&bm, 0), -1);
+    std_atomic_bitmap_destroy(&bm);
+}
+
+static bool stop_at_third(void *context, size_t bit) {
+    return ++*(int *)context < 3;
+}
+
+TEST(std_atomic_bitmap_test, drain_stop)
+{
+    std_atomic_bitmap_t bm;
+    ASSERT_EQ(std_atomic_bitmap_init(&bm, 64), STD_ERR_OK);
+    for (int ix = 0; ix < 10; ++ix) std_atomic_bitmap_test_and_set(&bm, ix * 5);
+    int seen = 0;
+    ASSERT_EQ(std_atomic_bitmap_drain(&bm, stop_at_third, &seen), 3);
+    /* the bits after the third are still there */
+    ASSERT_EQ(std_atomic_bitmap_find_first(&bm, 0), 15);
+    std_atomic_bitmap_destroy(&bm);
+}
+
+typedef struct drain_ctx_s {
+    std::vector<int> *count;
+} drain_ctx_t;
+
+static bool count_bit(void *context, size_t bit) {
+    (*((drain_ctx_t *)context)->count)[bit]++;
+    return true;
+}
+
+TEST(std_atomic_bitmap_test, concurrent_drain)
+{
+    const int len = 4096, threads = 4, rounds = 200;
+    std_atomic_bitmap_t bm;
+    ASSERT_EQ(std_atomic_bitmap_init(&bm, len), STD_ERR_OK);
+
+    /* each setter owns bits ix % threads == t, and counts the ones it made 0 -> 1 */
+    std::vector<int> made(len, 0), drained(len, 0);
+    std::atomic<int> running(threads);
+    std::vector<std::thread> th;
+    for (int t = 0; t < threads; ++t) {
+        th.push_back(std::thread([&, t]() {
+            for (int r = 0; r < rounds; ++r) {
+                for (int ix = t; ix < len; ix += threads) {
+                    if (!std_atomic_bitmap_test_and_set(&bm, ix)) made[ix]++;
+                }
+            }
+            running--;
+        }));
+    }
+    drain_ctx_t ctx = { &drained };
+    while (running > 0) std_atomic_bitmap_drain(&bm, count_bit, &ctx);
+    for (size_t ix = 0; ix < th.size(); ++ix) th[ix].join();
+    std_atomic_bitmap_drain(&bm, count_bit, &ctx);
+
+    /* every bit set was drained exactly once */
+    for (int ix = 0; ix < len; ++ix) ASSERT_EQ(made[ix], drained[ix]);
+    ASSERT_EQ(std_atomic_bitmap_find_first(&bm, 0), -1);
+    std_atomic_bitmap_destroy(&bm);
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -26,6 +26,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <vector>
 
 #include "gtest/gtest.h"
 
@@ -114,6 +115,152 @@ TEST(std_bit_masks, macros){
 
 
 
+static bool count_visit(void *context, size_t bit) {
+    std::vector<size_t> *v = (std::vector<size_t> *)context;
+    v->push_back(bit);
+    return true;
+}
+
+TEST(std_bit_masks, scan){
+    size_t lens[] = { 1, 63, 64, 100, 4096, 65536 + 13 };
+    for (size_t l = 0; l < sizeof(lens) / sizeof(*lens); ++l) {
+        size_t len = lens[l];
+        /* sparse and dense, the padding bits past len set */
+        for (int density = 0; density < 3; ++density) {
+            uint8_t *a = (uint8_t *)std_bitmap_create_array(len);
+            srand(len + density);
+            for (size_t ix = 0; ix < len; ++ix) {
+                bool set = (density == 0) ? (rand() % 1000 == 0) :
+                           (density == 1) ? (rand() % 2 == 0) : (rand() % 1000 != 0);
+                if (!set) STD_BIT_ARRAY_CLR(a, ix);
+            }
+
+            std::vector<size_t> ones;
+            for (size_t ix = 0; ix < len; ++ix)
+                if (STD_BIT_ARRAY_TEST(a, ix)) ones.push_back(ix);
+
+            for (size_t from = 0; from < len; from += (len > 200 ? 97 : 1)) {
+                int first = -1, zero = -1, last = -1;
+                for (size_t ix = from; ix < len && first < 0; ++ix)
+                    if (STD_BIT_ARRAY_TEST(a, ix)) first = ix;
+                for (size_t ix = from; ix < len && zero < 0; ++ix)
+                    if (!STD_BIT_ARRAY_TEST(a, ix)) zero = ix;
+                for (size_t ix = len - from; ix > 0 && last < 0; --ix)
+                    if (STD_BIT_ARRAY_TEST(a, ix - 1)) last = ix - 1;
+                ASSERT_EQ(std_find_first_bit(a, len, from), first);
+                ASSERT_EQ(std_find_next_zero_bit(a, len, from), zero);
+                ASSERT_EQ(std_find_last_bit(a, len, from), last);
+
+                size_t to = from + (len - from) / 3 + 1, cnt = 0;
+                for (size_t ix = from; ix < to; ++ix) cnt += STD_BIT_ARRAY_TEST(a, ix);
+                ASSERT_EQ(std_count_bits(a, from, to), cnt);
+            }
+
+            std::vector<size_t> seen;
+            ASSERT_EQ(std_for_each_bit(a, len, count_visit, &seen), ones.size());
+            ASSERT_TRUE(seen == ones);
+            int bit;
+            seen.clear();
+            STD_BIT_ARRAY_FOR_EACH(a, len, bit) seen.push_back(bit);
+            ASSERT_TRUE(seen == ones);
+            std_bitmaparray_free_data(a);
+        }
+    }
+}
+
+TEST(std_bit_masks, scan_partial_word){
+    /* the search runs off the end inside the last, partial word */
+    size_t len = 100;
+    uint8_t *a = (uint8_t *)std_bitmap_create_array_clear_bits(len);
+    ASSERT_EQ(std_find_first_bit(a, len, 0), -1);
+    ASSERT_EQ(std_find_first_bit(a, len, 70), -1);
+    STD_BIT_ARRAY_SET(a, len - 1);
+    ASSERT_EQ(std_find_first_bit(a, len, 0), (int)len - 1);
+    memset(a, 0xff, STD_BYTES_FOR_BITS(len));
+    ASSERT_EQ(std_find_next_zero_bit(a, len, 0), -1);
+    std_bitmaparray_free_data(a);
+}
+
+static bool ref_op(bool a, bool b, std_bit_op_t op) {
+    switch (op) {
+    case STD_BIT_OP_AND: return a && b;
+    case STD_BIT_OP_OR: return a || b;
+    case STD_BIT_OP_XOR: return a != b;
+    default: return a && !b;
+    }
+}
+
+TEST(std_bit_masks, bulk){
+    size_t lens[] = { 1, 7, 8, 100, 4094, 4096 * 8 * 2 + 75 };
+    for (size_t l = 0; l < sizeof(lens) / sizeof(*lens); ++l) {
+        size_t len = lens[l];
+        const int num = 4;
+        uint8_t *src[num];
+        srand(len);
+        for (int s = 0; s < num; ++s) {
+            src[s] = (uint8_t *)std_bitmap_create_array(len);
+            for (size_t ix = 0; ix < len; ++ix)
+                if (rand() % 4 != 0) STD_BIT_ARRAY_CLR(src[s], ix);
+        }
+        uint8_t *dst = (uint8_t *)std_bitmap_create_array_clear_bits(len);
+        uint8_t *cpy = (uint8_t *)std_bitmap_create_array_clear_bits(len);
+
+        for (int o = STD_BIT_OP_AND; o <= STD_BIT_OP_ANDNOT; ++o) {
+            std_bit_op_t op = (std_bit_op_t)o;
+            std_bit_array_op(dst, src[0], src[1], len, op);
+            for (size_t ix = 0; ix < len; ++ix) {
+                ASSERT_EQ(STD_BIT_ARRAY_TEST(dst, ix),
+                          ref_op(STD_BIT_ARRAY_TEST(src[0], ix), STD_BIT_ARRAY_TEST(src[1], ix), op));
+            }
+            /* in place gives the same */
+            memcpy(cpy, src[0], STD_BYTES_FOR_BITS(len));
+            std_bit_array_op(cpy, cpy, src[1], len, op);
+            ASSERT_TRUE(std_bit_array_equal(cpy, dst, len));
+
+            std_bit_array_op_multi(dst, op, (const void * const *)src, num, len);
+            for (size_t ix = 0; ix < len; ++ix) {
+                bool r = STD_BIT_ARRAY_TEST(src[0], ix);
+                for (int s = 1; s < num; ++s) r = ref_op(r, STD_BIT_ARRAY_TEST(src[s], ix), op);
+                ASSERT_EQ(STD_BIT_ARRAY_TEST(dst, ix), r);
+            }
+        }
+
+        std_bit_array_and(dst, src[0], src[1], len);
+        ASSERT_TRUE(std_bit_array_subset(dst, src[0], len));
+        ASSERT_TRUE(std_bit_array_subset(dst, src[1], len));
+        ASSERT_EQ(std_bit_array_subset(src[0], dst, len), std_bit_array_equal(src[0], dst, len));
+        std_bit_array_andnot(dst, src[0], src[0], len);
+        ASSERT_TRUE(std_bit_array_is_empty(dst, len));
+
+        /* the bits past len do not count */
+        memcpy(cpy, src[2], STD_BYTES_FOR_BITS(len));
+        if (len % 8) {
+            cpy[len / 8] ^= 0x80;
+        }
+        ASSERT_TRUE(std_bit_array_equal(cpy, src[2], len));
+        STD_BIT_ARRAY_SET(cpy, len - 1);
+        STD_BIT_ARRAY_CLR(src[2], len - 1);
+        ASSERT_FALSE(std_bit_array_equal(cpy, src[2], len));
+        ASSERT_FALSE(std_bit_array_subset(cpy, src[2], len));
+        ASSERT_TRUE(std_bit_array_subset(src[2], cpy, len));
+
+        for (size_t from = 0; from < len; from += len / 5 + 1) {
+            size_t to = from + (len - from) / 2 + 1;
+            memset(dst, 0, STD_BYTES_FOR_BITS(len));
+            std_bit_array_set_range(dst, from, to);
+            ASSERT_EQ(std_count_bits(dst, 0, len), to - from);
+            ASSERT_EQ(std_find_first_bit(dst, len, 0), (int)from);
+            ASSERT_EQ(std_find_last_bit(dst, len, 0), (int)to - 1);
+            std_bit_array_clear_range(dst, from, to);
+            ASSERT_TRUE(std_bit_array_is_empty(dst, len));
+        }
+
+        for (int s = 0; s < num; ++s) std_bitmaparray_free_data(src[s]);
+        std_bitmaparray_free_data(dst);
+        std_bitmaparray_free_data(cpy);
+    }
+}
+
 int main(int argc, char **argv) {
   ::testing::InitGoogleTest(&argc, argv);
   return RUN_ALL_TESTS();
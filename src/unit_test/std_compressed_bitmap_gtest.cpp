@@ -0,0 +1,217 @@
+/*
+ * Copyright (c) 2016 Dell Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * THIS CODE IS PROVIDED ON AN *AS IS* BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT
+ * LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS
+ * FOR A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+ *
+ * See the Apache Version 2.0 License for specific language governing
+ * permissions and limitations under the License.
+ */
+
+
+/*
+ * filename: std_compressed_bitmap_gtest.cpp
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <iterator>
+#include <set>
+#include <vector>
+
+#include "std_compressed_bitmap.h"
+
+typedef std::set<uint32_t> ref_t;
+
+static bool collect(void *context, size_t bit) {
+    ((std::vector<uint32_t> *)context)->push_back(bit);
+    return true;
+}
+
+static void check(const std_cbitmap_t *bm, const ref_t &ref) {
+    ASSERT_EQ(std_cbitmap_cardinality(bm), ref.size());
+    std::vector<uint32_t> got;
+    ASSERT_EQ(std_cbitmap_for_each(bm, collect, &got), ref.size());
+    ASSERT_TRUE(std::equal(got.begin(), got.end(), ref.begin()));
+
+    uint32_t v = 0;
+    size_t n = 0;
+    for (bool found = std_cbitmap_find_next(bm, 0, &v); found;
+         found = (v != UINT32_MAX) && std_cbitmap_find_next(bm, v + 1, &v)) ++n;
+    ASSERT_EQ(n, ref.size());
+}
+
+/* values in clusters and runs across a few chunks, dense enough for bitmaps */
+static void fill(std_cbitmap_t *bm, ref_t &ref, unsigned int seed) {
+    srand(seed);
+    for (int ix = 0; ix < 20000; ++ix) {
+        uint32_t v = ((rand() % 4) << 16) | (rand() % ((ix & 1) ? 70000 : 3000));
+        ASSERT_EQ(std_cbitmap_set(bm, v), STD_ERR_OK);
+        ref.insert(v);
+    }
+    for (int ix = 0; ix < 30; ++ix) {
+        uint32_t first = rand() % (6 << 16), last = first + rand() % 3000;
+        ASSERT_EQ(std_cbitmap_set_range(bm, first, last), STD_ERR_OK);
+        for (uint32_t v = first; v <= last; ++v) ref.insert(v);
+    }
+}
+
+TEST(std_compressed_bitmap_test, set_clear)
+{
+    std_cbitmap_t bm;
+    ref_t ref;
+    std_cbitmap_init(&bm);
+    check(&bm, ref);
+
+    fill(&bm, ref, 1);
+    check(&bm, ref);
+
+    /* high values and a range across chunks */
+    ASSERT_EQ(std_cbitmap_set(&bm, UINT32_MAX), STD_ERR_OK);
+    ASSERT_EQ(std_cbitmap_set_range(&bm, 0x7fff0, 0x90010), STD_ERR_OK);
+    ASSERT_NE(std_cbitmap_set_range(&bm, 5, 4), STD_ERR_OK);
+    ref.insert(UINT32_MAX);
+    for (uint32_t v = 0x7fff0; v <= 0x90010; ++v) ref.insert(v);
+    check(&bm, ref);
+
+    /* clear from every form, splitting runs */
+    srand(2);
+    for (int ix = 0; ix < 40000; ++ix) {
+        uint32_t v = (ix & 1) ? 0x80000 + rand() % 0x10000 : rand() % (4 << 16);
+        ASSERT_EQ(std_cbitmap_clear(&bm, v), STD_ERR_OK);
+        ref.erase(v);
+    }
+    check(&bm, ref);
+
+    srand(3);
+    for (int ix = 0; ix < 100000; ++ix) {
+        uint32_t v = rand() % (10 << 16);
+        ASSERT_EQ(std_cbitmap_test(&bm, v), ref.count(v) == 1);
+    }
+    for (int ix = 0; ix < 1000; ++ix) {
+        uint32_t v = rand() % (10 << 16);
+        ASSERT_EQ(std_cbitmap_rank(&bm, v),
+                  (uint64_t)std::distance(ref.begin(), ref.upper_bound(v)));
+        uint32_t next = 0;
+        ref_t::iterator it = ref.lower_bound(v);
+        ASSERT_EQ(std_cbitmap_find_next(&bm, v, &next), it != ref.end());
+        if (it != ref.end()) {
+            ASSERT_EQ(next, *it);
+        }
+    }
+
+    for (ref_t::iterator it = ref.begin(); it != ref.end(); ++it) {
+        ASSERT_EQ(std_cbitmap_clear(&bm, *it), STD_ERR_OK);
+    }
+    ref.clear();
+    check(&bm, ref);
+    std_cbitmap_destroy(&bm);
+}
+
+TEST(std_compressed_bitmap_test, or_and)
+{
+    std_cbitmap_t a, b, c;
+    ref_t ra, rb, rc;
+    std_cbitmap_init(&a);
+    std_cbitmap_init(&b);
+    std_cbitmap_init(&c);
+    fill(&a, ra, 4);
+    fill(&b, rb, 5);
+    ASSERT_EQ(std_cbitmap_set_range(&b, 1 << 20, (1 << 20) + 100), STD_ERR_OK);
+    for (uint32_t v = 1 << 20; v <= (1 << 20) + 100; ++v) rb.insert(v);
+
+    ASSERT_EQ(std_cbitmap_and(&c, &a, &b), STD_ERR_OK);
+    std::set_intersection(ra.begin(), ra.end(), rb.begin(), rb.end(),
+                          std::inserter(rc, rc.begin()));
+    check(&c, rc);
+
+    rc.clear();
+    ASSERT_EQ(std_cbitmap_or(&c, &a, &b), STD_ERR_OK);
+    std::set_union(ra.begin(), ra.end(), rb.begin(), rb.end(), std::inserter(rc, rc.begin()));
+    check(&c, rc);
+
+    /* in place, with runs on both sides */
+    ASSERT_EQ(std_cbitmap_optimize(&a), STD_ERR_OK);
+    ASSERT_EQ(std_cbitmap_optimize(&b), STD_ERR_OK);
+    ASSERT_EQ(std_cbitmap_or(&a, &a, &b), STD_ERR_OK);
+    check(&a, rc);
+    ASSERT_EQ(std_cbitmap_and(&a, &a, &c), STD_ERR_OK);
+    check(&a, rc);
+
+    std_cbitmap_destroy(&a);
+    std_cbitmap_destroy(&b);
+    std_cbitmap_destroy(&c);
+}
+
+TEST(std_compressed_bitmap_test, optimize)
+{
+    std_cbitmap_t bm;
+    ref_t ref;
+    std_cbitmap_init(&bm);
+
+    /* long runs set value by value end up in bitmaps until optimized */
+    for (uint32_t v = 0; v < 200000; ++v) {
+        if ((v / 5000) % 2 == 0) {
+            ASSERT_EQ(std_cbitmap_set(&bm, v), STD_ERR_OK);
+            ref.insert(v);
+        }
+    }
+    size_t before = std_cbitmap_size_in_bytes(&bm);
+    ASSERT_EQ(std_cbitmap_optimize(&bm), STD_ERR_OK);
+    ASSERT_LT(std_cbitmap_size_in_bytes(&bm) * 100, before);
+    check(&bm, ref);
+
+    /* runs that break up too much go back to a bitmap */
+    for (uint32_t v = 0; v < 10000; v += 2) {
+        ASSERT_EQ(std_cbitmap_clear(&bm, v), STD_ERR_OK);
+        ref.erase(v);
+    }
+    check(&bm, ref);
+    ASSERT_EQ(std_cbitmap_optimize(&bm), STD_ERR_OK);
+    check(&bm, ref);
+    std_cbitmap_destroy(&bm);
+}
+
+TEST(std_compressed_bitmap_test, array)
+{
+    const size_t len = 300001;
+    std::vector<uint8_t> in(len / 8 + 1), out(len / 8 + 1);
+    srand(6);
+    for (size_t ix = 0; ix < len; ++ix) {
+        /* a sparse chunk, a dense chunk, runs */
+        bool set = (ix < 65536) ? rand() % 100 == 0 :
+                   (ix < 131072) ? rand() % 2 == 0 : (ix / 1000) % 3 == 0;
+        if (set) STD_BIT_ARRAY_SET(&in[0], ix);
+    }
+    std_cbitmap_t bm;
+    std_cbitmap_init(&bm);
+    ASSERT_EQ(std_cbitmap_from_array(&bm, &in[0], len), STD_ERR_OK);
+    ASSERT_EQ(std_cbitmap_cardinality(&bm), std_count_bits(&in[0], 0, len));
+    ASSERT_EQ(std_cbitmap_optimize(&bm), STD_ERR_OK);
+
+    memset(&out[0], 0xff, out.size());
+    std_cbitmap_to_array(&bm, &out[0], len);
+    ASSERT_EQ(memcmp(&in[0], &out[0], len / 8), 0);
+    for (size_t ix = len / 8 * 8; ix < len; ++ix) {
+        ASSERT_EQ(STD_BIT_ARRAY_TEST(&in[0], ix), STD_BIT_ARRAY_TEST(&out[0], ix));
+    }
+
+    /* values past the array are left out */
+    ASSERT_EQ(std_cbitmap_set(&bm, len + 10), STD_ERR_OK);
+    std_cbitmap_to_array(&bm, &out[0], len);
+    ASSERT_EQ(memcmp(&in[0], &out[0], len / 8), 0);
+    std_cbitmap_destroy(&bm);
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,194 @@
+/*
+ * Copyright (c) 2016 Dell Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * THIS CODE IS PROVIDED ON AN *AS IS* BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT
+ * LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS
+ * FOR A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+ *
+ * See the Apache Version 2.0 License for specific language governing
+ * permissions and limitations under the License.
+ */
+
+
+/*
+ * filename: std_crc32_gtest.cpp
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "gtest/gtest.h"
+#include <vector>
+
+extern "C" {
+#include "std_crc32.h"
+}
+
+/* one bit at a time, straight from the polynomial */
+static uint32_t crc_bitwise(uint32_t poly, uint32_t crc, const uint8_t *p, size_t size) {
+    crc = ~crc;
+    while (size--) {
+        crc ^= *p++;
+        for (int k = 0; k < 8; ++k) crc = (crc >> 1) ^ (poly & -(crc & 1));
+    }
+    return ~crc;
+}
+
+static uint32_t crc32_bitwise(uint32_t crc, const uint8_t *p, size_t size) {
+    return crc_bitwise(0xedb88320, crc, p, size);
+}
+
+static std::vector<uint8_t> random_buf(size_t size, unsigned int seed) {
+    std::vector<uint8_t> b(size + 1);
+    srand(seed);
+    for (size_t ix = 0; ix < size; ++ix) b[ix] = rand();
+    return b;
+}
+
+TEST(std_crc32_test, known)
+{
+    ASSERT_EQ(std_crc32(0, "123456789", 9), 0xcbf43926U);
+    ASSERT_EQ(std_crc32(0, "", 0), 0U);
+    ASSERT_EQ(std_crc32(0x1234, "", 0), 0x1234U);
+}
+
+TEST(std_crc32_test, lengths_and_alignment)
+{
+    std::vector<uint8_t> b = random_buf(4200, 1);
+    /* every length around the 8, 16 and 64 byte kernel boundaries, at every alignment */
+    for (size_t off = 0; off < 16; ++off) {
+        for (size_t len = 0; len + off < b.size() - 1; len += (len < 300) ? 1 : 97) {
+            ASSERT_EQ(std_crc32(0, &b[off], len), crc32_bitwise(0, &b[off], len))
+                << "off " << off << " len " << len;
+        }
+    }
+}
+
+TEST(std_crc32_test, streaming)
+{
+    std::vector<uint8_t> b = random_buf(100000, 2);
+    uint32_t whole = std_crc32(0, &b[0], b.size() - 1);
+    ASSERT_EQ(whole, crc32_bitwise(0, &b[0], b.size() - 1));
+
+    srand(3);
+    for (int t = 0; t < 20; ++t) {
+        uint32_t crc = 0;
+        for (size_t pos = 0; pos < b.size() - 1; ) {
+            size_t n = rand() % 5000;
+            if (n > b.size() - 1 - pos) n = b.size() - 1 - pos;
+            crc = std_crc32(crc, &b[pos], n);
+            pos += n;
+        }
+        ASSERT_EQ(crc, whole);
+    }
+}
+
+TEST(std_crc32_test, combine)
+{
+    std::vector<uint8_t> b = random_buf(5000, 4);
+    uint32_t whole = std_crc32(0, &b[0], 5000);
+    size_t cuts[] = { 0, 1, 7, 64, 2500, 4999, 5000 };
+    for (size_t ix = 0; ix < sizeof(cuts) / sizeof(*cuts); ++ix) {
+        size_t c = cuts[ix];
+        uint32_t a = std_crc32(0, &b[0], c), z = std_crc32(0, &b[c], 5000 - c);
+        ASSERT_EQ(std_crc32_combine(a, z, 5000 - c), whole);
+    }
+    /* doubling runs of zeros, checked directly while short */
+    std::vector<uint8_t> zeros(1 << 20);
+    uint32_t z = std_crc32(0, &zeros[0], 1 << 16);
+    uint64_t len = 1 << 16;
+    for ( ; len < zeros.size(); len *= 2) {
+        z = std_crc32_combine(z, z, len);
+        ASSERT_EQ(z, std_crc32(0, &zeros[0], 2 * len));
+    }
+    /* lengths past 4GB: combining is associative */
+    uint64_t l1 = 5ULL << 30, l2 = (9ULL << 30) + 3;
+    uint32_t x = 0x12345678, y = 0x9abcdef0;
+    ASSERT_EQ(std_crc32_combine(std_crc32_combine(z, x, l1), y, l2),
+              std_crc32_combine(z, std_crc32_combine(x, y, l2), l1 + l2));
+}
+
+TEST(std_crc32_test, parallel)
+{
+    std_thread_create_param_t param;
+    std_thread_init_struct(&param);
+    param.name = "crc";
+    std_thread_pool_handle_t pool;
+    ASSERT_EQ(std_thread_pool_create(&pool, &param, 3), STD_ERR_OK);
+
+    size_t sizes[] = { 0, 1000, (1 << 20) + 5, (21 << 20) + 17 };
+    for (size_t ix = 0; ix < sizeof(sizes) / sizeof(*sizes); ++ix) {
+        std::vector<uint8_t> b = random_buf(sizes[ix], ix);
+        ASSERT_EQ(std_crc32_parallel(pool, 0x55, &b[0], sizes[ix]), std_crc32(0x55, &b[0], sizes[ix]));
+        ASSERT_EQ(std_crc32_parallel(NULL, 0, &b[0], sizes[ix]), std_crc32(0, &b[0], sizes[ix]));
+    }
+
+    /* a mapped file and a pipe */
+    std::vector<uint8_t> b = random_buf(3 << 20, 9);
+    char name[] = "/tmp/std_crc32_XXXXXX";
+    int fd = mkstemp(name);
+    ASSERT_GE(fd, 0);
+    unlink(name);
+    ASSERT_EQ(write(fd, &b[0], 3 << 20), 3 << 20);
+    uint32_t crc;
+    ASSERT_EQ(lseek(fd, 0, SEEK_SET), 0);
+    ASSERT_EQ(std_crc32_fd(pool, fd, &crc), STD_ERR_OK);
+    ASSERT_EQ(crc, std_crc32(0, &b[0], 3 << 20));
+    ASSERT_EQ(lseek(fd, 0, SEEK_CUR), 3 << 20);
+
+    /* from the current offset, not page aligned */
+    ASSERT_EQ(lseek(fd, 12345, SEEK_SET), 12345);
+    ASSERT_EQ(std_crc32_fd(pool, fd, &crc), STD_ERR_OK);
+    ASSERT_EQ(crc, std_crc32(0, &b[12345], (3 << 20) - 12345));
+    ASSERT_EQ(std_crc32_fd(pool, fd, &crc), STD_ERR_OK);
+    ASSERT_EQ(crc, 0U);
+    close(fd);
+
+    int p[2];
+    ASSERT_EQ(pipe(p), 0);
+    ASSERT_EQ(write(p[1], &b[0], 60000), 60000);
+    close(p[1]);
+    ASSERT_EQ(std_crc32_fd(pool, p[0], &crc), STD_ERR_OK);
+    ASSERT_EQ(crc, std_crc32(0, &b[0], 60000));
+    close(p[0]);
+
+    std_thread_pool_delete(pool);
+}
+
+TEST(std_crc32_test, crc32c)
+{
+    ASSERT_EQ(std_crc32c(0, "123456789", 9), 0xe3069283U);
+    ASSERT_EQ(std_crc32c(0, "", 0), 0U);
+
+    /* past the 3 x 256 and 3 x 8192 interleaved blocks, at every alignment */
+    std::vector<uint8_t> b = random_buf(60000, 5);
+    for (size_t off = 0; off < 9; ++off) {
+        for (size_t len = 0; len + off < b.size() - 1; len += (len < 1000) ? 1 : 331) {
+            ASSERT_EQ(std_crc32c(0, &b[off], len), crc_bitwise(0x82f63b78, 0, &b[off], len))
+                << "off " << off << " len " << len;
+        }
+    }
+
+    uint32_t whole = std_crc32c(0, &b[0], 60000);
+    srand(6);
+    for (int t = 0; t < 20; ++t) {
+        size_t cut = rand() % 60001;
+        uint32_t a = std_crc32c(0, &b[0], cut);
+        ASSERT_EQ(std_crc32c(a, &b[cut], 60000 - cut), whole);
+        ASSERT_EQ(std_crc32c_combine(a, std_crc32c(0, &b[cut], 60000 - cut), 60000 - cut), whole);
+    }
+    /* not the same as the IEEE one */
+    ASSERT_NE(std_crc32_combine(std_crc32c(0, &b[0], 100), std_crc32c(0, &b[100], 100), 100),
+              std_crc32c(0, &b[0], 200));
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
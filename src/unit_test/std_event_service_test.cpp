@@ -26,13 +26,19 @@
 
 
 #include "std_event_service.h"
+#include "private/std_event_ring.h"
+#include "private/std_event_utils.h"
+#include "std_socket_service.h"
 #include <std_time_tools.h>
 
 #include <stdio.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
 #include <stdlib.h>
 #include <string.h>
 #include <pthread.h>
+#include <vector>
 #include "gtest/gtest.h"
 
 std_event_server_handle_t handle;
@@ -216,6 +222,460 @@ bool create_service(void *param) {
     return true;
 }
 
+#define SHM_CHANNEL "/tmp/event_channel_shm"
+#define SHM_EVENTS (20000)
+
+static void shm_event_key(std_event_key_t *key) {
+    key->len = 2;
+    key->event_key[0] = 7;
+    key->event_key[1] = 8;
+}
+
+/* sequence number first, then bytes from it; every 1000th is larger than a ring */
+static size_t shm_event_data(uint32_t seq, uint8_t *data) {
+    size_t len = (seq % 1000 == 999) ? 10000 : sizeof(seq) + seq % 300;
+    memcpy(data, &seq, sizeof(seq));
+    for (size_t ix = sizeof(seq); ix < len; ++ix) data[ix] = (uint8_t)(seq + ix);
+    return len;
+}
+
+static void *shm_publisher(void *p) {
+    std_event_client_handle pub;
+    if (std_server_client_connect_shm(&pub, SHM_CHANNEL, 4096) != STD_ERR_OK) return NULL;
+    std_event_key_t key;
+    shm_event_key(&key);
+    static uint8_t data[10000];
+    for (uint32_t seq = 1; seq <= SHM_EVENTS; ++seq) {
+        if (std_client_publish_msg_data(pub, &key, data, shm_event_data(seq, data)) != STD_ERR_OK) {
+            break;
+        }
+    }
+    std_server_client_disconnect(pub);
+    return NULL;
+}
+
+/* the subscriber publishes an event of its own to know it is registered */
+static void shm_sync(std_event_client_handle h, std_event_msg_buff_t buff) {
+    std_event_key_t key;
+    shm_event_key(&key);
+    ASSERT_EQ(std_client_register_interest(h, &key, 1), STD_ERR_OK);
+    uint32_t seq = 0;
+    ASSERT_EQ(std_client_publish_msg_data(h, &key, &seq, sizeof(seq)), STD_ERR_OK);
+    ASSERT_EQ(std_client_wait_for_event(h, buff), STD_ERR_OK);
+    ASSERT_EQ(std_event_msg_from_buff(buff)->data_len, sizeof(seq));
+}
+
+TEST(std_event_service_test, shm_rings)
+{
+    std_event_server_handle_t serv;
+    ASSERT_EQ(std_event_server_init(&serv, SHM_CHANNEL, 4), STD_ERR_OK);
+    /* the rings are small, the subscribers catch up */
+    ASSERT_EQ(std_event_server_set_queue_policy(serv, STD_EVENT_QUEUE_BLOCK, 0), STD_ERR_OK);
+
+    /* one subscriber through rings, one through the socket */
+    std_event_client_handle sub, sock_sub;
+    ASSERT_EQ(std_server_client_connect_shm(&sub, SHM_CHANNEL, 4096), STD_ERR_OK);
+    ASSERT_EQ(std_server_client_connect(&sock_sub, SHM_CHANNEL), STD_ERR_OK);
+
+    std_event_msg_buff_t buff = std_client_allocate_msg_buff(100, false);
+    shm_sync(sub, buff);
+    shm_sync(sock_sub, buff);
+    /* the socket subscriber's own event, sent to both */
+    ASSERT_EQ(std_client_wait_for_event(sub, buff), STD_ERR_OK);
+
+    pthread_t id;
+    pthread_create(&id, NULL, shm_publisher, NULL);
+
+    /* the socket path counts the event header against the buffer length */
+    static uint8_t want[10000], got[10000 + sizeof(std_event_msg_t)];
+    for (uint32_t seq = 1; seq <= SHM_EVENTS; ++seq) {
+        size_t len = shm_event_data(seq, want);
+
+        ASSERT_EQ(std_client_wait_for_event(sub, buff), STD_ERR_OK);
+        std_event_msg_t *msg = std_event_msg_from_buff(buff);
+        ASSERT_EQ(msg->data_len, len);
+        ASSERT_EQ(memcmp(std_event_get_data(msg), want, len), 0);
+
+        std_event_msg_t hdr;
+        ASSERT_EQ(std_client_wait_for_event_data(sock_sub, &hdr, got, sizeof(got)), STD_ERR_OK);
+        ASSERT_EQ(hdr.data_len, len);
+        ASSERT_EQ(memcmp(got, want, len), 0);
+    }
+    pthread_join(id, NULL);
+
+    std_client_free_msg_buff(&buff);
+    std_server_client_disconnect(sub);
+    std_server_client_disconnect(sock_sub);
+}
+
+TEST(std_event_service_test, shm_sealed)
+{
+    /* the client can not shrink the memory the service maps */
+    std_event_shm_t shm, mapped;
+    int fd;
+    ASSERT_EQ(std_event_shm_create(4096, &shm, &fd), STD_ERR_OK);
+    ASSERT_NE(ftruncate(fd, 4096), 0);
+    ASSERT_EQ(std_event_shm_map(fd, 4096, &mapped), STD_ERR_OK);
+    std_event_shm_unmap(&mapped);
+    std_event_shm_unmap(&shm);
+    close(fd);
+
+    /* and the service only maps memory that is sealed */
+    fd = memfd_create("unsealed", MFD_CLOEXEC);
+    ASSERT_GE(fd, 0);
+    ASSERT_EQ(ftruncate(fd, 2 * (STD_EVENT_RING_HDR_LEN + 4096)), 0);
+    ASSERT_NE(std_event_shm_map(fd, 4096, &mapped), STD_ERR_OK);
+    close(fd);
+}
+
+#define QUEUE_CHANNEL "/tmp/event_channel_queue"
+#define QUEUE_SHM_CHANNEL "/tmp/event_channel_queue_shm"
+#define QUEUE_EVENTS (4000)
+
+typedef struct {
+    const char *channel;
+    uint32_t first;
+} queue_publish_t;
+
+static void *queue_publisher(void *p) {
+    queue_publish_t *q = (queue_publish_t *)p;
+    std_event_client_handle pub;
+    if (std_server_client_connect(&pub, q->channel) != STD_ERR_OK) return NULL;
+    std_event_key_t key;
+    shm_event_key(&key);
+    uint8_t data[1000];
+    uint32_t first = q->first;
+    for (uint32_t seq = first; seq < first + QUEUE_EVENTS; ++seq) {
+        memcpy(data, &seq, sizeof(seq));
+        if (std_client_publish_msg_data(pub, &key, data, sizeof(data)) != STD_ERR_OK) break;
+    }
+    std_server_client_disconnect(pub);
+    return NULL;
+}
+
+/* the fast subscriber gets every event, however far behind the slow one is */
+static void queue_fast_sub(std_event_client_handle h, std_event_msg_buff_t buff, uint32_t first) {
+    for (uint32_t seq = first; seq < first + QUEUE_EVENTS; ++seq) {
+        ASSERT_EQ(std_client_wait_for_event(h, buff), STD_ERR_OK);
+        ASSERT_EQ(*(uint32_t *)std_event_get_data(std_event_msg_from_buff(buff)), seq);
+    }
+}
+
+TEST(std_event_service_test, send_queues)
+{
+    std_event_server_handle_t serv;
+    ASSERT_EQ(std_event_server_init(&serv, QUEUE_CHANNEL, 4), STD_ERR_OK);
+    ASSERT_EQ(std_event_server_set_queue_policy(serv, STD_EVENT_QUEUE_DROP_OLDEST, 64*1024),
+            STD_ERR_OK);
+
+    std_event_client_handle fast, slow;
+    ASSERT_EQ(std_server_client_connect(&fast, QUEUE_CHANNEL), STD_ERR_OK);
+    ASSERT_EQ(std_server_client_connect(&slow, QUEUE_CHANNEL), STD_ERR_OK);
+    /* the least the service's socket buffer can be, to fill it up */
+    ASSERT_EQ(std_client_set_receive_buffer(slow, 0), STD_ERR_OK);
+    std_event_msg_buff_t buff = std_client_allocate_msg_buff(2000, false);
+    shm_sync(fast, buff);
+    shm_sync(slow, buff);
+    ASSERT_EQ(std_client_wait_for_event(fast, buff), STD_ERR_OK);
+
+    /* the slow subscriber reads nothing while the events are published */
+    pthread_t id;
+    queue_publish_t q = { QUEUE_CHANNEL, 1 };
+    pthread_create(&id, NULL, queue_publisher, &q);
+    queue_fast_sub(fast, buff, q.first);
+    pthread_join(id, NULL);
+
+    std_event_server_stats_t stats;
+    ASSERT_EQ(std_event_server_get_stats(serv, &stats), STD_ERR_OK);
+    ASSERT_GT(stats.events_queued, 0);
+    ASSERT_GT(stats.events_dropped, 0);
+    ASSERT_GT(stats.queue_max_depth, 0);
+    ASSERT_LE(stats.queue_bytes, 64*1024 + 2000);
+    ASSERT_EQ(stats.clients_closed, 0);
+
+    /* then gets the events that were not dropped, in order, up to the last one */
+    uint32_t prev = 0, got = 0;
+    while (prev != QUEUE_EVENTS) {
+        ASSERT_EQ(std_client_wait_for_event(slow, buff), STD_ERR_OK);
+        uint32_t seq = *(uint32_t *)std_event_get_data(std_event_msg_from_buff(buff));
+        ASSERT_GT(seq, prev);
+        prev = seq;
+        ++got;
+    }
+    ASSERT_LT(got, QUEUE_EVENTS);
+    ASSERT_EQ(std_event_server_get_stats(serv, &stats), STD_ERR_OK);
+    ASSERT_EQ(stats.queue_depth, 0);
+    ASSERT_EQ(stats.queue_bytes, 0);
+
+    /* a subscriber that does not keep up is closed */
+    ASSERT_EQ(std_event_server_set_queue_policy(serv, STD_EVENT_QUEUE_DISCONNECT, 64*1024),
+            STD_ERR_OK);
+    q.first = QUEUE_EVENTS + 1;
+    pthread_create(&id, NULL, queue_publisher, &q);
+    queue_fast_sub(fast, buff, q.first);
+    pthread_join(id, NULL);
+    while (std_client_wait_for_event(slow, buff) == STD_ERR_OK) ;
+    ASSERT_EQ(std_event_server_get_stats(serv, &stats), STD_ERR_OK);
+    ASSERT_EQ(stats.clients_closed, 1);
+
+    std_client_free_msg_buff(&buff);
+    std_server_client_disconnect(fast);
+    std_server_client_disconnect(slow);
+}
+
+TEST(std_event_service_test, shm_queues)
+{
+    std_event_server_handle_t serv;
+    ASSERT_EQ(std_event_server_init(&serv, QUEUE_SHM_CHANNEL, 4), STD_ERR_OK);
+    ASSERT_EQ(std_event_server_set_queue_policy(serv, STD_EVENT_QUEUE_DROP_OLDEST, 64*1024),
+            STD_ERR_OK);
+
+    /* a full ring does not hold up the subscriber on the socket */
+    std_event_client_handle fast, slow;
+    ASSERT_EQ(std_server_client_connect(&fast, QUEUE_SHM_CHANNEL), STD_ERR_OK);
+    ASSERT_EQ(std_server_client_connect_shm(&slow, QUEUE_SHM_CHANNEL, 4096), STD_ERR_OK);
+    std_event_msg_buff_t buff = std_client_allocate_msg_buff(2000, false);
+    shm_sync(fast, buff);
+    shm_sync(slow, buff);
+    ASSERT_EQ(std_client_wait_for_event(fast, buff), STD_ERR_OK);
+
+    pthread_t id;
+    queue_publish_t q = { QUEUE_SHM_CHANNEL, 1 };
+    pthread_create(&id, NULL, queue_publisher, &q);
+    queue_fast_sub(fast, buff, q.first);
+    pthread_join(id, NULL);
+
+    std_event_server_stats_t stats;
+    ASSERT_EQ(std_event_server_get_stats(serv, &stats), STD_ERR_OK);
+    ASSERT_GT(stats.events_queued, 0);
+    ASSERT_GT(stats.events_dropped, 0);
+    ASSERT_EQ(stats.publisher_waits, 0);
+    ASSERT_EQ(stats.clients_closed, 0);
+
+    /* what is queued goes to the ring as the subscriber makes room, in order */
+    uint32_t prev = 0;
+    while (prev != QUEUE_EVENTS) {
+        ASSERT_EQ(std_client_wait_for_event(slow, buff), STD_ERR_OK);
+        uint32_t seq = *(uint32_t *)std_event_get_data(std_event_msg_from_buff(buff));
+        ASSERT_GT(seq, prev);
+        prev = seq;
+    }
+    ASSERT_EQ(std_event_server_get_stats(serv, &stats), STD_ERR_OK);
+    ASSERT_EQ(stats.queue_depth, 0);
+    ASSERT_EQ(stats.queue_bytes, 0);
+
+    std_client_free_msg_buff(&buff);
+    std_server_client_disconnect(fast);
+    std_server_client_disconnect(slow);
+}
+
+#define BATCH_CHANNEL "/tmp/event_channel_batch"
+#define BATCH_EVENTS (5000)
+#define BATCH_LARGE (300000)
+
+/* odd lengths, and now and then an event larger than a batch frame */
+static size_t batch_event(uint32_t seq, std_event_msg_t *msg) {
+    shm_event_key(&msg->key);
+    msg->data_len = (seq % 1000 == 500) ? BATCH_LARGE : sizeof(seq) + seq % 7;
+    uint8_t *data = (uint8_t *)std_event_get_data(msg);
+    memcpy(data, &seq, sizeof(seq));
+    for (size_t ix = sizeof(seq); ix < msg->data_len; ++ix) data[ix] = (uint8_t)(seq + ix);
+    return sizeof(*msg) + msg->data_len;
+}
+
+static void *batch_publisher(void *p) {
+    std_event_client_handle pub;
+    if (std_server_client_connect(&pub, BATCH_CHANNEL) != STD_ERR_OK) return NULL;
+    std::vector<uint8_t> buff;
+    std::vector<std_event_msg_t *> msgs;
+    for (uint32_t seq = 1; seq <= BATCH_EVENTS; ) {
+        std::vector<size_t> offs;
+        buff.clear();
+        for (size_t ix = 0; ix < 100; ++ix, ++seq) {
+            offs.push_back(buff.size());
+            buff.resize(buff.size() + sizeof(std_event_msg_t) + BATCH_LARGE + 4);
+            buff.resize(offs.back() + batch_event(seq, (std_event_msg_t *)&buff[offs.back()]));
+            buff.resize((buff.size() + 3) & ~3);
+        }
+        msgs.clear();
+        for (size_t ix = 0; ix < offs.size(); ++ix) msgs.push_back((std_event_msg_t *)&buff[offs[ix]]);
+        if (std_client_publish_msg_batch(pub, &msgs[0], msgs.size()) != STD_ERR_OK) break;
+    }
+    std_server_client_disconnect(pub);
+    return NULL;
+}
+
+/* gets the events in order, more than one at a time */
+static void batch_receive(std_event_client_handle h) {
+    std_event_batch_buff_t buff = std_client_allocate_batch_buff(4096);
+    ASSERT_TRUE(buff != NULL);
+    std::vector<uint8_t> want(sizeof(std_event_msg_t) + BATCH_LARGE);
+    uint32_t seq = 1;
+    size_t calls = 0;
+    while (seq <= BATCH_EVENTS) {
+        ASSERT_EQ(std_client_wait_for_events(h, buff), STD_ERR_OK);
+        ++calls;
+        std_event_msg_t *msg;
+        while ((msg = std_event_batch_next(buff)) != NULL) {
+            std_event_msg_t *w = (std_event_msg_t *)&want[0];
+            batch_event(seq++, w);
+            ASSERT_EQ(msg->data_len, w->data_len);
+            ASSERT_EQ(memcmp(msg, w, sizeof(*msg) + msg->data_len), 0);
+        }
+    }
+    ASSERT_LT(calls, BATCH_EVENTS);
+    std_client_free_batch_buff(&buff);
+}
+
+TEST(std_event_service_test, batches)
+{
+    std_event_server_handle_t serv;
+    ASSERT_EQ(std_event_server_init(&serv, BATCH_CHANNEL, 4), STD_ERR_OK);
+
+    std_event_client_handle sub, shm_sub;
+    ASSERT_EQ(std_server_client_connect(&sub, BATCH_CHANNEL), STD_ERR_OK);
+    ASSERT_EQ(std_server_client_connect_shm(&shm_sub, BATCH_CHANNEL, 0), STD_ERR_OK);
+    std_event_msg_buff_t buff = std_client_allocate_msg_buff(100, false);
+    shm_sync(sub, buff);
+    shm_sync(shm_sub, buff);
+    ASSERT_EQ(std_client_wait_for_event(sub, buff), STD_ERR_OK);
+    std_client_free_msg_buff(&buff);
+
+    pthread_t id;
+    pthread_create(&id, NULL, batch_publisher, NULL);
+    batch_receive(sub);
+    batch_receive(shm_sub);
+    pthread_join(id, NULL);
+
+    std_server_client_disconnect(sub);
+    std_server_client_disconnect(shm_sub);
+}
+
+#define SHORT_CHANNEL "/tmp/event_channel_short"
+
+static void short_event(uint32_t seq, std_event_msg_t *msg) {
+    shm_event_key(&msg->key);
+    msg->data_len = sizeof(seq);
+    memcpy(std_event_get_data(msg), &seq, sizeof(seq));
+}
+
+TEST(std_event_service_test, short_batch)
+{
+    /* a batch of fewer events than it counts is not filled from the one before it */
+    std_event_server_handle_t serv;
+    ASSERT_EQ(std_event_server_init(&serv, SHORT_CHANNEL, 4), STD_ERR_OK);
+
+    std_event_client_handle sub, pub, pub2;
+    ASSERT_EQ(std_server_client_connect(&sub, SHORT_CHANNEL), STD_ERR_OK);
+    std_event_msg_buff_t buff = std_client_allocate_msg_buff(100, false);
+    shm_sync(sub, buff);
+
+    const size_t ev_len = STD_EVENT_BATCH_ALIGN(sizeof(std_event_msg_t) + sizeof(uint32_t));
+    std::vector<uint8_t> events(2 * ev_len);
+    std_event_msg_t *msgs[2] = { (std_event_msg_t *)&events[0], (std_event_msg_t *)&events[ev_len] };
+    short_event(1, msgs[0]);
+    short_event(2, msgs[1]);
+    ASSERT_EQ(std_server_client_connect(&pub, SHORT_CHANNEL), STD_ERR_OK);
+    ASSERT_EQ(std_client_publish_msg_batch(pub, msgs, 2), STD_ERR_OK);
+
+    /* counts two events but carries one */
+    std::vector<uint8_t> frame(sizeof(uint32_t) + ev_len);
+    uint32_t count = 2;
+    memcpy(&frame[0], &count, sizeof(count));
+    short_event(3, (std_event_msg_t *)&frame[sizeof(count)]);
+    event_serv_msg_t m;
+    m.op = event_serv_msg_t_PUBLISH_BATCH;
+    std_event_msg_descr_t d;
+    d.data = &frame[0];
+    d.len = frame.size();
+    ASSERT_EQ(std_event_util_event_send(pub, &m, &d, 1, 1000), STD_ERR_OK);
+
+    /* the service drops the publisher, then the next event comes from another */
+    struct timeval tv = { 2, 0 };
+    fd_set rset;
+    FD_ZERO(&rset);
+    FD_SET(pub, &rset);
+    select(pub + 1, &rset, NULL, NULL, &tv);
+    ASSERT_EQ(std_server_client_connect(&pub2, SHORT_CHANNEL), STD_ERR_OK);
+    std_event_key_t key;
+    shm_event_key(&key);
+    uint32_t seq = 4;
+    ASSERT_EQ(std_client_publish_msg_data(pub2, &key, &seq, sizeof(seq)), STD_ERR_OK);
+
+    const uint32_t want[] = { 1, 2, 4 };
+    for (size_t ix = 0; ix < sizeof(want)/sizeof(*want); ++ix) {
+        ASSERT_EQ(std_client_wait_for_event(sub, buff), STD_ERR_OK);
+        std_event_msg_t *msg = std_event_msg_from_buff(buff);
+        ASSERT_EQ(msg->data_len, sizeof(seq));
+        ASSERT_EQ(*(uint32_t *)std_event_get_data(msg), want[ix]);
+    }
+    std_client_free_msg_buff(&buff);
+    std_server_client_disconnect(pub);
+    std_server_client_disconnect(pub2);
+    std_server_client_disconnect(sub);
+}
+
+#define CLOSE_CHANNEL "/tmp/event_channel_close"
+
+static std_socket_server_handle_t close_serv;
+static bool close_in_data = false;
+static bool close_writable_failed = false;
+static int close_del_calls = 0;
+static bool close_del_in_data = false;
+
+/* asks for a write and holds on to the client until the write has failed */
+static bool close_some_data(void *context, int fd) {
+    char b;
+    if (recv(fd, &b, sizeof(b), MSG_DONTWAIT) <= 0) return false;
+    __atomic_store_n(&close_in_data, true, __ATOMIC_SEQ_CST);
+    std_socket_service_client_want_write(close_serv, fd);
+    for (size_t ix = 0; ix < 1000 && !__atomic_load_n(&close_writable_failed, __ATOMIC_SEQ_CST); ++ix) usleep(1000);
+    usleep(100*1000);
+    __atomic_store_n(&close_in_data, false, __ATOMIC_SEQ_CST);
+    return true;
+}
+
+static bool close_writable(void *context, int fd) {
+    __atomic_store_n(&close_writable_failed, true, __ATOMIC_SEQ_CST);
+    return false;
+}
+
+static bool close_del_client(void *context, int fd) {
+    if (__atomic_load_n(&close_in_data, __ATOMIC_SEQ_CST)) {
+        __atomic_store_n(&close_del_in_data, true, __ATOMIC_SEQ_CST);
+    }
+    __atomic_add_fetch(&close_del_calls, 1, __ATOMIC_SEQ_CST);
+    return true;
+}
+
+TEST(std_event_service_test, writable_close)
+{
+    /* a failed write closes the client only once the data call is done with it */
+    std_socket_server_t init;
+    memset(&init, 0, sizeof(init));
+    init.name = "close_test";
+    init.thread_pool_size = 4;
+    init.address.type = e_std_sock_UNIX;
+    init.address.addr_type = e_std_socket_a_t_STRING;
+    strcpy(init.address.address.str, CLOSE_CHANNEL);
+    init.some_data = close_some_data;
+    init.del_client = close_del_client;
+    init.writable = close_writable;
+    ASSERT_EQ(std_socket_service_init(&close_serv, &init), STD_ERR_OK);
+    ASSERT_EQ(std_socket_service_run(close_serv), STD_ERR_OK);
+
+    int sock;
+    ASSERT_EQ(std_sock_connect(&init.address, &sock), STD_ERR_OK);
+    char b = 0;
+    ASSERT_EQ(write(sock, &b, sizeof(b)), 1);
+    for (size_t ix = 0; ix < 2000 && __atomic_load_n(&close_del_calls, __ATOMIC_SEQ_CST) == 0; ++ix) usleep(1000);
+
+    ASSERT_TRUE(__atomic_load_n(&close_writable_failed, __ATOMIC_SEQ_CST));
+    ASSERT_EQ(__atomic_load_n(&close_del_calls, __ATOMIC_SEQ_CST), 1);
+    ASSERT_FALSE(__atomic_load_n(&close_del_in_data, __ATOMIC_SEQ_CST));
+    close(sock);
+}
+
 TEST(std_cfg_file_test, FileClose)
 {
     ASSERT_TRUE(create_service(NULL));
@@ -0,0 +1,143 @@
+/*
+ * Copyright (c) 2016 Dell Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * THIS CODE IS PROVIDED ON AN *AS IS* BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT
+ * LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS
+ * FOR A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+ *
+ * See the Apache Version 2.0 License for specific language governing
+ * permissions and limitations under the License.
+ */
+
+/*
+ * filename: std_hash_gtest.cpp
+ */
+
+#include <stdio.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdlib.h>
+#include "gtest/gtest.h"
+
+#include "std_hash.h"
+
+typedef struct mac_entry_s {
+    uint32_t ifindex;
+    uint8_t mac[6];
+    uint16_t vlan;
+} mac_entry_t;
+
+static int walk_cb(std_hash_handle h, void *data, va_list ap) {
+    size_t *cnt = va_arg(ap, size_t *);
+    (*cnt)++;
+    return 0;
+}
+
+TEST(std_hash_test, insert_find_remove)
+{
+    const size_t n = 50000;
+    mac_entry_t *e = (mac_entry_t *)calloc(n, sizeof(*e));
+    std_hash_handle h = std_hash_create_simple((char *)"mac", offsetof(mac_entry_t, mac), 6);
+    ASSERT_TRUE(h != NULL);
+
+    for (size_t ix = 0; ix < n; ++ix) {
+        e[ix].ifindex = ix;
+        e[ix].mac[0] = 0x00;
+        e[ix].mac[1] = 0x50;
+        memcpy(&e[ix].mac[2], &ix, 4);
+        ASSERT_EQ(std_hash_insert(h, &e[ix]), STD_ERR_OK);
+        ASSERT_EQ(std_hash_getexact(h, &e[ix]), &e[ix]);
+    }
+    ASSERT_EQ(std_hash_count(h), n);
+
+    /* duplicate keys are refused */
+    mac_entry_t k = e[7];
+    ASSERT_NE(std_hash_insert(h, &k), STD_ERR_OK);
+
+    for (size_t ix = 0; ix < n; ++ix) {
+        memcpy(&k, &e[ix], sizeof(k));
+        ASSERT_EQ(std_hash_getexact(h, &k), &e[ix]);
+    }
+
+    for (size_t ix = 0; ix < n; ix += 2) {
+        ASSERT_EQ(std_hash_remove(h, &e[ix]), &e[ix]);
+        ASSERT_TRUE(std_hash_remove(h, &e[ix]) == NULL);
+    }
+    ASSERT_EQ(std_hash_count(h), n / 2);
+
+    for (size_t ix = 0; ix < n; ++ix) {
+        ASSERT_EQ(std_hash_getexact(h, &e[ix]) != NULL, (ix % 2) == 1);
+    }
+
+    size_t cnt = 0;
+    ASSERT_TRUE(std_hash_walk(h, walk_cb, &cnt) == NULL);
+    ASSERT_EQ(cnt, n / 2);
+
+    std_hash_destroy(h);
+    free(e);
+}
+
+TEST(std_hash_test, churn)
+{
+    /* constant size with continuous insert/remove exercises deleted markers */
+    const size_t n = 4096;
+    mac_entry_t *e = (mac_entry_t *)calloc(n, sizeof(*e));
+    std_hash_handle h = std_hash_create_simple((char *)"churn", offsetof(mac_entry_t, ifindex),
+            sizeof(uint32_t));
+    for (size_t ix = 0; ix < n; ++ix) e[ix].ifindex = ix;
+
+    for (size_t ix = 0; ix < 100; ++ix) {
+        ASSERT_EQ(std_hash_insert(h, &e[ix]), STD_ERR_OK);
+    }
+    for (size_t ix = 100; ix < n; ++ix) {
+        ASSERT_EQ(std_hash_remove(h, &e[ix - 100]), &e[ix - 100]);
+        ASSERT_EQ(std_hash_insert(h, &e[ix]), STD_ERR_OK);
+    }
+    ASSERT_EQ(std_hash_count(h), 100);
+    for (size_t ix = 0; ix < n; ++ix) {
+        ASSERT_EQ(std_hash_getexact(h, &e[ix]) != NULL, ix >= n - 100);
+    }
+    std_hash_destroy(h);
+    free(e);
+}
+
+/* few distinct home groups, so probe chains run through many groups */
+static uint64_t clustered_hash(std_hash_handle h, void *data) {
+    uint32_t ix = ((mac_entry_t *)data)->ifindex;
+    return ((uint64_t)(ix % 3) << 7) | (ix & 0x7f);
+}
+
+TEST(std_hash_test, lookup_during_resize)
+{
+    const size_t n = 2000;
+    mac_entry_t *e = (mac_entry_t *)calloc(n, sizeof(*e));
+    std_hash_handle h = std_hash_create((char *)"resize", offsetof(mac_entry_t, ifindex),
+            sizeof(uint32_t), NULL, NULL, NULL, clustered_hash);
+    for (size_t ix = 0; ix < n; ++ix) e[ix].ifindex = ix;
+
+    /* every insert moves a few groups, so each pass sees a part done migration */
+    for (size_t ix = 0; ix < n; ++ix) {
+        ASSERT_EQ(std_hash_insert(h, &e[ix]), STD_ERR_OK);
+        for (size_t jx = 0; jx <= ix; ++jx) {
+            ASSERT_EQ(std_hash_getexact(h, &e[jx]), &e[jx]) << "after insert " << ix;
+        }
+    }
+    for (size_t ix = 0; ix < n; ix += 3) {
+        ASSERT_EQ(std_hash_remove(h, &e[ix]), &e[ix]);
+    }
+    for (size_t ix = 0; ix < n; ++ix) {
+        ASSERT_EQ(std_hash_getexact(h, &e[ix]) != NULL, (ix % 3) != 0);
+    }
+    std_hash_destroy(h);
+    free(e);
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
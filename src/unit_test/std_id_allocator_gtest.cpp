@@ -0,0 +1,145 @@
+/*
+ * Copyright (c) 2016 Dell Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * THIS CODE IS PROVIDED ON AN *AS IS* BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT
+ * LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS
+ * FOR A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+ *
+ * See the Apache Version 2.0 License for specific language governing
+ * permissions and limitations under the License.
+ */
+
+/*
+ * filename: std_id_allocator_gtest.cpp
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "gtest/gtest.h"
+#include <set>
+#include <thread>
+#include <vector>
+
+#include "std_id_allocator.h"
+
+TEST(std_id_allocator_test, alloc)
+{
+    const uint32_t base = 1, n = 70000;
+    std_id_allocator_t *a;
+    ASSERT_EQ(std_id_allocator_create(&a, base, n, false), STD_ERR_OK);
+
+    /* the lowest free one every time, until none is left */
+    uint32_t id;
+    for (uint32_t ix = 0; ix < n; ++ix) {
+        ASSERT_EQ(std_id_allocator_alloc(a, &id), STD_ERR_OK);
+        ASSERT_EQ(id, base + ix);
+    }
+    ASSERT_NE(std_id_allocator_alloc(a, &id), STD_ERR_OK);
+    ASSERT_EQ(std_id_allocator_num_free(a), 0);
+
+    ASSERT_EQ(std_id_allocator_free(a, base + 12345), STD_ERR_OK);
+    ASSERT_NE(std_id_allocator_free(a, base + 12345), STD_ERR_OK);
+    ASSERT_EQ(std_id_allocator_free(a, base + 999), STD_ERR_OK);
+    ASSERT_FALSE(std_id_allocator_is_allocated(a, base + 999));
+    ASSERT_EQ(std_id_allocator_alloc(a, &id), STD_ERR_OK);
+    ASSERT_EQ(id, base + 999);
+    ASSERT_EQ(std_id_allocator_alloc(a, &id), STD_ERR_OK);
+    ASSERT_EQ(id, base + 12345);
+
+    ASSERT_NE(std_id_allocator_free(a, 0), STD_ERR_OK);
+    ASSERT_NE(std_id_allocator_free(a, base + n), STD_ERR_OK);
+    ASSERT_EQ(std_id_allocator_free_range(a, base, n), STD_ERR_OK);
+    ASSERT_EQ(std_id_allocator_num_free(a), n);
+
+    ASSERT_EQ(std_id_allocator_alloc_specific(a, base + 5), STD_ERR_OK);
+    ASSERT_NE(std_id_allocator_alloc_specific(a, base + 5), STD_ERR_OK);
+    ASSERT_TRUE(std_id_allocator_is_allocated(a, base + 5));
+
+    /* ranges skip the holes that are too short */
+    uint32_t first;
+    ASSERT_EQ(std_id_allocator_alloc_range(a, 4, &first), STD_ERR_OK);
+    ASSERT_EQ(first, base);
+    ASSERT_EQ(std_id_allocator_alloc_range(a, 1, &first), STD_ERR_OK);
+    ASSERT_EQ(first, base + 4);
+    ASSERT_EQ(std_id_allocator_reserve(a, base + 200, 100), STD_ERR_OK);
+    ASSERT_NE(std_id_allocator_reserve(a, base + 250, 100), STD_ERR_OK);
+    ASSERT_FALSE(std_id_allocator_is_allocated(a, base + 300));
+    ASSERT_EQ(std_id_allocator_alloc_range(a, 150, &first), STD_ERR_OK);
+    ASSERT_EQ(first, base + 6);
+    ASSERT_EQ(std_id_allocator_alloc_range(a, 190, &first), STD_ERR_OK);
+    ASSERT_EQ(first, base + 300);
+    ASSERT_NE(std_id_allocator_alloc_range(a, n, &first), STD_ERR_OK);
+    ASSERT_EQ(std_id_allocator_num_free(a), n - 6 - 190 - 100 - 150);
+    std_id_allocator_destroy(a);
+}
+
+TEST(std_id_allocator_test, random)
+{
+    const uint32_t n = 5000;
+    std_id_allocator_t *a;
+    ASSERT_EQ(std_id_allocator_create(&a, 0, n, false), STD_ERR_OK);
+    std::set<uint32_t> used;
+
+    srand(1);
+    for (int step = 0; step < 20000; ++step) {
+        uint32_t id;
+        if (rand() % 3 != 0) {
+            t_std_error rc = std_id_allocator_alloc(a, &id);
+            if (used.size() == n) {
+                ASSERT_NE(rc, STD_ERR_OK);
+                continue;
+            }
+            ASSERT_EQ(rc, STD_ERR_OK);
+            /* the lowest free one */
+            uint32_t lowest = 0;
+            while (used.count(lowest)) ++lowest;
+            ASSERT_EQ(id, lowest);
+            used.insert(id);
+        } else if (!used.empty()) {
+            std::set<uint32_t>::iterator it = used.begin();
+            std::advance(it, rand() % used.size());
+            ASSERT_EQ(std_id_allocator_free(a, *it), STD_ERR_OK);
+            used.erase(it);
+        }
+    }
+    ASSERT_EQ(std_id_allocator_num_free(a), n - used.size());
+    std_id_allocator_destroy(a);
+}
+
+TEST(std_id_allocator_test, thread_safe)
+{
+    const int threads = 4, per_thread = 20000;
+    std_id_allocator_t *a;
+    ASSERT_EQ(std_id_allocator_create(&a, 100, threads * per_thread, true), STD_ERR_OK);
+
+    std::vector<uint32_t> got[threads];
+    std::vector<std::thread> th;
+    for (int t = 0; t < threads; ++t) {
+        th.push_back(std::thread([&, t]() {
+            for (int ix = 0; ix < per_thread; ++ix) {
+                uint32_t id;
+                if (std_id_allocator_alloc(a, &id) == STD_ERR_OK) got[t].push_back(id);
+                /* give some back and take them again */
+                if (ix % 7 == 0 && std_id_allocator_free(a, id) == STD_ERR_OK &&
+                    std_id_allocator_alloc(a, &id) == STD_ERR_OK) got[t].back() = id;
+            }
+        }));
+    }
+    for (size_t ix = 0; ix < th.size(); ++ix) th[ix].join();
+
+    std::set<uint32_t> all;
+    for (int t = 0; t < threads; ++t) all.insert(got[t].begin(), got[t].end());
+    ASSERT_EQ(all.size(), (size_t)threads * per_thread);
+    ASSERT_EQ(std_id_allocator_num_free(a), 0);
+    std_id_allocator_destroy(a);
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -90,6 +90,120 @@ TEST(std_ll_test, SortedList)
 }
 
 
+typedef struct my_skip_s {
+        std_dll_skip lst;
+        uint32_t value;
+        int seq;
+} my_skip_;
+
+TEST(std_ll_test, SkipList)
+{
+        const int n = 20000;
+        std_dll_skip_head list;
+        my_skip_ *e = (my_skip_ *)calloc(n, sizeof(*e));
+        std_dll_init_skip(&list,std_compare_uint32_function,offsetof(my_skip_,value),sizeof(uint32_t));
+
+        srand(1);
+        for (int ix = 0; ix < n; ++ix) {
+                /* plenty of duplicates to check equal keys keep insertion order */
+                e[ix].value = (rand() % (n / 4)) * 2;
+                e[ix].seq = ix;
+                std_dll_insert(&list.dll,&e[ix].lst.dll);
+        }
+
+        int cnt = 0;
+        my_skip_ *walk = (my_skip_ *)std_dll_getfirst(&list.dll);
+        while (walk != NULL) {
+                ++cnt;
+                my_skip_ *next = (my_skip_ *)std_dll_getnext(&list.dll,(std_dll*)walk);
+                if (next == NULL) break;
+                ASSERT_LE(walk->value, next->value);
+                if (walk->value == next->value) ASSERT_LT(walk->seq, next->seq);
+                walk = next;
+        }
+        ASSERT_EQ(cnt, n);
+
+        for (uint32_t k = 0; k < (uint32_t)n / 2; ++k) {
+                my_skip_ *f = (my_skip_ *)std_dll_find(&list.dll,&k);
+                my_skip_ *prev = f ? (my_skip_ *)std_dll_getprev(&list.dll,(std_dll*)f) : NULL;
+                if (k & 1) ASSERT_TRUE(f == NULL);
+                if (f != NULL) {
+                        ASSERT_EQ(f->value, k);
+                        ASSERT_TRUE(prev == NULL || prev->value < k);
+                }
+                f = (my_skip_ *)std_dll_find_ge(&list.dll,&k);
+                ASSERT_TRUE(f == NULL || f->value >= k);
+                if (f != NULL && (prev = (my_skip_ *)std_dll_getprev(&list.dll,(std_dll*)f)))
+                        ASSERT_LT(prev->value, k);
+        }
+
+        /* remove every other element, the index must follow */
+        for (int ix = 0; ix < n; ix += 2) {
+                std_dll_remove(&list.dll,&e[ix].lst.dll);
+        }
+        for (int ix = 1; ix < n; ix += 2) {
+                my_skip_ *f = (my_skip_ *)std_dll_find(&list.dll,&e[ix].value);
+                ASSERT_TRUE(f != NULL);
+                ASSERT_EQ(f->value, e[ix].value);
+        }
+        for (int ix = 1; ix < n; ix += 2) {
+                std_dll_remove(&list.dll,&e[ix].lst.dll);
+        }
+        ASSERT_TRUE(std_dll_getfirst(&list.dll) == NULL);
+        ASSERT_EQ(list.skip_height, 0);
+        free(e);
+}
+
+
+typedef struct sort_s {
+        std_dll lst;
+        uint32_t key;
+        int seq;
+} sort_t;
+
+TEST(std_ll_test, Sort)
+{
+        int sizes[] = { 0, 1, 2, 3, 100, 1023, 1024, 50001 };
+        for (size_t s = 0; s < sizeof(sizes) / sizeof(*sizes); ++s) {
+                std_dll_head list;
+                int n = sizes[s];
+                sort_t *e = (sort_t *)calloc(n + 1, sizeof(*e));
+
+                std_dll_init_sort(&list,std_compare_uint32_function,offsetof(sort_t,key),sizeof(uint32_t));
+                srand(n);
+                for (int ix = 0; ix < n; ++ix) {
+                        e[ix].key = rand() % (n / 2 + 1);
+                        e[ix].seq = ix;
+                        std_dll_insertatback(&list, &e[ix].lst);
+                }
+                std_dll_sort(&list, NULL, 0, 0);
+
+                int count = 0;
+                sort_t *prev = NULL;
+                for (sort_t *walk = (sort_t *)std_dll_getfirst(&list); walk != NULL;
+                     walk = (sort_t *)std_dll_getnext(&list, &walk->lst)) {
+                        if (prev != NULL) {
+                                ASSERT_LE(prev->key, walk->key);
+                                if (prev->key == walk->key) {
+                                        ASSERT_LT(prev->seq, walk->seq);
+                                }
+                                ASSERT_EQ(std_dll_getprev(&list, &walk->lst), &prev->lst);
+                        }
+                        prev = walk;
+                        ++count;
+                }
+                ASSERT_EQ(count, n);
+                ASSERT_EQ(std_dll_getlast(&list), prev ? &prev->lst : NULL);
+
+                /* an explicit compare on another field */
+                std_dll_sort(&list, std_compare_binary_function, offsetof(sort_t,seq), sizeof(int));
+                if (n > 0) {
+                        ASSERT_EQ(((sort_t *)std_dll_getfirst(&list))->seq, 0);
+                }
+                free(e);
+        }
+}
+
 int main(int argc, char **argv) {
   ::testing::InitGoogleTest(&argc, argv);
   return RUN_ALL_TESTS();
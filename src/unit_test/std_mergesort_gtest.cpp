@@ -0,0 +1,268 @@
+/*
+ * Copyright (c) 2016 Dell Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * THIS CODE IS PROVIDED ON AN *AS IS* BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT
+ * LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS
+ * FOR A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+ *
+ * See the Apache Version 2.0 License for specific language governing
+ * permissions and limitations under the License.
+ */
+
+/*
+ * filename: std_mergesort_gtest.cpp
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "gtest/gtest.h"
+
+extern "C" {
+#include "std_mergesort.h"
+}
+#include "std_record_sort.h"
+
+typedef struct route_s {
+    uint32_t prefix;
+    uint32_t seq;
+} route_t;
+
+static int route_cmp(void *context, void *a, int ia, void *b, int ib) {
+    uint32_t ka = ((route_t *)a)[ia].prefix, kb = ((route_t *)b)[ib].prefix;
+    return (ka < kb) ? -1 : (ka > kb) ? 1 : 0;
+}
+
+static void route_copy(void *context, void *dst, int di, void *src, int si) {
+    ((route_t *)dst)[di] = ((route_t *)src)[si];
+}
+
+static void check_sorted(route_t *r, int n) {
+    for (int ix = 1; ix < n; ++ix) {
+        ASSERT_LE(r[ix - 1].prefix, r[ix].prefix);
+        /* stable: equal keys stay in their original order */
+        if (r[ix - 1].prefix == r[ix].prefix) {
+            ASSERT_LT(r[ix - 1].seq, r[ix].seq);
+        }
+    }
+}
+
+TEST(std_mergesort_test, parallel)
+{
+    std_thread_create_param_t param;
+    std_thread_init_struct(&param);
+    param.name = "msort";
+    std_thread_pool_handle_t pool;
+    ASSERT_EQ(std_thread_pool_create(&pool, &param, 7), STD_ERR_OK);
+
+    int sizes[] = { 0, 1, 100, 5000, 40000, 300001 };
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(*sizes); ++s) {
+        int n = sizes[s];
+        route_t *r = (route_t *)malloc((n + 1) * sizeof(*r));
+        route_t *tmp = (route_t *)malloc((n + 1) * sizeof(*tmp));
+        route_t *ref = (route_t *)malloc((n + 1) * sizeof(*ref));
+        srand(n);
+        for (int ix = 0; ix < n; ++ix) {
+            r[ix].prefix = rand() % (n / 3 + 1);
+            r[ix].seq = ix;
+            ref[ix] = r[ix];
+        }
+        std_merge_sort_parallel(pool, NULL, r, n, tmp, route_cmp, route_copy);
+        check_sorted(r, n);
+
+        /* same result as the sequential sort, and without a pool */
+        std_merge_sort(NULL, ref, n, tmp, route_cmp, route_copy);
+        ASSERT_EQ(memcmp(r, ref, n * sizeof(*r)), 0);
+        srand(n);
+        for (int ix = 0; ix < n; ++ix) {
+            r[ix].prefix = rand() % (n / 3 + 1);
+            r[ix].seq = ix;
+        }
+        std_merge_sort_parallel(NULL, NULL, r, n, tmp, route_cmp, route_copy);
+        ASSERT_EQ(memcmp(r, ref, n * sizeof(*r)), 0);
+        free(r);
+        free(tmp);
+        free(ref);
+    }
+    std_thread_pool_delete(pool);
+}
+
+typedef struct mac_rec_s {
+    uint16_t vlan;
+    uint8_t mac[6];
+    int64_t ifindex;
+    uint32_t seq;
+} mac_rec_t;
+
+static bool mac_less(const mac_rec_t &a, const mac_rec_t &b, int which) {
+    switch (which) {
+    case 0: return a.vlan < b.vlan;
+    case 1: return memcmp(a.mac, b.mac, 6) < 0;
+    default: return a.ifindex < b.ifindex;
+    }
+}
+
+TEST(std_mergesort_test, record_sort)
+{
+    int sizes[] = { 0, 1, 17, 63, 64, 1000, 70000 };
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(*sizes); ++s) {
+        int n = sizes[s];
+        mac_rec_t *r = (mac_rec_t *)calloc(n + 1, sizeof(*r));
+        mac_rec_t *tmp = (mac_rec_t *)calloc(n + 1, sizeof(*tmp));
+        srand(n + 7);
+        for (int which = 0; which < 3; ++which) {
+            for (int ix = 0; ix < n; ++ix) {
+                r[ix].vlan = rand() % 50;
+                r[ix].mac[0] = 0x00;
+                r[ix].mac[1] = 0x50;
+                for (int b = 2; b < 6; ++b) r[ix].mac[b] = (b == 5) ? rand() : rand() % 3;
+                r[ix].ifindex = (int64_t)(rand() % 200) - 100;
+                r[ix].seq = ix;
+            }
+            switch (which) {
+            case 0:
+                ASSERT_EQ(std_record_sort(r, n, sizeof(*r), offsetof(mac_rec_t, vlan),
+                        STD_RECORD_KEY_U16, 0, tmp), STD_ERR_OK);
+                break;
+            case 1:
+                ASSERT_EQ(std_record_sort(r, n, sizeof(*r), offsetof(mac_rec_t, mac),
+                        STD_RECORD_KEY_BYTES, 6, tmp), STD_ERR_OK);
+                break;
+            default:
+                ASSERT_EQ(std_record_sort(r, n, sizeof(*r), offsetof(mac_rec_t, ifindex),
+                        STD_RECORD_KEY_I64, 0, tmp), STD_ERR_OK);
+                break;
+            }
+            for (int ix = 1; ix < n; ++ix) {
+                ASSERT_FALSE(mac_less(r[ix], r[ix - 1], which));
+                if (!mac_less(r[ix - 1], r[ix], which)) {
+                    ASSERT_LT(r[ix - 1].seq, r[ix].seq);
+                }
+            }
+        }
+        free(r);
+        free(tmp);
+    }
+
+    uint32_t k[4];
+    ASSERT_NE(std_record_sort(k, 4, 2, 0, STD_RECORD_KEY_U32, 0, k), STD_ERR_OK);
+}
+
+TEST(std_mergesort_test, kway_merge)
+{
+    const int runs = 9;
+    route_t *r[runs];
+    std_merge_run_t in[runs];
+    int total = 0;
+
+    srand(3);
+    for (int k = 0; k < runs; ++k) {
+        int n = (k == 4) ? 0 : rand() % 500 + 1;
+        r[k] = (route_t *)malloc((n + 1) * sizeof(route_t));
+        for (int ix = 0; ix < n; ++ix) {
+            r[k][ix].prefix = rand() % 100;
+            r[k][ix].seq = total++;
+        }
+        route_t *tmp = (route_t *)malloc((n + 1) * sizeof(route_t));
+        std_merge_sort(NULL, r[k], n, tmp, route_cmp, route_copy);
+        free(tmp);
+        in[k].buffer = r[k];
+        in[k].num_elements = n;
+        in[k].read = NULL;
+        in[k].run_arg = NULL;
+    }
+
+    std_kway_merge_t *m;
+    ASSERT_EQ(std_kway_merge_create(&m, NULL, in, runs, route_cmp), STD_ERR_OK);
+    void *array;
+    int index, got = 0;
+    route_t prev = { 0, 0 };
+    while (std_kway_merge_next(m, &array, &index) == STD_ERR_OK) {
+        route_t cur = ((route_t *)array)[index];
+        if (got > 0) {
+            ASSERT_LE(prev.prefix, cur.prefix);
+            /* runs were numbered in order, so ties keep the seq order */
+            if (prev.prefix == cur.prefix) {
+                ASSERT_LT(prev.seq, cur.seq);
+            }
+        }
+        prev = cur;
+        ++got;
+    }
+    ASSERT_EQ(got, total);
+    std_kway_merge_destroy(m);
+    for (int k = 0; k < runs; ++k) free(r[k]);
+}
+
+typedef struct ext_ctx_s {
+    int produced;
+    int total;
+    int consumed;
+    route_t last;
+} ext_ctx_t;
+
+static int ext_input(void *context, void *array, int max) {
+    ext_ctx_t *c = (ext_ctx_t *)context;
+    int n = 0;
+    /* short reads on purpose */
+    if (max > 77) max = 77;
+    for ( ; n < max && c->produced < c->total; ++n, ++c->produced) {
+        ((route_t *)array)[n].prefix = rand() % 1000;
+        ((route_t *)array)[n].seq = c->produced;
+    }
+    return n;
+}
+
+static t_std_error ext_output(void *context, void *array, int index) {
+    ext_ctx_t *c = (ext_ctx_t *)context;
+    route_t cur = ((route_t *)array)[index];
+    if (c->consumed > 0) {
+        if (c->last.prefix > cur.prefix) return STD_ERR(COM,FAIL,1);
+        if (c->last.prefix == cur.prefix && c->last.seq > cur.seq) return STD_ERR(COM,FAIL,2);
+    }
+    c->last = cur;
+    c->consumed++;
+    return STD_ERR_OK;
+}
+
+TEST(std_mergesort_test, external_sort)
+{
+    /* in memory, a single run, and enough runs for several merge passes */
+    int totals[] = { 0, 250, 600, 100000 };
+    for (size_t t = 0; t < sizeof(totals) / sizeof(*totals); ++t) {
+        ext_ctx_t c;
+        memset(&c, 0, sizeof(c));
+        c.total = totals[t];
+        srand(t);
+        ASSERT_EQ(std_external_sort(&c, sizeof(route_t), 600, NULL, ext_input, ext_output,
+                route_cmp, route_copy), STD_ERR_OK);
+        ASSERT_EQ(c.consumed, c.total);
+    }
+}
+
+TEST(std_mergesort_test, external_sort_small_memory)
+{
+    /* the least memory allowed, one element per run and two way merges */
+    ext_ctx_t c;
+    memset(&c, 0, sizeof(c));
+    c.total = 1000;
+    srand(7);
+    ASSERT_EQ(std_external_sort(&c, sizeof(route_t), 3, NULL, ext_input, ext_output,
+            route_cmp, route_copy), STD_ERR_OK);
+    ASSERT_EQ(c.consumed, c.total);
+
+    memset(&c, 0, sizeof(c));
+    c.total = 10;
+    ASSERT_NE(std_external_sort(&c, sizeof(route_t), 2, NULL, ext_input, ext_output,
+            route_cmp, route_copy), STD_ERR_OK);
+    ASSERT_EQ(c.consumed, 0);
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
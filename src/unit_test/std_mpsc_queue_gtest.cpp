@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2016 Dell Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * THIS CODE IS PROVIDED ON AN *AS IS* BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT
+ * LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS
+ * FOR A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+ *
+ * See the Apache Version 2.0 License for specific language governing
+ * permissions and limitations under the License.
+ */
+
+/*
+ * filename: std_mpsc_queue_gtest.cpp
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "gtest/gtest.h"
+#include <thread>
+#include <vector>
+
+#include "std_mpsc_queue.h"
+
+typedef struct work_s {
+    std_mpsc_node_t link;
+    int producer;
+    int seq;
+} work_t;
+
+static const int producers = 4;
+static const int per_producer = 100000;
+
+static void run_producers(std_mpsc_queue_t *q, work_t *w, std::vector<std::thread> &th) {
+    for (int p = 0; p < producers; ++p) {
+        th.push_back(std::thread([=]() {
+            for (int ix = 0; ix < per_producer; ++ix) {
+                work_t *e = &w[p * per_producer + ix];
+                e->producer = p;
+                e->seq = ix;
+                std_mpsc_queue_push(q, &e->link);
+            }
+        }));
+    }
+}
+
+TEST(std_mpsc_queue_test, pop)
+{
+    std_mpsc_queue_t q;
+    ASSERT_EQ(std_mpsc_queue_init(&q, false), STD_ERR_OK);
+    ASSERT_TRUE(std_mpsc_queue_pop(&q) == NULL);
+    ASSERT_TRUE(std_mpsc_queue_pop_all(&q) == NULL);
+
+    work_t *w = (work_t *)calloc(producers * per_producer, sizeof(*w));
+    std::vector<std::thread> th;
+    run_producers(&q, w, th);
+
+    int next[producers] = { 0 };
+    int got = 0;
+    while (got < producers * per_producer) {
+        work_t *e = (work_t *)std_mpsc_queue_pop(&q);
+        if (e == NULL) continue;
+        /* each producer's elements come out in the order pushed */
+        ASSERT_EQ(e->seq, next[e->producer]);
+        next[e->producer]++;
+        ++got;
+    }
+    for (size_t ix = 0; ix < th.size(); ++ix) th[ix].join();
+    ASSERT_TRUE(std_mpsc_queue_pop(&q) == NULL);
+    std_mpsc_queue_destroy(&q);
+    free(w);
+}
+
+TEST(std_mpsc_queue_test, pop_all_wakeup)
+{
+    std_mpsc_queue_t q;
+    ASSERT_EQ(std_mpsc_queue_init(&q, true), STD_ERR_OK);
+    ASSERT_GE(std_mpsc_queue_get_fd(&q), 0);
+    ASSERT_NE(std_mpsc_queue_wait(&q, 10), STD_ERR_OK);
+
+    work_t *w = (work_t *)calloc(producers * per_producer, sizeof(*w));
+    std::vector<std::thread> th;
+    run_producers(&q, w, th);
+
+    int next[producers] = { 0 };
+    int got = 0;
+    while (got < producers * per_producer) {
+        ASSERT_EQ(std_mpsc_queue_wait(&q, 5000), STD_ERR_OK);
+        std_mpsc_node_t *n = std_mpsc_queue_pop_all(&q);
+        for ( ; n != NULL; n = n->mpsc_next) {
+            work_t *e = (work_t *)n;
+            ASSERT_EQ(e->seq, next[e->producer]);
+            next[e->producer]++;
+            ++got;
+        }
+    }
+    for (size_t ix = 0; ix < th.size(); ++ix) th[ix].join();
+
+    /* a single element can be taken with pop after being signalled */
+    std_mpsc_queue_push(&q, &w[0].link);
+    ASSERT_EQ(std_mpsc_queue_wait(&q, 1000), STD_ERR_OK);
+    ASSERT_EQ(std_mpsc_queue_pop(&q), &w[0].link);
+    ASSERT_TRUE(std_mpsc_queue_pop(&q) == NULL);
+    std_mpsc_queue_destroy(&q);
+    free(w);
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
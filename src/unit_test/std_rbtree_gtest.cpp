@@ -0,0 +1,404 @@
+/*
+ * Copyright (c) 2016 Dell Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may
+ * not use this file except in compliance with the License. You may obtain
+ * a copy of the License at http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * THIS CODE IS PROVIDED ON AN *AS IS* BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT
+ * LIMITATION ANY IMPLIED WARRANTIES OR CONDITIONS OF TITLE, FITNESS
+ * FOR A PARTICULAR PURPOSE, MERCHANTABLITY OR NON-INFRINGEMENT.
+ *
+ * See the Apache Version 2.0 License for specific language governing
+ * permissions and limitations under the License.
+ */
+
+/*
+ * filename: std_rbtree_gtest.cpp
+ */
+
+#include <stdio.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdlib.h>
+#include "gtest/gtest.h"
+#include <atomic>
+#include <thread>
+#include <vector>
+
+extern "C" {
+#include "std_rbtree.h"
+}
+
+typedef struct rbt_entry_s {
+    int key;
+    int port;
+} rbt_entry_t;
+
+/* returns the black height or -1 if the RBT invariants are broken */
+static int check_subtree(rbtree_handle rbtt, std_rbtree_node *x) {
+    if (x == &rbtt->nil) return 1;
+    if (x->rbt_color == RBT_RED &&
+        (x->rbt_left->rbt_color == RBT_RED || x->rbt_right->rbt_color == RBT_RED))
+        return -1;
+    if (x->rbt_left != &rbtt->nil && x->rbt_left->rbt_parent != x) return -1;
+    if (x->rbt_right != &rbtt->nil && x->rbt_right->rbt_parent != x) return -1;
+    int l = check_subtree(rbtt, x->rbt_left);
+    int r = check_subtree(rbtt, x->rbt_right);
+    if (l < 0 || r < 0 || l != r) return -1;
+    return l + (x->rbt_color == RBT_BLACK ? 1 : 0);
+}
+
+static bool check_tree(rbtree_handle rbtt) {
+    if (rbtt->rbtt_root == &rbtt->nil) return true;
+    if (rbtt->rbtt_root->rbt_color != RBT_BLACK) return false;
+    return check_subtree(rbtt, rbtt->rbtt_root) > 0;
+}
+
+static int count_cb(rbtree_handle rbtt, void *data, va_list ap) {
+    int *cnt = va_arg(ap, int *);
+    (*cnt)++;
+    return 0;
+}
+
+TEST(std_rbtree_test, build_sorted)
+{
+    size_t sizes[] = { 1, 2, 3, 4, 7, 8, 9, 100, 1000, 4095 };
+    for (size_t s = 0; s < sizeof(sizes)/sizeof(*sizes); ++s) {
+        size_t n = sizes[s];
+        rbt_entry_t *e = (rbt_entry_t *)calloc(n, sizeof(*e));
+        void **p = (void **)calloc(n, sizeof(*p));
+        for (size_t ix = 0; ix < n; ++ix) {
+            e[ix].key = (int)ix * 2;
+            p[ix] = &e[ix];
+        }
+
+        rbtree_handle t = std_rbtree_create((char *)"bulk", offsetof(rbt_entry_t, key),
+                sizeof(int), NULL, NULL, RBT_INT_KEY);
+        ASSERT_EQ(std_rbtree_build_sorted(t, p, n), STD_ERR_OK);
+        ASSERT_TRUE(check_tree(t));
+        ASSERT_EQ(t->rbtt_numinodes, n);
+        ASSERT_EQ(t->rbtt_nummallocs, 1);
+
+        rbt_entry_t k;
+        for (size_t ix = 0; ix < n; ++ix) {
+            k.key = (int)ix * 2;
+            ASSERT_EQ(std_rbtree_getexact(t, &k), &e[ix]);
+            k.key = (int)ix * 2 + 1;
+            ASSERT_TRUE(std_rbtree_getexact(t, &k) == NULL);
+        }
+
+        /* remove every other node then the rest, the block goes last */
+        for (size_t ix = 0; ix < n; ix += 2) {
+            ASSERT_EQ(std_rbtree_remove(t, &e[ix]), &e[ix]);
+            ASSERT_TRUE(check_tree(t));
+        }
+        for (size_t ix = 1; ix < n; ix += 2) {
+            ASSERT_EQ(std_rbtree_remove(t, &e[ix]), &e[ix]);
+        }
+        ASSERT_TRUE(std_rbtree_getfirst(t) == NULL);
+        ASSERT_EQ(t->rbtt_nummallocs, t->rbtt_numfrees);
+
+        std_rbtree_destroy(t);
+        free(p);
+        free(e);
+    }
+}
+
+TEST(std_rbtree_test, build_sorted_unsorted)
+{
+    rbt_entry_t e[3] = { {1,0}, {3,0}, {2,0} };
+    void *p[3] = { &e[0], &e[1], &e[2] };
+    rbtree_handle t = std_rbtree_create((char *)"bad", offsetof(rbt_entry_t, key),
+            sizeof(int), NULL, NULL, RBT_INT_KEY);
+    ASSERT_NE(std_rbtree_build_sorted(t, p, 3), STD_ERR_OK);
+    ASSERT_TRUE(std_rbtree_getfirst(t) == NULL);
+    std_rbtree_destroy(t);
+}
+
+TEST(std_rbtree_test, remove_range)
+{
+    const int n = 500;
+    rbt_entry_t e[n];
+    void *p[n];
+    for (int ix = 0; ix < n; ++ix) {
+        e[ix].key = ix;
+        p[ix] = &e[ix];
+    }
+
+    rbtree_handle t = std_rbtree_create((char *)"range", offsetof(rbt_entry_t, key),
+            sizeof(int), NULL, NULL, RBT_INT_KEY);
+    ASSERT_EQ(std_rbtree_build_sorted(t, p, n / 2), STD_ERR_OK);
+    for (int ix = n / 2; ix < n; ++ix) {
+        ASSERT_EQ(std_rbtree_insert(t, &e[ix]), STD_ERR_OK);
+    }
+
+    rbt_entry_t lo, hi;
+    lo.key = 100;
+    hi.key = 299;
+    int cnt = 0;
+    ASSERT_EQ(std_rbtree_remove_range(t, &lo, &hi, count_cb, &cnt), 200);
+    ASSERT_EQ(cnt, 200);
+    ASSERT_TRUE(check_tree(t));
+    ASSERT_EQ(t->rbtt_numinodes, (u_long)(n - 200));
+
+    for (int ix = 0; ix < n; ++ix) {
+        bool gone = ix >= 100 && ix <= 299;
+        ASSERT_EQ(std_rbtree_getexact(t, &e[ix]) == NULL, gone);
+    }
+
+    hi.key = 49;
+    ASSERT_EQ(std_rbtree_remove_range(t, NULL, &hi, NULL), 50);
+    ASSERT_TRUE(check_tree(t));
+    ASSERT_EQ(((rbt_entry_t *)std_rbtree_getfirst(t))->key, 50);
+
+    cnt = 0;
+    ASSERT_EQ(std_rbtree_remove_range(t, NULL, NULL, count_cb, &cnt), (u_long)(n - 250));
+    ASSERT_EQ(cnt, n - 250);
+    ASSERT_TRUE(std_rbtree_getfirst(t) == NULL);
+    ASSERT_EQ(t->rbtt_nummallocs, t->rbtt_numfrees);
+    std_rbtree_destroy(t);
+}
+
+typedef struct rbt_range_s {
+    uint16_t start;
+    uint16_t end;
+} rbt_range_t;
+
+static uint64_t check_maxend(rbtree_handle rbtt, std_rbtree_node *x, bool *ok) {
+    if (x == &rbtt->nil) return 0;
+    uint64_t m = ((rbt_range_t *)x->rbt_data)->end;
+    uint64_t l = check_maxend(rbtt, x->rbt_left, ok);
+    uint64_t r = check_maxend(rbtt, x->rbt_right, ok);
+    if (l > m) m = l;
+    if (r > m) m = r;
+    if (((std_rbtree_inode *)x)->rbi_maxend != m) *ok = false;
+    return m;
+}
+
+static int stab_cb(rbtree_handle rbtt, void *data, va_list ap) {
+    int point = va_arg(ap, int);
+    rbt_range_t *r = (rbt_range_t *)data;
+    EXPECT_TRUE(r->start <= point && point <= r->end);
+    return 0;
+}
+
+TEST(std_rbtree_test, interval)
+{
+    const int n = 2000;
+    rbt_range_t *e = (rbt_range_t *)calloc(n, sizeof(*e));
+    bool on[n];
+    srand(4094);
+
+    rbtree_handle t = std_rbtree_create_interval((char *)"vlan", offsetof(rbt_range_t, start),
+            offsetof(rbt_range_t, end), sizeof(uint16_t));
+    ASSERT_TRUE(t != NULL);
+
+    for (int ix = 0; ix < n; ++ix) {
+        e[ix].start = rand() % 4000;
+        e[ix].end = e[ix].start + rand() % 100;
+        /* some intervals more than once */
+        if (ix % 4 == 1) e[ix] = e[ix - 1];
+        ASSERT_EQ(std_rbtree_insert(t, &e[ix]), STD_ERR_OK);
+        on[ix] = true;
+    }
+    for (int ix = 0; ix < n; ix += 3) {
+        ASSERT_EQ(std_rbtree_remove(t, &e[ix]), &e[ix]);
+        on[ix] = false;
+    }
+    for (int ix = 0; ix < n; ++ix) {
+        rbt_range_t *r = (rbt_range_t *)std_rbtree_overlap_first(t, e[ix].start, e[ix].end);
+        bool seen = false;
+        for ( ; r != NULL; r = (rbt_range_t *)std_rbtree_overlap_next(t, r, e[ix].start, e[ix].end))
+            seen = seen || (r == &e[ix]);
+        ASSERT_EQ(seen, on[ix]);
+    }
+    bool ok = true;
+    check_maxend(t, t->rbtt_root, &ok);
+    ASSERT_TRUE(ok);
+    ASSERT_TRUE(check_tree(t));
+
+    for (int q = 0; q < 200; ++q) {
+        uint64_t lo = rand() % 4100;
+        uint64_t hi = lo + rand() % 20;
+        int expect = 0;
+        for (int ix = 0; ix < n; ++ix) {
+            if (on[ix] && e[ix].start <= hi && e[ix].end >= lo) ++expect;
+        }
+        int found = 0;
+        uint64_t last = 0;
+        rbt_range_t *r = (rbt_range_t *)std_rbtree_overlap_first(t, lo, hi);
+        for ( ; r != NULL; r = (rbt_range_t *)std_rbtree_overlap_next(t, r, lo, hi)) {
+            ASSERT_TRUE(r->start <= hi && r->end >= lo);
+            ASSERT_GE(r->start, last);
+            last = r->start;
+            ++found;
+        }
+        ASSERT_EQ(found, expect);
+
+        /* the node cursor finds the same intervals in the same order */
+        r = (rbt_range_t *)std_rbtree_overlap_first(t, lo, hi);
+        std_rbtree_node *x = _std_rbtree_overlap_first(t, lo, hi);
+        for ( ; x != NULL; x = _std_rbtree_overlap_next(t, x, lo, hi)) {
+            ASSERT_EQ(x->rbt_data, r);
+            r = (rbt_range_t *)std_rbtree_overlap_next(t, r, lo, hi);
+        }
+        ASSERT_TRUE(r == NULL);
+
+        expect = 0;
+        for (int ix = 0; ix < n; ++ix) {
+            if (on[ix] && e[ix].start <= lo && e[ix].end >= lo) ++expect;
+        }
+        ASSERT_EQ(std_rbtree_stab(t, lo, stab_cb, (int)lo), (u_long)expect);
+    }
+
+    ASSERT_EQ(std_rbtree_remove_range(t, NULL, NULL, NULL), (u_long)(n - (n + 2) / 3));
+    std_rbtree_destroy(t);
+    free(e);
+}
+
+TEST(std_rbtree_test, interval_build_sorted)
+{
+    const int n = 1000;
+    rbt_range_t e[n];
+    void *p[n];
+    for (int ix = 0; ix < n; ++ix) {
+        e[ix].start = ix * 4;
+        e[ix].end = ix * 4 + (ix % 7);
+        p[ix] = &e[ix];
+    }
+    rbtree_handle t = std_rbtree_create_interval((char *)"ports", offsetof(rbt_range_t, start),
+            offsetof(rbt_range_t, end), sizeof(uint16_t));
+    ASSERT_EQ(std_rbtree_build_sorted(t, p, n), STD_ERR_OK);
+    bool ok = true;
+    check_maxend(t, t->rbtt_root, &ok);
+    ASSERT_TRUE(ok);
+    ASSERT_EQ(std_rbtree_stab(t, 26, NULL), 1);  /* [24,30] */
+    ASSERT_EQ(std_rbtree_stab(t, 28, NULL), 2);  /* [24,30] [28,28] */
+    ASSERT_EQ(std_rbtree_stab(t, 29, NULL), 1);  /* [24,30] */
+    std_rbtree_destroy(t);
+}
+
+static int freed_cnt = 0;
+static void count_free(void *data) {
+    __atomic_fetch_add(&freed_cnt, 1, __ATOMIC_RELAXED);
+}
+
+TEST(std_rbtree_test, concurrent)
+{
+    /* even keys stay on the tree, odd keys come and go under the readers */
+    const int n = 2000;
+    rbt_entry_t *e = (rbt_entry_t *)calloc(n, sizeof(*e));
+    rbtree_handle t = std_rbtree_create_concurrent((char *)"rcu", offsetof(rbt_entry_t, key),
+            sizeof(int), NULL, NULL, RBT_INT_KEY);
+    ASSERT_TRUE(t != NULL);
+    for (int ix = 0; ix < n; ++ix) {
+        e[ix].key = ix;
+        e[ix].port = ix * 10;
+        if ((ix & 1) == 0) ASSERT_EQ(std_rbtree_insert(t, &e[ix]), STD_ERR_OK);
+    }
+
+    std::atomic<bool> done(false);
+    std::atomic<int> errors(0);
+    std::vector<std::thread> readers;
+    for (int r = 0; r < 4; ++r) {
+        readers.push_back(std::thread([&, r]() {
+            rbt_entry_t k;
+            unsigned seed = r;
+            while (!done) {
+                k.key = rand_r(&seed) % n;
+                std_rbtree_read_lock(t);
+                rbt_entry_t *p = (rbt_entry_t *)std_rbtree_getexact(t, &k);
+                if ((k.key & 1) == 0 && (!p || p->port != k.key * 10)) errors++;
+                if (p && p->key != k.key) errors++;
+                p = (rbt_entry_t *)std_rbtree_getexactornext(t, &k);
+                if (k.key < n - 2 && (!p || p->key < k.key || p->key > k.key + 1)) errors++;
+                p = (rbt_entry_t *)std_rbtree_getnext(t, &k);
+                if (k.key < n - 2 && (!p || p->key <= k.key || p->key > k.key + 2)) errors++;
+                p = (rbt_entry_t *)std_rbtree_getfirst(t);
+                if (!p || p->key > 1) errors++;
+                std_rbtree_read_unlock(t);
+            }
+        }));
+    }
+
+    for (int round = 0; round < 20; ++round) {
+        for (int ix = 1; ix < n; ix += 2) {
+            ASSERT_EQ(std_rbtree_insert(t, &e[ix]), STD_ERR_OK);
+        }
+        for (int ix = 1; ix < n; ix += 2) {
+            ASSERT_EQ(std_rbtree_remove(t, &e[ix]), &e[ix]);
+        }
+    }
+    done = true;
+    for (size_t r = 0; r < readers.size(); ++r) readers[r].join();
+    ASSERT_EQ(errors, 0);
+    ASSERT_TRUE(check_tree(t));
+
+    /* removed user nodes are handed back once the readers are gone */
+    rbt_entry_t *extra = (rbt_entry_t *)malloc(sizeof(*extra));
+    extra->key = n + 1;
+    ASSERT_EQ(std_rbtree_insert(t, extra), STD_ERR_OK);
+    ASSERT_EQ(std_rbtree_remove(t, extra), extra);
+    ASSERT_EQ(std_rbtree_defer_free(t, extra, free), STD_ERR_OK);
+    freed_cnt = 0;
+    rbt_entry_t *gone = (rbt_entry_t *)malloc(sizeof(*gone));
+    ASSERT_EQ(std_rbtree_defer_free(t, gone, count_free), STD_ERR_OK);
+
+    ASSERT_EQ(std_rbtree_remove_range(t, NULL, NULL, NULL), (u_long)(n / 2));
+    std_rbtree_synchronize(t);
+    ASSERT_EQ(freed_cnt, 1);
+    free(gone);
+    ASSERT_EQ(t->rbtt_nummallocs, t->rbtt_numfrees);
+    std_rbtree_destroy(t);
+    free(e);
+}
+
+static std::atomic<int> stall_state(0);
+static int stall_cb(rbtree_handle rbtt, void *data, va_list ap) {
+    stall_state = 1;
+    while (stall_state != 2) std::this_thread::yield();
+    return 1;
+}
+
+TEST(std_rbtree_test, concurrent_stalled_writer)
+{
+    /* lookups go on while a writer sits in a remove callback */
+    const int n = 100;
+    rbt_entry_t *e = (rbt_entry_t *)calloc(n, sizeof(*e));
+    rbtree_handle t = std_rbtree_create_concurrent((char *)"stall", offsetof(rbt_entry_t, key),
+            sizeof(int), NULL, NULL, RBT_INT_KEY);
+    for (int ix = 0; ix < n; ++ix) {
+        e[ix].key = ix;
+        ASSERT_EQ(std_rbtree_insert(t, &e[ix]), STD_ERR_OK);
+    }
+
+    rbt_entry_t lo;
+    lo.key = 10;
+    std::thread writer([&]() { std_rbtree_remove_range(t, &lo, NULL, stall_cb); });
+    while (stall_state != 1) std::this_thread::yield();
+
+    rbt_entry_t k;
+    for (k.key = 0; k.key < n; ++k.key) {
+        ASSERT_EQ(std_rbtree_getexact(t, &k), (k.key == 10) ? NULL : &e[k.key]);
+    }
+    k.key = 10;
+    ASSERT_EQ(std_rbtree_getexactornext(t, &k), &e[11]);
+    ASSERT_EQ(std_rbtree_getexactorprev(t, &k), &e[9]);
+    k.key = 9;
+    ASSERT_EQ(std_rbtree_getnext(t, &k), &e[11]);
+    ASSERT_EQ(std_rbtree_getfirst(t), &e[0]);
+
+    stall_state = 2;
+    writer.join();
+    ASSERT_EQ(std_rbtree_remove_range(t, NULL, NULL, NULL), (u_long)(n - 1));
+    std_rbtree_synchronize(t);
+    std_rbtree_destroy(t);
+    free(e);
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
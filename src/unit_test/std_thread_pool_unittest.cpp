@@ -26,6 +26,9 @@
 #include <unistd.h>
 #include "std_thread_pool.h"
 
+#include <vector>
+#include <algorithm>
+
 std_mutex_lock_create_static_init_rec(lock);
 static volatile int count = 0;
 
@@ -73,6 +76,59 @@ TEST(std_thread_pool_create, create)
     test();
 }
 
+static int freed = 0;
+
+static void slow_job(void *param) {
+    usleep(1000);
+}
+
+static void count_free(void *param) {
+    __atomic_add_fetch(&freed,1,__ATOMIC_RELAXED);
+}
+
+TEST(std_thread_pool_create, delete_frees_queued)
+{
+    std_thread_create_param_t param;
+    std_thread_init_struct(&param);
+    param.name = "queued";
+    std_thread_pool_handle_t handle;
+    ASSERT_EQ(std_thread_pool_create(&handle,&param,1),STD_ERR_OK);
+
+    std_thread_pool_job_t j;
+    j.context = NULL;
+    j.funct = slow_job;
+    j.free_job_func = count_free;
+    for (size_t ix = 0; ix < 100 ; ++ix ) {
+        ASSERT_EQ(std_thread_pool_job_add(handle,&j),STD_ERR_OK);
+    }
+    std_thread_pool_delete(handle);
+    ASSERT_EQ(__atomic_load_n(&freed,__ATOMIC_RELAXED),100);
+}
+
+static void count_task(void *context, size_t ix) {
+    __atomic_add_fetch(&((int*)context)[ix],1,__ATOMIC_RELAXED);
+}
+
+TEST(std_thread_pool_create, run_tasks)
+{
+    std_thread_create_param_t param;
+    std_thread_init_struct(&param);
+    param.name = "tasks";
+    std_thread_pool_handle_t handle;
+    ASSERT_EQ(std_thread_pool_create(&handle,&param,4),STD_ERR_OK);
+
+    /* every task runs once, with the pool or without */
+    size_t sizes[] = { 0, 1, 2, 5, 1000 };
+    for (size_t ix = 0; ix < sizeof(sizes)/sizeof(*sizes) ; ++ix ) {
+        std::vector<int> runs(sizes[ix]+1,0);
+        std_thread_pool_run_tasks(handle,sizes[ix],count_task,&runs[0]);
+        ASSERT_EQ(std::count(runs.begin(),runs.end(),1),(long)sizes[ix]);
+        std_thread_pool_run_tasks(NULL,sizes[ix],count_task,&runs[0]);
+        ASSERT_EQ(std::count(runs.begin(),runs.end(),2),(long)sizes[ix]);
+    }
+    std_thread_pool_delete(handle);
+}
+
 
 
 int main(int argc, char **argv) {
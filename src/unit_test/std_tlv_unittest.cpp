@@ -22,6 +22,12 @@
 
 #include "gtest/gtest.h"
 #include "std_tlv.h"
+#include "std_tlv_index.h"
+#include "std_tlv_compact.h"
+#include "std_tlv_sg.h"
+#include "std_tlv_schema.h"
+#include <unistd.h>
+#include <vector>
 
 
 TEST(std_tlv,tlv_create ) {
@@ -81,6 +87,341 @@ TEST(std_tlv,tlv_create_list ) {
 	ASSERT_TRUE(count == ix);
 }
 
+/* an object of 300 attributes, some repeated, and two levels of nested ones */
+static size_t tlv_build_object(char *buff, size_t size) {
+	char inner[256], mid[1024];
+	size_t ilen = sizeof(inner), mlen = sizeof(mid), len = size;
+	void *p = inner;
+	p = std_tlv_add_u32(p,&ilen,7,77);
+	p = std_tlv_add_u32(p,&ilen,8,88);
+	ilen = sizeof(inner) - ilen;
+
+	p = mid;
+	p = std_tlv_add_u16(p,&mlen,5,55);
+	p = std_tlv_add(p,&mlen,6,ilen,inner);
+	p = std_tlv_add(p,&mlen,6,ilen,inner);
+	mlen = sizeof(mid) - mlen;
+
+	p = buff;
+	for (size_t ix = 0; ix < 300; ++ix) {
+		p = std_tlv_add_u64(p,&len,ix % 250,ix);
+		if (ix == 100) p = std_tlv_add(p,&len,1000,mlen,mid);
+	}
+	return size - len;
+}
+
+TEST(std_tlv,tlv_index ) {
+	static char buff[16384];
+	size_t len = tlv_build_object(buff,sizeof(buff));
+
+	std_tlv_index_t *index;
+	ASSERT_EQ(std_tlv_index_create(&index,buff,len),STD_ERR_OK);
+
+	for (std_tlv_tag_t tag = 0; tag < 260; ++tag) {
+		size_t dlen = len;
+		void *first = std_tlv_find_next(buff,&dlen,tag);
+		ASSERT_EQ(std_tlv_index_find(index,tag),first);
+
+		/* every instance in buffer order */
+		size_t n = 0;
+		for (void *tlv = first; tlv != NULL; ++n) {
+			ASSERT_EQ(std_tlv_index_find_nth(index,tag,n),tlv);
+			tlv = std_tlv_next(tlv,&dlen);
+			tlv = (tlv == NULL) ? NULL : std_tlv_find_next(tlv,&dlen,tag);
+		}
+		ASSERT_EQ(std_tlv_index_count(index,tag),n);
+		ASSERT_TRUE(std_tlv_index_find_nth(index,tag,n) == NULL);
+	}
+
+	/* nested paths match std_tlv_efind, found or not */
+	std_tlv_tag_t paths[][3] = { {1000,5,0}, {1000,6,8}, {1000,6,7}, {1000,6,9},
+		{1000,9,7}, {3,1,0}, {1000,6,0} };
+	size_t plen[] = { 2, 3, 3, 3, 3, 2, 2 };
+	for (int round = 0; round < 2; ++round) {
+		for (size_t ix = 0; ix < sizeof(plen) / sizeof(*plen); ++ix) {
+			size_t elen = len, ilen = 0;
+			void *want = std_tlv_efind(buff,&elen,paths[ix],plen[ix]);
+			ASSERT_EQ(std_tlv_index_efind(index,paths[ix],plen[ix],&ilen),want);
+			if (want != NULL) {
+				ASSERT_EQ(ilen,elen);
+			}
+		}
+	}
+	std_tlv_index_destroy(index);
+
+	/* a length running past the end, and a partial header */
+	ASSERT_NE(std_tlv_index_create(&index,buff,len - 1),STD_ERR_OK);
+	ASSERT_NE(std_tlv_index_create(&index,buff,len + 3),STD_ERR_OK);
+	ASSERT_EQ(std_tlv_index_create(&index,buff,0),STD_ERR_OK);
+	ASSERT_TRUE(std_tlv_index_find(index,0) == NULL);
+	std_tlv_index_destroy(index);
+}
+
+TEST(std_tlv,tlv_compact ) {
+	char buff[1024];
+	size_t len = sizeof(buff);
+	void * p = std_tlv_format_set(buff,&len,STD_TLV_FORMAT_COMPACT);
+	p = std_tlv_compact_add(p,&len,0,6,(void*)"Cliff");
+	p = std_tlv_compact_add_u16(p,&len,1,1);
+	p = std_tlv_compact_add_u32(p,&len,200,0x12345678);
+	p = std_tlv_compact_add_u64(p,&len,1ULL << 40,3);
+	ASSERT_TRUE(p != NULL);
+	len = sizeof(buff) - len;
+	/* 1 + (2+6) + (2+2) + (3+4) + (7+8) against 4 x 16 + 20 */
+	ASSERT_EQ(len,35);
+
+	void *ptr;
+	ASSERT_EQ(std_tlv_format_get(buff,&len,&ptr),STD_TLV_FORMAT_COMPACT);
+	ASSERT_EQ(std_tlv_compact_tag(ptr),0);
+	ASSERT_EQ(std_tlv_compact_len(ptr),6);
+	ASSERT_STREQ((char*)std_tlv_compact_data(ptr),"Cliff");
+	ptr = std_tlv_compact_next(ptr,&len);
+	ASSERT_EQ(std_tlv_compact_data_u16(ptr),1);
+	ptr = std_tlv_compact_next(ptr,&len);
+	ASSERT_EQ(std_tlv_compact_tag(ptr),200);
+	ASSERT_EQ(std_tlv_compact_data_u32(ptr),0x12345678);
+	ptr = std_tlv_compact_next(ptr,&len);
+	ASSERT_EQ(std_tlv_compact_tag(ptr),1ULL << 40);
+	ASSERT_EQ(std_tlv_compact_data_u64(ptr),3);
+	ptr = std_tlv_compact_next(ptr,&len);
+	ASSERT_EQ(len,0);
+
+	/* short, cut and overlong varints */
+	uint64_t v;
+	uint8_t bad[11];
+	memset(bad,0xff,sizeof(bad));
+	ASSERT_EQ(std_tlv_varint_get(bad,sizeof(bad),&v),0);
+	ASSERT_EQ(std_tlv_varint_put(bad,UINT64_MAX),10);
+	ASSERT_EQ(std_tlv_varint_get(bad,10,&v),10);
+	ASSERT_EQ(v,UINT64_MAX);
+	ASSERT_EQ(std_tlv_varint_get(bad,9,&v),0);
+	/* a 10th byte with more than bit 63, or that goes on */
+	bad[9] = 0x02;
+	ASSERT_EQ(std_tlv_varint_get(bad,10,&v),0);
+	bad[9] = 0x81;
+	ASSERT_EQ(std_tlv_varint_get(bad,11,&v),0);
+	bad[9] = 0x00;
+	ASSERT_EQ(std_tlv_varint_get(bad,10,&v),10);
+	ASSERT_EQ(v,UINT64_MAX >> 1);
+	ASSERT_FALSE(std_tlv_compact_valid(buff + 1,7));
+}
+
+TEST(std_tlv,tlv_convert ) {
+	static char fixed[16384], compact[16384], back[16384];
+	size_t len = tlv_build_object(fixed,sizeof(fixed));
+
+	size_t clen = 0;
+	ASSERT_EQ(std_tlv_to_compact(NULL,&clen,fixed,len),STD_ERR_OK);
+	size_t small = clen - 1;
+	ASSERT_NE(std_tlv_to_compact(compact,&small,fixed,len),STD_ERR_OK);
+	size_t clen2 = sizeof(compact);
+	ASSERT_EQ(std_tlv_to_compact(compact,&clen2,fixed,len),STD_ERR_OK);
+	ASSERT_EQ(clen,clen2);
+	ASSERT_LT(clen * 2,len);
+
+	/* same attributes found either way */
+	for (std_tlv_tag_t tag = 0; tag < 260; ++tag) {
+		size_t flen = len, cl = clen;
+		void *f = std_tlv_find_next(fixed,&flen,tag);
+		void *c = std_tlv_compact_find_next(compact,&cl,tag);
+		ASSERT_EQ(f == NULL,c == NULL);
+		if (f == NULL) continue;
+		ASSERT_EQ(std_tlv_len(f),std_tlv_compact_len(c));
+		ASSERT_EQ(memcmp(std_tlv_data(f),std_tlv_compact_data(c),std_tlv_len(f)),0);
+	}
+
+	size_t blen = sizeof(back);
+	ASSERT_EQ(std_tlv_from_compact(back,&blen,compact,clen),STD_ERR_OK);
+	ASSERT_EQ(blen,len);
+	ASSERT_EQ(memcmp(back,fixed,len),0);
+
+	ASSERT_NE(std_tlv_to_compact(NULL,&clen,fixed,len - 1),STD_ERR_OK);
+	ASSERT_NE(std_tlv_from_compact(NULL,&blen,compact,clen - 1),STD_ERR_OK);
+}
+
+TEST(std_tlv,tlv_sg ) {
+	static char table[100000], flat[120000], want[120000];
+	for (size_t ix = 0; ix < sizeof(table); ++ix) table[ix] = (char)ix;
+
+	std_tlv_sg_t sg;
+	std_tlv_sg_init(&sg);
+	for (int round = 0; round < 2; ++round) {
+		/* the same message built into one buffer */
+		size_t len = sizeof(want);
+		void *p = want;
+		p = std_tlv_add_u32(p,&len,1,round);
+		p = std_tlv_add(p,&len,2,6,(void*)"Cliff");
+		p = std_tlv_add(p,&len,3,sizeof(table),table);
+		char nest[512];
+		size_t nlen = sizeof(nest);
+		void *q = std_tlv_add_u16(nest,&nlen,5,55);
+		q = std_tlv_add(q,&nlen,6,300,table);
+		nlen = sizeof(nest) - nlen;
+		p = std_tlv_add(p,&len,4,nlen,nest);
+		p = std_tlv_add_u64(p,&len,7,77);
+		len = sizeof(want) - len;
+
+		std_tlv_sg_nest_t n;
+		ASSERT_EQ(std_tlv_sg_add_u32(&sg,1,round),STD_ERR_OK);
+		ASSERT_EQ(std_tlv_sg_add(&sg,2,6,"Cliff"),STD_ERR_OK);
+		ASSERT_EQ(std_tlv_sg_add(&sg,3,sizeof(table),table),STD_ERR_OK);
+		ASSERT_EQ(std_tlv_sg_nest_begin(&sg,4,&n),STD_ERR_OK);
+		ASSERT_EQ(std_tlv_sg_add_u16(&sg,5,55),STD_ERR_OK);
+		ASSERT_EQ(std_tlv_sg_add(&sg,6,300,table),STD_ERR_OK);
+		std_tlv_sg_nest_end(&sg,&n);
+		ASSERT_EQ(std_tlv_sg_add_u64(&sg,7,77),STD_ERR_OK);
+
+		ASSERT_EQ(std_tlv_sg_len(&sg),len);
+		ASSERT_NE(std_tlv_sg_copy_out(&sg,flat,len - 1),STD_ERR_OK);
+		ASSERT_EQ(std_tlv_sg_copy_out(&sg,flat,sizeof(flat)),STD_ERR_OK);
+		ASSERT_EQ(memcmp(flat,want,len),0);
+
+		/* headers and short data share iovecs, long data is not copied */
+		size_t num;
+		const struct iovec *iov = std_tlv_sg_iov(&sg,&num);
+		ASSERT_EQ(num,5);
+		ASSERT_TRUE(iov[1].iov_base == table);
+		ASSERT_TRUE(iov[3].iov_base == table);
+
+		/* the iovecs go out in one writev */
+		char path[] = "/tmp/tlv_sgXXXXXX";
+		int fd = mkstemp(path);
+		ASSERT_GE(fd,0);
+		unlink(path);
+		ASSERT_EQ(writev(fd,iov,num),(ssize_t)len);
+		std::vector<char> got(len);
+		ASSERT_EQ(pread(fd,&got[0],len,0),(ssize_t)len);
+		close(fd);
+		ASSERT_EQ(memcmp(&got[0],want,len),0);
+
+		std_tlv_sg_reset(&sg);
+		ASSERT_EQ(std_tlv_sg_len(&sg),0);
+	}
+	std_tlv_sg_destroy(&sg);
+}
+
+typedef struct {
+	uint8_t admin;
+	uint16_t vlan;
+	uint32_t ip;
+	uint64_t speed;
+	uint8_t mac[6];
+	char name[16];
+	uint32_t mtu;
+} intf_t;
+
+TEST(std_tlv,tlv_schema ) {
+	const std_tlv_tag_t big = 0x100000000ULL;
+	for (int hashed = 0; hashed < 2; ++hashed) {
+		std_tlv_tag_t t0 = hashed ? big : 0;
+		std_tlv_field_t fields[] = {
+			STD_TLV_FIELD(t0 + 1, STD_TLV_FIELD_UINT, intf_t, admin, STD_TLV_FIELD_REQUIRED),
+			STD_TLV_FIELD(t0 + 2, STD_TLV_FIELD_UINT, intf_t, vlan, 0),
+			STD_TLV_FIELD(t0 + 3, STD_TLV_FIELD_UINT, intf_t, ip, STD_TLV_FIELD_BE),
+			STD_TLV_FIELD(t0 + 4, STD_TLV_FIELD_UINT, intf_t, speed, 0),
+			STD_TLV_FIELD(t0 + 5, STD_TLV_FIELD_BYTES, intf_t, mac, 0),
+			STD_TLV_FIELD(t0 + 6, STD_TLV_FIELD_STRING, intf_t, name, STD_TLV_FIELD_REQUIRED),
+			STD_TLV_FIELD(t0 + 7, STD_TLV_FIELD_UINT, intf_t, mtu, 0),
+		};
+		std_tlv_schema_t *s;
+		ASSERT_EQ(std_tlv_schema_create(&s,fields,sizeof(fields)/sizeof(*fields)),STD_ERR_OK);
+
+		/* as it would be written by hand, with a tag the schema does not know */
+		char buff[1000];
+		size_t len = sizeof(buff);
+		void *p = buff;
+		uint32_t ip = htobe32(0x0a000001);
+		p = std_tlv_add_u16(p,&len,t0 + 2,100);
+		p = std_tlv_add(p,&len,t0 + 99,3,(void*)"xyz");
+		p = std_tlv_add(p,&len,t0 + 3,sizeof(ip),&ip);
+		p = std_tlv_add(p,&len,t0 + 6,6,(void*)"Cliff");
+		p = std_tlv_add(p,&len,t0 + 1,1,(void*)"\1");
+		p = std_tlv_add_u64(p,&len,t0 + 4,25000000000ULL);
+		p = std_tlv_add(p,&len,t0 + 5,6,(void*)"\x00\x50\x56\x01\x02\x03");
+		p = std_tlv_add_u16(p,&len,t0 + 2,200);
+		len = sizeof(buff) - len;
+
+		intf_t a;
+		memset(&a,0xee,sizeof(a));
+		a.mtu = 1500;
+		uint64_t present;
+		ASSERT_EQ(std_tlv_schema_decode(s,buff,len,&a,&present),STD_ERR_OK);
+		ASSERT_EQ(present,0x3fULL);
+		ASSERT_EQ(a.admin,1);
+		ASSERT_EQ(a.vlan,100);
+		ASSERT_EQ(a.ip,0x0a000001U);
+		ASSERT_EQ(a.speed,25000000000ULL);
+		ASSERT_EQ(memcmp(a.mac,"\x00\x50\x56\x01\x02\x03",6),0);
+		ASSERT_EQ(memcmp(a.name,"Cliff\0\0\0\0\0\0\0\0\0\0",16),0);
+		ASSERT_EQ(a.mtu,1500);
+
+		/* encode back, the optional mtu left out and then in */
+		char out[1000];
+		size_t olen;
+		ASSERT_EQ(std_tlv_schema_encode(s,&a,present,NULL,&olen),STD_ERR_OK);
+		olen--;
+		ASSERT_NE(std_tlv_schema_encode(s,&a,present,out,&olen),STD_ERR_OK);
+		olen = sizeof(out);
+		ASSERT_EQ(std_tlv_schema_encode(s,&a,present,out,&olen),STD_ERR_OK);
+		ASSERT_EQ(olen,6 * STD_TLV_HDR_LEN + 1 + 2 + 4 + 8 + 6 + 6);
+		size_t flen = olen;
+		ASSERT_TRUE(std_tlv_find_next(out,&flen,t0 + 7) == NULL);
+		flen = olen;
+		void *tlv = std_tlv_find_next(out,&flen,t0 + 3);
+		ASSERT_TRUE(tlv != NULL);
+		ASSERT_EQ(memcmp(std_tlv_data(tlv),&ip,4),0);
+
+		olen = sizeof(out);
+		ASSERT_EQ(std_tlv_schema_encode(s,&a,~0ULL,out,&olen),STD_ERR_OK);
+		intf_t b;
+		memset(&b,0,sizeof(b));
+		ASSERT_EQ(std_tlv_schema_decode(s,out,olen,&b,&present),STD_ERR_OK);
+		ASSERT_EQ(present,0x7fULL);
+		ASSERT_EQ(b.admin,a.admin);
+		ASSERT_EQ(b.vlan,a.vlan);
+		ASSERT_EQ(b.ip,a.ip);
+		ASSERT_EQ(b.speed,a.speed);
+		ASSERT_EQ(memcmp(b.mac,a.mac,6),0);
+		ASSERT_STREQ(b.name,a.name);
+		ASSERT_EQ(b.mtu,a.mtu);
+
+		/* only the required fields */
+		olen = sizeof(out);
+		ASSERT_EQ(std_tlv_schema_encode(s,&a,0,out,&olen),STD_ERR_OK);
+		ASSERT_EQ(olen,2 * STD_TLV_HDR_LEN + 1 + 6);
+
+		/* a missing required field, a bad length, a TLV past the end */
+		ASSERT_NE(std_tlv_schema_decode(s,buff,STD_TLV_HDR_LEN + 2,&b,NULL),STD_ERR_OK);
+		char bad[100];
+		len = sizeof(bad);
+		p = std_tlv_add_u32(bad,&len,t0 + 1,1);
+		ASSERT_NE(std_tlv_schema_decode(s,bad,sizeof(bad) - len,&b,NULL),STD_ERR_OK);
+		len = sizeof(bad);
+		p = std_tlv_add(bad,&len,t0 + 6,16,(void*)"0123456789abcdef");
+		ASSERT_NE(std_tlv_schema_decode(s,bad,sizeof(bad) - len,&b,NULL),STD_ERR_OK);
+		ASSERT_NE(std_tlv_schema_decode(s,buff,len - 1,&b,NULL),STD_ERR_OK);
+
+		/* a string that does not fit is not encoded */
+		memset(b.name,'x',sizeof(b.name));
+		ASSERT_NE(std_tlv_schema_encode(s,&b,0,NULL,&olen),STD_ERR_OK);
+		std_tlv_schema_destroy(s);
+	}
+
+	/* schemas that are not valid */
+	std_tlv_field_t twice[] = {
+		STD_TLV_FIELD(1, STD_TLV_FIELD_UINT, intf_t, admin, 0),
+		STD_TLV_FIELD(1, STD_TLV_FIELD_UINT, intf_t, vlan, 0),
+	};
+	std_tlv_schema_t *s;
+	ASSERT_NE(std_tlv_schema_create(&s,twice,2),STD_ERR_OK);
+	twice[0].tag = twice[1].tag = big;
+	ASSERT_NE(std_tlv_schema_create(&s,twice,2),STD_ERR_OK);
+	std_tlv_field_t wide[] = {
+		STD_TLV_FIELD(1, STD_TLV_FIELD_UINT, intf_t, mac, 0),
+	};
+	ASSERT_NE(std_tlv_schema_create(&s,wide,1),STD_ERR_OK);
+}
+
 int main(int argc, char **argv) {
   ::testing::InitGoogleTest(&argc, argv);
   return RUN_ALL_TESTS();